@@ -0,0 +1,284 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * executor_bench.c
+ *
+ * Compares dispatching tasks through a GThreadPool with the work-stealing
+ * SIBExecutor, and with the path of a request: the priority queues of a
+ * SIB's SIBScheduler in front of the shared executor, as in
+ * serverthread_push(). Producer and worker counts are varied separately,
+ * 1, 2, 4, ... up to their maximum. Reports the cost of a submit, the
+ * throughput and the latency from submit to start of the task.
+ *
+ * Usage: executor-bench [tasks per producer] [max producers] [max workers]
+ *                       [task work us]
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "sib_executor.h"
+#include "sib_scheduler.h"
+
+#define BENCH_TASKS 20000
+#define BENCH_MAX_THREADS 64
+#define BENCH_WORK_US 0
+/** SIBs the scheduler runs spread the producers over */
+#define BENCH_SIBS 4
+
+typedef enum _BenchKind
+  {
+    BenchKindPool,
+    BenchKindExecutor,
+    BenchKindScheduler
+  } BenchKind;
+
+static const gchar *bench_kind_names[] = { "pool", "executor", "scheduler" };
+
+typedef struct _BenchTask
+{
+  gdouble submitted;
+  gdouble latency;
+} BenchTask;
+
+typedef struct _BenchProducer
+{
+  BenchKind kind;
+  GThreadPool *pool;
+  SIBExecutor *executor;
+  SIBScheduler *scheduler;
+  BenchTask *tasks;
+  gint count;
+  gdouble enqueue;  /* seconds spent submitting */
+} BenchProducer;
+
+/* Shared by all threads of a run */
+static GTimer *bench_clock = NULL;
+static volatile gint bench_go = 0;
+static volatile gint bench_done = 0;
+static gint bench_work_us = BENCH_WORK_US;
+
+static void bench_task(BenchTask *task)
+{
+  gdouble start = g_timer_elapsed(bench_clock, NULL);
+
+  task->latency = start - task->submitted;
+  if(bench_work_us > 0)
+    {
+      while((g_timer_elapsed(bench_clock, NULL) - start) * G_USEC_PER_SEC < bench_work_us)
+	;
+    }
+  g_atomic_int_inc(&bench_done);
+}
+
+static void bench_pool_func(gpointer data, gpointer user_data)
+{
+  bench_task((BenchTask *)data);
+}
+
+static void bench_executor_func(gpointer data)
+{
+  bench_task((BenchTask *)data);
+}
+
+static void bench_scheduler_func(gpointer data, gpointer user_data)
+{
+  bench_task((BenchTask *)data);
+}
+
+static gpointer bench_producer(gpointer data)
+{
+  BenchProducer *p = (BenchProducer *)data;
+  GTimer *timer = NULL;
+  gint i;
+
+  while(g_atomic_int_get(&bench_go) == 0)
+    g_thread_yield();
+
+  timer = g_timer_new();
+  for(i = 0; i < p->count; i++)
+    {
+      p->tasks[i].submitted = g_timer_elapsed(bench_clock, NULL);
+      if(p->kind == BenchKindPool)
+	g_thread_pool_push(p->pool, &p->tasks[i], NULL);
+      else if(p->kind == BenchKindExecutor)
+	sib_executor_submit(p->executor, bench_executor_func, &p->tasks[i]);
+      else
+	sib_scheduler_push(p->scheduler, i % SIBSchedulerClassCount, &p->tasks[i]);
+    }
+  p->enqueue = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+
+  return NULL;
+}
+
+static gint bench_compare_double(gconstpointer a, gconstpointer b)
+{
+  gdouble x = *(const gdouble *)a;
+  gdouble y = *(const gdouble *)b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+/**
+ * Run count tasks from each of nproducers producers on nworkers workers.
+ */
+static void bench_run(BenchKind kind, gint nproducers, gint nworkers, gint count)
+{
+  BenchProducer *producers = NULL;
+  GThread **ids = NULL;
+  BenchTask *tasks = NULL;
+  GArray *us = NULL;
+  GThreadPool *pool = NULL;
+  SIBExecutor *executor = NULL;
+  SIBScheduler *schedulers[BENCH_SIBS];
+  gdouble start;
+  gdouble wall;
+  gdouble enqueue = 0;
+  gint total = nproducers * count;
+  gint i;
+
+  if(kind == BenchKindPool)
+    pool = g_thread_pool_new(bench_pool_func, NULL, nworkers, FALSE, NULL);
+  else
+    executor = sib_executor_new(nworkers);
+  for(i = 0; kind == BenchKindScheduler && i < BENCH_SIBS; i++)
+    schedulers[i] = sib_scheduler_new(executor, bench_scheduler_func, NULL, nworkers, 0);
+
+  tasks = g_new0(BenchTask, total);
+  producers = g_new0(BenchProducer, nproducers);
+  ids = g_new0(GThread *, nproducers);
+
+  bench_go = 0;
+  bench_done = 0;
+  for(i = 0; i < nproducers; i++)
+    {
+      producers[i].kind = kind;
+      producers[i].pool = pool;
+      producers[i].executor = executor;
+      if(kind == BenchKindScheduler)
+	producers[i].scheduler = schedulers[i % BENCH_SIBS];
+      producers[i].tasks = tasks + i * count;
+      producers[i].count = count;
+      ids[i] = g_thread_create(bench_producer, &producers[i], TRUE, NULL);
+    }
+
+  start = g_timer_elapsed(bench_clock, NULL);
+  g_atomic_int_inc(&bench_go);
+  for(i = 0; i < nproducers; i++)
+    {
+      g_thread_join(ids[i]);
+      enqueue += producers[i].enqueue;
+    }
+  while(g_atomic_int_get(&bench_done) < total)
+    g_usleep(100);
+  wall = g_timer_elapsed(bench_clock, NULL) - start;
+
+  for(i = 0; kind == BenchKindScheduler && i < BENCH_SIBS; i++)
+    sib_scheduler_destroy(schedulers[i]);
+  if(kind == BenchKindPool)
+    g_thread_pool_free(pool, FALSE, TRUE);
+  else
+    sib_executor_destroy(executor);
+
+  us = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), total);
+  for(i = 0; i < total; i++)
+    {
+      gdouble latency = tasks[i].latency * G_USEC_PER_SEC;
+      g_array_append_val(us, latency);
+    }
+  g_array_sort(us, bench_compare_double);
+
+  g_print("%-9s %2d producers %2d workers: enqueue %7.0f ns/task, %9.0f tasks/s, "
+	  "latency p50 %8.1f us, p99 %8.1f us, max %8.1f us\n",
+	  bench_kind_names[kind], nproducers, nworkers,
+	  enqueue * 1e9 / total, total / wall,
+	  g_array_index(us, gdouble, total / 2),
+	  g_array_index(us, gdouble, (total * 99) / 100),
+	  g_array_index(us, gdouble, total - 1));
+
+  g_array_free(us, TRUE);
+  g_free(ids);
+  g_free(producers);
+  g_free(tasks);
+}
+
+int main(int argc, char **argv)
+{
+  gint count = BENCH_TASKS;
+  gint max_producers = BENCH_MAX_THREADS;
+  gint max_workers = BENCH_MAX_THREADS;
+  gint nproducers;
+  gint nworkers;
+
+  if(argc > 1)
+    count = atoi(argv[1]);
+  if(argc > 2)
+    max_producers = atoi(argv[2]);
+  if(argc > 3)
+    max_workers = atoi(argv[3]);
+  if(argc > 4)
+    bench_work_us = atoi(argv[4]);
+  if(count <= 0 || max_producers <= 0 || max_workers <= 0 || bench_work_us < 0)
+    {
+      g_printerr("Usage: %s [tasks per producer] [max producers] [max workers] "
+		 "[task work us]\n", argv[0]);
+      return 1;
+    }
+
+  g_thread_init(NULL);
+  bench_clock = g_timer_new();
+
+  g_print("%d tasks per producer, %d us of work per task\n", count, bench_work_us);
+  for(nproducers = 1; nproducers <= max_producers; nproducers *= 2)
+    {
+      for(nworkers = 1; nworkers <= max_workers; nworkers *= 2)
+	{
+	  bench_run(BenchKindPool, nproducers, nworkers, count);
+	  bench_run(BenchKindExecutor, nproducers, nworkers, count);
+	  bench_run(BenchKindScheduler, nproducers, nworkers, count);
+	}
+    }
+
+  g_timer_destroy(bench_clock);
+  return 0;
+}
@@ -0,0 +1,219 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * framing_bench.c
+ *
+ * Compares receiving SSAP messages section by section with framing them
+ * first and parsing each complete message once.
+ *
+ * Usage: framing-bench [triples] [chunk size] [rounds]
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <sibmsg.h>
+
+#include "sib_framer.h"
+
+#define BENCH_TRIPLES 1000
+#define BENCH_CHUNK 8192
+#define BENCH_ROUNDS 200
+
+/**
+ * Build a query confirmation with the given number of triples.
+ */
+static GString *bench_make_message(gint triples)
+{
+  GString *msg = g_string_new(NULL);
+  gint i;
+
+  g_string_append(msg,
+		  "<SSAP_message>"
+		  "<transaction_type>QUERY</transaction_type>"
+		  "<message_type>CONFIRMATION</message_type>"
+		  "<transaction_id>1</transaction_id>"
+		  "<node_id>bench</node_id>"
+		  "<space_id>X</space_id>"
+		  "<parameter name=\"status\">m3:Success</parameter>"
+		  "<parameter name=\"results\"><triple_list>");
+  for(i = 0; i < triples; i++)
+    {
+      g_string_append_printf(msg,
+			     "<triple>"
+			     "<subject type=\"uri\">http://example.org/s%d</subject>"
+			     "<predicate>http://example.org/p</predicate>"
+			     "<object type=\"literal\">value %d</object>"
+			     "</triple>", i, i);
+    }
+  g_string_append(msg, "</triple_list></parameter></SSAP_message>");
+  return msg;
+}
+
+/**
+ * Today's receive path: every chunk is given to the parser.
+ */
+static gint bench_section(const GString *msg, gint chunk)
+{
+  NodeMsgContent_t *content = parseSSAPmsg_new();
+  ssStatus_t status = ss_ParsingInProgress;
+  gsize pos = 0;
+
+  while(pos < msg->len && status == ss_ParsingInProgress)
+    {
+      gint n = MIN((gsize)chunk, msg->len - pos);
+      status = parseSSAPmsg_section(content, msg->str + pos, n, 0);
+      pos += n;
+    }
+  parseSSAPmsg_free(&content);
+  return (status == ss_StatusOK ? 0 : -1);
+}
+
+/**
+ * Framed receive path: chunks go to the framer, the complete message is
+ * parsed once.
+ */
+static gint bench_framed(SIBFramer *framer, const GString *msg, gint chunk)
+{
+  NodeMsgContent_t *content = NULL;
+  ssStatus_t status = ss_OperationFailed;
+  const gchar *frame = NULL;
+  gsize framelen = 0;
+  gsize pos = 0;
+
+  while(pos < msg->len && frame == NULL)
+    {
+      gint n = MIN((gsize)chunk, msg->len - pos);
+      pos += sib_framer_feed(framer, msg->str + pos, n, &frame, &framelen);
+    }
+  if(frame != NULL)
+    {
+      content = parseSSAPmsg_new();
+      status = parseSSAPmsg_section(content, (gchar *)frame, framelen, 0);
+      parseSSAPmsg_free(&content);
+    }
+  return (status == ss_StatusOK ? 0 : -1);
+}
+
+static void bench_report(const gchar *name, gdouble secs, gsize bytes)
+{
+  g_print("%-10s %8.3f s %10.1f MB/s\n",
+	  name, secs, bytes / secs / (1024.0 * 1024.0));
+}
+
+static void bench_scan(const gchar *name, SIBFramerFindFunc find,
+		       const GString *msg, gint rounds)
+{
+  GTimer *timer = NULL;
+  gint i;
+
+  if(find == NULL)
+    {
+      g_print("%-10s not supported\n", name);
+      return;
+    }
+  if(find(msg->str, msg->len) != (gssize)msg->len)
+    {
+      g_printerr("%s: end tag not found\n", name);
+      exit(1);
+    }
+
+  timer = g_timer_new();
+  for(i = 0; i < rounds * 10; i++)
+    find(msg->str, msg->len);
+  bench_report(name, g_timer_elapsed(timer, NULL), msg->len * rounds * 10);
+  g_timer_destroy(timer);
+}
+
+int main(int argc, char **argv)
+{
+  gint triples = (argc > 1 ? atoi(argv[1]) : BENCH_TRIPLES);
+  gint chunk = (argc > 2 ? atoi(argv[2]) : BENCH_CHUNK);
+  gint rounds = (argc > 3 ? atoi(argv[3]) : BENCH_ROUNDS);
+  GString *msg = NULL;
+  SIBFramer *framer = NULL;
+  GTimer *timer = NULL;
+  gint i;
+
+  if(triples <= 0 || chunk <= 0 || rounds <= 0)
+    {
+      g_printerr("Usage: %s [triples] [chunk size] [rounds]\n", argv[0]);
+      return 1;
+    }
+
+  msg = bench_make_message(triples);
+  framer = sib_framer_new();
+  g_print("message %u bytes, chunk %d bytes, %d rounds, framer uses %s\n",
+	  (guint)msg->len, chunk, rounds, sib_framer_get_impl_name());
+
+  bench_scan("scalar", sib_framer_find_end_scalar, msg, rounds);
+  bench_scan("sse2", sib_framer_get_sse2(), msg, rounds);
+  bench_scan("avx2", sib_framer_get_avx2(), msg, rounds);
+
+  timer = g_timer_new();
+  for(i = 0; i < rounds; i++)
+    {
+      if(bench_section(msg, chunk) < 0)
+	{
+	  g_printerr("section parsing failed\n");
+	  return 1;
+	}
+    }
+  bench_report("section", g_timer_elapsed(timer, NULL), msg->len * rounds);
+
+  g_timer_start(timer);
+  for(i = 0; i < rounds; i++)
+    {
+      if(bench_framed(framer, msg, chunk) < 0)
+	{
+	  g_printerr("framed parsing failed\n");
+	  return 1;
+	}
+    }
+  bench_report("framed", g_timer_elapsed(timer, NULL), msg->len * rounds);
+
+  g_timer_destroy(timer);
+  sib_framer_free(framer);
+  g_string_free(msg, TRUE);
+  return 0;
+}
@@ -0,0 +1,861 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * mock_sib.c
+ *
+ * A stand-in SIB for load testing the access component. It answers SSAP
+ * join, leave, insert, remove, update, query, subscribe and unsubscribe
+ * from an in-memory triple store, over a Unix domain socket or TCP/IP.
+ * Queries and subscriptions take RDF-M3 templates.
+ *
+ * Usage: mock-sib [--listen=unix:PATH|[HOST:]PORT] [--latency=MS]
+ *                 [--jitter=MS] [--results=N] [--space=NAME] [--verbose]
+ *
+ * Point the access component at it with configure --with-sib-ip.
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#include <glib.h>
+
+#include "sib_framer.h"
+#include "sib_transport.h"
+#include "sib_triple.h"
+
+#define MOCK_BUF_SIZE 8192
+#define MOCK_BACKLOG 64
+
+#define MOCK_STATUS_OK "m3:Success"
+#define MOCK_STATUS_ERROR "m3:SIB.Error"
+#define MOCK_STATUS_NOT_IMPLEMENTED "m3:SIB.Error.NotImplemented"
+
+typedef struct _MockSIB
+{
+  GMutex *mutex;
+  /* the store, SIBTriple -> same SIBTriple */
+  GHashTable *triples;
+  /* subscription id -> MockSubscription */
+  GHashTable *subscriptions;
+  guint next_subscription;
+
+  gchar *space;
+  gint latency;     // ms before each confirmation
+  gint jitter;      // up to this many ms more
+  gint results;     // query results padded or cut to this, -1 for real results
+  gboolean verbose;
+} MockSIB;
+
+typedef struct _MockConnection MockConnection;
+
+typedef struct _MockSubscription
+{
+  gchar *id;
+  gchar *node_id;
+  gchar *transaction_id;
+  MockConnection *conn;  // indications are sent here
+  GSList *pattern;
+  /* current results, SIBTriple -> same SIBTriple */
+  GHashTable *results;
+  guint sequence;
+} MockSubscription;
+
+/** A parsed SSAP request */
+typedef struct _MockRequest
+{
+  gchar *transaction_type;
+  gchar *message_type;
+  gchar *transaction_id;
+  gchar *node_id;
+  gchar *space_id;
+  /* parameter name -> text */
+  GHashTable *params;
+  /* parameter name -> GSList of SIBTriple */
+  GHashTable *graphs;
+
+  /* parser state */
+  GString *text;
+  gchar *param;
+  SIBTripleParser *collector;
+} MockRequest;
+
+/** A client connection, shared by its reader thread and subscriptions */
+struct _MockConnection
+{
+  MockSIB *sib;
+  int s;
+  gint refcount;         // protected by the SIB mutex
+};
+
+static MockSIB mock_sib;
+
+/*****************************************************************************
+ * Sockets
+ *****************************************************************************/
+
+static gint mock_send_all(int s, const gchar *buf, gsize len)
+{
+  gsize total = 0;
+  gssize n;
+
+  while(total < len)
+    {
+      n = send(s, buf + total, len - total, 0);
+      if(n < 0 && errno == EINTR)
+	continue;
+      if(n <= 0)
+	return -1;
+      total += n;
+    }
+  return 0;
+}
+
+static int mock_listen(const gchar *address)
+{
+  int s = -1;
+  int on = 1;
+
+  if(g_str_has_prefix(address, SIB_TRANSPORT_UNIX_PREFIX))
+    {
+      struct sockaddr_un addr;
+      const gchar *path = address + strlen(SIB_TRANSPORT_UNIX_PREFIX);
+
+      if(strlen(path) >= sizeof(addr.sun_path))
+	{
+	  g_printerr("Socket path too long: %s\n", path);
+	  return -1;
+	}
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path);
+      unlink(path);
+
+      s = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(s < 0 || bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+	  g_printerr("Could not bind %s: %s\n", path, strerror(errno));
+	  return -1;
+	}
+    }
+  else
+    {
+      struct addrinfo hints;
+      struct addrinfo *res = NULL;
+      gchar *host = NULL;
+      const gchar *port = strrchr(address, ':');
+      gint err;
+
+      if(port != NULL)
+	{
+	  host = g_strndup(address, port - address);
+	  port++;
+	}
+      else
+	{
+	  port = address;
+	}
+
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_flags = AI_PASSIVE;
+      err = getaddrinfo(host, port, &hints, &res);
+      g_free(host);
+      if(err != 0)
+	{
+	  g_printerr("Could not resolve %s: %s\n", address, gai_strerror(err));
+	  return -1;
+	}
+      s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+      if(s >= 0)
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if(s < 0 || bind(s, res->ai_addr, res->ai_addrlen) < 0)
+	{
+	  g_printerr("Could not bind %s: %s\n", address, strerror(errno));
+	  freeaddrinfo(res);
+	  return -1;
+	}
+      freeaddrinfo(res);
+    }
+
+  if(listen(s, MOCK_BACKLOG) < 0)
+    {
+      g_printerr("Could not listen on %s: %s\n", address, strerror(errno));
+      close(s);
+      return -1;
+    }
+  return s;
+}
+
+/*****************************************************************************
+ * Request parsing
+ *****************************************************************************/
+
+static void mock_request_start(GMarkupParseContext *context,
+			       const gchar *element,
+			       const gchar **attribute_names,
+			       const gchar **attribute_values,
+			       gpointer user_data,
+			       GError **error)
+{
+  MockRequest *req = (MockRequest *)user_data;
+  gint i;
+
+  if(req->param != NULL)
+    {
+      sib_triple_parser_start(req->collector, element, attribute_names, attribute_values);
+      return;
+    }
+
+  g_string_truncate(req->text, 0);
+  if(strcmp(element, "parameter") == 0)
+    {
+      for(i = 0; attribute_names[i] != NULL; i++)
+	{
+	  if(strcmp(attribute_names[i], "name") == 0)
+	    req->param = g_strdup(attribute_values[i]);
+	}
+      if(req->param == NULL)
+	req->param = g_strdup("");
+      req->collector = sib_triple_parser_new();
+    }
+}
+
+static void mock_request_end(GMarkupParseContext *context,
+			     const gchar *element,
+			     gpointer user_data,
+			     GError **error)
+{
+  MockRequest *req = (MockRequest *)user_data;
+  gchar *text = NULL;
+
+  if(req->param != NULL && strcmp(element, "parameter") != 0)
+    {
+      sib_triple_parser_end(req->collector, element);
+      return;
+    }
+
+  text = g_strstrip(g_strdup(req->text->str));
+  if(req->param != NULL)
+    {
+      gboolean inline_triples = (sib_triple_parser_get_count(req->collector) > 0);
+      GSList *triples = sib_triple_parser_finish(req->collector);
+
+      /* the graph may also come as escaped text */
+      if(!inline_triples && strstr(text, "<triple") != NULL)
+	triples = sib_triple_list_parse(text, -1, NULL);
+      if(triples != NULL)
+	g_hash_table_replace(req->graphs, g_strdup(req->param), triples);
+      g_hash_table_replace(req->params, req->param, text);
+      req->param = NULL;
+      req->collector = NULL;
+      return;
+    }
+
+  if(strcmp(element, "transaction_type") == 0)
+    req->transaction_type = text;
+  else if(strcmp(element, "message_type") == 0)
+    req->message_type = text;
+  else if(strcmp(element, "transaction_id") == 0)
+    req->transaction_id = text;
+  else if(strcmp(element, "node_id") == 0)
+    req->node_id = text;
+  else if(strcmp(element, "space_id") == 0)
+    req->space_id = text;
+  else
+    g_free(text);
+}
+
+static void mock_request_text(GMarkupParseContext *context,
+			      const gchar *text,
+			      gsize len,
+			      gpointer user_data,
+			      GError **error)
+{
+  MockRequest *req = (MockRequest *)user_data;
+  if(req->param != NULL)
+    sib_triple_parser_text(req->collector, text, len);
+  g_string_append_len(req->text, text, len);
+}
+
+static void mock_request_free(MockRequest *req)
+{
+  g_free(req->transaction_type);
+  g_free(req->message_type);
+  g_free(req->transaction_id);
+  g_free(req->node_id);
+  g_free(req->space_id);
+  g_hash_table_destroy(req->params);
+  g_hash_table_destroy(req->graphs);
+  g_string_free(req->text, TRUE);
+  g_free(req->param);
+  if(req->collector != NULL)
+    sib_triple_list_free(sib_triple_parser_finish(req->collector));
+  g_free(req);
+}
+
+static MockRequest *mock_request_parse(const gchar *msg, gsize len)
+{
+  static const GMarkupParser parser =
+    {
+      mock_request_start,
+      mock_request_end,
+      mock_request_text,
+      NULL,
+      NULL
+    };
+  MockRequest *req = g_new0(MockRequest, 1);
+  GMarkupParseContext *context = NULL;
+  GError *error = NULL;
+
+  req->params = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  req->graphs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				      (GDestroyNotify)sib_triple_list_free);
+  req->text = g_string_new(NULL);
+
+  context = g_markup_parse_context_new(&parser, 0, req, NULL);
+  if(!g_markup_parse_context_parse(context, msg, len, &error) ||
+     !g_markup_parse_context_end_parse(context, &error))
+    {
+      g_printerr("Bad request: %s\n", error->message);
+      g_error_free(error);
+      g_markup_parse_context_free(context);
+      mock_request_free(req);
+      return NULL;
+    }
+  g_markup_parse_context_free(context);
+
+  if(req->transaction_type == NULL || req->transaction_id == NULL || req->node_id == NULL)
+    {
+      g_printerr("Bad request: missing transaction type, id or node id\n");
+      mock_request_free(req);
+      return NULL;
+    }
+  return req;
+}
+
+/*****************************************************************************
+ * Responses
+ *****************************************************************************/
+
+static GString *mock_message_begin(const gchar *transaction_type,
+				   const gchar *message_type,
+				   const gchar *transaction_id,
+				   const gchar *node_id,
+				   const gchar *space_id)
+{
+  GString *out = g_string_sized_new(MOCK_BUF_SIZE);
+  gchar *escaped = g_markup_printf_escaped("<SSAP_message>"
+					   "<transaction_type>%s</transaction_type>"
+					   "<message_type>%s</message_type>"
+					   "<transaction_id>%s</transaction_id>"
+					   "<node_id>%s</node_id>"
+					   "<space_id>%s</space_id>",
+					   transaction_type, message_type, transaction_id,
+					   node_id, space_id);
+  g_string_append(out, escaped);
+  g_free(escaped);
+  return out;
+}
+
+static GString *mock_confirmation(MockRequest *req, const gchar *status)
+{
+  GString *out = mock_message_begin(req->transaction_type, "CONFIRMATION",
+				    req->transaction_id, req->node_id,
+				    (req->space_id != NULL ? req->space_id : mock_sib.space));
+  g_string_append_printf(out, "<parameter name=\"status\">%s</parameter>", status);
+  return out;
+}
+
+static void mock_message_end(GString *out)
+{
+  g_string_append(out, SIB_FRAMER_ENDTAG);
+}
+
+static void mock_append_results(GString *out, const gchar *name, GSList *triples)
+{
+  g_string_append_printf(out, "<parameter name=\"%s\">", name);
+  sib_triple_list_append(out, triples);
+  g_string_append(out, "</parameter>");
+}
+
+/*****************************************************************************
+ * Triple store, called with the mutex locked
+ *****************************************************************************/
+
+static void mock_store_match(gpointer key, gpointer value, gpointer user_data)
+{
+  gpointer *args = (gpointer *)user_data;
+  SIBTriple *triple = (SIBTriple *)key;
+  GSList *pattern = NULL;
+
+  for(pattern = (GSList *)args[0]; pattern != NULL; pattern = pattern->next)
+    {
+      if(sib_triple_matches(triple, (SIBTriple *)pattern->data))
+	{
+	  args[1] = g_slist_prepend((GSList *)args[1], triple);
+	  return;
+	}
+    }
+}
+
+/**
+ * Get the stored triples matching any of the templates.
+ *
+ * @return List of triples owned by the store
+ */
+static GSList *mock_store_query(MockSIB *sib, GSList *pattern)
+{
+  gpointer args[2] = { pattern, NULL };
+  g_hash_table_foreach(sib->triples, mock_store_match, args);
+  return (GSList *)args[1];
+}
+
+/**
+ * Pad or cut query results to the configured size.
+ *
+ * @return List of copied triples
+ */
+static GSList *mock_sized_results(MockSIB *sib, GSList *matches)
+{
+  GSList *out = NULL;
+  GSList *item = NULL;
+  gint n = 0;
+
+  for(item = matches; item != NULL && (sib->results < 0 || n < sib->results); item = item->next, n++)
+    out = g_slist_prepend(out, sib_triple_copy((SIBTriple *)item->data));
+
+  for(; n < sib->results; n++)
+    {
+      gchar *subject = g_strdup_printf("mock:padding-%d", n);
+      out = g_slist_prepend(out, sib_triple_new(subject, "mock:padding", "padding", TRUE));
+      g_free(subject);
+    }
+  return g_slist_reverse(out);
+}
+
+static void mock_store_insert(MockSIB *sib, GSList *triples)
+{
+  for(; triples != NULL; triples = triples->next)
+    {
+      SIBTriple *t = (SIBTriple *)triples->data;
+      if(g_hash_table_lookup(sib->triples, t) == NULL)
+	{
+	  t = sib_triple_copy(t);
+	  g_hash_table_insert(sib->triples, t, t);
+	}
+    }
+}
+
+static void mock_store_remove(MockSIB *sib, GSList *triples)
+{
+  GSList *matches = NULL;
+  GSList *item = NULL;
+
+  /* removal accepts templates, as in the SIB */
+  matches = mock_store_query(sib, triples);
+  for(item = matches; item != NULL; item = item->next)
+    g_hash_table_remove(sib->triples, item->data);
+  g_slist_free(matches);
+}
+
+/**
+ * Release a connection, closing it with the last reference. Must be
+ * called with the SIB mutex locked.
+ */
+static void mock_connection_unref(MockConnection *conn)
+{
+  if(--conn->refcount == 0)
+    {
+      close(conn->s);
+      g_free(conn);
+    }
+}
+
+static void mock_subscription_free(gpointer data)
+{
+  MockSubscription *sub = (MockSubscription *)data;
+
+  /* ends the subscription for the client and wakes up the reader */
+  shutdown(sub->conn->s, SHUT_RDWR);
+  mock_connection_unref(sub->conn);
+  g_free(sub->id);
+  g_free(sub->node_id);
+  g_free(sub->transaction_id);
+  sib_triple_list_free(sub->pattern);
+  g_hash_table_destroy(sub->results);
+  g_free(sub);
+}
+
+static void mock_collect_obsolete(gpointer key, gpointer value, gpointer user_data)
+{
+  gpointer *args = (gpointer *)user_data;
+  if(g_hash_table_lookup((GHashTable *)args[0], key) == NULL)
+    args[1] = g_slist_prepend((GSList *)args[1], key);
+}
+
+/**
+ * Send an indication if the results of a subscription have changed.
+ *
+ * @return TRUE to remove the subscription, its socket is broken
+ */
+static gboolean mock_subscription_update(gpointer key, gpointer value, gpointer user_data)
+{
+  MockSIB *sib = (MockSIB *)user_data;
+  MockSubscription *sub = (MockSubscription *)value;
+  GHashTable *current = g_hash_table_new_full(sib_triple_hash, sib_triple_equal,
+					      (GDestroyNotify)sib_triple_free, NULL);
+  GSList *matches = mock_store_query(sib, sub->pattern);
+  GSList *added = NULL;
+  GSList *item = NULL;
+  gpointer args[2] = { current, NULL };
+  GString *out = NULL;
+  gboolean broken = FALSE;
+
+  for(item = matches; item != NULL; item = item->next)
+    {
+      SIBTriple *t = sib_triple_copy((SIBTriple *)item->data);
+      g_hash_table_insert(current, t, t);
+      if(g_hash_table_lookup(sub->results, t) == NULL)
+	added = g_slist_prepend(added, t);
+    }
+  g_slist_free(matches);
+  g_hash_table_foreach(sub->results, mock_collect_obsolete, args);
+
+  if(added != NULL || args[1] != NULL)
+    {
+      gchar *seq = g_strdup_printf("%u", ++sub->sequence);
+      out = mock_message_begin("SUBSCRIBE", "INDICATION", sub->transaction_id,
+			       sub->node_id, sib->space);
+      g_string_append_printf(out,
+			     "<parameter name=\"ind_sequence\">%s</parameter>"
+			     "<parameter name=\"subscription_id\">%s</parameter>",
+			     seq, sub->id);
+      mock_append_results(out, "new_results", added);
+      mock_append_results(out, "obsolete_results", (GSList *)args[1]);
+      mock_message_end(out);
+      broken = (mock_send_all(sub->conn->s, out->str, out->len) < 0);
+      g_string_free(out, TRUE);
+      g_free(seq);
+      if(sib->verbose)
+	g_printerr("Indication %u of %s%s\n", sub->sequence, sub->id, (broken ? " failed" : ""));
+    }
+
+  /* the obsolete triples are owned by the old result table */
+  g_slist_free(added);
+  g_slist_free((GSList *)args[1]);
+  g_hash_table_destroy(sub->results);
+  sub->results = current;
+  return broken;
+}
+
+/*****************************************************************************
+ * Request handling
+ *****************************************************************************/
+
+static GSList *mock_request_graph(MockRequest *req, const gchar *name)
+{
+  return (GSList *)g_hash_table_lookup(req->graphs, name);
+}
+
+static gboolean mock_request_is_template(MockRequest *req)
+{
+  const gchar *type = (const gchar *)g_hash_table_lookup(req->params, "type");
+  return (type == NULL || g_ascii_strcasecmp(type, "RDF-M3") == 0);
+}
+
+/**
+ * Handle a request.
+ *
+ * @param conn Connection the request came on
+ * @return The response, NULL if none is sent on this connection
+ */
+static GString *mock_handle(MockConnection *conn, MockRequest *req)
+{
+  MockSIB *sib = conn->sib;
+  const gchar *type = req->transaction_type;
+  GString *out = NULL;
+  gboolean modified = FALSE;
+
+  g_mutex_lock(sib->mutex);
+
+  if(strcmp(type, "JOIN") == 0 || strcmp(type, "LEAVE") == 0)
+    {
+      out = mock_confirmation(req, MOCK_STATUS_OK);
+    }
+  else if(strcmp(type, "INSERT") == 0 || strcmp(type, "REMOVE") == 0 ||
+	  strcmp(type, "UPDATE") == 0)
+    {
+      if(strcmp(type, "INSERT") != 0)
+	mock_store_remove(sib, mock_request_graph(req, "remove_graph"));
+      if(strcmp(type, "REMOVE") != 0)
+	mock_store_insert(sib, mock_request_graph(req, "insert_graph"));
+      modified = TRUE;
+      out = mock_confirmation(req, MOCK_STATUS_OK);
+      if(strcmp(type, "REMOVE") != 0)
+	g_string_append(out, "<parameter name=\"bnodes\"><urllist></urllist></parameter>");
+    }
+  else if(strcmp(type, "QUERY") == 0 || strcmp(type, "SUBSCRIBE") == 0)
+    {
+      if(!mock_request_is_template(req))
+	{
+	  out = mock_confirmation(req, MOCK_STATUS_NOT_IMPLEMENTED);
+	}
+      else
+	{
+	  GSList *pattern = mock_request_graph(req, "query");
+	  GSList *matches = mock_store_query(sib, pattern);
+	  GSList *results = mock_sized_results(sib, matches);
+
+	  out = mock_confirmation(req, MOCK_STATUS_OK);
+	  if(strcmp(type, "SUBSCRIBE") == 0)
+	    {
+	      MockSubscription *sub = g_new0(MockSubscription, 1);
+	      GSList *item = NULL;
+
+	      sub->id = g_strdup_printf("mock-subscription-%u", ++sib->next_subscription);
+	      sub->node_id = g_strdup(req->node_id);
+	      sub->transaction_id = g_strdup(req->transaction_id);
+	      sub->conn = conn;
+	      conn->refcount++;
+	      for(item = pattern; item != NULL; item = item->next)
+		sub->pattern = g_slist_prepend(sub->pattern, sib_triple_copy((SIBTriple *)item->data));
+	      sub->results = g_hash_table_new_full(sib_triple_hash, sib_triple_equal,
+						   (GDestroyNotify)sib_triple_free, NULL);
+	      for(item = matches; item != NULL; item = item->next)
+		{
+		  SIBTriple *t = sib_triple_copy((SIBTriple *)item->data);
+		  g_hash_table_insert(sub->results, t, t);
+		}
+	      g_hash_table_insert(sib->subscriptions, g_strdup(sub->id), sub);
+
+	      g_string_append_printf(out, "<parameter name=\"subscription_id\">%s</parameter>", sub->id);
+	    }
+	  mock_append_results(out, "results", results);
+	  sib_triple_list_free(results);
+	  g_slist_free(matches);
+	}
+    }
+  else if(strcmp(type, "UNSUBSCRIBE") == 0)
+    {
+      const gchar *id = (const gchar *)g_hash_table_lookup(req->params, "subscription_id");
+      MockSubscription *sub = (id != NULL ?
+			       (MockSubscription *)g_hash_table_lookup(sib->subscriptions, id) :
+			       NULL);
+      GString *cnf = mock_confirmation(req, (sub != NULL ? MOCK_STATUS_OK : MOCK_STATUS_ERROR));
+      g_string_append_printf(cnf, "<parameter name=\"subscription_id\">%s</parameter>",
+			     (id != NULL ? id : ""));
+      mock_message_end(cnf);
+      if(sub != NULL)
+	{
+	  /* the confirmation goes to the subscription connection */
+	  mock_send_all(sub->conn->s, cnf->str, cnf->len);
+	  g_hash_table_remove(sib->subscriptions, id);
+	  g_string_free(cnf, TRUE);
+	}
+      else
+	{
+	  out = cnf;
+	}
+    }
+  else
+    {
+      out = mock_confirmation(req, MOCK_STATUS_NOT_IMPLEMENTED);
+    }
+
+  if(modified)
+    g_hash_table_foreach_remove(sib->subscriptions, mock_subscription_update, sib);
+
+  g_mutex_unlock(sib->mutex);
+
+  if(out != NULL && strcmp(type, "UNSUBSCRIBE") != 0)
+    mock_message_end(out);
+  return out;
+}
+
+static gpointer mock_connection(gpointer data)
+{
+  MockConnection *conn = (MockConnection *)data;
+  MockSIB *sib = conn->sib;
+  SIBFramer *framer = sib_framer_new();
+  gchar *recvbuf = g_new(gchar, MOCK_BUF_SIZE);
+  const gchar *msg = NULL;
+  gsize msglen = 0;
+  gssize n;
+  gssize used;
+
+  while( (n = recv(conn->s, recvbuf, MOCK_BUF_SIZE, 0)) > 0 || (n < 0 && errno == EINTR) )
+    {
+      for(used = 0; used < n; )
+	{
+	  MockRequest *req = NULL;
+	  GString *out = NULL;
+
+	  used += sib_framer_feed(framer, recvbuf + used, n - used, &msg, &msglen);
+	  if(msg == NULL)
+	    continue;
+
+	  req = mock_request_parse(msg, msglen);
+	  if(req == NULL)
+	    continue;
+	  if(sib->verbose)
+	    g_printerr("%s %s from %s\n", req->transaction_type, req->transaction_id, req->node_id);
+
+	  out = mock_handle(conn, req);
+	  if(out != NULL)
+	    {
+	      gint delay = sib->latency;
+	      if(sib->jitter > 0)
+		delay += g_random_int_range(0, sib->jitter + 1);
+	      if(delay > 0)
+		g_usleep(delay * 1000);
+	      mock_send_all(conn->s, out->str, out->len);
+	      g_string_free(out, TRUE);
+	    }
+	  mock_request_free(req);
+	}
+    }
+
+  /* a subscription keeps the connection open for indications */
+  g_mutex_lock(sib->mutex);
+  mock_connection_unref(conn);
+  g_mutex_unlock(sib->mutex);
+  sib_framer_free(framer);
+  g_free(recvbuf);
+  return NULL;
+}
+
+/*****************************************************************************
+ * Main
+ *****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  gchar *address = NULL;
+  gchar *space = NULL;
+  gint latency = 0;
+  gint jitter = 0;
+  gint results = -1;
+  gboolean verbose = FALSE;
+  GOptionEntry entries[] =
+    {
+      { "listen", 'l', 0, G_OPTION_ARG_STRING, &address,
+	"Listen on a Unix domain socket or TCP port (default unix:/tmp/mock-sib)", "unix:PATH|[HOST:]PORT" },
+      { "latency", 'd', 0, G_OPTION_ARG_INT, &latency,
+	"Delay each confirmation (default 0)", "MS" },
+      { "jitter", 'j', 0, G_OPTION_ARG_INT, &jitter,
+	"Add a random delay up to this (default 0)", "MS" },
+      { "results", 'r', 0, G_OPTION_ARG_INT, &results,
+	"Pad or cut query results to N triples (default real results)", "N" },
+      { "space", 's', 0, G_OPTION_ARG_STRING, &space,
+	"Smart space name (default X)", "NAME" },
+      { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
+	"Log every request", NULL },
+      { NULL }
+    };
+  GOptionContext *context = NULL;
+  GError *error = NULL;
+  int listener;
+
+  context = g_option_context_new("- mock SIB for load testing");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+    {
+      g_printerr("%s\n", error->message);
+      g_error_free(error);
+      return 1;
+    }
+  g_option_context_free(context);
+
+  g_thread_init(NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  mock_sib.mutex = g_mutex_new();
+  mock_sib.triples = g_hash_table_new_full(sib_triple_hash, sib_triple_equal,
+					   (GDestroyNotify)sib_triple_free, NULL);
+  mock_sib.subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal,
+						 g_free, mock_subscription_free);
+  mock_sib.space = (space != NULL ? space : g_strdup("X"));
+  mock_sib.latency = MAX(latency, 0);
+  mock_sib.jitter = MAX(jitter, 0);
+  mock_sib.results = results;
+  mock_sib.verbose = verbose;
+
+  if(address == NULL)
+    address = g_strdup(SIB_TRANSPORT_UNIX_PREFIX "/tmp/mock-sib");
+  listener = mock_listen(address);
+  if(listener < 0)
+    return 1;
+  g_print("Mock SIB %s listening on %s\n", mock_sib.space, address);
+
+  while(TRUE)
+    {
+      MockConnection *conn = NULL;
+      int s = accept(listener, NULL, NULL);
+      if(s < 0)
+	{
+	  if(errno != EINTR)
+	    g_printerr("accept failed: %s\n", strerror(errno));
+	  continue;
+	}
+      conn = g_new0(MockConnection, 1);
+      conn->sib = &mock_sib;
+      conn->s = s;
+      conn->refcount = 1;
+      if(g_thread_create(mock_connection, conn, FALSE, NULL) == NULL)
+	{
+	  close(s);
+	  g_free(conn);
+	}
+    }
+
+  return 0;
+}
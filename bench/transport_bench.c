@@ -0,0 +1,357 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * transport_bench.c
+ *
+ * Measures insert and query latency and throughput against a running SIB
+ * over one transport. Run it once per transport to compare them, e.g.
+ *
+ *   transport-bench h_in
+ *   transport-bench unix:/tmp/sib.sock
+ *   transport-bench 127.0.0.1 10010
+ *
+ * Usage: transport-bench ADDRESS [PORT] [requests] [threads]
+ * The TCP port defaults to 10010.
+ *
+ * Each request opens its own connection, like SIB access does without
+ * connection pooling.
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <h_in/h_bsdapi.h>
+
+#include <glib.h>
+#include <sibmsg.h>
+
+#include "sib_framer.h"
+#include "sib_transport.h"
+
+#define BENCH_SPACE "X"
+#define BENCH_REQUESTS 1000
+#define BENCH_THREADS 1
+#define BENCH_PORT 10010
+#define BENCH_BUF_SIZE 8192
+
+/* used by the H_IN transport */
+h_in_t* instance = NULL;
+
+typedef struct _BenchClient
+{
+  const SIBTransport *transport;
+  const gchar *address;
+  gint port;
+  gint requests;
+  gchar *nodeid;
+  gint msgnumber;
+  gint op;          // MSG_N_INSERT or MSG_N_QUERY
+  GArray *ms;       // latency of each request of the current phase
+  gint failures;
+} BenchClient;
+
+/**
+ * Send one request on a new connection and wait for its confirmation.
+ *
+ * @return TRUE if a confirmation of the expected operation was received
+ */
+static gboolean bench_transact(BenchClient *c, ssBufDesc_t *buf, gint name)
+{
+  gchar recvbuf[BENCH_BUF_SIZE];
+  SIBFramer *framer = NULL;
+  NodeMsgContent_t *msg = NULL;
+  const gchar *frame = NULL;
+  gsize framelen = 0;
+  gboolean ok = FALSE;
+  gint n;
+  int s;
+
+  s = c->transport->connect(c->address, c->port);
+  if(s < 0)
+    return FALSE;
+
+  if(sib_transport_send_all(c->transport, s, ssBufDesc_GetMessage(buf),
+			    ssBufDesc_GetMessageLen(buf)) < 0)
+    {
+      c->transport->close(s);
+      return FALSE;
+    }
+  c->transport->shutdown(s, SHUT_WR);
+
+  framer = sib_framer_new();
+  while(frame == NULL && (n = c->transport->recv(s, recvbuf, sizeof(recvbuf))) > 0)
+    {
+      gint used = 0;
+      while(used < n && frame == NULL)
+	used += sib_framer_feed(framer, recvbuf + used, n - used, &frame, &framelen);
+    }
+
+  if(frame != NULL)
+    {
+      msg = parseSSAPmsg_new();
+      ok = (parseSSAPmsg_section(msg, (gchar *)frame, framelen, 0) == ss_StatusOK &&
+	    parseSSAPmsg_get_name(msg) == name &&
+	    parseSSAPmsg_get_type(msg) == MSG_T_CNF);
+      parseSSAPmsg_free(&msg);
+    }
+  sib_framer_free(framer);
+  c->transport->close(s);
+  return ok;
+}
+
+static gboolean bench_join(BenchClient *c, gboolean join)
+{
+  ssBufDesc_t *buf = ssBufDesc_new();
+  gboolean ok = FALSE;
+
+  if(join)
+    ok = (ssBufDesc_CreateJoinMessage(buf, (ssElement_ct)BENCH_SPACE,
+				      (ssElement_ct)c->nodeid, c->msgnumber++) == ss_StatusOK &&
+	  bench_transact(c, buf, MSG_N_JOIN));
+  else
+    ok = (ssBufDesc_CreateLeaveMessage(buf, (ssElement_ct)BENCH_SPACE,
+				       (ssElement_ct)c->nodeid, c->msgnumber++, TRUE) == ss_StatusOK &&
+	  bench_transact(c, buf, MSG_N_LEAVE));
+  ssBufDesc_free(&buf);
+  return ok;
+}
+
+static void bench_request(BenchClient *c, gint name, gint i, GTimer *timer)
+{
+  ssBufDesc_t *buf = ssBufDesc_new();
+  gchar *triple = NULL;
+  gdouble ms;
+  ssStatus_t status;
+
+  if(name == MSG_N_INSERT)
+    {
+      triple = g_strdup_printf("<triple_list><triple>"
+			       "<subject type=\"URI\">bench:%s-%d</subject>"
+			       "<predicate>bench:value</predicate>"
+			       "<object type=\"literal\">%d</object>"
+			       "</triple></triple_list>", c->nodeid, i, i);
+      status = ssBufDesc_CreateInsertMessage(buf, (ssElement_ct)BENCH_SPACE,
+					     (ssElement_ct)c->nodeid, c->msgnumber++,
+					     EncodingM3XML, (guchar *)triple, TRUE);
+    }
+  else
+    {
+      triple = g_strdup_printf("<triple_list><triple>"
+			       "<subject type=\"URI\">bench:%s-%d</subject>"
+			       "<predicate>bench:value</predicate>"
+			       "<object type=\"URI\">sib:any</object>"
+			       "</triple></triple_list>", c->nodeid, i);
+      status = ssBufDesc_CreateQueryMessage(buf, (ssElement_ct)BENCH_SPACE,
+					    (ssElement_ct)c->nodeid, c->msgnumber++,
+					    QueryTypeTemplate, (guchar *)triple);
+    }
+
+  g_timer_start(timer);
+  if(status != ss_StatusOK || !bench_transact(c, buf, name))
+    c->failures++;
+  ms = g_timer_elapsed(timer, NULL) * 1000.0;
+  g_array_append_val(c->ms, ms);
+
+  g_free(triple);
+  ssBufDesc_free(&buf);
+}
+
+static gpointer bench_client(gpointer data)
+{
+  BenchClient *c = (BenchClient *)data;
+  GTimer *timer = g_timer_new();
+  gint i;
+
+  for(i = 0; i < c->requests; i++)
+    bench_request(c, c->op, i, timer);
+
+  g_timer_destroy(timer);
+  return NULL;
+}
+
+/**
+ * Run one operation in all clients at once.
+ *
+ * @return Wall clock seconds of the phase
+ */
+static gdouble bench_phase(BenchClient *clients, gint threads, gint op, GArray *ms)
+{
+  GThread **ids = g_new0(GThread *, threads);
+  GTimer *timer = g_timer_new();
+  gdouble wall;
+  gint i;
+
+  for(i = 0; i < threads; i++)
+    {
+      clients[i].op = op;
+      clients[i].ms = g_array_sized_new(FALSE, FALSE, sizeof(gdouble), clients[i].requests);
+      ids[i] = g_thread_create(bench_client, &clients[i], TRUE, NULL);
+    }
+  for(i = 0; i < threads; i++)
+    {
+      if(ids[i] != NULL)
+	g_thread_join(ids[i]);
+      else
+	clients[i].failures += clients[i].requests;
+    }
+  wall = g_timer_elapsed(timer, NULL);
+
+  for(i = 0; i < threads; i++)
+    {
+      g_array_append_vals(ms, clients[i].ms->data, clients[i].ms->len);
+      g_array_free(clients[i].ms, TRUE);
+      clients[i].ms = NULL;
+    }
+  g_timer_destroy(timer);
+  g_free(ids);
+  return wall;
+}
+
+static gint bench_compare_double(gconstpointer a, gconstpointer b)
+{
+  gdouble x = *(const gdouble *)a;
+  gdouble y = *(const gdouble *)b;
+  return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+static void bench_report(const gchar *name, GArray *ms, gdouble wall)
+{
+  gdouble sum = 0;
+  guint i;
+
+  if(ms->len == 0)
+    return;
+  g_array_sort(ms, bench_compare_double);
+  for(i = 0; i < ms->len; i++)
+    sum += g_array_index(ms, gdouble, i);
+
+  g_print("%-6s %6u requests, %8.1f/s, latency avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	  name, ms->len, ms->len / wall, sum / ms->len,
+	  g_array_index(ms, gdouble, ms->len / 2),
+	  g_array_index(ms, gdouble, (ms->len * 99) / 100),
+	  g_array_index(ms, gdouble, ms->len - 1));
+}
+
+int main(int argc, char **argv)
+{
+  const gchar *address = NULL;
+  const SIBTransport *transport = NULL;
+  gint port = BENCH_PORT;
+  gint requests = BENCH_REQUESTS;
+  gint threads = BENCH_THREADS;
+  BenchClient *clients = NULL;
+  GArray *insert_ms = NULL;
+  GArray *query_ms = NULL;
+  gint failures = 0;
+  gint i;
+
+  if(argc < 2)
+    {
+      g_printerr("Usage: %s h_in|unix:PATH|IP [PORT] [requests] [threads]\n", argv[0]);
+      return 1;
+    }
+  address = argv[1];
+  if(argc > 2)
+    port = atoi(argv[2]);
+  if(argc > 3)
+    requests = atoi(argv[3]);
+  if(argc > 4)
+    threads = atoi(argv[4]);
+  if(requests <= 0 || threads <= 0)
+    {
+      g_printerr("requests and threads must be positive\n");
+      return 1;
+    }
+
+  g_thread_init(NULL);
+
+  if(strcmp(address, "h_in") == 0)
+    {
+      address = NULL;
+      instance = Hgetinstance();
+      if(instance == NULL)
+	{
+	  g_printerr("Could not create H_IN instance\n");
+	  return 1;
+	}
+    }
+  transport = sib_transport_for_address(address, port);
+
+  g_print("%s transport, %d threads, %d inserts and %d queries per thread\n",
+	  transport->name, threads, requests, requests);
+
+  clients = g_new0(BenchClient, threads);
+  for(i = 0; i < threads; i++)
+    {
+      clients[i].transport = transport;
+      clients[i].address = address;
+      clients[i].port = port;
+      clients[i].requests = requests;
+      clients[i].nodeid = g_strdup_printf("bench-%d-%d", (gint)getpid(), i);
+      clients[i].msgnumber = 1;
+      if(!bench_join(&clients[i], TRUE))
+	{
+	  g_printerr("%s: join failed\n", clients[i].nodeid);
+	  return 1;
+	}
+    }
+
+  insert_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+  query_ms = g_array_new(FALSE, FALSE, sizeof(gdouble));
+  bench_report("insert", insert_ms, bench_phase(clients, threads, MSG_N_INSERT, insert_ms));
+  bench_report("query", query_ms, bench_phase(clients, threads, MSG_N_QUERY, query_ms));
+
+  for(i = 0; i < threads; i++)
+    {
+      bench_join(&clients[i], FALSE);
+      failures += clients[i].failures;
+      g_free(clients[i].nodeid);
+    }
+  g_print("failures %d\n", failures);
+
+  g_array_free(insert_ms, TRUE);
+  g_array_free(query_ms, TRUE);
+  g_free(clients);
+  return (failures > 0 ? 2 : 0);
+}
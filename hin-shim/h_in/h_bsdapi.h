@@ -0,0 +1,84 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * h_bsdapi.h
+ *
+ * H_IN emulation over Unix domain sockets, for running and profiling the
+ * access component without a NoTA stack. Provides the subset of the NoTA
+ * H_IN socket API used by this component. Selected with configure
+ * --with-hin-shim.
+ *
+ * Connecting to service id N connects to the Unix domain socket
+ * $HIN_SHIM_DIR/hin-sid-N, /tmp/hin-sid-N by default, e.g. a mock SIB
+ * started with --listen=unix:/tmp/hin-sid-10.
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef H_BSDAPI_H
+#define H_BSDAPI_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#define AF_NOTA 30
+
+/** Environment variable naming the directory of the service sockets */
+#define HIN_SHIM_DIR_ENV "HIN_SHIM_DIR"
+#define HIN_SHIM_DIR_DEFAULT "/tmp"
+
+typedef struct _h_in_t h_in_t;
+
+/** Address of a NoTA service */
+typedef struct
+{
+  int sid;
+  int port;
+} nota_addr_t;
+
+h_in_t* Hgetinstance(void);
+
+int Hsocket(h_in_t* instance, int domain, int type, int protocol);
+int Hconnect(h_in_t* instance, int s, const struct sockaddr* addr, socklen_t len);
+int Hsend(h_in_t* instance, int s, const void* buf, int len, int flags);
+int Hrecv(h_in_t* instance, int s, void* buf, int len, int flags);
+int Hclose(h_in_t* instance, int s);
+int Hselect(h_in_t* instance, int nfds, fd_set* readfds, fd_set* writefds,
+	    fd_set* exceptfds, struct timeval* timeout);
+
+#endif
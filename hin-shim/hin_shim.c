@@ -0,0 +1,141 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * hin_shim.c
+ *
+ * H_IN emulation over Unix domain sockets, see h_in/h_bsdapi.h.
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+
+#include "h_in/h_bsdapi.h"
+
+struct _h_in_t
+{
+  char dir[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+static h_in_t hin_shim_instance;
+
+h_in_t* Hgetinstance(void)
+{
+  const char *dir = getenv(HIN_SHIM_DIR_ENV);
+
+  if(dir == NULL || *dir == '\0')
+    dir = HIN_SHIM_DIR_DEFAULT;
+  snprintf(hin_shim_instance.dir, sizeof(hin_shim_instance.dir), "%s", dir);
+  return &hin_shim_instance;
+}
+
+int Hsocket(h_in_t* instance, int domain, int type, int protocol)
+{
+  if(instance == NULL || domain != AF_NOTA)
+    {
+      errno = EAFNOSUPPORT;
+      return -1;
+    }
+  return socket(AF_UNIX, type, 0);
+}
+
+int Hconnect(h_in_t* instance, int s, const struct sockaddr* addr, socklen_t len)
+{
+  const nota_addr_t *nota = (const nota_addr_t *)addr;
+  struct sockaddr_un sun;
+  int n;
+
+  if(instance == NULL || addr == NULL || len < sizeof(nota_addr_t))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  memset(&sun, 0, sizeof(sun));
+  sun.sun_family = AF_UNIX;
+  n = snprintf(sun.sun_path, sizeof(sun.sun_path), "%s/hin-sid-%d", instance->dir, nota->sid);
+  if(n < 0 || n >= (int)sizeof(sun.sun_path))
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  return connect(s, (struct sockaddr *)&sun, sizeof(sun));
+}
+
+int Hsend(h_in_t* instance, int s, const void* buf, int len, int flags)
+{
+  int n;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL; // H_IN reports a closed peer as an error
+#endif
+  do
+    {
+      n = send(s, buf, len, flags);
+    }
+  while(n < 0 && errno == EINTR);
+  return n;
+}
+
+int Hrecv(h_in_t* instance, int s, void* buf, int len, int flags)
+{
+  int n;
+  do
+    {
+      n = recv(s, buf, len, flags);
+    }
+  while(n < 0 && errno == EINTR);
+  return n;
+}
+
+int Hclose(h_in_t* instance, int s)
+{
+  return close(s);
+}
+
+int Hselect(h_in_t* instance, int nfds, fd_set* readfds, fd_set* writefds,
+	    fd_set* exceptfds, struct timeval* timeout)
+{
+  return select(nfds, readfds, writefds, exceptfds, timeout);
+}
@@ -43,6 +43,7 @@
 
 #include <whiteboard_sib_access.h> 
 
+#include "sib_payload.h"
 #include "sib_server.h"
 #include "sib_service.h"
 
@@ -68,13 +69,18 @@ gint serverthread_leave(SIBServer* server,
 			guchar *sibid,
 			gint msgnumber);
 
+/*
+ * The payloads of insert, update and remove are referenced by the queued
+ * request, not copied; the caller keeps its own reference.
+ */
+
 gint serverthread_insert(SIBServer* server,
 			 WhiteBoardSIBAccessHandle* handle,
 			 guchar *nodeid,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,
-			 guchar *request );
+			 SIBPayload *request );
 
 gint serverthread_update(SIBServer* server,
 			 WhiteBoardSIBAccessHandle* handle,
@@ -82,8 +88,8 @@ gint serverthread_update(SIBServer* server,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,
-			 guchar *insert_request,
-			 guchar *remove_request);
+			 SIBPayload *insert_request,
+			 SIBPayload *remove_request);
 
 gint serverthread_query(SIBServer* server,
 			 WhiteBoardSIBAccessHandle* handle,
@@ -100,7 +106,7 @@ gint serverthread_remove(SIBServer* server,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,
-			 guchar *request);
+			 SIBPayload *request);
 
 gint serverthread_subscribe(SIBServer* server,
 			    WhiteBoardSIBAccessHandle* handle,
@@ -121,5 +127,18 @@ gint serverthread_unsubscribe(SIBServer* server,
 
 gint serverthread_create_listener();
 
+/**
+ * Release the worker threads and the queue of a SIB. Called when the
+ * server is destroyed.
+ *
+ * @param server The SIBServer
+ */
+void serverthread_release(SIBServer* server);
+
+/**
+ * Log the worker saturation and the request queue statistics of each SIB.
+ */
+void serverthread_maintenance();
+
 #endif
  
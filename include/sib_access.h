@@ -47,6 +47,9 @@ typedef struct _SIBAccess SIBAccess;
 
 #include <sibmsg.h>
 #include "sib_controller.h"
+#include "sib_connection_pool.h"
+#include "sib_reactor.h"
+#include "sib_transport.h"
 
 SIBAccess* sib_access_new(SIBController* cp, guchar *uri, gchar *ip, gint port);
 gboolean sib_access_destroy(SIBAccess *sa);
@@ -66,6 +69,44 @@ void sib_access_ref(SIBAccess* access);
  */
 void sib_access_unref(SIBAccess* access);
 
+/**
+ * Periodic maintenance: close timed out idle connections and log the
+ * connection statistics.
+ *
+ * @param sa The SIBAccess
+ */
+void sib_access_maintenance(SIBAccess *sa);
+
+/**
+ * Get the connection pool statistics of a SIBAccess.
+ *
+ * @param sa The SIBAccess
+ * @param stats Filled with the pool counters
+ * @return FALSE if connection pooling is not in use
+ */
+gboolean sib_access_get_pool_stats(SIBAccess *sa, SIBConnectionPoolStats *stats);
+
+/**
+ * Get the transport used to reach the SIB, see
+ * sib_transport_for_address().
+ *
+ * @param sa The SIBAccess
+ * @return The transport
+ */
+const SIBTransport *sib_access_get_transport(SIBAccess *sa);
+
+/**
+ * Get the write generation of the SIB. It changes whenever an insert,
+ * update or remove through this SIBAccess starts or completes, so a
+ * query result is known to be current if the generation is the same
+ * before the query is sent and when the result is used. Writes by other
+ * processes are not seen.
+ *
+ * @param sa The SIBAccess
+ * @return The generation
+ */
+guint sib_access_get_write_generation(SIBAccess *sa);
+
 gint sib_access_join(SIBAccess *sa,
 		     //apr09obsolete const gchar *username,
 		     ssElement_ct nodeId,
@@ -108,6 +149,79 @@ gint sib_access_query(SIBAccess *sa,
 		      guchar *request,
 		      NodeMsgContent_t *msgContent);
 
+/**
+ * Called once when an asynchronous operation completes.
+ *
+ * @param sa The SIBAccess
+ * @param status 1 if a proper confirmation was received, -1 otherwise
+ * @param msgContent The parsed response, freed after the call
+ * @param user_data User data given to the operation
+ */
+typedef void (*SIBAccessCompleteFunc)(SIBAccess *sa,
+				      gint status,
+				      NodeMsgContent_t *msgContent,
+				      gpointer user_data);
+
+/*
+ * Asynchronous variants of the unary operations. The request is sent
+ * before the function returns and the response is received by a reactor
+ * thread, which calls func. On success 0 is returned and func is called
+ * exactly once; on -1 func is not called. If the reactor cannot watch the
+ * socket, e.g. it uses another transport, or pipelining is in use, the
+ * response is received and func is called before returning.
+ */
+
+gint sib_access_join_async(SIBAccess *sa,
+			   SIBReactor *reactor,
+			   ssElement_ct nodeId,
+			   gint msgnumber,
+			   SIBAccessCompleteFunc func,
+			   gpointer user_data);
+
+gint sib_access_leave_async(SIBAccess *sa,
+			    SIBReactor *reactor,
+			    ssElement_ct nodeId,
+			    gint msgnumber,
+			    SIBAccessCompleteFunc func,
+			    gpointer user_data);
+
+gint sib_access_insert_async(SIBAccess *sa,
+			     SIBReactor *reactor,
+			     ssElement_ct nodeId,
+			     gint msgnumber,
+			     EncodingType encoding,
+			     guchar *request,
+			     SIBAccessCompleteFunc func,
+			     gpointer user_data);
+
+gint sib_access_update_async(SIBAccess *sa,
+			     SIBReactor *reactor,
+			     ssElement_ct nodeId,
+			     gint msgnumber,
+			     EncodingType encoding,
+			     guchar *insert_request,
+			     guchar *remove_request,
+			     SIBAccessCompleteFunc func,
+			     gpointer user_data);
+
+gint sib_access_remove_async(SIBAccess *sa,
+			     SIBReactor *reactor,
+			     ssElement_ct nodeId,
+			     gint msgnumber,
+			     EncodingType encoding,
+			     guchar *request,
+			     SIBAccessCompleteFunc func,
+			     gpointer user_data);
+
+gint sib_access_query_async(SIBAccess *sa,
+			    SIBReactor *reactor,
+			    ssElement_ct nodeId,
+			    gint msgnumber,
+			    gint type,
+			    guchar *request,
+			    SIBAccessCompleteFunc func,
+			    gpointer user_data);
+
 gint sib_access_subscribe(SIBAccess *sa, 
 			  ssElement_ct nodeId,
 			  gint msgnumber,
@@ -124,6 +238,46 @@ gint sib_access_wait_for_subscription_ind(SIBAccess *sa,
 					  ssElement_ct nodeId,
 					  guchar *subscriptionId,
 					  NodeMsgContent_t *msgContent);
+/**
+ * Called from a reactor thread for each message received on a watched
+ * subscription.
+ *
+ * @param sa The SIBAccess
+ * @param msg The message, NULL if status is negative. Freed after the call.
+ * @param status 1 for a subscription indication, 0 for an unsubscribe
+ *               confirmation or indication, negative on error. The
+ *               subscription is no longer watched after status 0 or an error.
+ * @param user_data User data given to sib_access_watch_subscription()
+ */
+typedef void (*SIBAccessSubscriptionFunc)(SIBAccess *sa,
+					  NodeMsgContent_t *msg,
+					  gint status,
+					  gpointer user_data);
+
+/**
+ * Receive the indications of a subscription in a reactor thread instead
+ * of blocking in sib_access_wait_for_subscription_ind(). The subscription
+ * socket is closed when the subscription ends.
+ *
+ * @param sa The SIBAccess
+ * @param reactor The reactor to watch the subscription socket with
+ * @param nodeId Node id of the subscriber
+ * @param subscriptionId Subscription id from the subscribe confirmation
+ * @param func Called for each received message
+ * @param user_data Passed to func and destroy
+ * @param destroy Called when the subscription is no longer watched
+ * @return FALSE if the subscription could not be watched, e.g. the reactor
+ *         uses another transport. destroy is not called then and the
+ *         subscription can still be waited on
+ */
+gboolean sib_access_watch_subscription(SIBAccess *sa,
+				       SIBReactor *reactor,
+				       ssElement_ct nodeId,
+				       guchar *subscriptionId,
+				       SIBAccessSubscriptionFunc func,
+				       gpointer user_data,
+				       GDestroyNotify destroy);
+
 gint sib_access_handle_receive(int sockfd,
 			       NodeMsgContent_t *msgContent);
 
@@ -0,0 +1,121 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_arena.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_ARENA_H
+#define SIB_ARENA_H
+
+#include <glib.h>
+
+/** Alignment of arena allocations */
+#define SIB_ARENA_ALIGN 8
+
+/** Minimum size of the blocks added when an arena runs out of space */
+#define SIB_ARENA_BLOCK_SIZE 1024
+
+/** Size to reserve in an arena for an object of the given size */
+#define SIB_ARENA_SIZE(size) (((size) + SIB_ARENA_ALIGN - 1) & ~(gsize)(SIB_ARENA_ALIGN - 1))
+
+/**
+ * A bump allocator for data with a common lifetime, e.g. one request.
+ * Allocations are not freed individually; everything goes at once with
+ * sib_arena_free(). An arena is not thread safe, but may be handed over
+ * between threads.
+ */
+typedef struct _SIBArena SIBArena;
+
+/** Allocation counters over all arenas */
+typedef struct _SIBArenaStats
+{
+  guint arenas;   /* arenas created */
+  guint blocks;   /* malloc calls, including the arenas themselves */
+  guint allocs;   /* objects allocated from arenas */
+} SIBArenaStats;
+
+/**
+ * Create an arena. The arena and its first block are a single malloc.
+ *
+ * @param size Expected total size of the allocations, see SIB_ARENA_SIZE()
+ * @return New arena
+ */
+SIBArena *sib_arena_new(gsize size);
+
+/**
+ * Free an arena and everything allocated from it.
+ *
+ * @param self The arena
+ */
+void sib_arena_free(SIBArena *self);
+
+/**
+ * Allocate memory from an arena.
+ *
+ * @param self The arena
+ * @param size Size in bytes
+ * @return Memory aligned to SIB_ARENA_ALIGN
+ */
+gpointer sib_arena_alloc(SIBArena *self, gsize size);
+
+/**
+ * Allocate zero-filled memory from an arena.
+ *
+ * @param self The arena
+ * @param size Size in bytes
+ * @return Memory aligned to SIB_ARENA_ALIGN
+ */
+gpointer sib_arena_alloc0(SIBArena *self, gsize size);
+
+/**
+ * Copy a string into an arena.
+ *
+ * @param self The arena
+ * @param str The string, may be NULL
+ * @return The copy or NULL
+ */
+gchar *sib_arena_strdup(SIBArena *self, const gchar *str);
+
+/**
+ * Get the allocation counters.
+ *
+ * @param stats Filled with the counters
+ */
+void sib_arena_get_stats(SIBArenaStats *stats);
+
+#endif
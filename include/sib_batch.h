@@ -0,0 +1,133 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_batch.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_BATCH_H
+#define SIB_BATCH_H
+
+#include <glib.h>
+
+/**
+ * Batching of small requests. Items added with the same key are held
+ * until the batch window of the first one has passed, or the batch
+ * reaches its size or item limit, and are then handed on together.
+ * Thread safe; the window is timed in the default main context.
+ */
+typedef struct _SIBBatcher SIBBatcher;
+
+/**
+ * Called with the items of a batch, outside the batcher's lock, either
+ * from the main loop when the window ends or from the thread whose item
+ * filled the batch.
+ *
+ * @param items The items in the order they were added, free the list
+ *              with g_slist_free()
+ * @param user_data User data given to sib_batcher_new()
+ */
+typedef void (*SIBBatchFunc)(GSList *items, gpointer user_data);
+
+/** Batcher counters */
+typedef struct _SIBBatchStats
+{
+  guint batches;    /* batches handed on */
+  guint items;      /* items in those batches */
+  guint max_batch;  /* most items in one batch */
+  guint early;      /* batches handed on before their window ended */
+  guint waiting;    /* items in batches not handed on yet */
+} SIBBatchStats;
+
+/**
+ * Create a batcher.
+ *
+ * @param window Milliseconds the first item of a batch waits for others
+ * @param max_size Largest total size of the items of a batch
+ * @param max_items Most items in a batch
+ * @param func Called with each batch
+ * @param user_data Passed to func
+ * @return New batcher
+ */
+SIBBatcher *sib_batcher_new(guint window,
+			    gsize max_size,
+			    guint max_items,
+			    SIBBatchFunc func,
+			    gpointer user_data);
+
+/**
+ * Hand on the waiting batches and free the batcher. The memory is
+ * released once the windows of the batches have ended.
+ *
+ * @param self The batcher
+ */
+void sib_batcher_destroy(SIBBatcher *self);
+
+/**
+ * Add an item to the batch of its key, starting a new batch if there is
+ * none or the item does not fit in it.
+ *
+ * @param self The batcher
+ * @param key Key of the batch
+ * @param item The item
+ * @param size Size of the item, counted against max_size
+ * @return FALSE if the item is larger than a batch may be, it is not
+ *         added then
+ */
+gboolean sib_batcher_add(SIBBatcher *self,
+			 const gchar *key,
+			 gpointer item,
+			 gsize size);
+
+/**
+ * Hand on the batch of a key now, e.g. before a request that must not
+ * overtake its items.
+ *
+ * @param self The batcher
+ * @param key Key of the batch
+ */
+void sib_batcher_flush(SIBBatcher *self, const gchar *key);
+
+/**
+ * Get the batcher counters.
+ *
+ * @param self The batcher
+ * @param stats Filled with the counters
+ */
+void sib_batcher_get_stats(SIBBatcher *self, SIBBatchStats *stats);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_connection_pool.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_CONNECTION_POOL_H
+#define SIB_CONNECTION_POOL_H
+
+#include <glib.h>
+
+/** Maximum number of idle connections kept per SIB */
+#define SIB_CONNECTION_POOL_MAX_IDLE 8
+
+/** Seconds an idle connection may stay in the pool before it is closed */
+#define SIB_CONNECTION_POOL_IDLE_TIMEOUT 30
+
+/** Consecutive failed reuses (with no successful reuse) before the pool
+    decides that the SIB closes its connections and stops reusing them */
+#define SIB_CONNECTION_POOL_MAX_REUSE_FAILURES 3
+
+typedef struct _SIBConnectionPool SIBConnectionPool;
+
+/**
+ * A connection checked out from the pool.
+ */
+typedef struct _SIBConnection
+{
+  int s;            // socket
+  gboolean reused;  // TRUE if the connection has been used before
+  guint uses;       // number of completed exchanges
+  GTimeVal last_used;
+} SIBConnection;
+
+typedef struct _SIBConnectionPoolStats
+{
+  guint hits;              // checkouts served by an idle connection
+  guint misses;            // checkouts that had to connect
+  guint connects;          // successful connects
+  guint connect_failures;
+  guint evictions;         // idle connections closed because of timeout
+  guint discards;          // connections closed because they were broken
+  guint reuse_failures;    // reused connections that turned out to be broken
+  guint idle;              // connections currently idle in the pool
+  guint in_use;            // connections currently checked out
+  gdouble connects_per_sec; // connect rate since the previous stats call
+  gboolean reuse_disabled;
+} SIBConnectionPoolStats;
+
+typedef int (*SIBConnectionPoolConnectFunc)(gpointer user_data);
+typedef void (*SIBConnectionPoolCloseFunc)(int s, gpointer user_data);
+
+/**
+ * Create a new connection pool.
+ *
+ * @param max_idle Maximum number of idle connections kept in the pool
+ * @param idle_timeout Seconds after which an idle connection is closed
+ * @param connect Function that opens and connects a new socket
+ * @param close Function that closes a socket
+ * @param user_data Passed to connect and close
+ * @return New pool
+ */
+SIBConnectionPool *sib_connection_pool_new(guint max_idle,
+					   guint idle_timeout,
+					   SIBConnectionPoolConnectFunc connect,
+					   SIBConnectionPoolCloseFunc close,
+					   gpointer user_data);
+
+/**
+ * Close all idle connections and destroy the pool. All connections must
+ * have been checked in before calling this.
+ *
+ * @param self The pool to destroy
+ */
+void sib_connection_pool_destroy(SIBConnectionPool *self);
+
+/**
+ * Get a connection from the pool. An idle connection is reused if one
+ * is available, otherwise a new connection is opened.
+ *
+ * @param self The pool
+ * @return Connection or NULL if connecting failed
+ */
+SIBConnection *sib_connection_pool_checkout(SIBConnectionPool *self);
+
+/**
+ * Return a connection to the pool.
+ *
+ * @param self The pool
+ * @param conn Connection returned by sib_connection_pool_checkout()
+ * @param healthy FALSE if the connection failed and must be closed
+ */
+void sib_connection_pool_checkin(SIBConnectionPool *self,
+				 SIBConnection *conn,
+				 gboolean healthy);
+
+/**
+ * Close idle connections that have exceeded the idle timeout.
+ *
+ * @param self The pool
+ * @return Number of connections closed
+ */
+guint sib_connection_pool_evict_idle(SIBConnectionPool *self);
+
+/**
+ * Get the pool counters. The connect rate is computed over the time
+ * elapsed since the previous call.
+ *
+ * @param self The pool
+ * @param stats Filled with the current counters
+ */
+void sib_connection_pool_get_stats(SIBConnectionPool *self,
+				   SIBConnectionPoolStats *stats);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_delta.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_DELTA_H
+#define SIB_DELTA_H
+
+#include <glib.h>
+
+/**
+ * The net change of a sequence of writes, to be sent as one update. The
+ * last change of each triple wins: a removed triple is dropped from the
+ * triples to insert and an inserted one from the triples to remove, so
+ * each triple is left in one of the two lists. A removal with wildcards
+ * drops all matching triples to insert. The SIB removes before it
+ * inserts, which keeps the result that of the writes in order. A delta
+ * is not thread safe.
+ */
+typedef struct _SIBDelta SIBDelta;
+
+/** Delta counters over all deltas */
+typedef struct _SIBDeltaStats
+{
+  guint deltas;      /* deltas sent */
+  guint triples;     /* triple changes written to them */
+  guint eliminated;  /* triple changes not sent */
+} SIBDeltaStats;
+
+SIBDelta *sib_delta_new(void);
+
+/**
+ * Free a delta that is not sent.
+ *
+ * @param self The delta
+ */
+void sib_delta_free(SIBDelta *self);
+
+/**
+ * Add the triples of an insert.
+ *
+ * @param self The delta
+ * @param triples M3XML triple list
+ * @param error Set on parse error
+ * @return FALSE if the triples could not be parsed, the delta is then
+ *         partly changed and should not be sent
+ */
+gboolean sib_delta_insert(SIBDelta *self, const gchar *triples, GError **error);
+
+/**
+ * Add the triples of a remove, which may contain wildcards.
+ *
+ * @param self The delta
+ * @param triples M3XML triple list
+ * @param error Set on parse error
+ * @return FALSE if the triples could not be parsed, the delta is then
+ *         partly changed and should not be sent
+ */
+gboolean sib_delta_remove(SIBDelta *self, const gchar *triples, GError **error);
+
+/**
+ * Get the net change as M3XML triple lists and free the delta. The
+ * changes are counted in the delta counters.
+ *
+ * @param self The delta
+ * @param inserted Set to the triples to insert, NULL if none
+ * @param removed Set to the triples to remove, NULL if none
+ */
+void sib_delta_finish(SIBDelta *self, gchar **inserted, gchar **removed);
+
+/**
+ * Get the delta counters.
+ *
+ * @param stats Filled with the counters
+ */
+void sib_delta_get_stats(SIBDeltaStats *stats);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_executor.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_EXECUTOR_H
+#define SIB_EXECUTOR_H
+
+#include <glib.h>
+
+/** Capacity of a worker's own task deque; tasks submitted by a worker
+    beyond it go to the shared injection queue */
+#define SIB_EXECUTOR_DEQUE_SIZE 256
+
+/** Tasks a worker moves from the injection queue to its own deque at a
+    time, where idle workers can steal them */
+#define SIB_EXECUTOR_INJECT_BATCH 16
+
+/** Seconds an idle worker waits for tasks before it exits */
+#define SIB_EXECUTOR_IDLE_TIMEOUT 30
+
+typedef struct _SIBExecutor SIBExecutor;
+
+/**
+ * A task run by the executor.
+ *
+ * @param data Data given to sib_executor_submit()
+ */
+typedef void (*SIBExecutorFunc)(gpointer data);
+
+/** Executor counters, summed over the workers */
+typedef struct _SIBExecutorStats
+{
+  guint threads;   /* worker threads now */
+  guint idle;      /* workers waiting for tasks */
+  guint executed;  /* tasks run */
+  guint local;     /* tasks taken from the worker's own deque */
+  guint injected;  /* tasks taken from the injection queue */
+  guint stolen;    /* tasks taken from another worker's deque */
+  guint parked;    /* times a worker went idle */
+} SIBExecutorStats;
+
+/**
+ * Create a work-stealing executor. Each worker thread has its own deque
+ * of tasks: it pushes and pops tasks it submits at one end, and idle
+ * workers steal from the other. Other threads, e.g. the main loop, submit
+ * through a lock-free injection queue. Workers are started on demand and
+ * exit after SIB_EXECUTOR_IDLE_TIMEOUT seconds without work.
+ *
+ * @param max_threads Maximum number of worker threads
+ * @return New executor
+ */
+SIBExecutor *sib_executor_new(guint max_threads);
+
+/**
+ * Run the submitted tasks, stop the workers and free the executor. Must
+ * not be called from a task.
+ *
+ * @param self The executor
+ */
+void sib_executor_destroy(SIBExecutor *self);
+
+/**
+ * Submit a task. It runs in a worker thread, in no particular order with
+ * respect to other tasks.
+ *
+ * @param self The executor
+ * @param func The task
+ * @param data Passed to func
+ */
+void sib_executor_submit(SIBExecutor *self, SIBExecutorFunc func, gpointer data);
+
+/**
+ * Get the executor counters.
+ *
+ * @param self The executor
+ * @param stats Filled with the counters
+ */
+void sib_executor_get_stats(SIBExecutor *self, SIBExecutorStats *stats);
+
+#endif
@@ -0,0 +1,119 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_flight.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_FLIGHT_H
+#define SIB_FLIGHT_H
+
+#include <glib.h>
+
+/**
+ * Single-flight collapsing of identical requests. The first caller with
+ * a key becomes the leader of a flight and does the work; callers with
+ * the same key arriving before the leader lands the flight attach to it
+ * as followers and are given the leader's result. A flight is only
+ * joined at the write generation it was started at, see
+ * sib_access_get_write_generation(), so a request that arrives after a
+ * write has started is never answered with an older result. Thread safe.
+ */
+typedef struct _SIBFlightGroup SIBFlightGroup;
+
+typedef struct _SIBFlight SIBFlight;
+
+/** Flight counters */
+typedef struct _SIBFlightStats
+{
+  guint leaders;    /* flights started */
+  guint followers;  /* requests answered by another request's flight */
+  guint in_flight;  /* flights not landed yet */
+  guint max_group;  /* most requests answered by one flight */
+} SIBFlightStats;
+
+/**
+ * Create a flight group.
+ *
+ * @return New group
+ */
+SIBFlightGroup *sib_flight_group_new(void);
+
+/**
+ * Free a flight group. Flights still in the air are forgotten, their
+ * followers must be landed by their leaders.
+ *
+ * @param self The group
+ */
+void sib_flight_group_destroy(SIBFlightGroup *self);
+
+/**
+ * Join the flight of a key or start a new one.
+ *
+ * @param self The group
+ * @param key Key of the request
+ * @param generation Current write generation of the target
+ * @param waiter Attached to the flight if it is joined, kept by the
+ *               caller otherwise
+ * @return The new flight if the caller is its leader, NULL if waiter was
+ *         attached to a flight in the air
+ */
+SIBFlight *sib_flight_join(SIBFlightGroup *self,
+			   const gchar *key,
+			   guint generation,
+			   gpointer waiter);
+
+/**
+ * Land a flight: later requests with its key start a new one. Called by
+ * the leader when its result is ready.
+ *
+ * @param self The group
+ * @param flight The flight, freed
+ * @return The waiters of the followers in arrival order, free the list
+ *         with g_slist_free()
+ */
+GSList *sib_flight_land(SIBFlightGroup *self, SIBFlight *flight);
+
+/**
+ * Get the flight counters.
+ *
+ * @param self The group
+ * @param stats Filled with the counters
+ */
+void sib_flight_get_stats(SIBFlightGroup *self, SIBFlightStats *stats);
+
+#endif
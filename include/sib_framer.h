@@ -0,0 +1,123 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_framer.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_FRAMER_H
+#define SIB_FRAMER_H
+
+#include <glib.h>
+
+#define SIB_FRAMER_ENDTAG "</SSAP_message>"
+#define SIB_FRAMER_ENDTAGLEN 15
+
+/**
+ * Splits a received byte stream into complete SSAP messages, so that the
+ * parser runs once per message instead of once per received chunk.
+ */
+typedef struct _SIBFramer SIBFramer;
+
+typedef gssize (*SIBFramerFindFunc)(const gchar *buf, gsize len);
+
+SIBFramer *sib_framer_new(void);
+void sib_framer_free(SIBFramer *self);
+
+/**
+ * Feed received bytes to the framer. If a message is completed, msg is
+ * set to it and the number of bytes used from data is returned; the rest
+ * must be fed again. The message stays valid until the next call.
+ * Otherwise msg is set to NULL and all of data is kept by the framer.
+ *
+ * @param self The framer
+ * @param data Received bytes
+ * @param len Number of received bytes
+ * @param msg Set to the complete message or NULL
+ * @param msglen Set to the length of the message
+ * @return Number of bytes used from data
+ */
+gsize sib_framer_feed(SIBFramer *self,
+		      const gchar *data,
+		      gsize len,
+		      const gchar **msg,
+		      gsize *msglen);
+
+/**
+ * Drop a partially received message.
+ *
+ * @param self The framer
+ */
+void sib_framer_reset(SIBFramer *self);
+
+/**
+ * Get the size of the buffer the framer keeps for partial messages.
+ *
+ * @param self The framer
+ * @return The size in bytes
+ */
+gsize sib_framer_get_capacity(SIBFramer *self);
+
+/**
+ * Find the end of the first SSAP message with the fastest search this
+ * CPU supports.
+ *
+ * @param buf Buffer to search
+ * @param len Length of the buffer
+ * @return Offset just past the end tag, -1 if there is no end tag
+ */
+gssize sib_framer_find_end(const gchar *buf, gsize len);
+
+/** Portable end tag search */
+gssize sib_framer_find_end_scalar(const gchar *buf, gsize len);
+
+/**
+ * Get the SSE2 or AVX2 end tag search.
+ *
+ * @return The search function, NULL if not supported by the build or CPU
+ */
+SIBFramerFindFunc sib_framer_get_sse2(void);
+SIBFramerFindFunc sib_framer_get_avx2(void);
+
+/**
+ * Get the name of the search used by sib_framer_find_end().
+ *
+ * @return "avx2", "sse2" or "scalar"
+ */
+const gchar *sib_framer_get_impl_name(void);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_msgcache.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_MSGCACHE_H
+#define SIB_MSGCACHE_H
+
+#include <glib.h>
+
+#include <sibmsg.h>
+
+/** Free parsers and message builders kept per thread */
+#define SIB_MSGCACHE_DEPTH 4
+
+/**
+ * Per-thread caches of SSAP parsers (NodeMsgContent_t) and message
+ * builders (ssBufDesc_t). A returned object is reset and kept for the
+ * next request of the same thread, so the steady state allocates none.
+ * Objects are reused only if libssap declares and exports the calls to
+ * reset them, see configure; otherwise no cache is kept, objects are
+ * created and freed as before and only counted as misses.
+ */
+
+/** Cache counters over all threads */
+typedef struct _SIBMsgCacheStats
+{
+  guint parser_hits;
+  guint parser_misses;
+  guint builder_hits;
+  guint builder_misses;
+} SIBMsgCacheStats;
+
+/**
+ * Get an empty parser, like parseSSAPmsg_new().
+ *
+ * @return The parser, returned with sib_msgcache_put_parser()
+ */
+NodeMsgContent_t *sib_msgcache_get_parser(void);
+
+/**
+ * Return a parser to the calling thread's cache, like parseSSAPmsg_free().
+ * It may be returned by another thread than the one that took it.
+ *
+ * @param msg The parser, set to NULL
+ */
+void sib_msgcache_put_parser(NodeMsgContent_t **msg);
+
+/**
+ * Get an empty message builder, like ssBufDesc_new().
+ *
+ * @return The builder, returned with sib_msgcache_put_builder()
+ */
+ssBufDesc_t *sib_msgcache_get_builder(void);
+
+/**
+ * Return a message builder to the calling thread's cache, like
+ * ssBufDesc_free().
+ *
+ * @param buf The builder, set to NULL
+ */
+void sib_msgcache_put_builder(ssBufDesc_t **buf);
+
+/**
+ * Get the cache counters.
+ *
+ * @param stats Filled with the counters
+ */
+void sib_msgcache_get_stats(SIBMsgCacheStats *stats);
+
+#endif
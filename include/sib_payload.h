@@ -0,0 +1,137 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_payload.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_PAYLOAD_H
+#define SIB_PAYLOAD_H
+
+#include <glib.h>
+
+/**
+ * A reference counted, immutable request payload, e.g. the RDF of an
+ * insert. The payload is handed from the D-Bus callback to the worker
+ * and to later stages by reference, so a large request is held in memory
+ * once. References may be taken and dropped from any thread.
+ */
+typedef struct _SIBPayload SIBPayload;
+
+/** Payload counters over all payloads */
+typedef struct _SIBPayloadStats
+{
+  guint payloads;  /* payloads created */
+  guint copied;    /* payloads created by copying */
+  gsize bytes;     /* bytes copied */
+} SIBPayloadStats;
+
+/**
+ * Take ownership of a buffer allocated with g_malloc(). The buffer is
+ * freed with g_free() when the last reference is dropped.
+ *
+ * @param data The buffer, nul terminated
+ * @param len Length of the data without the terminator, -1 to count it
+ * @return New payload with one reference
+ */
+SIBPayload *sib_payload_new_take(gchar *data, gssize len);
+
+/**
+ * Keep a reference to a buffer owned by someone else, e.g. a D-Bus
+ * message. destroy is called with destroy_data when the last reference is
+ * dropped; the buffer must stay valid and unchanged until then.
+ *
+ * @param data The buffer, nul terminated
+ * @param len Length of the data without the terminator, -1 to count it
+ * @param destroy Called to release the buffer or NULL
+ * @param destroy_data Passed to destroy
+ * @return New payload with one reference
+ */
+SIBPayload *sib_payload_new_wrap(const gchar *data, gssize len,
+				 GDestroyNotify destroy, gpointer destroy_data);
+
+/**
+ * Copy a buffer that is only valid for the duration of a call. The
+ * payload and the copy are a single malloc.
+ *
+ * @param data The buffer
+ * @param len Length of the data, -1 if nul terminated
+ * @return New payload with one reference
+ */
+SIBPayload *sib_payload_new_copy(const gchar *data, gssize len);
+
+/**
+ * Increase the payload's reference count
+ *
+ * @param self The payload
+ * @return The payload
+ */
+SIBPayload *sib_payload_ref(SIBPayload *self);
+
+/**
+ * Decrease the payload's reference count. The data is released when the
+ * counter reaches zero.
+ *
+ * @param self The payload
+ */
+void sib_payload_unref(SIBPayload *self);
+
+/**
+ * Get the data of a payload. It is nul terminated and valid as long as a
+ * reference is held.
+ *
+ * @param self The payload
+ * @return The data
+ */
+const gchar *sib_payload_get_data(SIBPayload *self);
+
+/**
+ * Get the length of a payload.
+ *
+ * @param self The payload
+ * @return Length of the data without the terminator
+ */
+gsize sib_payload_get_len(SIBPayload *self);
+
+/**
+ * Get the payload counters.
+ *
+ * @param stats Filled with the counters
+ */
+void sib_payload_get_stats(SIBPayloadStats *stats);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_pipeline.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_PIPELINE_H
+#define SIB_PIPELINE_H
+
+#include <glib.h>
+#include <sibmsg.h>
+
+/** Seconds to wait for a pipelined response before giving up */
+#define SIB_PIPELINE_TIMEOUT 30
+
+/** Returned by sib_pipeline_transact() when the request cannot be
+    pipelined because a request with the same node id and message number
+    is already outstanding. The caller should use a dedicated connection. */
+#define SIB_PIPELINE_BUSY -2
+
+typedef struct _SIBPipeline SIBPipeline;
+
+/**
+ * Socket operations used by the pipeline.
+ */
+typedef struct _SIBPipelineIO
+{
+  int (*connect)(gpointer user_data);
+  /* sends the whole buffer, returns 0 or -1 */
+  gint (*send)(int s, gchar *buf, gint len, gpointer user_data);
+  gint (*recv)(int s, gchar *buf, gint len, gpointer user_data);
+  /* shuts down both directions, waking up a blocked recv */
+  void (*shutdown)(int s, gpointer user_data);
+  void (*close)(int s, gpointer user_data);
+} SIBPipelineIO;
+
+typedef struct _SIBPipelineStats
+{
+  guint requests;         // requests sent through the pipeline
+  guint busy;             // requests rejected with SIB_PIPELINE_BUSY
+  guint in_flight;        // requests currently waiting for a response
+  guint max_in_flight;    // highest number of outstanding requests
+  guint timeouts;         // requests that got no response in time
+  guint failures;         // requests failed because the connection broke
+  guint connects;         // connections opened
+  guint orphans;          // responses nobody was waiting for
+} SIBPipelineStats;
+
+/**
+ * Create a new pipeline. The connection is opened when the first request
+ * is sent.
+ *
+ * @param io Socket operations
+ * @param user_data Passed to the connect and close operations
+ * @return New pipeline
+ */
+SIBPipeline *sib_pipeline_new(const SIBPipelineIO *io, gpointer user_data);
+
+/**
+ * Close the connection, fail outstanding requests and destroy the pipeline.
+ *
+ * @param self The pipeline
+ */
+void sib_pipeline_destroy(SIBPipeline *self);
+
+/**
+ * Send a request on the shared connection and wait for the response
+ * carrying the same node id and message number. Other requests may be
+ * sent and answered while this one is outstanding.
+ *
+ * @param self The pipeline
+ * @param nodeid Node id of the request
+ * @param msgnumber Message (transaction) number of the request
+ * @param msg The SSAP message
+ * @param len Length of the message
+ * @param response Parsed response
+ * @return Number of bytes parsed, -1 on error or SIB_PIPELINE_BUSY
+ */
+gint sib_pipeline_transact(SIBPipeline *self,
+			   ssElement_ct nodeid,
+			   gint msgnumber,
+			   gchar *msg,
+			   gint len,
+			   NodeMsgContent_t *response);
+
+/**
+ * Get the pipeline counters.
+ *
+ * @param self The pipeline
+ * @param stats Filled with the current counters
+ */
+void sib_pipeline_get_stats(SIBPipeline *self, SIBPipelineStats *stats);
+
+#endif
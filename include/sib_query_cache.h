@@ -0,0 +1,138 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_query_cache.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_QUERY_CACHE_H
+#define SIB_QUERY_CACHE_H
+
+#include <glib.h>
+
+/** Results larger than this fraction of the cache are not cached */
+#define SIB_QUERY_CACHE_MAX_ENTRY_FRACTION 4
+
+/**
+ * A bounded cache of query results, keyed by SIB URI, query type and
+ * query text. Each result is stored with the write generation of its
+ * SIB, see sib_access_get_write_generation(), and is not returned once
+ * the generation has changed. Writes that bypass this process are only
+ * noticed through the optional time to live. The least recently used
+ * results are evicted when the cache is full. Thread safe.
+ */
+typedef struct _SIBQueryCache SIBQueryCache;
+
+/** Query cache counters */
+typedef struct _SIBQueryCacheStats
+{
+  guint hits;
+  guint misses;
+  guint invalidated; /* found, but the SIB had been written since */
+  guint expired;     /* found, but older than the time to live */
+  guint evicted;     /* removed to make room */
+  guint entries;
+  gsize bytes;
+  gsize max_bytes;
+} SIBQueryCacheStats;
+
+/**
+ * Create a query cache.
+ *
+ * @param max_bytes Maximum total size of the keys and results
+ * @param ttl Seconds a result is valid, 0 for no limit
+ * @return New cache
+ */
+SIBQueryCache *sib_query_cache_new(gsize max_bytes, guint ttl);
+
+/**
+ * Free a query cache and the cached results.
+ *
+ * @param self The cache
+ */
+void sib_query_cache_destroy(SIBQueryCache *self);
+
+/**
+ * Look up the result of a query.
+ *
+ * @param self The cache
+ * @param uri URI of the SIB
+ * @param type Query type
+ * @param query Query text
+ * @param generation Current write generation of the SIB
+ * @return Copy of the result, free with g_free(), or NULL
+ */
+gchar *sib_query_cache_lookup(SIBQueryCache *self,
+			      const gchar *uri,
+			      gint type,
+			      const gchar *query,
+			      guint generation);
+
+/**
+ * Store the result of a query.
+ *
+ * @param self The cache
+ * @param uri URI of the SIB
+ * @param type Query type
+ * @param query Query text
+ * @param generation Write generation of the SIB before the query was sent
+ * @param result The result
+ */
+void sib_query_cache_store(SIBQueryCache *self,
+			   const gchar *uri,
+			   gint type,
+			   const gchar *query,
+			   guint generation,
+			   const gchar *result);
+
+/**
+ * Remove the results of one SIB, e.g. when it goes away.
+ *
+ * @param self The cache
+ * @param uri URI of the SIB
+ */
+void sib_query_cache_purge(SIBQueryCache *self, const gchar *uri);
+
+/**
+ * Get the cache counters.
+ *
+ * @param self The cache
+ * @param stats Filled with the counters
+ */
+void sib_query_cache_get_stats(SIBQueryCache *self, SIBQueryCacheStats *stats);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_reactor.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_REACTOR_H
+#define SIB_REACTOR_H
+
+#include <glib.h>
+
+#include "sib_transport.h"
+
+/** Default number of reactor threads */
+#define SIB_REACTOR_THREADS 2
+
+/** Milliseconds a reactor thread waits before picking up added sockets,
+    if it cannot be woken, see sib_reactor_is_prompt() */
+#define SIB_REACTOR_POLL_INTERVAL 200
+
+typedef struct _SIBReactor SIBReactor;
+
+/**
+ * Called by a reactor thread when the socket is readable.
+ *
+ * @param s The socket
+ * @param user_data User data given when the socket was added
+ * @return FALSE to stop watching the socket
+ */
+typedef gboolean (*SIBReactorFunc)(int s, gpointer user_data);
+
+/**
+ * Create a reactor with a fixed number of threads. Each thread waits for
+ * a share of the sockets with the transport's poll and runs their
+ * handlers.
+ *
+ * @param transport Transport of all sockets added to the reactor
+ * @param threads Number of threads
+ * @return New reactor or NULL
+ */
+SIBReactor *sib_reactor_new(const SIBTransport *transport, guint threads);
+
+/**
+ * Stop the threads and release all sockets still being watched.
+ *
+ * @param self The reactor
+ */
+void sib_reactor_destroy(SIBReactor *self);
+
+/**
+ * Start watching a socket. The handler runs in a reactor thread and must
+ * not block; it may read from the socket once per call.
+ *
+ * @param self The reactor
+ * @param s The socket
+ * @param func Handler for readable socket
+ * @param user_data Passed to func and destroy
+ * @param destroy Called when the socket is no longer watched, e.g. to
+ *                close it. May be NULL.
+ * @return FALSE if the socket cannot be watched, destroy is not called then
+ */
+gboolean sib_reactor_add(SIBReactor *self,
+			 int s,
+			 SIBReactorFunc func,
+			 gpointer user_data,
+			 GDestroyNotify destroy);
+
+/**
+ * Stop watching a socket. If the handler is running, destroy is called
+ * after it returns.
+ *
+ * @param self The reactor
+ * @param s The socket
+ */
+void sib_reactor_remove(SIBReactor *self, int s);
+
+/**
+ * Get the number of sockets being watched.
+ *
+ * @param self The reactor
+ * @return Number of sockets
+ */
+guint sib_reactor_get_count(SIBReactor *self);
+
+/**
+ * Check whether added sockets are watched at once. A reactor thread is
+ * woken through a pipe when its sockets change; that is not possible if
+ * the transport's sockets cannot be polled together with a pipe, e.g.
+ * H_IN, and an added socket is then only watched after up to
+ * SIB_REACTOR_POLL_INTERVAL.
+ *
+ * @param self The reactor
+ * @return TRUE if added sockets are watched at once
+ */
+gboolean sib_reactor_is_prompt(SIBReactor *self);
+
+/**
+ * Get the transport of the sockets the reactor can watch.
+ *
+ * @param self The reactor
+ * @return The transport
+ */
+const SIBTransport *sib_reactor_get_transport(SIBReactor *self);
+
+#endif
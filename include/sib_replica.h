@@ -0,0 +1,184 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_replica.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_REPLICA_H
+#define SIB_REPLICA_H
+
+#include <glib.h>
+
+/**
+ * A local copy of the part of a SIB's triples covered by template
+ * subscriptions, the scopes. A scope is filled from its subscription's
+ * results and kept current by its indications and by the writes made
+ * through this component. Template queries inside a valid scope are
+ * answered from the replica.
+ *
+ * Triples are stored as ids of a dictionary of URIs and literals and
+ * indexed in subject-predicate-object, predicate-object-subject and
+ * object-subject-predicate order, so each template is answered from the
+ * index of its first bound field. A replica can be used from any thread.
+ */
+typedef struct _SIBReplica SIBReplica;
+
+/** Replica counters */
+typedef struct _SIBReplicaStats
+{
+  guint scopes;    /* scopes in use */
+  guint invalid;   /* scopes that missed a change */
+  guint triples;   /* triples stored */
+  guint terms;     /* URIs and literals in the dictionary */
+  gsize bytes;     /* estimated memory use */
+  guint hits;      /* queries answered */
+  guint misses;    /* template queries outside the valid scopes */
+  guint reseeds;   /* invalid scopes made valid again */
+} SIBReplicaStats;
+
+SIBReplica *sib_replica_new(void);
+void sib_replica_destroy(SIBReplica *self);
+
+/**
+ * Add the scope of a template subscription. Triples already stored that
+ * match the templates are replaced by the results.
+ *
+ * @param self The replica
+ * @param templates The subscription's query, an M3XML triple list where
+ *                  sib:any matches anything
+ * @param results The subscription's results
+ * @return Id of the scope, 0 if the query or the results could not be parsed
+ */
+guint sib_replica_add_scope(SIBReplica *self,
+			    const gchar *templates,
+			    const gchar *results);
+
+/**
+ * Remove a scope. Its triples not in another scope are dropped.
+ *
+ * @param self The replica
+ * @param scope Id of the scope
+ */
+void sib_replica_remove_scope(SIBReplica *self, guint scope);
+
+/**
+ * Apply an indication of a scope's subscription. A missed indication
+ * makes the scope invalid, it no longer answers queries until it is
+ * re-seeded.
+ *
+ * @param self The replica
+ * @param scope Id of the scope
+ * @param sequence Update sequence of the indication
+ * @param added Triple list of added triples, NULL or empty for none
+ * @param removed Triple list of removed triples, NULL or empty for none
+ */
+void sib_replica_apply(SIBReplica *self,
+		       guint scope,
+		       gint sequence,
+		       const gchar *added,
+		       const gchar *removed);
+
+/**
+ * Apply a successful write. The removed triples, which may be templates,
+ * are removed before the inserted ones are added; triples outside the
+ * scopes are not stored.
+ *
+ * @param self The replica
+ * @param inserted Triple list of inserted triples or NULL
+ * @param removed Triple list of removed triples or NULL
+ * @return FALSE if a triple list could not be parsed, all scopes are
+ *         invalid then
+ */
+gboolean sib_replica_write(SIBReplica *self,
+			   const gchar *inserted,
+			   const gchar *removed);
+
+/**
+ * Make all scopes invalid, e.g. after a write whose effect is not known.
+ *
+ * @param self The replica
+ */
+void sib_replica_invalidate(SIBReplica *self);
+
+/**
+ * Claim a scope to re-seed it from a fresh query if it is invalid. The
+ * scope is not claimed again until sib_replica_reseed_scope() is called
+ * for it.
+ * @param self The replica
+ * @param scope Id of the scope
+ * @param mark Set to the scope's change mark, to be passed on to
+ *             sib_replica_reseed_scope()
+ * @return The scope's query, free with g_free(). NULL if the scope is
+ *         valid, already claimed or removed.
+ */
+gchar *sib_replica_claim_invalid(SIBReplica *self, guint scope, guint *mark);
+
+/**
+ * Re-seed a claimed scope from the results of its query, which makes it
+ * valid again. The scope stays invalid if it saw an indication or a write
+ * while the query was out, the results could be missing that change.
+ * @param self The replica
+ * @param scope Id of the scope
+ * @param mark Change mark given by sib_replica_claim_invalid()
+ * @param results The query's results, NULL if the query failed
+ * @return TRUE if the scope is valid again
+ */
+gboolean sib_replica_reseed_scope(SIBReplica *self,
+				  guint scope,
+				  guint mark,
+				  const gchar *results);
+
+/**
+ * Answer a template query.
+ *
+ * @param self The replica
+ * @param templates The query, an M3XML triple list
+ * @return The matching triples as an M3XML triple list, free with
+ *         g_free(). NULL if a template is not inside a valid scope.
+ */
+gchar *sib_replica_query(SIBReplica *self, const gchar *templates);
+
+/**
+ * Get the replica counters.
+ *
+ * @param self The replica
+ * @param stats Filled with the counters
+ */
+void sib_replica_get_stats(SIBReplica *self, SIBReplicaStats *stats);
+
+#endif
@@ -0,0 +1,217 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_scheduler.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_SCHEDULER_H
+#define SIB_SCHEDULER_H
+
+#include <glib.h>
+
+#include "sib_executor.h"
+
+/** Priority classes, highest first */
+typedef enum _SIBSchedulerClass
+  {
+    SIBSchedulerClassControl, /* join, leave, unsubscribe */
+    SIBSchedulerClassWrite,   /* insert, update, remove */
+    SIBSchedulerClassRead,    /* query, subscribe */
+    SIBSchedulerClassBulk,    /* large requests of any kind */
+    SIBSchedulerClassCount
+  } SIBSchedulerClass;
+
+/** Milliseconds a queued item may wait before it is run ahead of higher
+    classes, indexed by SIBSchedulerClass. Keeps a steady stream of control
+    operations from starving data operations. */
+#define SIB_SCHEDULER_AGING_CONTROL 0
+#define SIB_SCHEDULER_AGING_WRITE 250
+#define SIB_SCHEDULER_AGING_READ 500
+#define SIB_SCHEDULER_AGING_BULK 2000
+
+/** Spare capacity the thread share controller adds to the Little's law
+    estimate of busy threads, in percent */
+#define SIB_SCHEDULER_HEADROOM 25
+
+/** Average queueing time in ms above which the thread share controller
+    grows the threads even if the Little's law estimate says otherwise,
+    and never shrinks them */
+#define SIB_SCHEDULER_WAIT_GOAL 50
+
+typedef struct _SIBScheduler SIBScheduler;
+
+/** Queue statistics of one priority class */
+typedef struct _SIBSchedulerStats
+{
+  guint depth;       /* items queued now */
+  guint peak;        /* highest depth seen */
+  guint pushed;      /* items pushed */
+  guint aged;        /* items run ahead of higher classes due to aging */
+  guint rejected;    /* items refused because the queue was full */
+  guint max_wait;    /* longest queueing time, ms */
+  gdouble avg_wait;  /* average queueing time, ms */
+} SIBSchedulerStats;
+
+/** Saturation of a scheduler */
+typedef struct _SIBSchedulerLoad
+{
+  guint threads;     /* maximum number of items run at a time */
+  guint running;     /* items being run now */
+  guint queued;      /* items queued in all classes */
+  guint max_queued;  /* queue bound, 0 if unbounded */
+
+  /* Last estimate of sib_scheduler_estimate() */
+  gdouble arrival_rate; /* items per second */
+  gdouble service_time; /* average time of an item until it completed, ms */
+  gdouble queue_wait;   /* average queueing time, ms */
+  guint target;         /* threads needed by Little's law and the wait */
+} SIBSchedulerLoad;
+
+/**
+ * Create a scheduler running items on an executor, which may be shared by
+ * several schedulers. A free runner always takes the oldest item of the
+ * highest priority class, unless an item of a lower class has waited
+ * longer than the aging limit of its class.
+ *
+ * @param executor Executor running the items
+ * @param func Called in an executor thread for each item
+ * @param user_data Passed to func
+ * @param max_threads Maximum number of items run at a time
+ * @param max_queued Maximum number of queued items over all classes,
+ *                   0 for no limit
+ * @return New scheduler or NULL
+ */
+SIBScheduler *sib_scheduler_new(SIBExecutor *executor,
+				GFunc func,
+				gpointer user_data,
+				gint max_threads,
+				guint max_queued);
+
+/**
+ * Destroy a scheduler. Nothing may be queued; items being run finish in
+ * their threads, and the scheduler is freed after the last one. May be
+ * called from func.
+ *
+ * @param self The scheduler
+ */
+void sib_scheduler_destroy(SIBScheduler *self);
+
+/**
+ * Queue an item. Takes no lock, any thread.
+ *
+ * @param self The scheduler
+ * @param klass Priority class of the item
+ * @param data The item, passed to func
+ * @return FALSE if the queue is full; the item is not queued then
+ */
+gboolean sib_scheduler_push(SIBScheduler *self,
+			    SIBSchedulerClass klass,
+			    gpointer data);
+
+/**
+ * Change the maximum number of items run at a time.
+ *
+ * @param self The scheduler
+ * @param max_threads Maximum number of items run at a time
+ */
+void sib_scheduler_set_max_threads(SIBScheduler *self, gint max_threads);
+
+/**
+ * Complete the item being run later, e.g. when its response arrives, so
+ * that its service time is measured until then. Called from func; the
+ * caller must call sib_scheduler_complete() once if this returns TRUE.
+ *
+ * @param self The scheduler running the item
+ * @param started Set to when the item started to run
+ * @return FALSE if the thread is not running an item of self, or the item
+ *         was already deferred
+ */
+gboolean sib_scheduler_defer(SIBScheduler *self, GTimeVal *started);
+
+/**
+ * Count the service time of a deferred item, from any thread.
+ *
+ * @param self The scheduler
+ * @param started As set by sib_scheduler_defer()
+ */
+void sib_scheduler_complete(SIBScheduler *self, GTimeVal *started);
+
+/**
+ * Estimate the number of items to run at a time from the load seen since
+ * the previous call. By Little's law the number of busy threads is the
+ * arrival rate times the service time; the estimate is that plus
+ * SIB_SCHEDULER_HEADROOM, plus the threads needed to drain the current
+ * backlog within one period. While the average queueing time exceeds
+ * SIB_SCHEDULER_WAIT_GOAL, the estimate also covers the items waiting on
+ * average and never shrinks. Growth is wanted at once, shrinking by half
+ * the difference per call. Nothing is changed until the caller applies
+ * the estimate with sib_scheduler_set_max_threads().
+ *
+ * @param self The scheduler
+ * @return The wanted maximum number of threads
+ */
+guint sib_scheduler_estimate(SIBScheduler *self);
+
+/**
+ * Get the saturation of a scheduler.
+ *
+ * @param self The scheduler
+ * @param load Filled with the counters
+ */
+void sib_scheduler_get_load(SIBScheduler *self, SIBSchedulerLoad *load);
+
+/**
+ * Get the queue statistics of a priority class.
+ *
+ * @param self The scheduler
+ * @param klass Priority class
+ * @param stats Filled with the counters
+ */
+void sib_scheduler_get_stats(SIBScheduler *self,
+			     SIBSchedulerClass klass,
+			     SIBSchedulerStats *stats);
+
+/**
+ * Get the name of a priority class for logging.
+ *
+ * @param klass Priority class
+ * @return Static name
+ */
+const gchar *sib_scheduler_class_name(SIBSchedulerClass klass);
+
+#endif
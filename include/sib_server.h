@@ -52,6 +52,7 @@ typedef struct _SIBServer SIBServer;
 
 #include "sib_service.h"
 #include "sib_access.h"
+#include "sib_replica.h"
 /*****************************************************************************
  * Browse canceling related declarations
  *****************************************************************************/
@@ -113,6 +114,32 @@ gint sib_server_compare_udn(gconstpointer server, gconstpointer udn);
 
 SIBAccess *sib_server_get_sib_access(SIBServer* self);
 
+/**
+ * Get the replica of the server's SIB.
+ *
+ * @param self An SIBServer instance
+ * @return The replica, NULL if template queries are not answered locally
+ */
+SIBReplica *sib_server_get_replica(SIBServer* self);
+
+/**
+ * Get the slot where the request scheduler of the server's SIB is kept,
+ * so that a request finds it without a lookup under a shared lock. The
+ * slot is NULL until serverthread stores the scheduler.
+ *
+ * @param self An SIBServer instance
+ * @return The slot, read and written with g_atomic_pointer_*()
+ */
+volatile gpointer *sib_server_get_bulkhead(SIBServer* self);
+
+/**
+ * Periodic maintenance of the server's SIB access, e.g. closing idle
+ * connections and logging statistics.
+ *
+ * @param self An SIBServer instance
+ */
+void sib_server_maintenance(SIBServer* self);
+
 /*****************************************************************************/
 
 /*****************************************************************************/
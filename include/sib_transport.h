@@ -0,0 +1,136 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_transport.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_TRANSPORT_H
+#define SIB_TRANSPORT_H
+
+#include <sys/types.h>
+#include <poll.h>
+
+#include <glib.h>
+
+/** Seconds a TCP connection is idle before keepalive probes are sent */
+#define SIB_TRANSPORT_TCP_KEEPIDLE 60
+/** Seconds between TCP keepalive probes */
+#define SIB_TRANSPORT_TCP_KEEPINTVL 10
+/** Unanswered TCP keepalive probes before the connection is dropped */
+#define SIB_TRANSPORT_TCP_KEEPCNT 3
+
+/** Address prefix selecting the Unix domain socket transport */
+#define SIB_TRANSPORT_UNIX_PREFIX "unix:"
+/** Send and receive buffer size of Unix domain sockets */
+#define SIB_TRANSPORT_UNIX_BUFSIZE (256*1024)
+
+/**
+ * Socket operations of one way to reach a SIB. Sockets of different
+ * transports must not be mixed, e.g. in one poll call.
+ */
+typedef struct _SIBTransport
+{
+  const gchar *name;
+
+  /**
+   * Open a connection to the SIB.
+   *
+   * @param ip Address of the SIB, ignored by H_IN
+   * @param port Port of the SIB, used only by TCP
+   * @return The socket, -1 on error
+   */
+  int (*connect)(const gchar *ip, gint port);
+
+  /** Send once, like send(2). @return Bytes sent, -1 on error */
+  gint (*send)(int s, const gchar *buf, gint len);
+
+  /** Receive once, like recv(2). @return Bytes received, 0 on end of stream, -1 on error */
+  gint (*recv)(int s, gchar *buf, gint len);
+
+  /** Shut down one or both directions, like shutdown(2) */
+  gint (*shutdown)(int s, int how);
+
+  void (*close)(int s);
+
+  /** Wait until sockets are readable, like poll(2) with only POLLIN */
+  gint (*poll)(struct pollfd *fds, guint nfds, gint timeout);
+
+  /** Sockets from this number on cannot be polled, 0 if there is no
+      limit. Such a transport's sockets are not operating system
+      descriptors and cannot be polled together with them. */
+  int max_socket;
+} SIBTransport;
+
+/**
+ * Get the NoTA H_IN transport. The SIB is reached at its service id.
+ */
+const SIBTransport *sib_transport_hin(void);
+
+/**
+ * Get the TCP/IP transport. Connections use TCP_NODELAY and keepalive.
+ */
+const SIBTransport *sib_transport_tcp(void);
+
+/**
+ * Get the Unix domain socket transport, for a SIB on the same host. The
+ * address is SIB_TRANSPORT_UNIX_PREFIX followed by the socket path.
+ */
+const SIBTransport *sib_transport_unix(void);
+
+/**
+ * Choose the transport for a SIB from its discovery information.
+ *
+ * @param ip Address of the SIB or NULL
+ * @param port Port of the SIB
+ * @return Unix domain sockets for a "unix:/path" address, TCP if another
+ *         address and a port are given, H_IN otherwise
+ */
+const SIBTransport *sib_transport_for_address(const gchar *ip, gint port);
+
+/**
+ * Send a whole buffer.
+ *
+ * @param transport The transport of the socket
+ * @param s The socket
+ * @param buf Data to send
+ * @param len Length of the data
+ * @return 0 on success, -1 on error
+ */
+gint sib_transport_send_all(const SIBTransport *transport, int s, const gchar *buf, gint len);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_triple.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_TRIPLE_H
+#define SIB_TRIPLE_H
+
+#include <glib.h>
+
+/** Matches any subject, predicate or object in a query template */
+#define SIB_TRIPLE_ANY "sib:any"
+
+/**
+ * An RDF triple as carried in an M3XML triple list.
+ */
+typedef struct _SIBTriple
+{
+  gchar *subject;
+  gchar *predicate;
+  gchar *object;
+  gboolean literal;   // object is a literal, otherwise a URI
+} SIBTriple;
+
+/**
+ * Collects triples from the elements of an M3XML triple list. Used by
+ * GMarkup parsers that meet a triple list inside a larger document.
+ */
+typedef struct _SIBTripleParser SIBTripleParser;
+
+SIBTriple *sib_triple_new(const gchar *subject,
+			  const gchar *predicate,
+			  const gchar *object,
+			  gboolean literal);
+SIBTriple *sib_triple_copy(const SIBTriple *triple);
+void sib_triple_free(SIBTriple *triple);
+
+/**
+ * Hash and equality for keying GHashTables by triple.
+ */
+guint sib_triple_hash(gconstpointer triple);
+gboolean sib_triple_equal(gconstpointer a, gconstpointer b);
+
+/**
+ * Check whether a triple matches a query template triple, where
+ * SIB_TRIPLE_ANY matches anything.
+ *
+ * @param triple The triple
+ * @param pattern The template
+ * @return TRUE if the triple matches
+ */
+gboolean sib_triple_matches(const SIBTriple *triple, const SIBTriple *pattern);
+
+/**
+ * Parse an M3XML triple list.
+ *
+ * @param text The triple list
+ * @param len Length of text, -1 if nul terminated
+ * @param error Set on parse error
+ * @return List of SIBTriple, free with sib_triple_list_free()
+ */
+GSList *sib_triple_list_parse(const gchar *text, gssize len, GError **error);
+
+/**
+ * Append an M3XML triple list.
+ *
+ * @param out String to append to
+ * @param triples List of SIBTriple
+ */
+void sib_triple_list_append(GString *out, GSList *triples);
+
+void sib_triple_list_free(GSList *triples);
+
+SIBTripleParser *sib_triple_parser_new(void);
+
+/*
+ * Feed GMarkup events of the triple list elements. Elements other than
+ * triple_list, triple, subject, predicate and object are ignored.
+ */
+void sib_triple_parser_start(SIBTripleParser *self,
+			     const gchar *element,
+			     const gchar **attribute_names,
+			     const gchar **attribute_values);
+void sib_triple_parser_end(SIBTripleParser *self, const gchar *element);
+void sib_triple_parser_text(SIBTripleParser *self, const gchar *text, gsize len);
+
+/**
+ * Get the number of triples collected so far.
+ */
+guint sib_triple_parser_get_count(SIBTripleParser *self);
+
+/**
+ * Free the parser.
+ *
+ * @param self The parser
+ * @return The collected triples in document order
+ */
+GSList *sib_triple_parser_finish(SIBTripleParser *self);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_view.h
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifndef SIB_VIEW_H
+#define SIB_VIEW_H
+
+#include <glib.h>
+
+/**
+ * The result set of a subscribed query, kept current by applying the
+ * added and removed triples of the subscription's indications, so the
+ * query can be answered without asking the SIB. Only results that are
+ * M3XML triple lists can be kept.
+ *
+ * The update sequence of the indications is tracked: a missed indication
+ * makes the view stale until it is reset from a fresh query result. A view
+ * is not thread safe, its user serializes the calls.
+ */
+typedef struct _SIBView SIBView;
+
+/** View counters over all views */
+typedef struct _SIBViewStats
+{
+  guint views;        /* views in use */
+  guint answers;      /* queries answered from a view */
+  guint indications;  /* indications applied */
+  guint gaps;         /* indications missed */
+  guint resets;       /* views reset from a query result */
+} SIBViewStats;
+
+/**
+ * Create a view of a result set.
+ *
+ * @param results The results of the subscription
+ * @return The view, NULL if the results are not a triple list
+ */
+SIBView *sib_view_new(const gchar *results);
+
+void sib_view_free(SIBView *self);
+
+/**
+ * Replace the contents of a view with a fresh result set of its query.
+ * A stale view is current again afterwards, and the next indication is
+ * taken as the start of the update sequence.
+ *
+ * @param self The view
+ * @param results The query results
+ * @return FALSE if the results are not a triple list, the view is stale then
+ */
+gboolean sib_view_reset(SIBView *self, const gchar *results);
+
+/**
+ * Apply a subscription indication.
+ *
+ * @param self The view
+ * @param sequence Update sequence of the indication
+ * @param added Triple list of added results, NULL or empty for none
+ * @param removed Triple list of removed results, NULL or empty for none
+ * @return FALSE if the view is stale, because an indication was missed or
+ *         could not be parsed
+ */
+gboolean sib_view_apply(SIBView *self,
+			gint sequence,
+			const gchar *added,
+			const gchar *removed);
+
+/**
+ * Get the results of a view.
+ *
+ * @param self The view
+ * @return The results as an M3XML triple list, free with g_free(). NULL
+ *         if the view is stale.
+ */
+gchar *sib_view_get_results(SIBView *self);
+
+/**
+ * Get the update sequence of the last applied indication.
+ *
+ * @param self The view
+ * @return The sequence, -1 if no indication was applied since the view was
+ *         created or reset
+ */
+gint sib_view_get_sequence(SIBView *self);
+
+/**
+ * Get the view counters.
+ *
+ * @param stats Filled with the counters
+ */
+void sib_view_get_stats(SIBViewStats *stats);
+
+#endif
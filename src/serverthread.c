@@ -52,6 +52,17 @@
 #include "sib_server.h"
 #include "sib_service.h"
 #include "sib_access.h"
+#include "sib_reactor.h"
+#include "sib_arena.h"
+#include "sib_batch.h"
+#include "sib_delta.h"
+#include "sib_payload.h"
+#include "sib_query_cache.h"
+#include "sib_executor.h"
+#include "sib_flight.h"
+#include "sib_msgcache.h"
+#include "sib_scheduler.h"
+#include "sib_view.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -62,11 +73,91 @@
 #define INC_COUNT 20
 #define BACKLOG 5
 
-/** Maximum number of browse/metadata threads */
-#define SERVERTHREAD_MAX_THREADS 10
+/** Default minimum number of worker threads of a single SIB, overridden
+    by the SIB_ACCESS_THREADS_MIN environment variable */
+#define SERVERTHREAD_THREADS_FLOOR 2
+
+/** Default maximum number of worker threads over all SIBs, overridden by
+    the SIB_ACCESS_THREADS_MAX environment variable */
+#define SERVERTHREAD_THREADS_CEILING 64
+
+/** Milliseconds between worker pool size adjustments */
+#define SERVERTHREAD_TUNE_INTERVAL 1000
+
+/** Milliseconds between attempts to re-seed invalid replica scopes */
+#define SERVERTHREAD_RESEED_INTERVAL 1000
+
+/** First transaction id of the requests the component makes on its own,
+    above the ids the nodes use */
+#define SERVERTHREAD_OWN_MSGNUMBER 0x40000000
+
+/** Maximum number of requests queued for a single SIB */
+#define SERVERTHREAD_SIB_MAX_QUEUED 128
 #define NODEPORT 10011
-/** The thread pool object */
-static GThreadPool* serverthread_pool = NULL;
+/** Requests larger than this many bytes are scheduled as bulk work */
+#define SERVERTHREAD_BULK_SIZE 16384
+
+/** Most inserts merged into one insert message */
+#define SERVERTHREAD_BATCH_MAX_INSERTS 64
+
+/** Bulkheads: each SIBServer has its own scheduler with a bounded queue
+    and a share of the threads, so a slow or hung SIB can only exhaust its
+    own workers. Created on first use. Requests find the scheduler in
+    their server, the table is only used to go through all of them. */
+static GHashTable* serverthread_bulkheads = NULL;
+static GMutex* serverthread_bulkheads_mutex = NULL;
+static SIBService* serverthread_service = NULL;
+
+/** Worker threads shared by the schedulers of all SIBs */
+static SIBExecutor* serverthread_executor = NULL;
+
+/** Worker pool size limits, see serverthread_tune() */
+static guint serverthread_threads_floor = SERVERTHREAD_THREADS_FLOOR;
+static guint serverthread_threads_ceiling = SERVERTHREAD_THREADS_CEILING;
+
+/** Threads given to all SIBs, at most the ceiling, and threads they were
+    short of at the last serverthread_tune(). Under the bulkheads mutex. */
+static guint serverthread_threads_granted = 0;
+static guint serverthread_threads_short = 0;
+
+/** Reactors receiving subscription indications and asynchronous
+    responses, one per transport since a reactor can only wait on sockets
+    of one transport. Created on first use. */
+static GHashTable* serverthread_reactors = NULL;
+static GMutex* serverthread_reactors_mutex = NULL;
+
+/** Results of repeated queries, NULL if not cached */
+static SIBQueryCache* serverthread_query_cache = NULL;
+
+/** Queries in flight, identical queries wait for their results */
+static SIBFlightGroup* serverthread_flights = NULL;
+
+/** Writes of a node waiting to be merged, NULL if each write is sent
+    on its own */
+static SIBBatcher* serverthread_batcher = NULL;
+
+/** Whether removes and updates are batched and combined with inserts
+    into their net change, see serverthread_combine_thread() */
+static gboolean serverthread_combine = FALSE;
+
+/** Subscriptions watched by the reactor, by sharing key and by the
+    subscription ids given to their subscribers */
+static GHashTable* serverthread_subscriptions = NULL;
+static GHashTable* serverthread_subscribers = NULL;
+static GMutex* serverthread_subscriptions_mutex = NULL;
+static guint serverthread_subscriptions_upstream = 0;
+static guint serverthread_subscriptions_joined = 0;
+
+/** Whether shared subscriptions keep a view of their results for
+    answering the identical query, see serverthread_view_lookup() */
+static gboolean serverthread_views = FALSE;
+
+/** Changed by every view change, a query result is only used to refresh
+    a view if no view changed while the query was out */
+static volatile gint serverthread_views_changes = 0;
+
+/** Next transaction id of a request made on the component's own */
+static volatile gint serverthread_own_msgnumber = SERVERTHREAD_OWN_MSGNUMBER;
 
 /*****************************************************************************
  * Type definitions
@@ -83,11 +174,15 @@ typedef enum _ServerThreadAction
     ServerThreadActionQuery,
     ServerThreadActionSubscribe,
     ServerThreadActionUnsubscribe,
+    ServerThreadActionCombine,
   } ServerThreadAction;
 
-/** Server thread action arguments */
+/** Server thread action arguments. The structure and its strings are
+    allocated from the request's arena, except the payloads of insert,
+    update and remove, which are held by reference. */
 typedef struct _ServerThreadArgs
 {
+  SIBArena *arena;
   ServerThreadAction action;
   
   SIBServer* server;
@@ -99,6 +194,10 @@ typedef struct _ServerThreadArgs
   gint q_type;
   guchar *insert_request;
   guchar *remove_request; /* used only with update */
+  SIBPayload *insert_payload; /* holds insert_request, if not in the arena */
+  SIBPayload *remove_payload; /* holds remove_request, if not in the arena */
+  SIBFlight *flight; /* query answering identical queries, if the leader */
+  GSList *batch; /* merged writes answered besides handle */
   gint start;
   gint count;
   EncodingType encoding;
@@ -106,6 +205,103 @@ typedef struct _ServerThreadArgs
   
 } ServerThreadArgs;
 
+/** An indication held for a subscriber that has not got its results yet */
+typedef struct _ServerThreadIndication
+{
+  gchar *added;
+  gchar *removed;
+} ServerThreadIndication;
+
+/** A handle receiving the indications of a subscription */
+typedef struct _ServerThreadSubscriber
+{
+  WhiteBoardSIBAccessHandle* handle;
+  gint access_id;
+  guchar *subscriptionid;
+  gboolean leader;    /* made the subscription in the SIB */
+  gboolean pending;   /* waiting for its initial results */
+  gint seqnum;
+  GSList *queued;
+} ServerThreadSubscriber;
+
+/** A subscription in the SIB whose indications are received by the
+    reactor and sent to each of its subscribers */
+typedef struct _ServerThreadSubscription
+{
+  SIBServer* server;
+  gchar *key;                /* NULL if not offered for sharing */
+  ssElement_ct nodeid;
+  guchar *subscriptionid;
+  GSList *subscribers;
+  ServerThreadSubscriber *closer;
+  guint next_local;
+  gboolean closed;
+  SIBView *view;             /* NULL if the results are not kept */
+  guint view_generation;     /* write generation the view is current for */
+  guint scope;               /* replica scope, 0 if none */
+  GMutex *mutex;
+  volatile gint refcount;
+} ServerThreadSubscription;
+
+typedef void (*ServerThreadRespondFunc)(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response);
+
+/** An operation whose response is received by the reactor */
+typedef struct _ServerThreadCompletion
+{
+  SIBServer* server;
+  WhiteBoardSIBAccessHandle* handle;
+  gint access_id;
+  ServerThreadRespondFunc respond;
+  SIBReactor *reactor;
+  SIBScheduler *scheduler; /* counts the service time, NULL if none */
+  GTimeVal started;
+  gint q_type;
+  gchar *query;       /* query text, NULL if not a query */
+  guint generation;   /* write generation when the query was sent */
+  guint view_mark;    /* view changes when the query was sent */
+  gboolean write;     /* insert, update or remove applied to the replica */
+  EncodingType encoding;
+  gchar *inserted;
+  gchar *removed;
+  SIBFlight *flight;  /* answers identical queries, NULL if none */
+  GSList *batch;      /* merged writes answered besides handle */
+} ServerThreadCompletion;
+
+/** A query answered by an identical query in flight */
+typedef struct _ServerThreadFollower
+{
+  WhiteBoardSIBAccessHandle* handle;
+  gint access_id;
+} ServerThreadFollower;
+
+/** A write waiting to be merged with the other writes of its node */
+typedef struct _ServerThreadBatched
+{
+  ServerThreadAction action;
+  SIBServer* server;
+  WhiteBoardSIBAccessHandle* handle;
+  guchar *nodeid;
+  guchar *sibid;
+  gint msgnumber;
+  SIBPayload *inserted;  /* NULL for a remove */
+  SIBPayload *removed;   /* NULL for an insert */
+  const gchar *triples;  /* the triples inside the triple list of inserted */
+  gsize len;
+} ServerThreadBatched;
+
+/** The thread share of a SIB, see serverthread_tune() */
+typedef struct _ServerThreadShare
+{
+  SIBServer* server;
+  SIBScheduler *scheduler;
+  guint current;  /* threads before tuning */
+  guint wanted;   /* estimate, within [floor, ceiling] */
+  guint threads;  /* granted */
+} ServerThreadShare;
+
 
 
 /*****************************************************************************
@@ -143,7 +339,8 @@ static void serverthread_insert_thread(SIBService* service,
 				       ssElement_ct sibid,
 				       gint msgnumber,
 				       EncodingType encoding,
-				       guchar *request);
+				       guchar *request,
+				       GSList *batch);
 
 static void serverthread_update_thread(SIBService* service,
 				       SIBServer* server,
@@ -172,7 +369,8 @@ static void serverthread_query_thread(SIBService* service,
 				      ssElement_ct sibid,
 				      gint msgnumber,
 				      gint type,
-				      guchar *request);
+				      guchar *request,
+				      SIBFlight *flight);
 
 static void serverthread_subscribe_thread(SIBService* service,
 					  SIBServer* server,
@@ -193,6 +391,218 @@ static void serverthread_unsubscribe_thread(SIBService* service,
 					    gint msgnumber,
 					    guchar *request);
 
+static ServerThreadArgs* serverthread_args_new(ServerThreadAction action,
+					       SIBServer* server,
+					       WhiteBoardSIBAccessHandle* handle,
+					       guchar *nodeid,
+					       guchar *sibid,
+					       guchar *insert_request,
+					       guchar *remove_request);
+
+static void serverthread_push(ServerThreadArgs* sta);
+
+static SIBScheduler *serverthread_get_bulkhead(SIBServer* server);
+
+static void serverthread_reject(ServerThreadArgs* sta);
+
+static void serverthread_args_free(ServerThreadArgs* sta);
+
+static void serverthread_args_set_payload(ServerThreadArgs* sta,
+					  SIBPayload *insert_request,
+					  SIBPayload *remove_request);
+
+static guint serverthread_getenv(const gchar *name, guint value);
+
+static gboolean serverthread_getenv_bool(const gchar *name, gboolean value);
+
+static gboolean serverthread_tune(gpointer user_data);
+
+static void serverthread_tune_estimate(gpointer key,
+				       gpointer value,
+				       gpointer user_data);
+
+static void serverthread_tune_apply(ServerThreadShare *share);
+
+static void serverthread_log_bulkhead(gpointer key,
+				      gpointer value,
+				      gpointer user_data);
+
+static SIBReactor *serverthread_get_reactor(SIBServer* server);
+
+static gboolean serverthread_watch_subscription(SIBServer* server,
+						WhiteBoardSIBAccessHandle* handle,
+						gint access_id,
+						ssElement_ct nodeid,
+						guchar *subscriptionid,
+						gint type,
+						guchar *request,
+						const gchar *results,
+						guint generation);
+
+static gboolean serverthread_subscription_join(SIBServer* server,
+					       WhiteBoardSIBAccessHandle* handle,
+					       gint access_id,
+					       ssElement_ct nodeid,
+					       gint msgnumber,
+					       gint type,
+					       guchar *request);
+
+static gboolean serverthread_subscription_leave(SIBServer* server,
+						WhiteBoardSIBAccessHandle* handle,
+						gint access_id,
+						gint msgnumber,
+						guchar *subscriptionid);
+
+static void serverthread_subscription_cb(SIBAccess *sa,
+					 NodeMsgContent_t *msg,
+					 gint status,
+					 gpointer user_data);
+
+static void serverthread_subscription_unshare(ServerThreadSubscription *sub);
+
+static void serverthread_subscription_free(gpointer data);
+
+static void serverthread_subscription_unref(ServerThreadSubscription *sub);
+
+static ServerThreadSubscriber *serverthread_subscriber_new(WhiteBoardSIBAccessHandle* handle,
+							   gint access_id,
+							   guchar *subscriptionid);
+
+static void serverthread_subscriber_unregister(ServerThreadSubscription *sub,
+					       ServerThreadSubscriber *subscriber);
+
+static void serverthread_subscriber_free(ServerThreadSubscriber *subscriber);
+
+static void serverthread_indication_free(ServerThreadIndication *ind);
+
+static ServerThreadSubscription *serverthread_subscription_find(SIBServer* server,
+								gint type,
+								const guchar *request);
+
+static gchar *serverthread_view_lookup(SIBServer* server,
+				       gint type,
+				       const guchar *request);
+
+static void serverthread_view_reset(SIBServer* server,
+				    gint type,
+				    const gchar *query,
+				    guint generation,
+				    guint view_mark,
+				    const guchar *results);
+
+static gboolean serverthread_async(SIBServer* server,
+				   WhiteBoardSIBAccessHandle* handle,
+				   gint access_id,
+				   ServerThreadRespondFunc respond,
+				   ServerThreadCompletion **completion);
+
+static void serverthread_complete(SIBAccess *sa,
+				  gint status,
+				  NodeMsgContent_t *msg,
+				  gpointer user_data);
+
+static void serverthread_insert_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response);
+
+static void serverthread_update_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response);
+
+static void serverthread_remove_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response);
+
+static void serverthread_query_respond(WhiteBoardSIBAccessHandle* handle,
+				       gint access_id,
+				       gint success,
+				       NodeMsgContent_t *response);
+
+static void serverthread_query_store(SIBServer* server,
+				     gint type,
+				     const gchar *query,
+				     guint generation,
+				     guint view_mark,
+				     gint success,
+				     NodeMsgContent_t *response);
+
+static const guchar *serverthread_query_results(gint success,
+						NodeMsgContent_t *response);
+
+static void serverthread_query_send(WhiteBoardSIBAccessHandle* handle,
+				    gint access_id,
+				    const guchar *results);
+
+static void serverthread_query_land(SIBFlight *flight,
+				    const guchar *results);
+
+static void serverthread_replica_hold(ServerThreadCompletion *completion,
+				      EncodingType encoding,
+				      guchar *inserted,
+				      guchar *removed);
+
+static void serverthread_replica_write(SIBServer* server,
+				       EncodingType encoding,
+				       const gchar *inserted,
+				       const gchar *removed,
+				       gint success,
+				       NodeMsgContent_t *response);
+
+static gboolean serverthread_replica_reseed_all(gpointer user_data);
+
+static void serverthread_replica_collect(gpointer key,
+					 gpointer value,
+					 gpointer user_data);
+
+static void serverthread_replica_reseed(gpointer data);
+
+static gboolean serverthread_batch_write(SIBServer* server,
+					 WhiteBoardSIBAccessHandle* handle,
+					 ServerThreadAction action,
+					 guchar *nodeid,
+					 guchar *sibid,
+					 gint msgnumber,
+					 EncodingType encoding,
+					 SIBPayload *inserted,
+					 SIBPayload *removed);
+
+static gboolean serverthread_batch_triples(const gchar *data,
+					   const gchar **triples,
+					   gsize *len);
+
+static gchar *serverthread_batch_key(SIBServer* server,
+				     guchar *nodeid,
+				     EncodingType encoding);
+
+static void serverthread_batch_flush(SIBServer* server,
+				     guchar *nodeid);
+
+static void serverthread_batch_send(GSList *items,
+				    gpointer user_data);
+
+static void serverthread_combine_thread(SIBService* service,
+					SIBServer* server,
+					ssElement_ct nodeid,
+					gint msgnumber,
+					GSList *batch);
+
+static void serverthread_batched_run(SIBService* service,
+				     ServerThreadBatched *batched);
+
+static void serverthread_batch_respond(GSList *batch,
+				       gint access_id,
+				       gint success,
+				       NodeMsgContent_t *response);
+
+static ServerThreadRespondFunc serverthread_batch_respond_func(ServerThreadAction action);
+
+static void serverthread_batched_reject(ServerThreadBatched *batched);
+
+static void serverthread_batched_free(ServerThreadBatched *batched);
+
 
 
 /*****************************************************************************
@@ -203,14 +613,50 @@ gint serverthread_init(SIBService* service)
 {
   g_return_val_if_fail(service != NULL, FALSE);
 	
-  /* Create a server thread pool */
-  serverthread_pool = g_thread_pool_new(serverthread,
-					service,
-					SERVERTHREAD_MAX_THREADS,
-					FALSE,
-					NULL);
-	
-  g_return_val_if_fail(serverthread_pool != NULL, FALSE);
+  /* The thread pools are created per SIB on first use */
+  serverthread_service = service;
+  serverthread_bulkheads = g_hash_table_new(g_direct_hash, g_direct_equal);
+  serverthread_bulkheads_mutex = g_mutex_new();
+
+  serverthread_threads_floor = MAX(1, serverthread_getenv("SIB_ACCESS_THREADS_MIN",
+							  serverthread_threads_floor));
+  serverthread_threads_ceiling = MAX(serverthread_threads_floor,
+				     serverthread_getenv("SIB_ACCESS_THREADS_MAX",
+							 serverthread_threads_ceiling));
+  whiteboard_log_debug("Worker threads per SIB: min %u, all SIBs: max %u\n",
+		       serverthread_threads_floor, serverthread_threads_ceiling);
+  serverthread_executor = sib_executor_new(serverthread_threads_ceiling);
+  g_timeout_add(SERVERTHREAD_TUNE_INTERVAL, serverthread_tune, NULL);
+
+  serverthread_reactors = g_hash_table_new(g_direct_hash, g_direct_equal);
+  serverthread_reactors_mutex = g_mutex_new();
+
+  serverthread_flights = sib_flight_group_new();
+
+#ifdef WITH_INSERT_BATCHING
+  /* a merged insert is not large enough to be scheduled as bulk work */
+  serverthread_batcher = sib_batcher_new(SIB_INSERT_BATCH_WINDOW,
+					 SERVERTHREAD_BULK_SIZE - strlen("<triple_list></triple_list>"),
+					 SERVERTHREAD_BATCH_MAX_INSERTS,
+					 serverthread_batch_send, NULL);
+#endif
+#ifdef WITH_WRITE_COMBINING
+  serverthread_combine = (serverthread_batcher != NULL);
+#endif
+
+  serverthread_subscriptions = g_hash_table_new(g_str_hash, g_str_equal);
+  serverthread_subscribers = g_hash_table_new(g_str_hash, g_str_equal);
+  serverthread_subscriptions_mutex = g_mutex_new();
+#ifdef WITH_QUERY_VIEWS
+  serverthread_views = serverthread_getenv_bool("SIB_ACCESS_QUERY_VIEWS", TRUE);
+#endif
+
+#ifdef WITH_QUERY_CACHE
+  serverthread_query_cache = sib_query_cache_new(SIB_QUERY_CACHE_SIZE, SIB_QUERY_CACHE_TTL);
+#endif
+#ifdef WITH_REPLICA
+  g_timeout_add(SERVERTHREAD_RESEED_INTERVAL, serverthread_replica_reseed_all, NULL);
+#endif
 
   return TRUE;
 }
@@ -233,15 +679,11 @@ gint serverthread_join(SIBServer* server,
   sib_server_ref(server);
   whiteboard_sib_access_handle_ref(handle);
 
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionJoin;
-  sta->server = server;
-  sta->sibid = (ssElement_ct)g_strdup( (gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup( (gchar *)nodeid);
-  sta->handle = handle; 
+  sta = serverthread_args_new(ServerThreadActionJoin, server, handle,
+			      nodeid, sibid, NULL, NULL);
   sta->access_id = access_id; 
   sta->msgnumber = msgnumber;
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -266,16 +708,12 @@ gint serverthread_leave(SIBServer* server,
   sib_server_ref(server);
   whiteboard_sib_access_handle_ref(handle);
 
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionLeave;
-  sta->server = server;
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  sta = serverthread_args_new(ServerThreadActionLeave, server, handle,
+			      nodeid, sibid, NULL, NULL);
   /* 	sta->start = start; */
   /* 	sta->count = count; */
-  sta->handle = handle; 
   sta->msgnumber = msgnumber;
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -290,7 +728,7 @@ gint serverthread_insert(SIBServer* server,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,			 
-			 guchar *request )
+			 SIBPayload *request )
 {
   ServerThreadArgs* sta = NULL;
 
@@ -301,20 +739,24 @@ gint serverthread_insert(SIBServer* server,
 	
   /* 	g_return_val_if_fail(itemid != NULL, -1); */
 
+  if (serverthread_batch_write(server, handle, ServerThreadActionInsert,
+			       nodeid, sibid, msgnumber, encoding, request, NULL))
+    {
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+  serverthread_batch_flush(server, nodeid);
+
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionInsert;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup( (gchar *)request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  sta = serverthread_args_new(ServerThreadActionInsert, server, handle,
+			      nodeid, sibid, NULL, NULL);
+  serverthread_args_set_payload(sta, request, NULL);
   sta->msgnumber = msgnumber;
-  sta->handle = handle;
   sta->encoding = encoding;
   /* 	sta->browse_id = browse_id; */
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -327,8 +769,8 @@ gint serverthread_update(SIBServer* server,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,
-			 guchar *insert_request,
-			 guchar *remove_request)
+			 SIBPayload *insert_request,
+			 SIBPayload *remove_request)
 {
   ServerThreadArgs* sta = NULL;
 
@@ -340,21 +782,24 @@ gint serverthread_update(SIBServer* server,
   
   /* 	g_return_val_if_fail(itemid != NULL, -1); */
 
+  if (serverthread_batch_write(server, handle, ServerThreadActionUpdate,
+			       nodeid, sibid, msgnumber, encoding,
+			       insert_request, remove_request))
+    {
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+  serverthread_batch_flush(server, nodeid);
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionUpdate;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup((gchar *)insert_request);
-  sta->remove_request = (guchar *)g_strdup((gchar *)remove_request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  sta = serverthread_args_new(ServerThreadActionUpdate, server, handle,
+			      nodeid, sibid, NULL, NULL);
+  serverthread_args_set_payload(sta, insert_request, remove_request);
   sta->msgnumber = msgnumber;
-  sta->handle = handle;
   sta->encoding = encoding;
   /* 	sta->browse_id = browse_id; */
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -367,7 +812,7 @@ gint serverthread_remove(SIBServer* server,
 			 guchar *sibid,
 			 gint msgnumber,
 			 EncodingType encoding,
-			 guchar *request)
+			 SIBPayload *request)
 {
   ServerThreadArgs* sta = NULL;
 
@@ -378,20 +823,23 @@ gint serverthread_remove(SIBServer* server,
 	
   /* 	g_return_val_if_fail(itemid != NULL, -1); */
 
+  if (serverthread_batch_write(server, handle, ServerThreadActionRemove,
+			       nodeid, sibid, msgnumber, encoding, NULL, request))
+    {
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+  serverthread_batch_flush(server, nodeid);
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionRemove;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup((gchar *)request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  sta = serverthread_args_new(ServerThreadActionRemove, server, handle,
+			      nodeid, sibid, NULL, NULL);
+  serverthread_args_set_payload(sta, request, NULL);
   sta->msgnumber = msgnumber;
-  sta->handle = handle;
   sta->encoding = encoding;
   /* 	sta->browse_id = browse_id; */
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -408,6 +856,10 @@ gint serverthread_query(SIBServer* server,
 			guchar *request)
 {
   ServerThreadArgs* sta = NULL;
+  ServerThreadFollower* follower = NULL;
+  SIBFlight* flight = NULL;
+  gchar *key = NULL;
+  gchar *results = NULL;
 
   whiteboard_log_debug_fb();
 	
@@ -416,20 +868,47 @@ gint serverthread_query(SIBServer* server,
 	
   /* 	g_return_val_if_fail(itemid != NULL, -1); */
 
+  /* A subscription to the same query keeps its results current */
+  results = serverthread_view_lookup(server, type, request);
+  if (results != NULL)
+    {
+      serverthread_query_send(handle, access_id, (guchar *)results);
+      g_free(results);
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+
+  /* An identical query in flight answers this one as well, without
+     another worker or round trip. The follower must hold its handle
+     before joining, the flight may land right after. */
+  follower = g_new(ServerThreadFollower, 1);
+  follower->handle = handle;
+  follower->access_id = access_id;
+  whiteboard_sib_access_handle_ref(handle);
+  key = g_strdup_printf("%s\n%d\n%s", sib_server_get_udn(server), type, request);
+  flight = sib_flight_join(serverthread_flights, key,
+			   sib_access_get_write_generation(sib_server_get_sib_access(server)),
+			   follower);
+  g_free(key);
+  if (flight == NULL)
+    {
+      whiteboard_log_debug("Query joined an identical query in flight\n");
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+  whiteboard_sib_access_handle_unref(handle);
+  g_free(follower);
+
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionQuery;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup((gchar *)request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
-  sta->handle = handle;
+  sta = serverthread_args_new(ServerThreadActionQuery, server, handle,
+			      nodeid, sibid, request, NULL);
   sta->msgnumber = msgnumber;
   sta->access_id = access_id;
   sta->q_type = type;
+  sta->flight = flight;
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -457,18 +936,13 @@ gint serverthread_subscribe(SIBServer* server,
 
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionSubscribe;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup((gchar *)request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
-  sta->handle = handle;
+  sta = serverthread_args_new(ServerThreadActionSubscribe, server, handle,
+			      nodeid, sibid, request, NULL);
   sta->msgnumber = msgnumber;
   sta->access_id = access_id;
   sta->q_type = type;
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -493,17 +967,12 @@ gint serverthread_unsubscribe(SIBServer* server,
 
   sib_server_ref(server);
 	
-  sta = g_new0(ServerThreadArgs, 1);
-  sta->action = ServerThreadActionUnsubscribe;
-  sta->server = server;
-  sta->insert_request = (guchar *)g_strdup((gchar *)request);
-  sta->sibid = (ssElement_ct)g_strdup((gchar *)sibid);
-  sta->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
-  sta->handle = handle;
+  sta = serverthread_args_new(ServerThreadActionUnsubscribe, server, handle,
+			      nodeid, sibid, request, NULL);
   sta->msgnumber = msgnumber;
   sta->access_id = access_id;
   whiteboard_sib_access_handle_ref(sta->handle);
-  g_thread_pool_push(serverthread_pool, sta, NULL);
+  serverthread_push(sta);
 
   whiteboard_log_debug_fe();
 
@@ -511,159 +980,759 @@ gint serverthread_unsubscribe(SIBServer* server,
 }
 
 
+void serverthread_release(SIBServer* server)
+{
+  SIBScheduler *scheduler = NULL;
+  SIBSchedulerLoad load;
+
+  g_return_if_fail(server != NULL);
+  g_return_if_fail(serverthread_bulkheads != NULL);
+
+  g_mutex_lock(serverthread_bulkheads_mutex);
+  scheduler = (SIBScheduler *)g_hash_table_lookup(serverthread_bulkheads, server);
+  if (scheduler != NULL)
+    {
+      sib_scheduler_get_load(scheduler, &load);
+      serverthread_threads_granted -= MIN(load.threads,
+					  serverthread_threads_granted);
+      g_hash_table_remove(serverthread_bulkheads, server);
+      g_atomic_pointer_compare_and_exchange(sib_server_get_bulkhead(server),
+					    scheduler, NULL);
+    }
+  g_mutex_unlock(serverthread_bulkheads_mutex);
+
+  /* Usually called from the server's own last request */
+  if (scheduler != NULL)
+    sib_scheduler_destroy(scheduler);
+
+  if (serverthread_query_cache != NULL)
+    sib_query_cache_purge(serverthread_query_cache,
+			  (const gchar *)sib_server_get_udn(server));
+}
+
+void serverthread_maintenance()
+{
+  SIBExecutorStats stats;
+  SIBArenaStats arena;
+  SIBPayloadStats payload;
+  SIBQueryCacheStats query;
+  SIBFlightStats flights;
+  SIBViewStats views;
+  SIBBatchStats batches;
+  SIBDeltaStats deltas;
+
+  g_return_if_fail(serverthread_bulkheads != NULL);
+
+  sib_executor_get_stats(serverthread_executor, &stats);
+  whiteboard_log_debug("Workers: %u threads, %u idle, ran %u tasks "
+		       "(own %u, injected %u, stolen %u), parked %u times\n",
+		       stats.threads, stats.idle, stats.executed,
+		       stats.local, stats.injected, stats.stolen, stats.parked);
+
+  sib_arena_get_stats(&arena);
+  if (arena.arenas > 0)
+    whiteboard_log_debug("Request arenas: %u, %.2f mallocs and %.2f "
+			 "allocations per request\n",
+			 arena.arenas,
+			 (gdouble)arena.blocks / arena.arenas,
+			 (gdouble)arena.allocs / arena.arenas);
+
+  sib_payload_get_stats(&payload);
+  if (payload.payloads > 0)
+    whiteboard_log_debug("Request payloads: %u, %u copied (%lu bytes)\n",
+			 payload.payloads, payload.copied, (gulong)payload.bytes);
+
+  sib_flight_get_stats(serverthread_flights, &flights);
+  if (flights.leaders > 0)
+    whiteboard_log_debug("Query flights: %u round trips for %u queries "
+			 "(%.2f queries per round trip), %u in flight, "
+			 "largest group %u\n",
+			 flights.leaders, flights.leaders + flights.followers,
+			 (gdouble)(flights.leaders + flights.followers) / flights.leaders,
+			 flights.in_flight, flights.max_group);
+
+  if (serverthread_batcher != NULL)
+    {
+      sib_batcher_get_stats(serverthread_batcher, &batches);
+      if (batches.batches > 0)
+	whiteboard_log_debug("Write batches: %u batches of %u writes "
+			     "(%.2f writes per batch), %u sent early, "
+			     "largest %u, %u waiting\n",
+			     batches.batches, batches.items,
+			     (gdouble)batches.items / batches.batches,
+			     batches.early, batches.max_batch, batches.waiting);
+    }
+
+  sib_delta_get_stats(&deltas);
+  if (deltas.deltas > 0)
+    whiteboard_log_debug("Write combining: %u combined writes, %u of %u triple "
+			 "changes eliminated\n",
+			 deltas.deltas, deltas.eliminated, deltas.triples);
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  if (serverthread_subscriptions_upstream > 0)
+    whiteboard_log_debug("Subscriptions: %u in the SIBs for %u subscribers, "
+			 "%u joined an existing one\n",
+			 serverthread_subscriptions_upstream,
+			 g_hash_table_size(serverthread_subscribers),
+			 serverthread_subscriptions_joined);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  sib_view_get_stats(&views);
+  if (views.views > 0)
+    whiteboard_log_debug("Query views: %u, %u queries answered, %u indications "
+			 "applied, %u missed, %u views refreshed\n",
+			 views.views, views.answers, views.indications,
+			 views.gaps, views.resets);
+
+  if (serverthread_query_cache != NULL)
+    {
+      sib_query_cache_get_stats(serverthread_query_cache, &query);
+      whiteboard_log_debug("Query cache: hits %u, misses %u, invalidated %u, "
+			   "expired %u, evicted %u, %u results, %lu/%lu bytes\n",
+			   query.hits, query.misses, query.invalidated,
+			   query.expired, query.evicted, query.entries,
+			   (gulong)query.bytes, (gulong)query.max_bytes);
+    }
+
+  g_mutex_lock(serverthread_bulkheads_mutex);
+  g_hash_table_foreach(serverthread_bulkheads, serverthread_log_bulkhead, NULL);
+  g_mutex_unlock(serverthread_bulkheads_mutex);
+}
+
+
 /*****************************************************************************
  * Static thread functions
  *****************************************************************************/
 
-static void serverthread(gpointer data, gpointer user_data)
+/**
+ * Queue a request in its SIB's scheduler, in the priority class of its
+ * action. Session operations are run ahead of data operations, and large
+ * requests behind all others. The request is failed if the SIB's queue is
+ * full.
+ *
+ * @param sta The request
+ */
+static void serverthread_push(ServerThreadArgs* sta)
 {
-  ServerThreadArgs* sta = NULL;
-  SIBService* service = NULL;
-	
-  whiteboard_log_debug_fb();
-	
-  service = (SIBService*) user_data;
-  g_return_if_fail(service != NULL);
-
-  sta = (ServerThreadArgs*) data;
-  g_return_if_fail(sta != NULL);
+  SIBScheduler *scheduler = NULL;
+  SIBSchedulerClass klass;
+  gsize size = 0;
 
   switch (sta->action)
     {
-	  	  
     case ServerThreadActionJoin:
-      serverthread_join_thread(service,
-			       sta->server,
-			       sta->handle,
-			       sta->access_id,
-			       sta->nodeid,
-			       sta->sibid,
-			       sta->msgnumber);
-      break;
-
     case ServerThreadActionLeave:
-      serverthread_leave_thread(service,
-				sta->server,
-				sta->handle,
-				sta->nodeid,
-				sta->sibid,
-				sta->msgnumber);
+    case ServerThreadActionUnsubscribe:
+      klass = SIBSchedulerClassControl;
       break;
 
     case ServerThreadActionInsert:
-      serverthread_insert_thread(service,
-				 sta->server,
-				 sta->handle,
-				 sta->nodeid,
-				 sta->sibid,
-				 sta->msgnumber,
-				 sta->encoding,
-				 sta->insert_request);
-      break;
-
     case ServerThreadActionUpdate:
-      serverthread_update_thread(service,
-				 sta->server,
-				 sta->handle,
-				 sta->nodeid,
-				 sta->sibid,
-				 sta->msgnumber,
-				 sta->encoding,
-				 sta->insert_request,
-				 sta->remove_request);
-      break;
-      
     case ServerThreadActionRemove:
-      serverthread_remove_thread(service,
-				 sta->server,
-				 sta->handle,
-				 sta->nodeid,
-				 sta->sibid,
-				 sta->msgnumber,
-				 sta->encoding,
-				 sta->insert_request);
-      break;
-		
-    case ServerThreadActionQuery:
-      serverthread_query_thread(service,
-				sta->server,
-				sta->handle,
-				sta->access_id,
-				sta->nodeid,
-				sta->sibid,
-				sta->msgnumber,
-				sta->q_type,
-				sta->insert_request);
+    case ServerThreadActionCombine:
+      klass = SIBSchedulerClassWrite;
       break;
 
-    case ServerThreadActionSubscribe:
-      serverthread_subscribe_thread(service,
-				    sta->server,
-				    sta->handle,
-				    sta->access_id,
-				    sta->nodeid,
-				    sta->sibid,
-				    sta->msgnumber,
-				    sta->q_type,
-				    sta->insert_request);
-      break;
-    case ServerThreadActionUnsubscribe:
-      serverthread_unsubscribe_thread(service,
-				      sta->server,
-				      sta->handle,
-				      sta->access_id,
-				      sta->nodeid,
-				      sta->sibid,
-				      sta->msgnumber,
-				      sta->insert_request);
+    default:
+      klass = SIBSchedulerClassRead;
       break;
-	  
     }
-  if(sta->server)
-    sib_server_unref(sta->server);
-	
-  if(sta->handle)
+
+  if (klass != SIBSchedulerClassControl)
     {
-      whiteboard_log_debug("Unreferencing handle\n");
-      whiteboard_sib_access_handle_unref(sta->handle);
-      sta->handle = NULL;
+      if (sta->insert_payload)
+	size += sib_payload_get_len(sta->insert_payload);
+      else if (sta->insert_request)
+	size += strlen((gchar *)sta->insert_request);
+      if (sta->remove_payload)
+	size += sib_payload_get_len(sta->remove_payload);
+      if (size > SERVERTHREAD_BULK_SIZE)
+	klass = SIBSchedulerClassBulk;
     }
-	
-  if(sta->insert_request)
+
+  /* The request holds a server reference, so the scheduler stays */
+  scheduler = serverthread_get_bulkhead(sta->server);
+  if (scheduler == NULL ||
+      sib_scheduler_push(scheduler, klass, sta) == FALSE)
     {
-      whiteboard_log_debug("Deleting insert_request\n");
-      g_free(sta->insert_request);
-      sta->insert_request = NULL;
+      whiteboard_log_warning("SIB %s saturated, rejecting request\n",
+			     sib_server_get_udn(sta->server));
+      serverthread_reject(sta);
     }
-  if(sta->remove_request)
+}
+
+/**
+ * Get the scheduler of a SIB, creating it for the SIB's first request.
+ * Only the creation takes the bulkheads lock.
+ *
+ * @param server The SIB
+ * @return The scheduler or NULL
+ */
+static SIBScheduler *serverthread_get_bulkhead(SIBServer* server)
+{
+  volatile gpointer *slot = sib_server_get_bulkhead(server);
+  SIBScheduler *scheduler = NULL;
+  guint threads;
+
+  scheduler = (SIBScheduler *)g_atomic_pointer_get(slot);
+  if (scheduler != NULL)
+    return scheduler;
+
+  g_mutex_lock(serverthread_bulkheads_mutex);
+  scheduler = (SIBScheduler *)g_atomic_pointer_get(slot);
+  if (scheduler == NULL)
     {
-      whiteboard_log_debug("Deleting remove_request\n");
-      g_free(sta->remove_request);
-      sta->remove_request = NULL;
+      /* The floor if the budget has it left, until the next tuning */
+      threads = serverthread_threads_ceiling > serverthread_threads_granted ?
+	serverthread_threads_ceiling - serverthread_threads_granted : 0;
+      threads = CLAMP(threads, 1, serverthread_threads_floor);
+      scheduler = sib_scheduler_new(serverthread_executor,
+				    serverthread,
+				    serverthread_service,
+				    threads,
+				    SERVERTHREAD_SIB_MAX_QUEUED);
+      if (scheduler != NULL)
+	{
+	  serverthread_threads_granted += threads;
+	  g_hash_table_insert(serverthread_bulkheads, server, scheduler);
+	  g_atomic_pointer_compare_and_exchange(slot, NULL, scheduler);
+	}
     }
+  g_mutex_unlock(serverthread_bulkheads_mutex);
 
-  if(sta->sibid)
-    g_free((char *)sta->sibid);
-  if(sta->nodeid)
-    g_free((char *)sta->nodeid);
-	
-  g_free(sta);
-
-  whiteboard_log_debug_fe();
+  return scheduler;
 }
 
-static void serverthread_insert_thread(SIBService* service,
-				       SIBServer* server,
-				       WhiteBoardSIBAccessHandle* handle,
-				       ssElement_ct nodeid,
-				       ssElement_ct sibid,
+/**
+ * Fail a request that could not be queued.
+ *
+ * @param sta The request, freed
+ */
+static void serverthread_reject(ServerThreadArgs* sta)
+{
+  GSList *l = NULL;
+
+  switch (sta->action)
+    {
+    case ServerThreadActionJoin:
+      sib_server_send_join_complete(sta->handle, sta->access_id, -1);
+      break;
+
+    case ServerThreadActionLeave:
+      break;
+
+    case ServerThreadActionInsert:
+      sib_server_send_insert_response(sta->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+
+    case ServerThreadActionUpdate:
+      sib_server_send_update_response(sta->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+
+    case ServerThreadActionRemove:
+      sib_server_send_remove_response(sta->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+
+    case ServerThreadActionQuery:
+      sib_server_send_query_response(sta->handle, sta->access_id,
+				     ss_OperationFailed, (guchar *)"InvalidResults");
+      serverthread_query_land(sta->flight, NULL);
+      break;
+
+    case ServerThreadActionSubscribe:
+      sib_server_send_subscribe_response(sta->handle, sta->access_id,
+					 ss_OperationFailed,
+					 (guchar *)"sib:InvalidSubscriptionID",
+					 (guchar *)"sib:InvalidResults");
+      break;
+
+    case ServerThreadActionUnsubscribe:
+      sib_server_send_unsubscribe_complete(sta->handle, sta->access_id,
+					   ss_OperationFailed, sta->insert_request);
+      break;
+
+    case ServerThreadActionCombine:
+      break;
+    }
+
+  for (l = sta->batch; l != NULL; l = l->next)
+    serverthread_batched_reject((ServerThreadBatched *)l->data);
+
+  serverthread_args_free(sta);
+}
+
+/**
+ * Read a number from the environment.
+ *
+ * @param name Name of the variable
+ * @param value Value to use if the variable is not a positive number
+ * @return The value
+ */
+static guint serverthread_getenv(const gchar *name, guint value)
+{
+  const gchar *str = g_getenv(name);
+  guint64 parsed;
+
+  if (str == NULL)
+    return value;
+
+  parsed = g_ascii_strtoull(str, NULL, 10);
+  if (parsed == 0 || parsed > G_MAXINT)
+    {
+      whiteboard_log_warning("Ignoring invalid %s=%s\n", name, str);
+      return value;
+    }
+  return (guint)parsed;
+}
+
+/**
+ * Read a switch from the environment: 1, yes or true turn it on, 0, no
+ * or false turn it off.
+ *
+ * @param name Name of the variable
+ * @param value Value to use if the variable is not set or not a switch
+ * @return The value
+ */
+static gboolean serverthread_getenv_bool(const gchar *name, gboolean value)
+{
+  const gchar *str = g_getenv(name);
+
+  if (str == NULL)
+    return value;
+
+  if (strcmp(str, "1") == 0 || g_ascii_strcasecmp(str, "yes") == 0 ||
+      g_ascii_strcasecmp(str, "true") == 0)
+    return TRUE;
+  if (strcmp(str, "0") == 0 || g_ascii_strcasecmp(str, "no") == 0 ||
+      g_ascii_strcasecmp(str, "false") == 0)
+    return FALSE;
+
+  whiteboard_log_warning("Ignoring invalid %s=%s\n", name, str);
+  return value;
+}
+
+/**
+ * Periodically resize the worker pool of each SIB to its load, sharing
+ * the ceiling between the SIBs so that their threads never add up to
+ * more. Each SIB first gets the floor, or an equal part of the ceiling if
+ * the floors do not fit, but at least one thread. The rest is handed out
+ * in equal slices to the SIBs wanting more, so one busy SIB cannot take
+ * the threads of the others. A shortfall is logged when it changes.
+ *
+ * @param user_data Unused
+ * @return TRUE to keep the timeout
+ */
+static gboolean serverthread_tune(gpointer user_data)
+{
+  GPtrArray *shares = NULL;
+  ServerThreadShare *share = NULL;
+  guint count;
+  guint base;
+  guint left;
+  guint wanted;
+  guint active;
+  guint slice;
+  guint extra;
+  guint i;
+
+  g_mutex_lock(serverthread_bulkheads_mutex);
+  count = g_hash_table_size(serverthread_bulkheads);
+  if (count == 0)
+    {
+      g_mutex_unlock(serverthread_bulkheads_mutex);
+      return TRUE;
+    }
+
+  shares = g_ptr_array_sized_new(count);
+  g_hash_table_foreach(serverthread_bulkheads, serverthread_tune_estimate,
+		       shares);
+
+  base = MIN(serverthread_threads_floor,
+	     MAX(1, serverthread_threads_ceiling / count));
+  left = serverthread_threads_ceiling > base * count ?
+    serverthread_threads_ceiling - base * count : 0;
+  wanted = 0;
+  for (i = 0; i < shares->len; i++)
+    {
+      share = (ServerThreadShare *)g_ptr_array_index(shares, i);
+      share->threads = MIN(base, share->wanted);
+      wanted += share->wanted - share->threads;
+    }
+
+  while (left > 0 && wanted > 0)
+    {
+      active = 0;
+      for (i = 0; i < shares->len; i++)
+	{
+	  share = (ServerThreadShare *)g_ptr_array_index(shares, i);
+	  if (share->threads < share->wanted)
+	    active++;
+	}
+
+      slice = MAX(1, left / active);
+      for (i = 0; i < shares->len && left > 0; i++)
+	{
+	  share = (ServerThreadShare *)g_ptr_array_index(shares, i);
+	  extra = MIN(slice, share->wanted - share->threads);
+	  extra = MIN(extra, left);
+	  share->threads += extra;
+	  left -= extra;
+	  wanted -= extra;
+	}
+    }
+
+  if (wanted != serverthread_threads_short)
+    {
+      if (wanted > 0)
+	whiteboard_log_warning("Worker threads: %u SIBs are short of %u "
+			       "threads over the ceiling of %u "
+			       "(SIB_ACCESS_THREADS_MAX)\n",
+			       count, wanted, serverthread_threads_ceiling);
+      else
+	whiteboard_log_debug("Worker threads: no SIB is short of threads\n");
+      serverthread_threads_short = wanted;
+    }
+
+  /* Shrink first, so the total stays within the ceiling while growing */
+  serverthread_threads_granted = 0;
+  for (i = 0; i < shares->len; i++)
+    {
+      share = (ServerThreadShare *)g_ptr_array_index(shares, i);
+      if (share->threads < share->current)
+	serverthread_tune_apply(share);
+      serverthread_threads_granted += share->threads;
+    }
+  for (i = 0; i < shares->len; i++)
+    {
+      share = (ServerThreadShare *)g_ptr_array_index(shares, i);
+      if (share->threads > share->current)
+	serverthread_tune_apply(share);
+      g_free(share);
+    }
+  g_ptr_array_free(shares, TRUE);
+  g_mutex_unlock(serverthread_bulkheads_mutex);
+
+  return TRUE;
+}
+
+/**
+ * Estimate the threads a SIB needs for its load.
+ *
+ * @param key The SIBServer
+ * @param value Its SIBScheduler
+ * @param user_data GPtrArray getting a new ServerThreadShare
+ */
+static void serverthread_tune_estimate(gpointer key,
+				       gpointer value,
+				       gpointer user_data)
+{
+  ServerThreadShare *share = g_new0(ServerThreadShare, 1);
+  SIBSchedulerLoad load;
+
+  share->server = (SIBServer *)key;
+  share->scheduler = (SIBScheduler *)value;
+  sib_scheduler_get_load(share->scheduler, &load);
+  share->current = load.threads;
+  share->wanted = CLAMP(sib_scheduler_estimate(share->scheduler),
+			serverthread_threads_floor,
+			serverthread_threads_ceiling);
+  g_ptr_array_add((GPtrArray *)user_data, share);
+}
+
+/**
+ * Resize the worker pool of a SIB to its share.
+ *
+ * @param share The share of the SIB
+ */
+static void serverthread_tune_apply(ServerThreadShare *share)
+{
+  SIBSchedulerLoad load;
+
+  sib_scheduler_set_max_threads(share->scheduler, share->threads);
+  sib_scheduler_get_load(share->scheduler, &load);
+  whiteboard_log_debug("SIB %s workers: %u threads (arrivals %.1f/s, "
+		       "service %.1f ms, wait %.1f ms, needed %u, "
+		       "wanted %u)\n",
+		       sib_server_get_udn(share->server), share->threads,
+		       load.arrival_rate, load.service_time,
+		       load.queue_wait, load.target, share->wanted);
+}
+
+/**
+ * Log the saturation and the queue statistics of a SIB.
+ *
+ * @param key The SIBServer
+ * @param value Its SIBScheduler
+ * @param user_data Unused
+ */
+static void serverthread_log_bulkhead(gpointer key,
+				      gpointer value,
+				      gpointer user_data)
+{
+  SIBServer *server = (SIBServer *)key;
+  SIBScheduler *scheduler = (SIBScheduler *)value;
+  SIBSchedulerLoad load;
+  SIBSchedulerStats stats;
+  gint klass;
+
+  sib_scheduler_get_load(scheduler, &load);
+  whiteboard_log_debug("SIB %s workers: running %u/%u, queued %u/%u, "
+		       "arrivals %.1f/s, service %.1f ms, wait %.1f ms, "
+		       "needed %u\n",
+		       sib_server_get_udn(server),
+		       load.running, load.threads,
+		       load.queued, load.max_queued,
+		       load.arrival_rate, load.service_time,
+		       load.queue_wait, load.target);
+
+  for (klass = 0; klass < SIBSchedulerClassCount; klass++)
+    {
+      sib_scheduler_get_stats(scheduler, klass, &stats);
+      whiteboard_log_debug("SIB %s %s requests: queued %u (peak %u), "
+			   "pushed %u, rejected %u, aged %u, "
+			   "wait avg %.1f ms max %u ms\n",
+			   sib_server_get_udn(server),
+			   sib_scheduler_class_name(klass),
+			   stats.depth, stats.peak, stats.pushed,
+			   stats.rejected, stats.aged,
+			   stats.avg_wait, stats.max_wait);
+    }
+}
+
+static void serverthread(gpointer data, gpointer user_data)
+{
+  ServerThreadArgs* sta = NULL;
+  SIBService* service = NULL;
+	
+  whiteboard_log_debug_fb();
+	
+  service = (SIBService*) user_data;
+  g_return_if_fail(service != NULL);
+
+  sta = (ServerThreadArgs*) data;
+  g_return_if_fail(sta != NULL);
+
+  switch (sta->action)
+    {
+	  	  
+    case ServerThreadActionJoin:
+      serverthread_join_thread(service,
+			       sta->server,
+			       sta->handle,
+			       sta->access_id,
+			       sta->nodeid,
+			       sta->sibid,
+			       sta->msgnumber);
+      break;
+
+    case ServerThreadActionLeave:
+      serverthread_leave_thread(service,
+				sta->server,
+				sta->handle,
+				sta->nodeid,
+				sta->sibid,
+				sta->msgnumber);
+      break;
+
+    case ServerThreadActionInsert:
+      serverthread_insert_thread(service,
+				 sta->server,
+				 sta->handle,
+				 sta->nodeid,
+				 sta->sibid,
+				 sta->msgnumber,
+				 sta->encoding,
+				 sta->insert_request,
+				 sta->batch);
+      /* the merged writes are released by the insert */
+      sta->batch = NULL;
+      break;
+
+    case ServerThreadActionUpdate:
+      serverthread_update_thread(service,
+				 sta->server,
+				 sta->handle,
+				 sta->nodeid,
+				 sta->sibid,
+				 sta->msgnumber,
+				 sta->encoding,
+				 sta->insert_request,
+				 sta->remove_request);
+      break;
+      
+    case ServerThreadActionRemove:
+      serverthread_remove_thread(service,
+				 sta->server,
+				 sta->handle,
+				 sta->nodeid,
+				 sta->sibid,
+				 sta->msgnumber,
+				 sta->encoding,
+				 sta->insert_request);
+      break;
+		
+    case ServerThreadActionQuery:
+      serverthread_query_thread(service,
+				sta->server,
+				sta->handle,
+				sta->access_id,
+				sta->nodeid,
+				sta->sibid,
+				sta->msgnumber,
+				sta->q_type,
+				sta->insert_request,
+				sta->flight);
+      break;
+
+    case ServerThreadActionSubscribe:
+      serverthread_subscribe_thread(service,
+				    sta->server,
+				    sta->handle,
+				    sta->access_id,
+				    sta->nodeid,
+				    sta->sibid,
+				    sta->msgnumber,
+				    sta->q_type,
+				    sta->insert_request);
+      break;
+    case ServerThreadActionUnsubscribe:
+      serverthread_unsubscribe_thread(service,
+				      sta->server,
+				      sta->handle,
+				      sta->access_id,
+				      sta->nodeid,
+				      sta->sibid,
+				      sta->msgnumber,
+				      sta->insert_request);
+      break;
+
+    case ServerThreadActionCombine:
+      serverthread_combine_thread(service,
+				  sta->server,
+				  sta->nodeid,
+				  sta->msgnumber,
+				  sta->batch);
+      sta->batch = NULL;
+      break;
+	  
+    }
+
+  serverthread_args_free(sta);
+
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Allocate a request and copies of its strings from a new arena sized to
+ * hold them all.
+ *
+ * @return The request, released with serverthread_args_free()
+ */
+static ServerThreadArgs* serverthread_args_new(ServerThreadAction action,
+					       SIBServer* server,
+					       WhiteBoardSIBAccessHandle* handle,
+					       guchar *nodeid,
+					       guchar *sibid,
+					       guchar *insert_request,
+					       guchar *remove_request)
+{
+  ServerThreadArgs* sta = NULL;
+  SIBArena *arena = NULL;
+  gsize size = SIB_ARENA_SIZE(sizeof(ServerThreadArgs));
+
+  if (nodeid)
+    size += SIB_ARENA_SIZE(strlen((gchar *)nodeid) + 1);
+  if (sibid)
+    size += SIB_ARENA_SIZE(strlen((gchar *)sibid) + 1);
+  if (insert_request)
+    size += SIB_ARENA_SIZE(strlen((gchar *)insert_request) + 1);
+  if (remove_request)
+    size += SIB_ARENA_SIZE(strlen((gchar *)remove_request) + 1);
+
+  arena = sib_arena_new(size);
+  sta = (ServerThreadArgs *)sib_arena_alloc0(arena, sizeof(ServerThreadArgs));
+  sta->arena = arena;
+  sta->action = action;
+  sta->server = server;
+  sta->handle = handle;
+  sta->nodeid = (ssElement_ct)sib_arena_strdup(arena, (gchar *)nodeid);
+  sta->sibid = (ssElement_ct)sib_arena_strdup(arena, (gchar *)sibid);
+  sta->insert_request = (guchar *)sib_arena_strdup(arena, (gchar *)insert_request);
+  sta->remove_request = (guchar *)sib_arena_strdup(arena, (gchar *)remove_request);
+
+  return sta;
+}
+
+/**
+ * Release the references of a request and free it with its strings.
+ *
+ * @param sta The request
+ */
+static void serverthread_args_free(ServerThreadArgs* sta)
+{
+  if(sta->server)
+    sib_server_unref(sta->server);
+	
+  if(sta->handle)
+    {
+      whiteboard_log_debug("Unreferencing handle\n");
+      whiteboard_sib_access_handle_unref(sta->handle);
+      sta->handle = NULL;
+    }
+
+  if(sta->insert_payload)
+    sib_payload_unref(sta->insert_payload);
+  if(sta->remove_payload)
+    sib_payload_unref(sta->remove_payload);
+
+  g_slist_foreach(sta->batch, (GFunc)serverthread_batched_free, NULL);
+  g_slist_free(sta->batch);
+
+  sib_arena_free(sta->arena);
+}
+
+/**
+ * Reference the payloads of a request instead of copying them into its
+ * arena.
+ *
+ * @param sta The request
+ * @param insert_request The request or insert payload
+ * @param remove_request The remove payload of an update or NULL
+ */
+static void serverthread_args_set_payload(ServerThreadArgs* sta,
+					  SIBPayload *insert_request,
+					  SIBPayload *remove_request)
+{
+  if (insert_request)
+    {
+      sta->insert_payload = sib_payload_ref(insert_request);
+      sta->insert_request = (guchar *)sib_payload_get_data(insert_request);
+    }
+  if (remove_request)
+    {
+      sta->remove_payload = sib_payload_ref(remove_request);
+      sta->remove_request = (guchar *)sib_payload_get_data(remove_request);
+    }
+}
+
+static void serverthread_insert_thread(SIBService* service,
+				       SIBServer* server,
+				       WhiteBoardSIBAccessHandle* handle,
+				       ssElement_ct nodeid,
+				       ssElement_ct sibid,
 				       gint msgnumber,
 				       EncodingType encoding,
-				       guchar *request)
+				       guchar *request,
+				       GSList *batch)
 {
   
   g_return_if_fail(server != NULL);
   gint success=0;
+  ServerThreadCompletion *completion = NULL;
   SIBController *ctrl = NULL;
   const guchar *udn = sib_server_get_udn( server );
   NodeMsgContent_t *response;
@@ -679,9 +1748,33 @@ static void serverthread_insert_thread(SIBService* service,
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "insert_threadDEBUG, node: %s, UDN: %s\n", nodeid, udn);
 
-  response = parseSSAPmsg_new();
+  if( serverthread_async(server, handle, 0, serverthread_insert_respond, &completion) )
+    {
+      serverthread_replica_hold(completion, encoding, request, NULL);
+      completion->batch = batch;
+      if( sib_access_insert_async(sib_server_get_sib_access(server), completion->reactor,
+				  nodeid, msgnumber, encoding, request,
+				  serverthread_complete, completion) < 0 )
+	serverthread_complete(NULL, -1, NULL, completion);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  response = sib_msgcache_get_parser();
   
   success =  sib_access_insert(sib_server_get_sib_access(server), nodeid, msgnumber, encoding, request,  response);
+  serverthread_insert_respond(handle, 0, success, response);
+  serverthread_batch_respond(batch, 0, success, response);
+  serverthread_replica_write(server, encoding, (gchar *)request, NULL, success, response);
+  sib_msgcache_put_parser(&response);  
+  whiteboard_log_debug_fe();
+}
+
+static void serverthread_insert_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response)
+{
   if( success < 0)
     {
       whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "insert_thread: success: %d\n", success);
@@ -708,10 +1801,8 @@ static void serverthread_insert_thread(SIBService* service,
 	  sib_server_send_insert_response(handle, ss_OperationFailed,  (guchar *)"sib:reported error");//"sib:invalidTripleId");
 	}
 	   
-      //      parseSSAPmsg_free(&response);
+      //      sib_msgcache_put_parser(&response);
     }
-  parseSSAPmsg_free(&response);  
-  whiteboard_log_debug_fe();
 }
 
 static void serverthread_update_thread(SIBService* service,
@@ -728,6 +1819,7 @@ static void serverthread_update_thread(SIBService* service,
   
   g_return_if_fail(server != NULL);
   gint success=0;
+  ServerThreadCompletion *completion = NULL;
   SIBController *ctrl = NULL;
   const guchar *udn = sib_server_get_udn( server );
   NodeMsgContent_t *response;
@@ -746,9 +1838,32 @@ static void serverthread_update_thread(SIBService* service,
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "update_thread, node: %s, UDN: %s\n", nodeid, udn);
 
-  response = parseSSAPmsg_new();
+  if( serverthread_async(server, handle, 0, serverthread_update_respond, &completion) )
+    {
+      serverthread_replica_hold(completion, encoding, insert_request, remove_request);
+      if( sib_access_update_async(sib_server_get_sib_access(server), completion->reactor,
+				  nodeid, msgnumber, encoding, insert_request, remove_request,
+				  serverthread_complete, completion) < 0 )
+	serverthread_complete(NULL, -1, NULL, completion);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  response = sib_msgcache_get_parser();
   
   success =  sib_access_update(sib_server_get_sib_access(server), nodeid, msgnumber, encoding, insert_request, remove_request, response);
+  serverthread_update_respond(handle, 0, success, response);
+  serverthread_replica_write(server, encoding, (gchar *)insert_request, (gchar *)remove_request,
+			     success, response);
+  sib_msgcache_put_parser(&response);  
+  whiteboard_log_debug_fe();
+}
+
+static void serverthread_update_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response)
+{
   if( success < 0)
     {
       whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "update_thread: success: %d\n", success);
@@ -775,10 +1890,8 @@ static void serverthread_update_thread(SIBService* service,
 	  sib_server_send_update_response(handle, ss_OperationFailed,  (guchar *)"sib:reported error");//"sib:invalidTripleId");
 	}
 	   
-      //      parseSSAPmsg_free(&response);
+      //      sib_msgcache_put_parser(&response);
     }
-  parseSSAPmsg_free(&response);  
-  whiteboard_log_debug_fe();
 }
 
 static void serverthread_remove_thread(SIBService* service,
@@ -792,6 +1905,7 @@ static void serverthread_remove_thread(SIBService* service,
 {
   g_return_if_fail(server != NULL);
   gint success=0;
+  ServerThreadCompletion *completion = NULL;
   NodeMsgContent_t *response = NULL;
   SIBController *ctrl = NULL;
   g_return_if_fail(sibid != NULL );
@@ -805,8 +1919,30 @@ static void serverthread_remove_thread(SIBService* service,
   ctrl = sib_service_get_controller(service); //?? ctrl not further used
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "remove_thread, node: %s, UDN: %s\n", nodeid, sibid);
-  response = parseSSAPmsg_new();
+  if( serverthread_async(server, handle, 0, serverthread_remove_respond, &completion) )
+    {
+      serverthread_replica_hold(completion, encoding, NULL, request);
+      if( sib_access_remove_async(sib_server_get_sib_access(server), completion->reactor,
+				  nodeid, msgnumber, encoding, request,
+				  serverthread_complete, completion) < 0 )
+	serverthread_complete(NULL, -1, NULL, completion);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  response = sib_msgcache_get_parser();
   success =  sib_access_remove(sib_server_get_sib_access(server), nodeid, msgnumber, encoding, request, response);
+  serverthread_remove_respond(handle, 0, success, response);
+  serverthread_replica_write(server, encoding, NULL, (gchar *)request, success, response);
+  sib_msgcache_put_parser(&response);
+  whiteboard_log_debug_fe();
+}
+
+static void serverthread_remove_respond(WhiteBoardSIBAccessHandle* handle,
+					gint access_id,
+					gint success,
+					NodeMsgContent_t *response)
+{
   if( success < 0)
     {
       whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "remove_thread: success: %d\n", success);
@@ -830,9 +1966,6 @@ static void serverthread_remove_thread(SIBService* service,
       whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "remove_thread: operation failed\n");
       sib_server_send_remove_response(handle, ss_OperationFailed,  (guchar *)"sib:reported error");//"sib:invalidTripleId");
     }
-
-  parseSSAPmsg_free(&response);
-  whiteboard_log_debug_fe();
 }
 
 static void serverthread_join_thread(SIBService* service, 
@@ -859,7 +1992,7 @@ static void serverthread_join_thread(SIBService* service,
   ctrl = sib_service_get_controller(service);
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "join_thread, node: %s, UDN: %s\n", nodeid, udn);
-  response = parseSSAPmsg_new();
+  response = sib_msgcache_get_parser();
   success =  sib_access_join(sib_server_get_sib_access(server),
 			     nodeid,
 			     msgnumber,
@@ -869,7 +2002,7 @@ static void serverthread_join_thread(SIBService* service,
     ss_OperationFailed : ss_StatusOK;
   sib_server_send_join_complete(handle, access_id, status);
 
-  parseSSAPmsg_free(&response);
+  sib_msgcache_put_parser(&response);
   whiteboard_log_debug_fe();
 }
 
@@ -896,13 +2029,13 @@ static void serverthread_leave_thread(SIBService* service,
   ctrl = sib_service_get_controller(service);
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "leave_thread, node: %s, UDN: %s\n", nodeid, udn);
-  response = parseSSAPmsg_new();
+  response = sib_msgcache_get_parser();
   success =  sib_access_leave(sib_server_get_sib_access(server), nodeid, msgnumber, response );
   if(success < 0)
     {
       whiteboard_log_error("leave failed for SIB (%s)\n", udn);
     }
-  parseSSAPmsg_free(&response);
+  sib_msgcache_put_parser(&response);
   whiteboard_log_debug_fe();
 }
 
@@ -914,12 +2047,19 @@ static void serverthread_query_thread(SIBService* service,
 				      ssElement_ct sibid,
 				      gint msgnumber,
 				      gint type,
-				      guchar *request)
+				      guchar *request,
+				      SIBFlight *flight)
 {
   g_return_if_fail(server != NULL);
   gint success=0;
+  ServerThreadCompletion *completion = NULL;
   NodeMsgContent_t *response = NULL;
   SIBController *ctrl = NULL;
+  SIBAccess *sa = NULL;
+  guint generation = 0;
+  guint view_mark = 0;
+  gchar *cached = NULL;
+  const guchar *results = NULL;
   const guchar *udn = sib_server_get_udn( server );
   g_return_if_fail(udn != NULL );
   whiteboard_log_debug_fb();
@@ -929,38 +2069,762 @@ static void serverthread_query_thread(SIBService* service,
   g_return_if_fail(request != NULL);
   
   ctrl = sib_service_get_controller(service);
+  sa = sib_server_get_sib_access(server);
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread, node: %s, UDN: %s\n", nodeid, udn);
-  response = parseSSAPmsg_new();
-  success =  sib_access_query(sib_server_get_sib_access(server), nodeid, msgnumber, type, request, response);
+
+  if( type == QueryTypeTemplate && sib_server_get_replica(server) != NULL )
+    {
+      /* scopes that missed a change are re-seeded by
+	 serverthread_replica_reseed_all(), never while a query waits */
+      cached = sib_replica_query(sib_server_get_replica(server), (const gchar *)request);
+      if( cached != NULL )
+	{
+	  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread: answered from replica\n");
+	  serverthread_query_send(handle, access_id, (guchar *)cached);
+	  serverthread_query_land(flight, (guchar *)cached);
+	  g_free(cached);
+	  whiteboard_log_debug_fe();
+	  return;
+	}
+    }
+
+  /* the generation is taken before the query is sent, a write
+     overlapping the query changes it and the result is not kept */
+  generation = sib_access_get_write_generation(sa);
+  view_mark = g_atomic_int_get(&serverthread_views_changes);
+  if( serverthread_query_cache != NULL )
+    {
+      cached = sib_query_cache_lookup(serverthread_query_cache, (const gchar *)udn,
+				      type, (const gchar *)request, generation);
+      if( cached != NULL )
+	{
+	  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread: cached result\n");
+	  serverthread_query_send(handle, access_id, (guchar *)cached);
+	  serverthread_query_land(flight, (guchar *)cached);
+	  g_free(cached);
+	  whiteboard_log_debug_fe();
+	  return;
+	}
+    }
+
+  if( serverthread_async(server, handle, access_id, serverthread_query_respond, &completion) )
+    {
+      completion->q_type = type;
+      completion->query = g_strdup((gchar *)request);
+      completion->generation = generation;
+      completion->view_mark = view_mark;
+      completion->flight = flight;
+      if( sib_access_query_async(sa, completion->reactor,
+				 nodeid, msgnumber, type, request,
+				 serverthread_complete, completion) < 0 )
+	serverthread_complete(NULL, -1, NULL, completion);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  response = sib_msgcache_get_parser();
+  success =  sib_access_query(sa, nodeid, msgnumber, type, request, response);
+  results = serverthread_query_results(success, response);
+  serverthread_query_send(handle, access_id, results);
+  serverthread_query_land(flight, results);
+  serverthread_query_store(server, type, (const gchar *)request, generation, view_mark,
+			   success, response);
+  sib_msgcache_put_parser(&response);
+  whiteboard_log_debug_fe();
+}
+
+static void serverthread_query_respond(WhiteBoardSIBAccessHandle* handle,
+				       gint access_id,
+				       gint success,
+				       NodeMsgContent_t *response)
+{
+  serverthread_query_send(handle, access_id, serverthread_query_results(success, response));
+}
+
+/**
+ * Get the results of a query from its response.
+ *
+ * @param success Result of the query, see sib_access_query()
+ * @param response The response
+ * @return The M3XML results, NULL if the query failed
+ */
+static const guchar *serverthread_query_results(gint success,
+						NodeMsgContent_t *response)
+{
   if( success <= 0)
     {
       whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread: success: %d\n", success);
-      sib_server_send_query_response(handle,access_id, ss_OperationFailed,  (guchar *)"InvalidResults");
+      return NULL;
+    }
+
+  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread: success: %d, response %p\n", success, response);
+  if( parseSSAPmsg_get_msg_status(response) != MSG_E_OK )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "Parse error\n");
+      return NULL;
+    }
+  if( NULL == parseSSAPmsg_get_M3XML(response) )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query status not_ok\n");
+      return NULL;
     }
+  return (const guchar *)parseSSAPmsg_get_M3XML(response);
+}
+
+/**
+ * Send the response of a query.
+ *
+ * @param results The M3XML results, NULL if the query failed
+ */
+static void serverthread_query_send(WhiteBoardSIBAccessHandle* handle,
+				    gint access_id,
+				    const guchar *results)
+{
+  if( results != NULL )
+    sib_server_send_query_response(handle, access_id, ss_StatusOK, results);
   else
+    sib_server_send_query_response(handle, access_id, ss_OperationFailed, (guchar *)"InvalidResults");
+}
+
+/**
+ * Land the flight of a query and give its results to the identical
+ * queries that joined it.
+ *
+ * @param flight The flight, NULL if none
+ * @param results The M3XML results, NULL if the query failed
+ */
+static void serverthread_query_land(SIBFlight *flight,
+				    const guchar *results)
+{
+  GSList *followers = NULL;
+  GSList *l = NULL;
+
+  if( flight == NULL )
+    return;
+
+  followers = sib_flight_land(serverthread_flights, flight);
+  for( l = followers; l != NULL; l = l->next )
     {
-      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query_thread: success: %d, response %p\n", success, response);
-      if( parseSSAPmsg_get_msg_status(response) == MSG_E_OK )
+      ServerThreadFollower *follower = (ServerThreadFollower *)l->data;
+      serverthread_query_send(follower->handle, follower->access_id, results);
+      whiteboard_sib_access_handle_unref(follower->handle);
+      g_free(follower);
+    }
+  g_slist_free(followers);
+}
+
+/**
+ * Cache the result of a successful query and refresh the view of a
+ * subscription to the same query.
+ *
+ * @param server The SIB that was queried
+ * @param type Query type
+ * @param query Query text
+ * @param generation Write generation of the SIB before the query was sent
+ * @param view_mark View changes before the query was sent
+ * @param success Result of the query, see sib_access_query()
+ * @param response The response
+ */
+static void serverthread_query_store(SIBServer* server,
+				     gint type,
+				     const gchar *query,
+				     guint generation,
+				     guint view_mark,
+				     gint success,
+				     NodeMsgContent_t *response)
+{
+  const guchar *results = serverthread_query_results(success, response);
+
+  if( results == NULL )
+    return;
+
+  if( serverthread_query_cache != NULL )
+    sib_query_cache_store(serverthread_query_cache,
+			  (const gchar *)sib_server_get_udn(server),
+			  type, query, generation, (const gchar *)results);
+  serverthread_view_reset(server, type, query, generation, view_mark, results);
+}
+
+/**
+ * Keep the triples of an asynchronous write until it completes, to apply
+ * them to the server's replica.
+ */
+static void serverthread_replica_hold(ServerThreadCompletion *completion,
+				      EncodingType encoding,
+				      guchar *inserted,
+				      guchar *removed)
+{
+  if( sib_server_get_replica(completion->server) == NULL )
+    return;
+
+  completion->write = TRUE;
+  completion->encoding = encoding;
+  if( encoding == EncodingM3XML )
+    {
+      completion->inserted = g_strdup((gchar *)inserted);
+      completion->removed = g_strdup((gchar *)removed);
+    }
+}
+
+/**
+ * Apply a write to the server's replica. A write whose outcome is not
+ * known, or whose triples are RDF/XML, makes the replica invalid.
+ *
+ * @param success Result of the write, see sib_access_insert()
+ * @param response The response
+ */
+static void serverthread_replica_write(SIBServer* server,
+				       EncodingType encoding,
+				       const gchar *inserted,
+				       const gchar *removed,
+				       gint success,
+				       NodeMsgContent_t *response)
+{
+  SIBReplica *replica = sib_server_get_replica(server);
+
+  if( replica == NULL )
+    return;
+
+  /* refused by the SIB, nothing changed */
+  if( success >= 0 && parseSSAPmsg_get_msg_status(response) != MSG_E_OK )
+    return;
+
+  if( success < 0 || encoding != EncodingM3XML )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "replica: write not applied, replica invalid\n");
+      sib_replica_invalidate(replica);
+      return;
+    }
+  sib_replica_write(replica, inserted, removed);
+}
+
+/**
+ * Periodically hand the replica scopes of the watched subscriptions to
+ * the workers, to re-seed the ones that missed a change. Otherwise such a
+ * scope would never answer a query again.
+ *
+ * @param user_data Unused
+ * @return TRUE to keep the timeout
+ */
+static gboolean serverthread_replica_reseed_all(gpointer user_data)
+{
+  GSList *subs = NULL;
+  GSList *item = NULL;
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  g_hash_table_foreach(serverthread_subscribers, serverthread_replica_collect, &subs);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  for( item = subs; item != NULL; item = item->next )
+    sib_executor_submit(serverthread_executor, serverthread_replica_reseed, item->data);
+  g_slist_free(subs);
+
+  return TRUE;
+}
+
+/**
+ * Add a subscription with a replica scope to a list, once.
+ *
+ * @param key A subscription id of a subscriber
+ * @param value The ServerThreadSubscription
+ * @param user_data GSList ** getting a reference to the subscription
+ */
+static void serverthread_replica_collect(gpointer key,
+					 gpointer value,
+					 gpointer user_data)
+{
+  ServerThreadSubscription *sub = (ServerThreadSubscription *)value;
+  GSList **subs = (GSList **)user_data;
+
+  if( sub->scope == 0 || g_slist_find(*subs, sub) != NULL )
+    return;
+
+  g_atomic_int_inc(&sub->refcount);
+  *subs = g_slist_prepend(*subs, sub);
+}
+
+/**
+ * Executor task: re-seed the replica scope of a subscription from a fresh
+ * query of its templates if the scope is invalid, as
+ * serverthread_view_reset() does for views. The query is the
+ * component's own request, with its own transaction id.
+ *
+ * @param data The ServerThreadSubscription, its reference is released
+ */
+static void serverthread_replica_reseed(gpointer data)
+{
+  ServerThreadSubscription *sub = (ServerThreadSubscription *)data;
+  SIBReplica *replica = sib_server_get_replica(sub->server);
+  NodeMsgContent_t *response = NULL;
+  gchar *templates = NULL;
+  guint mark = 0;
+  gint msgnumber;
+  gint success = 0;
+  gboolean reseeded = FALSE;
+
+  templates = sib_replica_claim_invalid(replica, sub->scope, &mark);
+  if( templates == NULL )
+    {
+      serverthread_subscription_unref(sub);
+      return;
+    }
+
+  msgnumber = g_atomic_int_exchange_and_add(&serverthread_own_msgnumber, 1);
+  response = sib_msgcache_get_parser();
+  success = sib_access_query(sib_server_get_sib_access(sub->server), sub->nodeid, msgnumber,
+			     QueryTypeTemplate, (guchar *)templates, response);
+  reseeded = sib_replica_reseed_scope(replica, sub->scope, mark,
+				      (const gchar *)serverthread_query_results(success, response));
+  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "replica: scope %u %s\n", sub->scope,
+			(reseeded ? "re-seeded" : "still invalid"));
+  sib_msgcache_put_parser(&response);
+  g_free(templates);
+  serverthread_subscription_unref(sub);
+}
+
+/**
+ * Hold a write to be sent with the writes its node makes to the same SIB
+ * within the batch window. Inserts are merged into one insert; with write
+ * combining, removes and updates are held too and a batch with them is
+ * sent as the net change of its writes. Only M3XML triple lists without
+ * blank nodes are held: blank node labels are local to a message.
+ *
+ * @param inserted The triples to insert, NULL for a remove
+ * @param removed The triples to remove, NULL for an insert
+ * @return FALSE if the write has to be sent on its own
+ */
+static gboolean serverthread_batch_write(SIBServer* server,
+					 WhiteBoardSIBAccessHandle* handle,
+					 ServerThreadAction action,
+					 guchar *nodeid,
+					 guchar *sibid,
+					 gint msgnumber,
+					 EncodingType encoding,
+					 SIBPayload *inserted,
+					 SIBPayload *removed)
+{
+  ServerThreadBatched *batched = NULL;
+  const gchar *triples = NULL;
+  const gchar *remove_triples = NULL;
+  gsize len = 0;
+  gsize remove_len = 0;
+  gchar *key = NULL;
+  gboolean added = FALSE;
+
+  if( serverthread_batcher == NULL || encoding != EncodingM3XML )
+    return FALSE;
+  if( action != ServerThreadActionInsert && !serverthread_combine )
+    return FALSE;
+  if( inserted != NULL &&
+      !serverthread_batch_triples(sib_payload_get_data(inserted), &triples, &len) )
+    return FALSE;
+  if( removed != NULL &&
+      !serverthread_batch_triples(sib_payload_get_data(removed), &remove_triples, &remove_len) )
+    return FALSE;
+
+  batched = g_new0(ServerThreadBatched, 1);
+  batched->action = action;
+  batched->server = server;
+  batched->handle = handle;
+  batched->nodeid = (guchar *)g_strdup((gchar *)nodeid);
+  batched->sibid = (guchar *)g_strdup((gchar *)sibid);
+  batched->msgnumber = msgnumber;
+  if( inserted != NULL )
+    batched->inserted = sib_payload_ref(inserted);
+  if( removed != NULL )
+    batched->removed = sib_payload_ref(removed);
+  batched->triples = triples;
+  batched->len = len;
+  sib_server_ref(server);
+  whiteboard_sib_access_handle_ref(handle);
+
+  key = serverthread_batch_key(server, nodeid, encoding);
+  added = sib_batcher_add(serverthread_batcher, key, batched, len + remove_len);
+  g_free(key);
+
+  if( !added )
+    serverthread_batched_free(batched);
+  return added;
+}
+
+/**
+ * Find the triples of an insert that is a plain M3XML triple list.
+ *
+ * @param data The insert
+ * @param triples Set to the start of the triples inside the list
+ * @param len Set to the length of the triples
+ * @return FALSE if the insert cannot be merged with others
+ */
+static gboolean serverthread_batch_triples(const gchar *data,
+					   const gchar **triples,
+					   gsize *len)
+{
+  const gchar *start = data;
+  const gchar *end = NULL;
+
+  while( g_ascii_isspace(*start) )
+    start++;
+  if( g_str_has_prefix(start, "<?xml") )
+    {
+      start = strstr(start, "?>");
+      if( start == NULL )
+	return FALSE;
+      start += 2;
+      while( g_ascii_isspace(*start) )
+	start++;
+    }
+
+  /* attributes, e.g. namespaces, would be lost in the merged list */
+  if( !g_str_has_prefix(start, "<triple_list>") )
+    return FALSE;
+  start += strlen("<triple_list>");
+
+  end = g_strrstr(start, "</triple_list>");
+  if( end == NULL )
+    return FALSE;
+  for( data = end + strlen("</triple_list>"); *data != '\0'; data++ )
+    if( !g_ascii_isspace(*data) )
+      return FALSE;
+
+  if( g_strstr_len(start, end - start, "bnode") != NULL )
+    return FALSE;
+
+  *triples = start;
+  *len = end - start;
+  return TRUE;
+}
+
+/**
+ * Key of the batch of an insert: the SIB, the node and the encoding.
+ */
+static gchar *serverthread_batch_key(SIBServer* server,
+				     guchar *nodeid,
+				     EncodingType encoding)
+{
+  return g_strdup_printf("%s\n%s\n%d", sib_server_get_udn(server), nodeid, encoding);
+}
+
+/**
+ * Queue the writes a node has waiting for a SIB now, so that its next
+ * write does not overtake them.
+ */
+static void serverthread_batch_flush(SIBServer* server,
+				     guchar *nodeid)
+{
+  gchar *key = NULL;
+
+  if( serverthread_batcher == NULL )
+    return;
+
+  key = serverthread_batch_key(server, nodeid, EncodingM3XML);
+  sib_batcher_flush(serverthread_batcher, key);
+  g_free(key);
+}
+
+/**
+ * Queue the writes of a batch. A batch of inserts is sent as one insert of
+ * all their triples, made for the first of them; the others are answered
+ * with its response. A batch with removes or updates is combined by a
+ * worker, see serverthread_combine_thread(). Called by the batcher when
+ * the batch window ends or the batch is full.
+ *
+ * @param items ServerThreadBatched in arrival order
+ * @param user_data Unused
+ */
+static void serverthread_batch_send(GSList *items,
+				    gpointer user_data)
+{
+  ServerThreadBatched *first = (ServerThreadBatched *)items->data;
+  ServerThreadBatched *batched = NULL;
+  ServerThreadArgs* sta = NULL;
+  SIBPayload *request = NULL;
+  GString *merged = NULL;
+  GSList *l = NULL;
+
+  for( l = items; l != NULL; l = l->next )
+    if( ((ServerThreadBatched *)l->data)->action != ServerThreadActionInsert )
+      break;
+
+  if( l != NULL )
+    {
+      /* the request takes the first write's server reference */
+      sta = serverthread_args_new(ServerThreadActionCombine, first->server, NULL,
+				  first->nodeid, first->sibid, NULL, NULL);
+      sta->msgnumber = first->msgnumber;
+      sta->encoding = EncodingM3XML;
+      sta->batch = items;
+      first->server = NULL;
+      serverthread_push(sta);
+      return;
+    }
+
+  if( items->next == NULL )
+    {
+      request = sib_payload_ref(first->inserted);
+    }
+  else
+    {
+      merged = g_string_sized_new(SERVERTHREAD_BULK_SIZE);
+      g_string_append(merged, "<triple_list>");
+      for( l = items; l != NULL; l = l->next )
 	{
-	  if( NULL != parseSSAPmsg_get_M3XML(response) )
-	    sib_server_send_query_response(handle, access_id, ss_StatusOK,  (guchar *)parseSSAPmsg_get_M3XML(response) );
-	  else
-	    {
-	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query status not_ok\n");
-	      sib_server_send_query_response(handle, access_id,ss_OperationFailed, (guchar *)"InvalidResults");
-	    }
+	  batched = (ServerThreadBatched *)l->data;
+	  g_string_append_len(merged, batched->triples, batched->len);
 	}
-      else
+      g_string_append(merged, "</triple_list>");
+      request = sib_payload_new_take(merged->str, merged->len);
+      g_string_free(merged, FALSE);
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "Merged %u inserts of node %s\n",
+			    g_slist_length(items), first->nodeid);
+    }
+
+  /* the request takes the first insert's references */
+  sta = serverthread_args_new(ServerThreadActionInsert, first->server, first->handle,
+			      first->nodeid, first->sibid, NULL, NULL);
+  serverthread_args_set_payload(sta, request, NULL);
+  sib_payload_unref(request);
+  sta->msgnumber = first->msgnumber;
+  sta->encoding = EncodingM3XML;
+  first->server = NULL;
+  first->handle = NULL;
+
+  sta->batch = g_slist_delete_link(items, items);
+  serverthread_batched_free(first);
+  for( l = sta->batch; l != NULL; l = l->next )
+    {
+      /* the triples are in the merged insert */
+      batched = (ServerThreadBatched *)l->data;
+      sib_payload_unref(batched->inserted);
+      batched->inserted = NULL;
+    }
+
+  serverthread_push(sta);
+}
+
+/**
+ * Send the net change of a batch of writes as a single update, or as an
+ * insert or a remove if it only has triples to insert or to remove. Each
+ * write is answered with the response. If a write cannot be parsed, the
+ * writes are sent one by one instead.
+ *
+ * @param batch ServerThreadBatched in arrival order, freed
+ */
+static void serverthread_combine_thread(SIBService* service,
+					SIBServer* server,
+					ssElement_ct nodeid,
+					gint msgnumber,
+					GSList *batch)
+{
+  ServerThreadBatched *first = NULL;
+  ServerThreadBatched *batched = NULL;
+  ServerThreadCompletion *completion = NULL;
+  ServerThreadRespondFunc respond = NULL;
+  NodeMsgContent_t *response = NULL;
+  SIBAccess *sa = NULL;
+  SIBDelta *delta = NULL;
+  gchar *inserted = NULL;
+  gchar *removed = NULL;
+  GSList *l = NULL;
+  gboolean ok = TRUE;
+  gint success = 0;
+
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(server != NULL);
+  g_return_if_fail(batch != NULL);
+
+  sa = sib_server_get_sib_access(server);
+
+  /* an update removes before it inserts */
+  delta = sib_delta_new();
+  for( l = batch; l != NULL && ok; l = l->next )
+    {
+      batched = (ServerThreadBatched *)l->data;
+      if( batched->removed != NULL )
+	ok = sib_delta_remove(delta, sib_payload_get_data(batched->removed), NULL);
+      if( ok && batched->inserted != NULL )
+	ok = sib_delta_insert(delta, sib_payload_get_data(batched->inserted), NULL);
+    }
+
+  if( !ok )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "combine_thread: bad triples, "
+			    "sending %u writes one by one\n", g_slist_length(batch));
+      sib_delta_free(delta);
+      for( l = batch; l != NULL; l = l->next )
 	{
-	  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "Parse error\n");
-	  sib_server_send_query_response(handle, access_id,ss_OperationFailed, (guchar *)"InvalidResults");
+	  serverthread_batched_run(service, (ServerThreadBatched *)l->data);
+	  serverthread_batched_free((ServerThreadBatched *)l->data);
 	}
-      parseSSAPmsg_free(&response);
+      g_slist_free(batch);
       whiteboard_log_debug_fe();
+      return;
+    }
+
+  sib_delta_finish(delta, &inserted, &removed);
+  if( inserted == NULL && removed == NULL )
+    inserted = g_strdup("<triple_list></triple_list>");
+  whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "combine_thread: %u writes of node %s\n",
+			g_slist_length(batch), nodeid);
+
+  /* the first write is answered as the operation, the others as its batch */
+  first = (ServerThreadBatched *)batch->data;
+  batch = g_slist_delete_link(batch, batch);
+  respond = serverthread_batch_respond_func(first->action);
+
+  if( serverthread_async(server, first->handle, 0, respond, &completion) )
+    {
+      serverthread_replica_hold(completion, EncodingM3XML, (guchar *)inserted, (guchar *)removed);
+      completion->batch = batch;
+      if( inserted != NULL && removed != NULL )
+	success = sib_access_update_async(sa, completion->reactor, nodeid, msgnumber,
+					  EncodingM3XML, (guchar *)inserted, (guchar *)removed,
+					  serverthread_complete, completion);
+      else if( inserted != NULL )
+	success = sib_access_insert_async(sa, completion->reactor, nodeid, msgnumber,
+					  EncodingM3XML, (guchar *)inserted,
+					  serverthread_complete, completion);
+      else
+	success = sib_access_remove_async(sa, completion->reactor, nodeid, msgnumber,
+					  EncodingM3XML, (guchar *)removed,
+					  serverthread_complete, completion);
+      if( success < 0 )
+	serverthread_complete(NULL, -1, NULL, completion);
+    }
+  else
+    {
+      response = sib_msgcache_get_parser();
+      if( inserted != NULL && removed != NULL )
+	success = sib_access_update(sa, nodeid, msgnumber, EncodingM3XML,
+				    (guchar *)inserted, (guchar *)removed, response);
+      else if( inserted != NULL )
+	success = sib_access_insert(sa, nodeid, msgnumber, EncodingM3XML,
+				    (guchar *)inserted, response);
+      else
+	success = sib_access_remove(sa, nodeid, msgnumber, EncodingM3XML,
+				    (guchar *)removed, response);
+      respond(first->handle, 0, success, response);
+      serverthread_batch_respond(batch, 0, success, response);
+      serverthread_replica_write(server, EncodingM3XML, inserted, removed, success, response);
+      sib_msgcache_put_parser(&response);
+    }
+
+  serverthread_batched_free(first);
+  g_free(inserted);
+  g_free(removed);
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Send a held write on its own.
+ */
+static void serverthread_batched_run(SIBService* service,
+				     ServerThreadBatched *batched)
+{
+  switch( batched->action )
+    {
+    case ServerThreadActionInsert:
+      serverthread_insert_thread(service, batched->server, batched->handle,
+				 (ssElement_ct)batched->nodeid, (ssElement_ct)batched->sibid,
+				 batched->msgnumber, EncodingM3XML,
+				 (guchar *)sib_payload_get_data(batched->inserted), NULL);
+      break;
+
+    case ServerThreadActionUpdate:
+      serverthread_update_thread(service, batched->server, batched->handle,
+				 (ssElement_ct)batched->nodeid, (ssElement_ct)batched->sibid,
+				 batched->msgnumber, EncodingM3XML,
+				 (guchar *)sib_payload_get_data(batched->inserted),
+				 (guchar *)sib_payload_get_data(batched->removed));
+      break;
+
+    default:
+      serverthread_remove_thread(service, batched->server, batched->handle,
+				 (ssElement_ct)batched->nodeid, (ssElement_ct)batched->sibid,
+				 batched->msgnumber, EncodingM3XML,
+				 (guchar *)sib_payload_get_data(batched->removed));
+      break;
+    }
+}
+
+/**
+ * Answer the writes of a batch with the response of the write made for
+ * them, and free them.
+ *
+ * @param batch ServerThreadBatched, freed
+ */
+static void serverthread_batch_respond(GSList *batch,
+				       gint access_id,
+				       gint success,
+				       NodeMsgContent_t *response)
+{
+  ServerThreadBatched *batched = NULL;
+  GSList *l = NULL;
+
+  for( l = batch; l != NULL; l = l->next )
+    {
+      batched = (ServerThreadBatched *)l->data;
+      serverthread_batch_respond_func(batched->action)(batched->handle, access_id,
+						       success, response);
+      serverthread_batched_free(batched);
+    }
+  g_slist_free(batch);
+}
+
+/**
+ * Get the function answering a held write.
+ */
+static ServerThreadRespondFunc serverthread_batch_respond_func(ServerThreadAction action)
+{
+  switch( action )
+    {
+    case ServerThreadActionInsert:
+      return serverthread_insert_respond;
+    case ServerThreadActionUpdate:
+      return serverthread_update_respond;
+    default:
+      return serverthread_remove_respond;
     }
 }
 
+/**
+ * Fail a held write whose batch could not be queued.
+ */
+static void serverthread_batched_reject(ServerThreadBatched *batched)
+{
+  switch( batched->action )
+    {
+    case ServerThreadActionInsert:
+      sib_server_send_insert_response(batched->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+    case ServerThreadActionUpdate:
+      sib_server_send_update_response(batched->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+    default:
+      sib_server_send_remove_response(batched->handle, ss_OperationFailed,
+				      (guchar *)"sib:saturated");
+      break;
+    }
+}
+
+static void serverthread_batched_free(ServerThreadBatched *batched)
+{
+  if( batched->server != NULL )
+    sib_server_unref(batched->server);
+  if( batched->handle != NULL )
+    whiteboard_sib_access_handle_unref(batched->handle);
+  if( batched->inserted != NULL )
+    sib_payload_unref(batched->inserted);
+  if( batched->removed != NULL )
+    sib_payload_unref(batched->removed);
+  g_free(batched->nodeid);
+  g_free(batched->sibid);
+  g_free(batched);
+}
+
 static void serverthread_subscribe_thread(SIBService* service,
 					  SIBServer* server,
 					  WhiteBoardSIBAccessHandle* handle,
@@ -978,6 +2842,8 @@ static void serverthread_subscribe_thread(SIBService* service,
   SIBAccess *sa=NULL;
   const guchar *udn = sib_server_get_udn( server );
   guchar *subscriptionid=NULL;
+  gchar *results = NULL;
+  guint generation = 0;
   gint err = 0;
   g_return_if_fail(udn != NULL );
   
@@ -990,8 +2856,19 @@ static void serverthread_subscribe_thread(SIBService* service,
   ctrl = sib_service_get_controller(service);
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "subscribe_thread, node: %s, UDN: %s\n", nodeid, udn);
-  response = parseSSAPmsg_new();
+
+  /* Only subscriptions watched by the reactor can be shared */
+  if( serverthread_get_reactor(server) != NULL &&
+      serverthread_subscription_join(server, handle, access_id, nodeid,
+				     msgnumber, type, request) )
+    {
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  response = sib_msgcache_get_parser();
   sa = sib_server_get_sib_access(server);
+  generation = sib_access_get_write_generation(sa);
   success =  sib_access_subscribe(sa, nodeid, msgnumber, type, request, response);
   if( success <= 0)
     {
@@ -1005,6 +2882,9 @@ static void serverthread_subscribe_thread(SIBService* service,
       if( parseSSAPmsg_get_msg_status(response) == MSG_E_OK )
 	{
 	  subscriptionid = (guchar *) g_strdup(parseSSAPmsg_get_subscriptionid(response));
+	  if( (serverthread_views || sib_server_get_replica(server) != NULL) &&
+	      parseSSAPmsg_get_M3XML(response) != NULL )
+	    results = g_strdup(parseSSAPmsg_get_M3XML(response));
 	  sib_server_send_subscribe_response(handle, access_id, ss_StatusOK,
 					      (guchar *)parseSSAPmsg_get_subscriptionid(response),
 					      (guchar *)parseSSAPmsg_get_M3XML(response));
@@ -1019,11 +2899,19 @@ static void serverthread_subscribe_thread(SIBService* service,
 	}
     }
   
-  parseSSAPmsg_free(&response);
-  if( success > 0)
+  sib_msgcache_put_parser(&response);
+  if( success > 0 &&
+      serverthread_watch_subscription(server, handle, access_id, nodeid, subscriptionid,
+				      type, request, results, generation) )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "subscribe_thread: subscription %s handed to reactor\n",
+			    subscriptionid);
+      g_free(subscriptionid);
+    }
+  else if( success > 0)
     {
 
-      while( ((response = parseSSAPmsg_new()) != NULL) &&
+      while( ((response = sib_msgcache_get_parser()) != NULL) &&
 	     ( (err=sib_access_wait_for_subscription_ind(sa, nodeid, subscriptionid, response)) > 0))
     {
 	  if( (parseSSAPmsg_get_name(response) == MSG_N_SUBSCRIBE) &&
@@ -1034,7 +2922,7 @@ static void serverthread_subscribe_thread(SIBService* service,
 						       (guchar *)parseSSAPmsg_get_results_added(response),
 						      (guchar *)parseSSAPmsg_get_results_removed(response) );
 	      
-	      parseSSAPmsg_free(&response);
+	      sib_msgcache_put_parser(&response);
 	    }
 	  else if( (parseSSAPmsg_get_name(response) == MSG_N_UNSUBSCRIBE) &&
 		   (parseSSAPmsg_get_type(response) == MSG_T_CNF) )
@@ -1044,14 +2932,14 @@ static void serverthread_subscribe_thread(SIBService* service,
 						   status, 
 						   (guchar *)parseSSAPmsg_get_subscriptionid(response));
 	      
-	      parseSSAPmsg_free(&response);
+	      sib_msgcache_put_parser(&response);
 	      break;
 	    }
 	  else
 	    {
 	      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB,
 				    "Received msg not subscibe_ind of unsubscribe_cnf\n");
-	      parseSSAPmsg_free(&response);
+	      sib_msgcache_put_parser(&response);
 	    }
 	}
       if(err<0)
@@ -1060,16 +2948,731 @@ static void serverthread_subscribe_thread(SIBService* service,
 	}
 	 
       if(response)
-	parseSSAPmsg_free(&response);
+	sib_msgcache_put_parser(&response);
 
       if(subscriptionid)
 	{
 	  g_free(subscriptionid);
 	}
     }
+  g_free(results);
+  whiteboard_log_debug_fe();
+}
+
+
+/**
+ * Get the reactor for the transport of a server's SIB, creating it on
+ * first use. Without a reactor each subscription keeps a pool thread
+ * busy and unary operations wait in pool threads.
+ *
+ * @return The reactor, NULL if it could not be created
+ */
+static SIBReactor *serverthread_get_reactor(SIBServer* server)
+{
+  const SIBTransport *transport = NULL;
+  gpointer key = NULL;
+  gpointer reactor = NULL;
+
+  transport = sib_access_get_transport(sib_server_get_sib_access(server));
+  g_return_val_if_fail(transport != NULL, NULL);
+
+  g_mutex_lock(serverthread_reactors_mutex);
+  if( !g_hash_table_lookup_extended(serverthread_reactors, transport, &key, &reactor) )
+    {
+      reactor = sib_reactor_new(transport, SIB_REACTOR_THREADS);
+      if(reactor == NULL)
+	whiteboard_log_warning("Could not create %s reactor\n", transport->name);
+      /* a failed reactor is remembered too, and not retried */
+      g_hash_table_insert(serverthread_reactors, (gpointer)transport, reactor);
+    }
+  g_mutex_unlock(serverthread_reactors_mutex);
+
+  return (SIBReactor *)reactor;
+}
+
+/**
+ * Prepare an operation to be completed by the reactor, so that the pool
+ * thread does not wait for the SIB.
+ *
+ * @return FALSE if the operation has to be done synchronously
+ */
+static gboolean serverthread_async(SIBServer* server,
+				   WhiteBoardSIBAccessHandle* handle,
+				   gint access_id,
+				   ServerThreadRespondFunc respond,
+				   ServerThreadCompletion **completion)
+{
+  ServerThreadCompletion *c = NULL;
+  SIBScheduler *scheduler = NULL;
+  SIBReactor *reactor = serverthread_get_reactor(server);
+
+  /* a reactor that only sees new sockets when it polls again would
+     delay every response */
+  if(reactor == NULL || !sib_reactor_is_prompt(reactor))
+    return FALSE;
+
+  c = g_new0(ServerThreadCompletion, 1);
+  c->server = server;
+  c->handle = handle;
+  c->access_id = access_id;
+  c->respond = respond;
+  c->reactor = reactor;
+
+  /* the SIB serves the request until the response, not until the send */
+  scheduler = (SIBScheduler *)g_atomic_pointer_get(sib_server_get_bulkhead(server));
+  if(scheduler != NULL && sib_scheduler_defer(scheduler, &c->started))
+    c->scheduler = scheduler;
+
+  sib_server_ref(server);
+  whiteboard_sib_access_handle_ref(handle);
+
+  *completion = c;
+  return TRUE;
+}
+
+/**
+ * Called from a reactor thread when an asynchronous operation completes.
+ */
+static void serverthread_complete(SIBAccess *sa,
+				  gint status,
+				  NodeMsgContent_t *msg,
+				  gpointer user_data)
+{
+  ServerThreadCompletion *c = (ServerThreadCompletion *)user_data;
+  whiteboard_log_debug_fb();
+
+  c->respond(c->handle, c->access_id, status, msg);
+  serverthread_batch_respond(c->batch, c->access_id, status, msg);
+  serverthread_query_land(c->flight, serverthread_query_results(status, msg));
+  if(c->write)
+    {
+      serverthread_replica_write(c->server, c->encoding, c->inserted, c->removed, status, msg);
+      g_free(c->inserted);
+      g_free(c->removed);
+    }
+  if(c->query != NULL)
+    {
+      serverthread_query_store(c->server, c->q_type, c->query, c->generation, c->view_mark,
+			       status, msg);
+      g_free(c->query);
+    }
+  if(c->scheduler != NULL)
+    sib_scheduler_complete(c->scheduler, &c->started);
+
+  whiteboard_sib_access_handle_unref(c->handle);
+  sib_server_unref(c->server);
+  g_free(c);
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Key of a subscription for sharing: the SIB, the query type and the
+ * query text.
+ */
+static gchar *serverthread_subscription_key(SIBServer* server,
+					    gint type,
+					    const guchar *request)
+{
+  return g_strdup_printf("%s\n%d\n%s", sib_server_get_udn(server), type, request);
+}
+
+/**
+ * Watch an upstream subscription in the reactor and offer it to later
+ * subscribers of the identical query. Its results are kept in a view if
+ * they are given.
+ *
+ * @param results The initial results or NULL
+ * @param generation Write generation taken before subscribing
+ * @return FALSE if the subscription could not be watched
+ */
+static gboolean serverthread_watch_subscription(SIBServer* server,
+						WhiteBoardSIBAccessHandle* handle,
+						gint access_id,
+						ssElement_ct nodeid,
+						guchar *subscriptionid,
+						gint type,
+						guchar *request,
+						const gchar *results,
+						guint generation)
+{
+  ServerThreadSubscription *sub = NULL;
+  ServerThreadSubscriber *subscriber = NULL;
+  SIBAccess *sa = NULL;
+  SIBReactor *reactor = serverthread_get_reactor(server);
+  whiteboard_log_debug_fb();
+
+  if(reactor == NULL)
+    {
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  subscriber = serverthread_subscriber_new(handle, access_id, subscriptionid);
+  subscriber->leader = TRUE;
+
+  sub = g_new0(ServerThreadSubscription, 1);
+  sub->server = server;
+  sub->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  sub->subscriptionid = (guchar *)g_strdup((gchar *)subscriptionid);
+  sub->subscribers = g_slist_prepend(NULL, subscriber);
+  sub->mutex = g_mutex_new();
+  sub->refcount = 1;
+  sib_server_ref(server);
+
+  /* before the watch, no indication may be missed */
+  if( results != NULL && serverthread_views )
+    {
+      g_atomic_int_inc(&serverthread_views_changes);
+      sub->view = sib_view_new(results);
+      sub->view_generation = generation;
+    }
+  if( results != NULL && type == QueryTypeTemplate && sib_server_get_replica(server) != NULL )
+    sub->scope = sib_replica_add_scope(sib_server_get_replica(server),
+				       (const gchar *)request, results);
+
+  /* the reactor may free its reference before sub is registered */
+  g_atomic_int_inc(&sub->refcount);
+
+  sa = sib_server_get_sib_access(server);
+  if( !sib_access_watch_subscription(sa, reactor, nodeid, subscriptionid,
+				     serverthread_subscription_cb, sub,
+				     serverthread_subscription_free) )
+    {
+      /* the watch took no reference */
+      g_atomic_int_add(&sub->refcount, -1);
+      if( sub->scope != 0 )
+	sib_replica_remove_scope(sib_server_get_replica(server), sub->scope);
+      g_slist_free(sub->subscribers);
+      sub->subscribers = NULL;
+      serverthread_subscriber_free(subscriber);
+      serverthread_subscription_unref(sub);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  /* the reactor may already have seen the subscription end */
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  g_mutex_lock(sub->mutex);
+  serverthread_subscriptions_upstream++;
+  if( !sub->closed )
+    {
+      g_hash_table_insert(serverthread_subscribers, subscriber->subscriptionid, sub);
+      sub->key = serverthread_subscription_key(server, type, request);
+      if( g_hash_table_lookup(serverthread_subscriptions, sub->key) == NULL )
+	{
+	  g_hash_table_insert(serverthread_subscriptions, sub->key, sub);
+	}
+      else
+	{
+	  /* an identical subscription was made at the same time */
+	  g_free(sub->key);
+	  sub->key = NULL;
+	}
+    }
+  if( sub->key == NULL && sub->view != NULL )
+    {
+      sib_view_free(sub->view);
+      sub->view = NULL;
+    }
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+  serverthread_subscription_unref(sub);
+
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
+/**
+ * Subscribe by joining an identical subscription of another handle,
+ * without a subscription of its own in the SIB. The initial results are
+ * queried; indications arriving meanwhile are held until the subscribe
+ * response has been sent.
+ *
+ * @return FALSE if there is no subscription to join or the query failed,
+ *         the caller subscribes on its own then
+ */
+static gboolean serverthread_subscription_join(SIBServer* server,
+					       WhiteBoardSIBAccessHandle* handle,
+					       gint access_id,
+					       ssElement_ct nodeid,
+					       gint msgnumber,
+					       gint type,
+					       guchar *request)
+{
+  ServerThreadSubscription *sub = NULL;
+  ServerThreadSubscriber *subscriber = NULL;
+  NodeMsgContent_t *response = NULL;
+  const guchar *results = NULL;
+  gchar *key = NULL;
+  gchar *subscriptionid = NULL;
+  gint success = 0;
+  gboolean joined = FALSE;
+  GSList *l = NULL;
+  whiteboard_log_debug_fb();
+
+  key = serverthread_subscription_key(server, type, request);
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  sub = (ServerThreadSubscription *)g_hash_table_lookup(serverthread_subscriptions, key);
+  g_free(key);
+  if( sub == NULL )
+    {
+      g_mutex_unlock(serverthread_subscriptions_mutex);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  g_mutex_lock(sub->mutex);
+  subscriptionid = g_strdup_printf("%s.%u", sub->subscriptionid, ++sub->next_local);
+  subscriber = serverthread_subscriber_new(handle, access_id, (guchar *)subscriptionid);
+  g_free(subscriptionid);
+  subscriber->pending = TRUE;
+  sub->subscribers = g_slist_append(sub->subscribers, subscriber);
+  g_atomic_int_inc(&sub->refcount);
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  response = sib_msgcache_get_parser();
+  success = sib_access_query(sib_server_get_sib_access(server), nodeid, msgnumber,
+			     type, request, response);
+  results = serverthread_query_results(success, response);
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  g_mutex_lock(sub->mutex);
+  if( results != NULL && !sub->closed )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "subscribe_thread: joined subscription %s as %s\n",
+			    sub->subscriptionid, subscriber->subscriptionid);
+      sib_server_send_subscribe_response(handle, access_id, ss_StatusOK,
+					 subscriber->subscriptionid, results);
+      subscriber->queued = g_slist_reverse(subscriber->queued);
+      for( l = subscriber->queued; l != NULL; l = l->next )
+	{
+	  ServerThreadIndication *ind = (ServerThreadIndication *)l->data;
+	  sib_server_send_subscription_indication(handle, access_id, ++subscriber->seqnum,
+						  subscriber->subscriptionid,
+						  (guchar *)ind->added, (guchar *)ind->removed);
+	  serverthread_indication_free(ind);
+	}
+      g_slist_free(subscriber->queued);
+      subscriber->queued = NULL;
+      subscriber->pending = FALSE;
+      g_hash_table_insert(serverthread_subscribers, subscriber->subscriptionid, sub);
+      serverthread_subscriptions_joined++;
+      joined = TRUE;
+    }
+  else
+    {
+      sub->subscribers = g_slist_remove(sub->subscribers, subscriber);
+      serverthread_subscriber_free(subscriber);
+    }
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  sib_msgcache_put_parser(&response);
+  serverthread_subscription_unref(sub);
+  whiteboard_log_debug_fe();
+  return joined;
+}
+
+/**
+ * Unsubscribe a subscription watched by the reactor. The subscription in
+ * the SIB is ended when its last subscriber leaves.
+ *
+ * @return FALSE if the subscription is not watched by the reactor
+ */
+static gboolean serverthread_subscription_leave(SIBServer* server,
+						WhiteBoardSIBAccessHandle* handle,
+						gint access_id,
+						gint msgnumber,
+						guchar *subscriptionid)
+{
+  ServerThreadSubscription *sub = NULL;
+  ServerThreadSubscriber *subscriber = NULL;
+  GSList *l = NULL;
+  gint success = 0;
+  whiteboard_log_debug_fb();
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  sub = (ServerThreadSubscription *)g_hash_table_lookup(serverthread_subscribers, subscriptionid);
+  if( sub == NULL || sub->server != server )
+    {
+      g_mutex_unlock(serverthread_subscriptions_mutex);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  g_mutex_lock(sub->mutex);
+  for( l = sub->subscribers; l != NULL && subscriber == NULL; l = l->next )
+    {
+      ServerThreadSubscriber *s = (ServerThreadSubscriber *)l->data;
+      if( !s->pending && strcmp((gchar *)s->subscriptionid, (gchar *)subscriptionid) == 0 )
+	subscriber = s;
+    }
+  if( subscriber == NULL )
+    {
+      g_mutex_unlock(sub->mutex);
+      g_mutex_unlock(serverthread_subscriptions_mutex);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+  serverthread_subscriber_unregister(sub, subscriber);
+  sub->subscribers = g_slist_remove(sub->subscribers, subscriber);
+
+  if( sub->subscribers != NULL )
+    {
+      /* others still use the subscription in the SIB */
+      sib_server_send_unsubscribe_complete(subscriber->handle, subscriber->access_id,
+					   ss_StatusOK, subscriber->subscriptionid);
+      serverthread_subscriber_free(subscriber);
+      g_mutex_unlock(sub->mutex);
+      g_mutex_unlock(serverthread_subscriptions_mutex);
+      whiteboard_log_debug_fe();
+      return TRUE;
+    }
+
+  /* the confirmation is received by the reactor and sent to the closer */
+  sub->closer = subscriber;
+  serverthread_subscription_unshare(sub);
+  g_atomic_int_inc(&sub->refcount);
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  success = sib_access_unsubscribe(sib_server_get_sib_access(server), sub->nodeid,
+				   msgnumber, sub->subscriptionid);
+  if( success < 0 )
+    {
+      whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "unsubscribe_thread: success: %d\n", success);
+      sib_server_send_unsubscribe_complete(handle, access_id, ss_OperationFailed, subscriptionid);
+
+      /* the subscriber keeps the subscription, it is no longer shared */
+      g_mutex_lock(serverthread_subscriptions_mutex);
+      g_mutex_lock(sub->mutex);
+      if( sub->closer == subscriber && !sub->closed )
+	{
+	  sub->closer = NULL;
+	  sub->subscribers = g_slist_prepend(sub->subscribers, subscriber);
+	  g_hash_table_insert(serverthread_subscribers, subscriber->subscriptionid, sub);
+	}
+      g_mutex_unlock(sub->mutex);
+      g_mutex_unlock(serverthread_subscriptions_mutex);
+    }
+
+  serverthread_subscription_unref(sub);
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
+/**
+ * Called from a reactor thread for each message of a subscription, which
+ * is sent to each of its subscribers.
+ */
+static void serverthread_subscription_cb(SIBAccess *sa,
+					 NodeMsgContent_t *msg,
+					 gint status,
+					 gpointer user_data)
+{
+  ServerThreadSubscription *sub = (ServerThreadSubscription *)user_data;
+  ServerThreadSubscriber *closer = NULL;
+  GSList *l = NULL;
+  whiteboard_log_debug_fb();
+
+  if( status > 0 &&
+      (parseSSAPmsg_get_name(msg) == MSG_N_SUBSCRIBE) &&
+      (parseSSAPmsg_get_type(msg) == MSG_T_IND) )
+    {
+      if( sub->scope != 0 )
+	sib_replica_apply(sib_server_get_replica(sub->server), sub->scope,
+			  parseSSAPmsg_get_update_sequence(msg),
+			  parseSSAPmsg_get_results_added(msg),
+			  parseSSAPmsg_get_results_removed(msg));
+
+      g_mutex_lock(sub->mutex);
+      if( sub->view != NULL )
+	{
+	  g_atomic_int_inc(&serverthread_views_changes);
+	  sib_view_apply(sub->view, parseSSAPmsg_get_update_sequence(msg),
+			 parseSSAPmsg_get_results_added(msg),
+			 parseSSAPmsg_get_results_removed(msg));
+	}
+      for( l = sub->subscribers; l != NULL; l = l->next )
+	{
+	  ServerThreadSubscriber *s = (ServerThreadSubscriber *)l->data;
+	  if( s->pending )
+	    {
+	      ServerThreadIndication *ind = g_new(ServerThreadIndication, 1);
+	      ind->added = g_strdup(parseSSAPmsg_get_results_added(msg));
+	      ind->removed = g_strdup(parseSSAPmsg_get_results_removed(msg));
+	      s->queued = g_slist_prepend(s->queued, ind);
+	      continue;
+	    }
+	  /* the subscriber that made the subscription sees the SIB's
+	     sequence numbers, the others count their own */
+	  sib_server_send_subscription_indication(s->handle, s->access_id,
+						  (s->leader ? parseSSAPmsg_get_update_sequence(msg) :
+						   ++s->seqnum),
+						  s->subscriptionid,
+						  (guchar *)parseSSAPmsg_get_results_added(msg),
+						  (guchar *)parseSSAPmsg_get_results_removed(msg) );
+	}
+      g_mutex_unlock(sub->mutex);
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  /* the subscription has ended */
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  g_mutex_lock(sub->mutex);
+  sub->closed = TRUE;
+  serverthread_subscription_unshare(sub);
+  closer = sub->closer;
+  sub->closer = NULL;
+  if( status >= 0 &&
+      (parseSSAPmsg_get_name(msg) == MSG_N_UNSUBSCRIBE) &&
+      (parseSSAPmsg_get_type(msg) == MSG_T_CNF) )
+    {
+      ssStatus_t cnf_status = (parseSSAPmsg_get_msg_status(msg) == MSG_E_OK ? ss_StatusOK : ss_OperationFailed);
+      if( closer != NULL )
+	sib_server_send_unsubscribe_complete(closer->handle, closer->access_id,
+					     cnf_status, closer->subscriptionid);
+    }
+  else
+    {
+      /* e.g. unsubscribe indication or an error, the subscription is gone */
+      if( status >= 0 )
+	whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB,
+			      "Received msg not subscibe_ind of unsubscribe_cnf\n");
+      if( closer != NULL )
+	sib_server_send_unsubscribe_complete(closer->handle, closer->access_id,
+					     -1, closer->subscriptionid);
+    }
+  for( l = sub->subscribers; l != NULL; l = l->next )
+    {
+      ServerThreadSubscriber *s = (ServerThreadSubscriber *)l->data;
+      /* a pending subscriber subscribes on its own instead */
+      if( s->pending )
+	continue;
+      serverthread_subscriber_unregister(sub, s);
+      sib_server_send_unsubscribe_complete(s->handle, s->access_id, -1, s->subscriptionid);
+    }
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  if( closer != NULL )
+    serverthread_subscriber_free(closer);
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Stop offering a subscription to new subscribers. Called with the
+ * subscriptions mutex held.
+ */
+static void serverthread_subscription_unshare(ServerThreadSubscription *sub)
+{
+  if( sub->key != NULL )
+    {
+      g_hash_table_remove(serverthread_subscriptions, sub->key);
+      g_free(sub->key);
+      sub->key = NULL;
+    }
+}
+
+/**
+ * Called when the reactor no longer watches a subscription. Pending
+ * subscribers are released by their own threads.
+ */
+static void serverthread_subscription_free(gpointer data)
+{
+  ServerThreadSubscription *sub = (ServerThreadSubscription *)data;
+  GSList *l = NULL;
+  GSList *pending = NULL;
+  whiteboard_log_debug_fb();
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  g_mutex_lock(sub->mutex);
+  sub->closed = TRUE;
+  serverthread_subscription_unshare(sub);
+  for( l = sub->subscribers; l != NULL; l = l->next )
+    {
+      ServerThreadSubscriber *s = (ServerThreadSubscriber *)l->data;
+      if( s->pending )
+	{
+	  pending = g_slist_prepend(pending, s);
+	  continue;
+	}
+      serverthread_subscriber_unregister(sub, s);
+      serverthread_subscriber_free(s);
+    }
+  g_slist_free(sub->subscribers);
+  sub->subscribers = g_slist_reverse(pending);
+  if( sub->closer != NULL )
+    {
+      serverthread_subscriber_free(sub->closer);
+      sub->closer = NULL;
+    }
+  serverthread_subscriptions_upstream--;
+  g_mutex_unlock(sub->mutex);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+
+  if( sub->scope != 0 )
+    sib_replica_remove_scope(sib_server_get_replica(sub->server), sub->scope);
+
+  serverthread_subscription_unref(sub);
   whiteboard_log_debug_fe();
 }
 
+static void serverthread_subscription_unref(ServerThreadSubscription *sub)
+{
+  if( !g_atomic_int_dec_and_test(&sub->refcount) )
+    return;
+
+  if( sub->view != NULL )
+    sib_view_free(sub->view);
+  g_mutex_free(sub->mutex);
+  sib_server_unref(sub->server);
+  g_free((gchar *)sub->nodeid);
+  g_free(sub->subscriptionid);
+  g_free(sub);
+}
+
+static ServerThreadSubscriber *serverthread_subscriber_new(WhiteBoardSIBAccessHandle* handle,
+							   gint access_id,
+							   guchar *subscriptionid)
+{
+  ServerThreadSubscriber *subscriber = g_new0(ServerThreadSubscriber, 1);
+
+  subscriber->handle = handle;
+  subscriber->access_id = access_id;
+  subscriber->subscriptionid = (guchar *)g_strdup((gchar *)subscriptionid);
+  whiteboard_sib_access_handle_ref(handle);
+  return subscriber;
+}
+
+/**
+ * Remove a subscriber's subscription id from the lookup table, unless it
+ * belongs to a subscription of another SIB. Called with the subscriptions
+ * mutex held.
+ */
+static void serverthread_subscriber_unregister(ServerThreadSubscription *sub,
+					       ServerThreadSubscriber *subscriber)
+{
+  if( g_hash_table_lookup(serverthread_subscribers, subscriber->subscriptionid) == sub )
+    g_hash_table_remove(serverthread_subscribers, subscriber->subscriptionid);
+}
+
+static void serverthread_subscriber_free(ServerThreadSubscriber *subscriber)
+{
+  g_slist_foreach(subscriber->queued, (GFunc)serverthread_indication_free, NULL);
+  g_slist_free(subscriber->queued);
+  whiteboard_sib_access_handle_unref(subscriber->handle);
+  g_free(subscriber->subscriptionid);
+  g_free(subscriber);
+}
+
+static void serverthread_indication_free(ServerThreadIndication *ind)
+{
+  g_free(ind->added);
+  g_free(ind->removed);
+  g_free(ind);
+}
+
+/**
+ * Find the shared subscription to a query and take a reference to it.
+ */
+static ServerThreadSubscription *serverthread_subscription_find(SIBServer* server,
+								gint type,
+								const guchar *request)
+{
+  ServerThreadSubscription *sub = NULL;
+  gchar *key = serverthread_subscription_key(server, type, request);
+
+  g_mutex_lock(serverthread_subscriptions_mutex);
+  sub = (ServerThreadSubscription *)g_hash_table_lookup(serverthread_subscriptions, key);
+  if( sub != NULL )
+    g_atomic_int_inc(&sub->refcount);
+  g_mutex_unlock(serverthread_subscriptions_mutex);
+  g_free(key);
+  return sub;
+}
+
+/**
+ * Answer a query from the view of a subscription to the same query. The
+ * view is used if it has seen every indication and no write was made
+ * through this component since the view was last refreshed, as the
+ * indication of such a write may still be on its way.
+ *
+ * @return The results, free with g_free(). NULL if the query has to be
+ *         sent to the SIB.
+ */
+static gchar *serverthread_view_lookup(SIBServer* server,
+				       gint type,
+				       const guchar *request)
+{
+  ServerThreadSubscription *sub = NULL;
+  gchar *results = NULL;
+  guint generation = 0;
+
+  if( !serverthread_views )
+    return NULL;
+
+  generation = sib_access_get_write_generation(sib_server_get_sib_access(server));
+  sub = serverthread_subscription_find(server, type, request);
+  if( sub == NULL )
+    return NULL;
+
+  g_mutex_lock(sub->mutex);
+  if( sub->view != NULL && !sub->closed && sub->view_generation == generation )
+    {
+      results = sib_view_get_results(sub->view);
+      if( results != NULL )
+	whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "query answered from subscription %s, update %d\n",
+			      sub->subscriptionid, sib_view_get_sequence(sub->view));
+    }
+  g_mutex_unlock(sub->mutex);
+
+  serverthread_subscription_unref(sub);
+  return results;
+}
+
+/**
+ * Refresh the view of a subscription to a query from the query's results,
+ * e.g. after a write or a missed indication. A view that changed while the
+ * query was out may be newer than the results and is left alone.
+ *
+ * @param generation Write generation taken before the query was sent
+ * @param view_mark View changes taken before the query was sent
+ */
+static void serverthread_view_reset(SIBServer* server,
+				    gint type,
+				    const gchar *query,
+				    guint generation,
+				    guint view_mark,
+				    const guchar *results)
+{
+  ServerThreadSubscription *sub = NULL;
+
+  if( !serverthread_views )
+    return;
+
+  /* a write overlapped the query */
+  if( generation != sib_access_get_write_generation(sib_server_get_sib_access(server)) )
+    return;
+
+  sub = serverthread_subscription_find(server, type, (const guchar *)query);
+  if( sub == NULL )
+    return;
+
+  g_mutex_lock(sub->mutex);
+  if( sub->view != NULL && !sub->closed &&
+      (guint)g_atomic_int_get(&serverthread_views_changes) == view_mark )
+    {
+      g_atomic_int_inc(&serverthread_views_changes);
+      sib_view_reset(sub->view, (const gchar *)results);
+      sub->view_generation = generation;
+    }
+  g_mutex_unlock(sub->mutex);
+
+  serverthread_subscription_unref(sub);
+}
 
 static void serverthread_unsubscribe_thread(SIBService* service,
 					    SIBServer* server,
@@ -1094,6 +3697,12 @@ static void serverthread_unsubscribe_thread(SIBService* service,
   
   whiteboard_log_debugc(WHITEBOARD_DEBUG_SIB, "unsubscribe_thread, node: %s, UDN: %s\n", nodeid, udn);
 
+  if( serverthread_subscription_leave(server, handle, access_id, msgnumber, request) )
+    {
+      whiteboard_log_debug_fe();
+      return;
+    }
+
   sa = sib_server_get_sib_access(server);
   success =  sib_access_unsubscribe(sa, nodeid, msgnumber, request);
   if( success < 0)
@@ -46,13 +46,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/types.h>
-/*
 #include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-*/
-
-#include <h_in/h_bsdapi.h>
 
 
 #include <glib.h>
@@ -61,23 +55,131 @@
 #include <sibmsg.h>
 
 #include "sib_controller.h"
-
-#define SID_M3SIB 10
+#include "sib_connection_pool.h"
+#include "sib_framer.h"
+#include "sib_msgcache.h"
+#include "sib_pipeline.h"
+#include "sib_reactor.h"
+#include "sib_transport.h"
+#include "sib_access.h"
 
 #define BUF_SIZE 8192
+/** Largest receive buffer; buffers start from the size history and grow
+    towards this while a response keeps filling them */
+#define RECV_BUF_MAX (1024*1024)
 //gchar recvbuf[BUF_SIZE];
 
-#define ENDTAG "</SSAP_message>"
-#define ENDTAGLEN 15
-
 typedef struct _SubData
 {
+  const SIBTransport *transport;
   int s;    // socket
   gchar *recvbuf;
+  gint size; // size of recvbuf
+  gboolean full; // last receive filled the buffer
+  guint recvs; // receive calls since the last response was recorded
+  guint grows; // buffer growths since the last response was recorded
   gint len; // lenth of received message
   gint remaining_len; // unhandled bytes
+  gint total; // total bytes received
+  SIBFramer *framer; // collects the current message
+  struct _SubDataCache *owner; // cache of the thread that took it
+  struct _SubData *next; // next free SubData in a thread's cache
 } SubData;
 
+/** Receive buffers of BUF_SIZE, 2 * BUF_SIZE, ... up to this many size
+    classes are kept for reuse, larger ones are freed */
+#define SUB_DATA_CACHE_CLASSES 4
+/** Free SubData kept per size class and thread */
+#define SUB_DATA_CACHE_DEPTH 8
+/** Free SubData that other threads may hand back to a thread */
+#define SUB_DATA_CACHE_REMOTE (SUB_DATA_CACHE_CLASSES * SUB_DATA_CACHE_DEPTH)
+/** A framer that grew its buffer beyond this is not kept in the cache */
+#define SUB_DATA_FRAMER_MAX (BUF_SIZE << (SUB_DATA_CACHE_CLASSES - 1))
+
+/**
+ * Free SubData of one thread, with their receive buffers. SubData freed
+ * by another thread, e.g. an asynchronous operation completed by a
+ * reactor thread, go back to the thread that took them through the
+ * remote list: other threads only push to it, the owner takes all of it
+ * at once, so it needs no lock.
+ */
+typedef struct _SubDataCache
+{
+  SubData *free[SUB_DATA_CACHE_CLASSES];
+  guint count[SUB_DATA_CACHE_CLASSES];
+  volatile gpointer remote;
+  volatile gint remote_count;
+  /* the thread and each SubData it has taken */
+  volatile gint refcount;
+} SubDataCache;
+
+static GStaticPrivate sub_data_cache_key = G_STATIC_PRIVATE_INIT;
+
+/* process wide SubData counters, updated atomically */
+static volatile gint sub_data_requests = 0;
+static volatile gint sub_data_hits = 0;
+static volatile gint sub_data_in_use = 0;
+static volatile gint sub_data_peak = 0;
+
+/** Operations whose response sizes are tracked separately */
+typedef enum _SIBAccessOp
+  {
+    SIB_ACCESS_OP_JOIN,
+    SIB_ACCESS_OP_LEAVE,
+    SIB_ACCESS_OP_INSERT,
+    SIB_ACCESS_OP_UPDATE,
+    SIB_ACCESS_OP_REMOVE,
+    SIB_ACCESS_OP_QUERY,
+    SIB_ACCESS_OP_SUBSCRIBE,
+    SIB_ACCESS_OP_INDICATION,
+    SIB_ACCESS_OP_COUNT
+  } SIBAccessOp;
+
+static const gchar *sib_access_op_names[SIB_ACCESS_OP_COUNT] =
+  { "join", "leave", "insert", "update", "remove", "query", "subscribe", "indication" };
+
+/** Response size history of one operation */
+typedef struct _RecvHistory
+{
+  gint hint;        // initial receive buffer size for the next response
+  guint responses;
+  guint64 bytes;
+  gint max_bytes;
+  guint recvs;      // receive calls
+  guint grows;      // buffer growths
+} RecvHistory;
+
+/** A subscription socket watched by a reactor */
+typedef struct _SubWatch
+{
+  SIBAccess *sa;
+  SubData *sdata;
+  ssElement_ct nodeid;
+  guchar *subscription_id;
+  NodeMsgContent_t *msg;  // message being parsed
+  SIBAccessSubscriptionFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} SubWatch;
+
+/** An asynchronous unary operation waiting for its confirmation */
+typedef struct _AsyncOp
+{
+  SIBAccess *sa;
+  SubData *sdata;
+  SIBReactor *reactor;
+  SIBConnection *conn;    // NULL if the socket is not pooled
+  ssBufDesc_t *buf;       // kept to resend it if conn was closed, or NULL
+  gboolean retry;         // conn turned out to be closed by the SIB
+  SIBAccessOp op;
+  ssElement_ct nodeid;
+  gint name;              // expected message name
+  NodeMsgContent_t *msg;
+  gint status;
+  SIBAccessCompleteFunc func;
+  gpointer user_data;
+} AsyncOp;
+
 struct _SIBAccess
 {
   SIBController* cp;
@@ -86,32 +188,69 @@ struct _SIBAccess
   
   gchar* ip_address;
   gint port;
+  const SIBTransport *transport;
 
   //  int sockfd;
   
   /* subscription id -> SubData */
   GHashTable *subs_sockfd_map;
+  GMutex *subs_mutex;
+
+  /* long-lived connections for unary operations, NULL if every
+     operation opens its own connection */
+  SIBConnectionPool *pool;
+
+  /* shared connection for pipelined unary operations, NULL if not used */
+  SIBPipeline *pipeline;
 
+  /* receive buffer sizing, per operation */
+  RecvHistory recv_history[SIB_ACCESS_OP_COUNT];
+  GMutex *recv_mutex;
+
+  /* changed when a write starts and when it completes */
+  volatile gint write_generation;
   
   gint refcount;
 };
 
-/* Urgh, global to access nota */
-extern h_in_t* instance;
-
 /*****************************************************************************
  * Private utilities
  *****************************************************************************/
 
-static gint sib_access_command(int s, gchar *msg, gint len, NodeMsgContent_t *response);
-static gint sib_access_subscribe_command(int s, gchar *msg, gint len, NodeMsgContent_t *response);
+static gint sib_access_command(SIBAccess *sa, SIBAccessOp op, ssElement_ct nodeid, gint msgnumber,
+			       gchar *msg, gint len, NodeMsgContent_t *response);
+static gint sib_access_pooled_command(SIBAccess *sa, SIBAccessOp op, gchar *msg, gint len,
+				      NodeMsgContent_t *response);
+static SIBConnection *sib_access_pooled_send(SIBAccess *sa, gchar *msg, gint len);
+static gboolean sib_access_pooled_stale(SIBAccessOp op, SIBConnection *conn, SubData *sdata);
+static gint sib_access_subscribe_command(SIBAccess *sa, int s, gchar *msg, gint len,
+					 NodeMsgContent_t *response);
 
-static gint sib_access_send_command(int s, gchar *msg, gint len);
+static gint sib_access_send_command(SIBAccess *sa, int s, gchar *msg, gint len);
 
-static gint sib_access_send_message(int s, gchar *buf, gint len);
+static gint sib_access_send_message(SIBAccess *sa, int s, gchar *buf, gint len);
 static gint sib_access_receive_message(SubData *sdata, NodeMsgContent_t *msgContent);
+static gint sib_access_parse_buffered(SubData *sdata, NodeMsgContent_t *msgContent);
+static gint sib_access_check_confirmation(SIBAccess *sa, ssElement_ct nodeid, gint name,
+					  const gchar *opname, NodeMsgContent_t *msgContent);
+static gint sib_access_check_subscription_msg(SIBAccess *sa, ssElement_ct nodeid, guchar *id,
+					      NodeMsgContent_t *msg);
+static gboolean sib_access_subscription_readable(int s, gpointer user_data);
+static void sub_watch_free(gpointer data);
+static gint sib_access_command_async(SIBAccess *sa, SIBReactor *reactor, SIBAccessOp op,
+				     ssElement_ct nodeid, gint msgnumber, gint name, ssBufDesc_t *buf,
+				     SIBAccessCompleteFunc func, gpointer user_data);
+static void sib_access_async_watch(AsyncOp *op);
+static gboolean sib_access_async_resend(AsyncOp *op);
+static gboolean sib_access_async_readable(int s, gpointer user_data);
+static void async_op_free(gpointer data);
 
 static int sib_access_get_and_connect_socket(SIBAccess *sa);
+static int sib_access_pool_connect(gpointer user_data);
+static void sib_access_pool_close(int s, gpointer user_data);
+static gint sib_access_pipeline_send(int s, gchar *buf, gint len, gpointer user_data);
+static gint sib_access_pipeline_recv(int s, gchar *buf, gint len, gpointer user_data);
+static void sib_access_pipeline_shutdown(int s, gpointer user_data);
 static ssBufDesc_t *sib_access_create_join_message(ssElement_ct ssId,
 					     //apr09obsolete const gchar *username,
 					     ssElement_ct nodeName,
@@ -152,7 +291,15 @@ static void sub_data_free(gpointer data);
 static void sub_data_free_close(gpointer data);
 
 
-static SubData *sub_data_new(int s);
+static SubData *sub_data_new(const SIBTransport *transport, int s, gint size);
+static void sub_data_destroy(SubData *sdata);
+static void sub_data_cache_free(gpointer data);
+static void sub_data_cache_unref(SubDataCache *cache);
+static gint sub_data_recv(SubData *sdata);
+
+static gint sib_access_recv_hint(SIBAccess *sa, SIBAccessOp op);
+static void sib_access_note_write(SIBAccess *sa, SIBAccessOp op);
+static void sib_access_record_response(SIBAccess *sa, SIBAccessOp op, SubData *sdata, gint bytes);
 /*****************************************************************************
  * Construction/destruction
  *****************************************************************************/
@@ -171,12 +318,38 @@ SIBAccess* sib_access_new(SIBController* cp, guchar *uri, gchar *ip, gint port)
 
   self->cp = cp;
   self->uri=(ssElement_ct)g_strdup( (gchar *)uri);
-  //self->ip_address = g_strdup(ip);
-  //self->port = port;
+  self->ip_address = g_strdup(ip);
+  self->port = port;
+  self->transport = sib_transport_for_address(ip, port);
+  whiteboard_log_debug("SIB %s reached over %s\n", self->uri, self->transport->name);
   self->refcount=1;
 
   //  self->sockfd = -1;
   self->subs_sockfd_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, sub_data_free_close);
+  self->subs_mutex = g_mutex_new();
+  self->recv_mutex = g_mutex_new();
+  {
+    gint op;
+    for(op = 0; op < SIB_ACCESS_OP_COUNT; op++)
+      self->recv_history[op].hint = BUF_SIZE;
+  }
+#ifdef WITH_CONNECTION_POOL
+  self->pool = sib_connection_pool_new(SIB_CONNECTION_POOL_MAX_IDLE,
+				       SIB_CONNECTION_POOL_IDLE_TIMEOUT,
+				       sib_access_pool_connect,
+				       sib_access_pool_close,
+				       self);
+#endif
+#ifdef WITH_PIPELINING
+  {
+    SIBPipelineIO io = { sib_access_pool_connect,
+			 sib_access_pipeline_send,
+			 sib_access_pipeline_recv,
+			 sib_access_pipeline_shutdown,
+			 sib_access_pool_close };
+    self->pipeline = sib_pipeline_new(&io, self);
+  }
+#endif
   whiteboard_log_debug_fe();
   return self;
 }
@@ -208,6 +381,16 @@ gboolean sib_access_destroy(SIBAccess* sa)
   sa->ip_address = NULL;
 
   g_hash_table_destroy(sa->subs_sockfd_map);
+  g_mutex_free(sa->subs_mutex);
+  g_mutex_free(sa->recv_mutex);
+
+  if (sa->pipeline)
+    sib_pipeline_destroy(sa->pipeline);
+  sa->pipeline = NULL;
+
+  if (sa->pool)
+    sib_connection_pool_destroy(sa->pool);
+  sa->pool = NULL;
   
   /*Finally destroy self */
   g_free(sa);
@@ -294,6 +477,117 @@ gint sib_access_compare_uri(gconstpointer sib, gconstpointer uri)
   return g_ascii_strcasecmp((char *)sa->uri, uri);
 }
 
+/**
+ * Periodic maintenance: close idle connections that have timed out and
+ * log the connection statistics.
+ *
+ * @param sa The SIBAccess
+ */
+void sib_access_maintenance(SIBAccess *sa)
+{
+  SIBConnectionPoolStats stats;
+  guint evicted = 0;
+  whiteboard_log_debug_fb();
+  g_return_if_fail(sa != NULL);
+
+  if(sa->pool != NULL)
+    {
+      evicted = sib_connection_pool_evict_idle(sa->pool);
+      sib_connection_pool_get_stats(sa->pool, &stats);
+      whiteboard_log_debug("SIB %s connection pool: hits %d, misses %d, connects %d (%.2f/s), "
+			   "connect failures %d, evicted %d (%d now), discarded %d, reuse failures %d, "
+			   "idle %d, in use %d%s\n",
+			   sa->uri,
+			   stats.hits, stats.misses, stats.connects, stats.connects_per_sec,
+			   stats.connect_failures, stats.evictions, evicted, stats.discards,
+			   stats.reuse_failures, stats.idle, stats.in_use,
+			   stats.reuse_disabled ? ", reuse disabled" : "");
+    }
+  g_mutex_lock(sa->recv_mutex);
+  {
+    gint op;
+    for(op = 0; op < SIB_ACCESS_OP_COUNT; op++)
+      {
+	RecvHistory *h = &sa->recv_history[op];
+	if(h->responses == 0)
+	  continue;
+	whiteboard_log_debug("SIB %s %s responses: %d, avg %d bytes, max %d bytes, "
+			     "%.2f receives per response, buffer growths %d, next buffer %d bytes\n",
+			     sa->uri, sib_access_op_names[op], h->responses,
+			     (gint)(h->bytes / h->responses), h->max_bytes,
+			     (gdouble)h->recvs / h->responses, h->grows, h->hint);
+      }
+  }
+  g_mutex_unlock(sa->recv_mutex);
+
+  {
+    gint requests = g_atomic_int_get(&sub_data_requests);
+    gint hits = g_atomic_int_get(&sub_data_hits);
+    whiteboard_log_debug("Receive buffers (all SIBs): requests %d, cache hits %d (%d%%), "
+			 "in use %d, peak %d\n",
+			 requests, hits, (requests > 0 ? (gint)(100.0 * hits / requests) : 0),
+			 g_atomic_int_get(&sub_data_in_use), g_atomic_int_get(&sub_data_peak));
+  }
+
+  {
+    SIBMsgCacheStats cache;
+    sib_msgcache_get_stats(&cache);
+    whiteboard_log_debug("Parsers (all SIBs): cache hits %u, misses %u; "
+			 "message builders: cache hits %u, misses %u\n",
+			 cache.parser_hits, cache.parser_misses,
+			 cache.builder_hits, cache.builder_misses);
+  }
+
+  if(sa->pipeline != NULL)
+    {
+      SIBPipelineStats pstats;
+      sib_pipeline_get_stats(sa->pipeline, &pstats);
+      whiteboard_log_debug("SIB %s pipeline: requests %d, in flight %d (max %d), busy %d, "
+			   "timeouts %d, failures %d, connects %d, orphans %d\n",
+			   sa->uri,
+			   pstats.requests, pstats.in_flight, pstats.max_in_flight, pstats.busy,
+			   pstats.timeouts, pstats.failures, pstats.connects, pstats.orphans);
+    }
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Get the connection pool statistics of a SIBAccess.
+ *
+ * @param sa The SIBAccess
+ * @param stats Filled with the pool counters
+ * @return FALSE if connection pooling is not in use
+ */
+gboolean sib_access_get_pool_stats(SIBAccess *sa, SIBConnectionPoolStats *stats)
+{
+  g_return_val_if_fail(sa != NULL, FALSE);
+  g_return_val_if_fail(stats != NULL, FALSE);
+
+  if(sa->pool == NULL)
+    return FALSE;
+
+  sib_connection_pool_get_stats(sa->pool, stats);
+  return TRUE;
+}
+
+/**
+ * Get the transport used to reach the SIB.
+ *
+ * @param sa The SIBAccess
+ * @return The transport
+ */
+const SIBTransport *sib_access_get_transport(SIBAccess *sa)
+{
+  g_return_val_if_fail(sa != NULL, NULL);
+  return sa->transport;
+}
+
+guint sib_access_get_write_generation(SIBAccess *sa)
+{
+  g_return_val_if_fail(sa != NULL, 0);
+  return (guint)g_atomic_int_get(&sa->write_generation);
+}
+
 gint sib_access_join( SIBAccess *sa,
 		      //apr09obsolete const gchar *username,
 		      ssElement_ct nodeid,
@@ -304,7 +598,6 @@ gint sib_access_join( SIBAccess *sa,
 {
   gint retvalue = -1;
   gint rbytes=-1;
-  int s;
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg =NULL;
   gint sendmsgLen = -1;
@@ -323,37 +616,12 @@ gint sib_access_join( SIBAccess *sa,
       whiteboard_log_debug_fe();
       return -1;
     }
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);
-      whiteboard_log_debug_fe();
-      return -1;
-    }
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
-  rbytes = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes = sib_access_command(sa, SIB_ACCESS_OP_JOIN, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
   if(rbytes > 0)
     {
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_JOIN ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper join conf. Receiver: %s(%s), Sender: %s(%s), Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       nodeid,
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       sa->uri,
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_JOIN, "join", msgContent);
     }
   else
     {
@@ -361,7 +629,7 @@ gint sib_access_join( SIBAccess *sa,
       retvalue = -1;
     }
   
-  ssBufDesc_free(&buf);
+  sib_msgcache_put_builder(&buf);
 
   whiteboard_log_debug_fe();
   return retvalue;
@@ -374,7 +642,6 @@ gint sib_access_leave( SIBAccess *sa, ssElement_ct nodeid, gint msgnumber,
   whiteboard_log_debug_fb();
   gint rbytes;
   gint retvalue = -1;
-  int s;
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg = NULL;
   gint sendmsgLen = -1;
@@ -385,39 +652,14 @@ gint sib_access_leave( SIBAccess *sa, ssElement_ct nodeid, gint msgnumber,
       whiteboard_log_debug_fe();
       return -1;
     }
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);
-      whiteboard_log_debug_fe();
-      return -1;
-    }
 
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
-  rbytes = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes = sib_access_command(sa, SIB_ACCESS_OP_LEAVE, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
    if(rbytes > 0)
     {
       
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_LEAVE ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper leave conf. Receiver: %s(%s), Sender: %s(%s), Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       nodeid,
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       sa->uri,
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_LEAVE, "leave", msgContent);
     }
   else
     {
@@ -425,7 +667,7 @@ gint sib_access_leave( SIBAccess *sa, ssElement_ct nodeid, gint msgnumber,
       retvalue = -1;
     }
    
-   ssBufDesc_free(&buf);
+   sib_msgcache_put_builder(&buf);
   whiteboard_log_debug_fe();
   return retvalue;
 }
@@ -438,7 +680,6 @@ gint sib_access_insert(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, Encod
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg = NULL;
   gint sendmsgLen = -1;
-  int s;
   whiteboard_log_debug_fb();
 
   g_return_val_if_fail( NULL != sa, -1);
@@ -453,44 +694,21 @@ gint sib_access_insert(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, Encod
       return -1;
     }
 
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      whiteboard_log_debug_fe();
-      ssBufDesc_free(&buf);
-      return -1;
-    }
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
-  rbytes  = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes  = sib_access_command(sa, SIB_ACCESS_OP_INSERT, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
    
   if(rbytes > 0)
     {
       
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_INSERT ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper insert conf. Receiver: %s, Sender: %s, Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_INSERT, "insert", msgContent);
     }
   else
     {
       whiteboard_log_debug("Sending insert command failed\n");
       retvalue = -1;
     }
-  ssBufDesc_free(&buf);
+  sib_msgcache_put_builder(&buf);
   whiteboard_log_debug_fe();
   return retvalue;
 }
@@ -504,7 +722,6 @@ gint sib_access_update(SIBAccess *sa, ssElement_ct nodeid,
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg = NULL;
   gint sendmsgLen = -1;
-  int s;
   whiteboard_log_debug_fb();
 
   g_return_val_if_fail( NULL != sa, -1);
@@ -520,45 +737,22 @@ gint sib_access_update(SIBAccess *sa, ssElement_ct nodeid,
       return -1;
     }
 
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);      
-      whiteboard_log_debug_fe();
-      return -1;
-    }
   
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
-  rbytes  = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes  = sib_access_command(sa, SIB_ACCESS_OP_UPDATE, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
   
   if(rbytes > 0)
     {
       
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_UPDATE ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper update conf. Receiver: %s, Sender: %s, Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_UPDATE, "update", msgContent);
     }
   else
     {
       whiteboard_log_debug("Sending update command failed\n");
       retvalue = -1;
     }
-  ssBufDesc_free(&buf);      
+  sib_msgcache_put_builder(&buf);      
   whiteboard_log_debug_fe();
   return retvalue;
 }
@@ -571,7 +765,6 @@ gint sib_access_remove(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, Encod
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg = NULL;
   gint sendmsgLen = -1;
-  int s;
   whiteboard_log_debug_fb();
 
   g_return_val_if_fail( NULL != sa, -1);
@@ -585,47 +778,24 @@ gint sib_access_remove(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, Encod
       whiteboard_log_debug_fe();
       return -1;
     }
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);      
-      whiteboard_log_debug_fe();
-      return -1;
-    }
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
   
 
-  rbytes  = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes  = sib_access_command(sa, SIB_ACCESS_OP_REMOVE, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
    
   if(rbytes > 0)
     {
       
       whiteboard_log_debug("Remove command sent, Parsing response... %d bytes, \n", rbytes);
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_REMOVE ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper remove conf. Receiver: %s, Sender: %s, Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_REMOVE, "remove", msgContent);
     }
   else
     {
       whiteboard_log_debug("Sending remove command failed\n");
       retvalue = -1;
     }
-  ssBufDesc_free(&buf);      
+  sib_msgcache_put_builder(&buf);      
   whiteboard_log_debug_fe();
   return retvalue;
 }
@@ -638,7 +808,6 @@ gint sib_access_query(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gint t
   ssBufDesc_t *buf = NULL;
   gchar *sendmsg = NULL;
   gint sendmsgLen = -1;
-  int s;
   whiteboard_log_debug_fb();
   
   g_return_val_if_fail( NULL != sa, -1);
@@ -652,50 +821,58 @@ gint sib_access_query(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gint t
       whiteboard_log_debug_fe();
       return -1;
     }
-  s = sib_access_get_and_connect_socket(sa);
-  if(s<0)
-    {
-      whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);  
-      whiteboard_log_debug_fe();
-      return -1;
-    }
 
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
   
-  rbytes  = sib_access_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes  = sib_access_command(sa, SIB_ACCESS_OP_QUERY, nodeid, msgnumber, sendmsg, sendmsgLen, msgContent);
    
   if(rbytes > 0)
     {
-      if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
-	  g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
-	  ( parseSSAPmsg_get_name(msgContent) != MSG_N_QUERY ) ||
-	  ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
-	{
-	  whiteboard_log_debug("Not proper query conf. Receiver: %s, Sender: %s, Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msgContent),
-			       parseSSAPmsg_get_spaceid( msgContent),
-			       parseSSAPmsg_get_name(msgContent),
-			       parseSSAPmsg_get_type(msgContent) );
-	  retvalue = -1;
-	}
-      else
-	{
-	  retvalue = 1;
-	}
+      retvalue = sib_access_check_confirmation(sa, nodeid, MSG_N_QUERY, "query", msgContent);
     }
   else
     {
       whiteboard_log_debug("Sending query command failed\n");
       retvalue = -1;
     }
-  ssBufDesc_free(&buf);  
+  sib_msgcache_put_builder(&buf);  
 
   whiteboard_log_debug_fe();
   return retvalue;
 }
 
+/**
+ * Check that a response is the confirmation of a request.
+ *
+ * @param sa The SIBAccess
+ * @param nodeid Node id of the request
+ * @param name Expected message name, e.g. MSG_N_INSERT
+ * @param opname Operation name for the log
+ * @param msgContent The parsed response
+ * @return 1 if the response is a proper confirmation, -1 otherwise
+ */
+static gint sib_access_check_confirmation(SIBAccess *sa, ssElement_ct nodeid, gint name,
+					  const gchar *opname, NodeMsgContent_t *msgContent)
+{
+  if( g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msgContent) ) ||
+      g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msgContent) ) ||
+      ( parseSSAPmsg_get_name(msgContent) != name ) ||
+      ( parseSSAPmsg_get_type(msgContent) != MSG_T_CNF ) )
+    {
+      whiteboard_log_debug("Not proper %s conf. Receiver: %s(%s), Sender: %s(%s), Name: %d, Type: %d\n",
+			   opname,
+			   parseSSAPmsg_get_nodeid( msgContent),
+			   nodeid,
+			   parseSSAPmsg_get_spaceid( msgContent),
+			   sa->uri,
+			   parseSSAPmsg_get_name(msgContent),
+			   parseSSAPmsg_get_type(msgContent) );
+      return -1;
+    }
+  return 1;
+}
+
 gint sib_access_subscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gint type,
 			  guchar *request, NodeMsgContent_t *msgContent)
 {
@@ -722,7 +899,7 @@ gint sib_access_subscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gi
   if (s<0)
     {
       whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);  
+      sib_msgcache_put_builder(&buf);  
 
       whiteboard_log_debug_fe();
       return -1;
@@ -730,7 +907,7 @@ gint sib_access_subscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gi
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
 
-  rbytes  = sib_access_subscribe_command(s, sendmsg, sendmsgLen, msgContent);
+  rbytes  = sib_access_subscribe_command(sa, s, sendmsg, sendmsgLen, msgContent);
    
   if(rbytes > 0)
     {
@@ -746,11 +923,11 @@ gint sib_access_subscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gi
 			       parseSSAPmsg_get_type(msgContent) );
 	  retvalue = -1;
 	  // close(s);
-	  Hclose(instance, s);
+	  sa->transport->close(s);
 	}
       else
 	{
-	  SubData *sdata = sub_data_new(s);
+	  SubData *sdata = sub_data_new(sa->transport, s, sib_access_recv_hint(sa, SIB_ACCESS_OP_INDICATION));
 	  if( sib_access_add_subscription_socket(sa, (guchar *)g_strdup(parseSSAPmsg_get_subscriptionid(msgContent)), sdata) )
 	    retvalue = 1;
 	  else
@@ -766,7 +943,7 @@ gint sib_access_subscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber, gi
       whiteboard_log_debug("Sending Subscribe command failed\n");
       retvalue = -1;
     }
-  ssBufDesc_free(&buf);  
+  sib_msgcache_put_builder(&buf);  
   whiteboard_log_debug_fe();
   return retvalue;
 }
@@ -797,92 +974,552 @@ gint sib_access_unsubscribe(SIBAccess *sa, ssElement_ct nodeid, gint msgnumber,
   if (s<0)
     {
       whiteboard_log_warning("socket err\n");
-      ssBufDesc_free(&buf);  
+      sib_msgcache_put_builder(&buf);  
       whiteboard_log_debug_fe();
       return -1;
     }
   
   sendmsg = ssBufDesc_GetMessage(buf);
   sendmsgLen = ssBufDesc_GetMessageLen(buf);
-  success  = sib_access_send_command(s, sendmsg, sendmsgLen);
+  success  = sib_access_send_command(sa, s, sendmsg, sendmsgLen);
    
   if(success < 0)
     {
       whiteboard_log_debug("Cound not send unsubscribe command\n");
     }
-  ssBufDesc_free(&buf);  
+  sib_msgcache_put_builder(&buf);  
   whiteboard_log_debug_fe();
   return success;
 }
 
-static gint sib_access_command(int s, gchar *msg, gint len, NodeMsgContent_t *response)
+gint sib_access_join_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			   SIBAccessCompleteFunc func, gpointer user_data)
 {
-  gint rbytes = 0;
-  //apr09unused gint rtmp;
-  //apr09unused gboolean finished = FALSE;
-  //apr09unused gint rpos = 0;
-  SubData *sdata = NULL;
-  whiteboard_log_debug_fb();
-
-  sdata = sub_data_new(s);
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
 
-  if( sib_access_send_message(s, msg, len) < 0)
+  buf = sib_access_create_join_message(sa->uri, nodeid, msgnumber);
+  if(buf == NULL)
     {
-      whiteboard_log_warning("Could not send message\n");
-      sub_data_free_close(sdata);
-      whiteboard_log_debug_fe();
+      whiteboard_log_warning("Could not create Join message\n");
       return -1;
     }
-
-  shutdown(s, SHUT_WR); // shutdown write direction.
-  
-  rbytes = sib_access_receive_message(sdata, response);
-  
-  sub_data_free_close(sdata);// closes socket also
-  
-  whiteboard_log_debug_fe();
-  return rbytes;
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_JOIN, nodeid, msgnumber, MSG_N_JOIN, buf, func, user_data);
 }
 
-static gint sib_access_send_command(int s, gchar *msg, gint len)
+gint sib_access_leave_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			    SIBAccessCompleteFunc func, gpointer user_data)
 {
-  gint rbytes = 0;
-  whiteboard_log_debug_fb();
-  if( sib_access_send_message(s, msg, len) < 0)
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
+
+  buf = sib_access_create_leave_message(sa->uri, nodeid, msgnumber);
+  if(buf == NULL)
     {
-      whiteboard_log_warning("Could not send message\n");
-      // close (s);
-      Hclose (instance,s);
-      whiteboard_log_debug_fe();
+      whiteboard_log_warning("Could not create Leave message\n");
       return -1;
     }
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_LEAVE, nodeid, msgnumber, MSG_N_LEAVE, buf, func, user_data);
+}
 
-  // close(s);
-  Hclose(instance, s);
-  whiteboard_log_debug_fe();
-  return rbytes;
+gint sib_access_insert_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			     EncodingType encoding, guchar *request,
+			     SIBAccessCompleteFunc func, gpointer user_data)
+{
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
+  g_return_val_if_fail( NULL != request, -1 );
+
+  buf = sib_access_create_insert_message(sa->uri, nodeid, msgnumber, encoding, request);
+  if(buf == NULL)
+    {
+      whiteboard_log_warning("Could not create INSERT message\n");
+      return -1;
+    }
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_INSERT, nodeid, msgnumber, MSG_N_INSERT, buf, func, user_data);
 }
 
-static gint sib_access_subscribe_command(int s, gchar *msg, gint len, NodeMsgContent_t *msgContent)
+gint sib_access_update_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			     EncodingType encoding, guchar *insert_request, guchar *remove_request,
+			     SIBAccessCompleteFunc func, gpointer user_data)
 {
-  gint rbytes = 0;
-  //apr09unused gint rtmp;
-  //apr09unused gboolean finished = FALSE;
-  //apr09unused gint rpos = 0;
-  //apr09unused gboolean close_socket = FALSE;
-  SubData *sdata=NULL;
-  whiteboard_log_debug_fb();
-  sdata = sub_data_new(s);
-  if( sib_access_send_message(s, msg, len) < 0)
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
+  g_return_val_if_fail( NULL != insert_request, -1 );
+  g_return_val_if_fail( NULL != remove_request, -1 );
+
+  buf = sib_access_create_update_message(sa->uri, nodeid, msgnumber, encoding,
+					 insert_request, remove_request);
+  if(buf == NULL)
     {
-      whiteboard_log_warning("Could not send message\n");
-      // close (s);
-      Hclose (instance, s);
-      whiteboard_log_debug_fe();
+      whiteboard_log_warning("Could not create UPDATE message\n");
       return -1;
     }
-  shutdown(s, SHUT_WR); // shutdown write direction.
-  rbytes = sib_access_receive_message(sdata, msgContent);
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_UPDATE, nodeid, msgnumber, MSG_N_UPDATE, buf, func, user_data);
+}
+
+gint sib_access_remove_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			     EncodingType encoding, guchar *request,
+			     SIBAccessCompleteFunc func, gpointer user_data)
+{
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
+  g_return_val_if_fail( NULL != request, -1 );
+
+  buf = sib_access_create_remove_message(sa->uri, nodeid, msgnumber, encoding, request);
+  if(buf == NULL)
+    {
+      whiteboard_log_warning("Could not create REMOVE message\n");
+      return -1;
+    }
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_REMOVE, nodeid, msgnumber, MSG_N_REMOVE, buf, func, user_data);
+}
+
+gint sib_access_query_async(SIBAccess *sa, SIBReactor *reactor, ssElement_ct nodeid, gint msgnumber,
+			    gint type, guchar *request,
+			    SIBAccessCompleteFunc func, gpointer user_data)
+{
+  ssBufDesc_t *buf = NULL;
+  g_return_val_if_fail( NULL != sa, -1);
+  g_return_val_if_fail( NULL != nodeid, -1 );
+  g_return_val_if_fail( NULL != request, -1 );
+
+  buf = sib_access_create_query_message(sa->uri, nodeid, msgnumber, type, request);
+  if(buf == NULL)
+    {
+      whiteboard_log_warning("Could not create QUERY message\n");
+      return -1;
+    }
+  return sib_access_command_async(sa, reactor, SIB_ACCESS_OP_QUERY, nodeid, msgnumber, MSG_N_QUERY, buf, func, user_data);
+}
+
+/**
+ * Send a command and let the reactor receive the confirmation. Frees buf.
+ * Connecting and sending block; the command is small and the SIB reads it
+ * right away, the long wait is for the response. With pipelining the
+ * command is done synchronously on the shared connection.
+ */
+static gint sib_access_command_async(SIBAccess *sa, SIBReactor *reactor, SIBAccessOp op_id,
+				     ssElement_ct nodeid, gint msgnumber, gint name, ssBufDesc_t *buf,
+				     SIBAccessCompleteFunc func, gpointer user_data)
+{
+  const gchar *opname = sib_access_op_names[op_id];
+  AsyncOp *op = NULL;
+  SIBConnection *conn = NULL;
+  int s = -1;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail( NULL != reactor, -1);
+  g_return_val_if_fail( NULL != func, -1);
+
+  if(sa->pipeline != NULL || sib_reactor_get_transport(reactor) != sa->transport)
+    {
+      /* the pipeline already shares one connection between requests, and
+	 the reactor cannot wait on sockets of another transport */
+      NodeMsgContent_t *msg = sib_msgcache_get_parser();
+      gint status = -1;
+      gint rbytes = sib_access_command(sa, op_id, nodeid, msgnumber, ssBufDesc_GetMessage(buf),
+				       ssBufDesc_GetMessageLen(buf), msg);
+      if(rbytes > 0)
+	status = sib_access_check_confirmation(sa, nodeid, name, opname, msg);
+      sib_msgcache_put_builder(&buf);
+      func(sa, status, msg, user_data);
+      sib_msgcache_put_parser(&msg);
+      whiteboard_log_debug_fe();
+      return 0;
+    }
+
+  sib_access_note_write(sa, op_id);
+
+  if(sa->pool != NULL)
+    {
+      conn = sib_access_pooled_send(sa, ssBufDesc_GetMessage(buf), ssBufDesc_GetMessageLen(buf));
+      if(conn == NULL)
+	{
+	  sib_msgcache_put_builder(&buf);
+	  whiteboard_log_debug_fe();
+	  return -1;
+	}
+      s = conn->s;
+    }
+  else
+    {
+      s = sib_access_get_and_connect_socket(sa);
+      if(s < 0)
+	{
+	  whiteboard_log_warning("socket err\n");
+	  sib_msgcache_put_builder(&buf);
+	  whiteboard_log_debug_fe();
+	  return -1;
+	}
+      if( sib_access_send_message(sa, s, ssBufDesc_GetMessage(buf), ssBufDesc_GetMessageLen(buf)) < 0)
+	{
+	  whiteboard_log_warning("Could not send message\n");
+	  sa->transport->close(s);
+	  sib_msgcache_put_builder(&buf);
+	  whiteboard_log_debug_fe();
+	  return -1;
+	}
+      sib_msgcache_put_builder(&buf);
+      sa->transport->shutdown(s, SHUT_WR); // shutdown write direction.
+    }
+
+  op = g_new0(AsyncOp, 1);
+  op->sa = sa;
+  op->sdata = sub_data_new(sa->transport, s, sib_access_recv_hint(sa, op_id));
+  op->reactor = reactor;
+  op->conn = conn;
+  op->buf = (conn != NULL ? buf : NULL);
+  op->op = op_id;
+  op->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  op->name = name;
+  op->msg = sib_msgcache_get_parser();
+  op->status = -1;
+  op->func = func;
+  op->user_data = user_data;
+  sib_access_ref(sa);
+
+  sib_access_async_watch(op);
+
+  whiteboard_log_debug_fe();
+  return 0;
+}
+
+/**
+ * Wait for the response of a sent asynchronous operation in the reactor,
+ * or receive it right away if the socket cannot be watched.
+ */
+static void sib_access_async_watch(AsyncOp *op)
+{
+  const gchar *opname = sib_access_op_names[op->op];
+  gint rbytes = 0;
+
+  if( sib_reactor_add(op->reactor, op->sdata->s, sib_access_async_readable, op, async_op_free) )
+    return;
+
+  /* the request has been sent, so wait for the response here */
+  whiteboard_log_debug("Could not watch %s response, receiving it now\n", opname);
+  rbytes = sib_access_receive_message(op->sdata, op->msg);
+  if( rbytes > 0 )
+    {
+      sib_access_record_response(op->sa, op->op, op->sdata, rbytes);
+      op->status = sib_access_check_confirmation(op->sa, op->nodeid, op->name, opname, op->msg);
+    }
+  else if( op->conn != NULL && sib_access_pooled_stale(op->op, op->conn, op->sdata) )
+    {
+      op->retry = TRUE;
+    }
+  async_op_free(op);
+}
+
+/**
+ * Send an asynchronous query again on another pooled connection,
+ * after the SIB had closed the reused one before responding.
+ *
+ * @return FALSE if it could not be sent, the operation then fails
+ */
+static gboolean sib_access_async_resend(AsyncOp *op)
+{
+  SIBAccess *sa = op->sa;
+
+  whiteboard_log_debug("Reused connection %d was closed, retrying\n", op->conn->s);
+  op->retry = FALSE;
+  sib_connection_pool_checkin(sa->pool, op->conn, FALSE);
+  sub_data_free(op->sdata);
+  op->sdata = NULL;
+
+  op->conn = sib_access_pooled_send(sa, ssBufDesc_GetMessage(op->buf), ssBufDesc_GetMessageLen(op->buf));
+  if(op->conn == NULL)
+    return FALSE;
+
+  op->sdata = sub_data_new(sa->transport, op->conn->s, sib_access_recv_hint(sa, op->op));
+  sib_access_async_watch(op);
+  return TRUE;
+}
+
+/**
+ * Reactor handler of an asynchronous operation. Reads what is available
+ * and stops when the confirmation is complete.
+ */
+static gboolean sib_access_async_readable(int s, gpointer user_data)
+{
+  AsyncOp *op = (AsyncOp *)user_data;
+  SubData *sdata = op->sdata;
+  gint rtmp = 0;
+
+  rtmp = sub_data_recv(sdata);
+  if(rtmp <= 0)
+    {
+      whiteboard_log_debug("Receiving %s response failed (%d)\n", sib_access_op_names[op->op], rtmp);
+      if(op->conn != NULL && sib_access_pooled_stale(op->op, op->conn, sdata))
+	op->retry = TRUE;
+      return FALSE;
+    }
+
+  rtmp = sib_access_parse_buffered(sdata, op->msg);
+  if(rtmp == 0)
+    return TRUE;
+
+  if(rtmp > 0)
+    {
+      sib_access_record_response(op->sa, op->op, sdata, rtmp);
+      op->status = sib_access_check_confirmation(op->sa, op->nodeid, op->name, sib_access_op_names[op->op], op->msg);
+    }
+  return FALSE;
+}
+
+/**
+ * Completes an asynchronous operation. Called by the reactor when the
+ * socket is no longer watched, also if the reactor is destroyed. An
+ * operation whose reused connection was closed is sent again instead.
+ */
+static void async_op_free(gpointer data)
+{
+  AsyncOp *op = (AsyncOp *)data;
+  whiteboard_log_debug_fb();
+
+  if(op->retry && sib_access_async_resend(op))
+    {
+      whiteboard_log_debug_fe();
+      return;
+    }
+
+  sib_access_note_write(op->sa, op->op);
+  if(op->func != NULL)
+    op->func(op->sa, op->status, op->msg, op->user_data);
+
+  if(op->sdata == NULL)
+    {
+      /* resending failed, the connection went back to the pool */
+    }
+  else if(op->conn != NULL)
+    {
+      /* leftover bytes mean the stream is out of sync */
+      sib_connection_pool_checkin(op->sa->pool, op->conn,
+				  (op->status > 0 && op->sdata->remaining_len == 0));
+      sub_data_free(op->sdata); // socket owned by the pool
+    }
+  else
+    {
+      sub_data_free_close(op->sdata);
+    }
+
+  if(op->buf != NULL)
+    sib_msgcache_put_builder(&op->buf);
+  sib_msgcache_put_parser(&op->msg);
+  g_free((gchar *)op->nodeid);
+  sib_access_unref(op->sa);
+  g_free(op);
+  whiteboard_log_debug_fe();
+}
+
+static gint sib_access_command(SIBAccess *sa, SIBAccessOp op, ssElement_ct nodeid, gint msgnumber,
+			       gchar *msg, gint len, NodeMsgContent_t *response)
+{
+  gint rbytes = 0;
+  //apr09unused gint rtmp;
+  //apr09unused gboolean finished = FALSE;
+  //apr09unused gint rpos = 0;
+  SubData *sdata = NULL;
+  int s;
+  whiteboard_log_debug_fb();
+
+  sib_access_note_write(sa, op);
+
+  /* The response is matched to the request by node id and message
+     number, the sib_access_* callers verify the rest */
+  if(sa->pipeline != NULL)
+    {
+      rbytes = sib_pipeline_transact(sa->pipeline, nodeid, msgnumber, msg, len, response);
+      if(rbytes != SIB_PIPELINE_BUSY)
+	{
+	  sib_access_note_write(sa, op);
+	  whiteboard_log_debug_fe();
+	  return rbytes;
+	}
+      whiteboard_log_debug("Request %s/%d already in the pipeline, using own connection\n",
+			   nodeid, msgnumber);
+    }
+
+  if(sa->pool != NULL)
+    {
+      rbytes = sib_access_pooled_command(sa, op, msg, len, response);
+      sib_access_note_write(sa, op);
+      whiteboard_log_debug_fe();
+      return rbytes;
+    }
+
+  s = sib_access_get_and_connect_socket(sa);
+  if(s<0)
+    {
+      whiteboard_log_warning("socket err\n");
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  sdata = sub_data_new(sa->transport, s, sib_access_recv_hint(sa, op));
+
+  if( sib_access_send_message(sa, s, msg, len) < 0)
+    {
+      whiteboard_log_warning("Could not send message\n");
+      sub_data_free_close(sdata);
+      sib_access_note_write(sa, op);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  sa->transport->shutdown(s, SHUT_WR); // shutdown write direction.
+  
+  rbytes = sib_access_receive_message(sdata, response);
+  if(rbytes > 0)
+    sib_access_record_response(sa, op, sdata, rbytes);
+  
+  sub_data_free_close(sdata);// closes socket also
+  sib_access_note_write(sa, op);
+  
+  whiteboard_log_debug_fe();
+  return rbytes;
+}
+
+/**
+ * Send a command over a pooled connection and receive the response.
+ * The connection is not half-closed, the end of the response is
+ * recognized by the parser. If a reused connection turns out to be
+ * closed by the SIB before anything was received, a query is retried on
+ * another connection; other commands fail, see sib_access_pooled_stale().
+ */
+static gint sib_access_pooled_command(SIBAccess *sa, SIBAccessOp op, gchar *msg, gint len,
+				      NodeMsgContent_t *response)
+{
+  gint rbytes = -1;
+  gboolean retry = TRUE;
+  gboolean healthy = FALSE;
+  SIBConnection *conn = NULL;
+  SubData *sdata = NULL;
+  whiteboard_log_debug_fb();
+
+  while(retry)
+    {
+      conn = sib_access_pooled_send(sa, msg, len);
+      if(conn == NULL)
+	{
+	  whiteboard_log_debug_fe();
+	  return -1;
+	}
+
+      sdata = sub_data_new(sa->transport, conn->s, sib_access_recv_hint(sa, op));
+      rbytes = sib_access_receive_message(sdata, response);
+      if(rbytes > 0)
+	sib_access_record_response(sa, op, sdata, rbytes);
+
+      /* Anything left over after the response means the stream is out
+	 of sync, so the connection cannot be reused */
+      healthy = (rbytes > 0 && sdata->remaining_len == 0);
+      retry = (rbytes < 0 && sib_access_pooled_stale(op, conn, sdata));
+      if(retry)
+	whiteboard_log_debug("Reused connection %d was closed, retrying\n", conn->s);
+
+      sib_connection_pool_checkin(sa->pool, conn, healthy);
+      sub_data_free(sdata); // socket owned by the pool
+    }
+
+  whiteboard_log_debug_fe();
+  return rbytes;
+}
+
+/**
+ * Send a command over a pooled connection. A reused connection that
+ * the SIB has closed meanwhile is replaced by another one.
+ *
+ * @return The checked out connection, or NULL if sending failed
+ */
+static SIBConnection *sib_access_pooled_send(SIBAccess *sa, gchar *msg, gint len)
+{
+  SIBConnection *conn = NULL;
+  gboolean reused = FALSE;
+
+  while(TRUE)
+    {
+      conn = sib_connection_pool_checkout(sa->pool);
+      if(conn == NULL)
+	{
+	  whiteboard_log_warning("socket err\n");
+	  return NULL;
+	}
+      if( sib_access_send_message(sa, conn->s, msg, len) >= 0)
+	return conn;
+
+      whiteboard_log_debug("Could not send message on connection %d\n", conn->s);
+      reused = conn->reused;
+      sib_connection_pool_checkin(sa->pool, conn, FALSE);
+      if(!reused)
+	{
+	  whiteboard_log_warning("Could not send message\n");
+	  return NULL;
+	}
+    }
+}
+
+/**
+ * Tells if a command whose response could not be received on a pooled
+ * connection may be sent again: the connection was reused and nothing
+ * came back, so the SIB probably closed it before the command arrived.
+ * It may also have run the command and closed before responding, so
+ * only queries are sent again; a write or a join would be applied twice.
+ */
+static gboolean sib_access_pooled_stale(SIBAccessOp op, SIBConnection *conn, SubData *sdata)
+{
+  return (op == SIB_ACCESS_OP_QUERY && conn->reused && sdata->total == 0);
+}
+
+static gint sib_access_send_command(SIBAccess *sa, int s, gchar *msg, gint len)
+{
+  gint rbytes = 0;
+  whiteboard_log_debug_fb();
+  if( sib_access_send_message(sa, s, msg, len) < 0)
+    {
+      whiteboard_log_warning("Could not send message\n");
+      // close (s);
+      sa->transport->close(s);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  // close(s);
+  sa->transport->close(s);
+  whiteboard_log_debug_fe();
+  return rbytes;
+}
+
+static gint sib_access_subscribe_command(SIBAccess *sa, int s, gchar *msg, gint len,
+					 NodeMsgContent_t *msgContent)
+{
+  gint rbytes = 0;
+  //apr09unused gint rtmp;
+  //apr09unused gboolean finished = FALSE;
+  //apr09unused gint rpos = 0;
+  //apr09unused gboolean close_socket = FALSE;
+  SubData *sdata=NULL;
+  whiteboard_log_debug_fb();
+  sdata = sub_data_new(sa->transport, s, sib_access_recv_hint(sa, SIB_ACCESS_OP_SUBSCRIBE));
+  if( sib_access_send_message(sa, s, msg, len) < 0)
+    {
+      whiteboard_log_warning("Could not send message\n");
+      // close (s);
+      sub_data_free(sdata);
+      sa->transport->close(s);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+  sa->transport->shutdown(s, SHUT_WR); // shutdown write direction.
+  rbytes = sib_access_receive_message(sdata, msgContent);
+  if(rbytes > 0)
+    sib_access_record_response(sa, SIB_ACCESS_OP_SUBSCRIBE, sdata, rbytes);
   if(rbytes < 0)
     sub_data_free_close(sdata); // closes socket also
   else
@@ -925,67 +1562,50 @@ static gint sib_access_subscribe_command(int s, gchar *msg, gint len, NodeMsgCon
 }
 
 
-static gint sib_access_send_message(int s, gchar *buf, gint len)
+static gint sib_access_send_message(SIBAccess *sa, int s, gchar *buf, gint len)
 {
-  gint total = 0;        // how many bytes we've sent
-  gint bytesleft = len; // how many we have left to send
-  gint n;
+  gint rv;
   whiteboard_log_debug_fb();
   whiteboard_log_debug("Sending request: %s", buf);
-  while(total < len)
-    {
-      // n = send(s, buf+total, bytesleft, 0);
-      n = Hsend(instance,s, buf+total, bytesleft, 0);
-      if(n == -1)
-	{
-	  whiteboard_log_debug_fe();
-	  return -1;
-	}
-      total += n;
-      bytesleft -= n;
-    }
+  rv = sib_transport_send_all(sa->transport, s, buf, len);
   whiteboard_log_debug_fe();
-  return 0;
+  return rv;
+}
+
+static int sib_access_pool_connect(gpointer user_data)
+{
+  return sib_access_get_and_connect_socket((SIBAccess *)user_data);
+}
+
+static void sib_access_pool_close(int s, gpointer user_data)
+{
+  ((SIBAccess *)user_data)->transport->close(s);
+}
+
+static gint sib_access_pipeline_send(int s, gchar *buf, gint len, gpointer user_data)
+{
+  return sib_access_send_message((SIBAccess *)user_data, s, buf, len);
+}
+
+static gint sib_access_pipeline_recv(int s, gchar *buf, gint len, gpointer user_data)
+{
+  return ((SIBAccess *)user_data)->transport->recv(s, buf, len);
+}
+
+static void sib_access_pipeline_shutdown(int s, gpointer user_data)
+{
+  ((SIBAccess *)user_data)->transport->shutdown(s, SHUT_RDWR);
 }
 
 static int sib_access_get_and_connect_socket(SIBAccess *sa)
 {
   int sockfd;
-  // struct sockaddr_in sib_addr;
-  nota_addr_t sib_addr = {SID_M3SIB,0};     // at SID 10
-
   whiteboard_log_debug_fb();
   
   g_return_val_if_fail(sa!=NULL, -1);
-  //  g_return_val_if_fail(sa->ip_address!=NULL, -1);
-  
-  // sockfd = socket(PF_INET, SOCK_STREAM, 0); 
-  sockfd = Hsocket(instance, AF_NOTA, SOCK_STREAM, 0); 
-  
-  if(sockfd < 0)
-    {
-      whiteboard_log_warning("Could not open socket\n");
-      whiteboard_log_debug_fe();
-      return -1;
-    }
   
-  /*
-  sib_addr.sin_family = AF_INET;       
-  sib_addr.sin_port = htons(sa->port);   
-  sib_addr.sin_addr.s_addr = inet_addr(sa->ip_address);
-  memset(sib_addr.sin_zero, '\0', sizeof sib_addr.sin_zero);
-  */
+  sockfd = sa->transport->connect(sa->ip_address, sa->port);
   
-  // if( connect( sockfd, (struct sockaddr *)&sib_addr, sizeof(sib_addr)) < 0)
-  if( Hconnect( instance, sockfd, (struct sockaddr *)&sib_addr, sizeof(sib_addr)) < 0)
-    {
-      whiteboard_log_warning("Could not connect socket\n");
-      // close(sockfd);
-      Hclose(instance, sockfd);
-      whiteboard_log_debug_fe();
-      return -1;
-      
-    }
   whiteboard_log_debug_fe();
   
   return sockfd;
@@ -1007,7 +1627,7 @@ static ssBufDesc_t *sib_access_create_join_message(ssElement_ct ssId,
   //apr09obsolete g_return_val_if_fail( node_pk != NULL, NULL);
     
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateJoinMessage(buf,
 						ssId,
 						//apr09obsolete username,
@@ -1017,7 +1637,7 @@ static ssBufDesc_t *sib_access_create_join_message(ssElement_ct ssId,
 						//apr09obsolete accessGroup_req
 						) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
   whiteboard_log_debug_fe();
@@ -1031,10 +1651,10 @@ static ssBufDesc_t *sib_access_create_leave_message(ssElement_ct sibid, ssElemen
   ssBufDesc_t *buf = NULL;
   whiteboard_log_debug_fb();
   g_return_val_if_fail( nodeid!= NULL, NULL);
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateLeaveMessage(buf, sibid, nodeid, msgnumber,TRUE) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
   whiteboard_log_debug_fe();  
@@ -1052,10 +1672,10 @@ static ssBufDesc_t *sib_access_create_insert_message(ssElement_ct sibid,
   g_return_val_if_fail( nodeid != NULL, NULL);
   g_return_val_if_fail( request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateInsertMessage(buf, sibid, nodeid, msgnumber, encoding, request,TRUE) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1072,10 +1692,10 @@ static ssBufDesc_t *sib_access_create_update_message(ssElement_ct sibid, ssEleme
   g_return_val_if_fail( insert_request != NULL, NULL);
   g_return_val_if_fail( remove_request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateUpdateMessage(buf, sibid, nodeid, msgnumber, encoding, insert_request, remove_request, TRUE) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1092,10 +1712,10 @@ static ssBufDesc_t *sib_access_create_remove_message(ssElement_ct sibid, ssEleme
   g_return_val_if_fail( nodeid != NULL, NULL);
   g_return_val_if_fail( request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateRemoveMessage(buf, sibid, nodeid, msgnumber, encoding, request) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1111,10 +1731,10 @@ static ssBufDesc_t *sib_access_create_query_message(ssElement_ct sibid, ssElemen
   g_return_val_if_fail( nodeid != NULL, NULL);
   g_return_val_if_fail( request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateQueryMessage(buf, sibid, nodeid, msgnumber, type, request) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1130,10 +1750,10 @@ ssBufDesc_t *sib_access_create_subscribe_message(ssElement_ct sibid, ssElement_c
   g_return_val_if_fail( nodeid != NULL, NULL);
   g_return_val_if_fail( request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateSubscribeMessage(buf, sibid, nodeid, msgnumber, type, request) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1149,10 +1769,10 @@ static ssBufDesc_t *sib_access_create_unsubscribe_message(ssElement_ct sibid, ss
   g_return_val_if_fail( nodeid != NULL, NULL);
   g_return_val_if_fail( request != NULL, NULL);
 
-  buf = ssBufDesc_new();
+  buf = sib_msgcache_get_builder();
   if(ss_StatusOK != ssBufDesc_CreateUnsubscribeMessage(buf, sibid, nodeid, msgnumber, request) )
     {
-      ssBufDesc_free(&buf);
+      sib_msgcache_put_builder(&buf);
       return NULL;
     }
 
@@ -1160,6 +1780,44 @@ static ssBufDesc_t *sib_access_create_unsubscribe_message(ssElement_ct sibid, ss
   return buf;
 }
 
+/**
+ * Check that a message received on a subscription socket belongs to the
+ * subscription.
+ *
+ * @return 1 for a subscription indication, 0 for an unsubscribe
+ *         confirmation or indication, -2 for any other message
+ */
+static gint sib_access_check_subscription_msg(SIBAccess *sa, ssElement_ct nodeid, guchar *id,
+					      NodeMsgContent_t *msg)
+{
+  if( !g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msg) ) &&
+      !g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msg) ) &&
+      ( parseSSAPmsg_get_name(msg) == MSG_N_SUBSCRIBE ) &&
+      ( parseSSAPmsg_get_type(msg) == MSG_T_IND ) &&
+      !g_ascii_strcasecmp( (gchar *)id, parseSSAPmsg_get_subscriptionid(msg)) )
+    {
+      whiteboard_log_debug("Received subscription indication\n");
+      return 1;
+    }
+  else if  ( !g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msg) ) &&
+	     !g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msg) ) &&
+	     ( parseSSAPmsg_get_name(msg) == MSG_N_UNSUBSCRIBE ) &&
+	     ( ( parseSSAPmsg_get_type(msg) == MSG_T_CNF) ||
+	       ( parseSSAPmsg_get_type(msg) == MSG_T_IND) ) &&
+	     !g_ascii_strcasecmp( (gchar *)id, parseSSAPmsg_get_subscriptionid(msg)) )
+    {
+      whiteboard_log_debug("Received unsubscribe indication/confirmation\n");
+      return 0;
+    }
+
+  whiteboard_log_debug("Not proper subscription indication: To: %s from %s, Name: %d, Type: %d\n",
+		       parseSSAPmsg_get_nodeid( msg),
+		       parseSSAPmsg_get_spaceid(msg),
+		       parseSSAPmsg_get_name(msg),
+		       parseSSAPmsg_get_type(msg) );
+  return -2;
+}
+
 gint sib_access_wait_for_subscription_ind(SIBAccess *sa, ssElement_ct nodeid,  guchar *id,
 					  NodeMsgContent_t *msg)
 {
@@ -1180,36 +1838,21 @@ gint sib_access_wait_for_subscription_ind(SIBAccess *sa, ssElement_ct nodeid,  g
   if( rtmp > 0 )
     {
       whiteboard_log_debug("Handled (%d bytes)\n", rtmp);
+      sib_access_record_response(sa, SIB_ACCESS_OP_INDICATION, sdata, rtmp);
       
-      if( !g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msg) ) &&
-	  !g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msg) ) &&
-	  ( parseSSAPmsg_get_name(msg) == MSG_N_SUBSCRIBE ) &&
-	  ( parseSSAPmsg_get_type(msg) == MSG_T_IND ) &&
-	  !g_ascii_strcasecmp( (gchar *)id, parseSSAPmsg_get_subscriptionid(msg)) )
+      switch( sib_access_check_subscription_msg(sa, nodeid, id, msg) )
 	{
-	  whiteboard_log_debug("Received subscription indication\n");
+	case 1:
 	  rbytes = rtmp;
-	}
-      else if  ( !g_ascii_strcasecmp((char *)nodeid, parseSSAPmsg_get_nodeid( msg) ) &&
-		 !g_ascii_strcasecmp((char *)sa->uri, parseSSAPmsg_get_spaceid( msg) ) &&
-		 ( parseSSAPmsg_get_name(msg) == MSG_N_UNSUBSCRIBE ) &&
-		 ( ( parseSSAPmsg_get_type(msg) == MSG_T_CNF) ||
-		   ( parseSSAPmsg_get_type(msg) == MSG_T_IND) ) &&
-		 !g_ascii_strcasecmp( (gchar *)id, parseSSAPmsg_get_subscriptionid(msg)) )
-	{
-	  whiteboard_log_debug("Received unsubscribe indication/confirmation\n");
+	  break;
+	case 0:
 	  sib_access_remove_subscription_socket(sa,id);
 	  rbytes = rtmp;
-	}
-      else
-	{
-	  whiteboard_log_debug("Not proper subscription indication: To: %s from %s, Name: %d, Type: %d\n",
-			       parseSSAPmsg_get_nodeid( msg),
-			       parseSSAPmsg_get_spaceid(msg),
-			       parseSSAPmsg_get_name(msg),
-			       parseSSAPmsg_get_type(msg) );
+	  break;
+	default:
 	  sib_access_remove_subscription_socket(sa,id);
 	  rbytes = -2;
+	  break;
 	}
     }
   else
@@ -1224,62 +1867,182 @@ gint sib_access_wait_for_subscription_ind(SIBAccess *sa, ssElement_ct nodeid,  g
   return rbytes;
 }
 
+gboolean sib_access_watch_subscription(SIBAccess *sa,
+				       SIBReactor *reactor,
+				       ssElement_ct nodeid,
+				       guchar *id,
+				       SIBAccessSubscriptionFunc func,
+				       gpointer user_data,
+				       GDestroyNotify destroy)
+{
+  SubWatch *watch = NULL;
+  SubData *sdata = NULL;
+  whiteboard_log_debug_fb();
+  g_return_val_if_fail( sa != NULL, FALSE);
+  g_return_val_if_fail( reactor != NULL, FALSE);
+  g_return_val_if_fail( nodeid != NULL, FALSE);
+  g_return_val_if_fail( id != NULL, FALSE);
+  g_return_val_if_fail( func != NULL, FALSE);
+
+  /* the reactor can only wait on sockets of its own transport */
+  if(sib_reactor_get_transport(reactor) != sa->transport)
+    {
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  sdata = sib_access_get_subscription_socket(sa, id);
+  if(sdata == NULL)
+    {
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  watch = g_new0(SubWatch, 1);
+  watch->sa = sa;
+  watch->sdata = sdata;
+  watch->nodeid = (ssElement_ct)g_strdup((gchar *)nodeid);
+  watch->subscription_id = (guchar *)g_strdup((gchar *)id);
+  watch->msg = sib_msgcache_get_parser();
+  watch->func = func;
+  watch->user_data = user_data;
+  watch->destroy = destroy;
+  sib_access_ref(sa);
+
+  if( !sib_reactor_add(reactor, sdata->s, sib_access_subscription_readable, watch, sub_watch_free) )
+    {
+      whiteboard_log_debug("Could not watch subscription %s\n", id);
+      watch->destroy = NULL;
+      sib_msgcache_put_parser(&watch->msg);
+      g_free((gchar *)watch->nodeid);
+      g_free(watch->subscription_id);
+      g_free(watch);
+      sib_access_unref(sa);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
+/**
+ * Reactor handler of a subscription socket. Reads what is available and
+ * passes every completed message to the subscriber.
+ */
+static gboolean sib_access_subscription_readable(int s, gpointer user_data)
+{
+  SubWatch *watch = (SubWatch *)user_data;
+  SubData *sdata = watch->sdata;
+  gint rtmp = 0;
+  gint status = 0;
+  whiteboard_log_debug_fb();
+
+  rtmp = sub_data_recv(sdata);
+  if(rtmp <= 0)
+    {
+      whiteboard_log_debug("Subscription %s closed (%d)\n", watch->subscription_id, rtmp);
+      watch->func(watch->sa, NULL, -1, watch->user_data);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  while( (rtmp = sib_access_parse_buffered(sdata, watch->msg)) != 0 )
+    {
+      if(rtmp < 0)
+	{
+	  watch->func(watch->sa, NULL, -1, watch->user_data);
+	  whiteboard_log_debug_fe();
+	  return FALSE;
+	}
+
+      sib_access_record_response(watch->sa, SIB_ACCESS_OP_INDICATION, sdata, rtmp);
+      status = sib_access_check_subscription_msg(watch->sa, watch->nodeid,
+						 watch->subscription_id, watch->msg);
+      watch->func(watch->sa, (status < 0 ? NULL : watch->msg), status, watch->user_data);
+      sib_msgcache_put_parser(&watch->msg);
+      watch->msg = sib_msgcache_get_parser();
+      if(status <= 0)
+	{
+	  whiteboard_log_debug_fe();
+	  return FALSE;
+	}
+    }
+
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
+static void sub_watch_free(gpointer data)
+{
+  SubWatch *watch = (SubWatch *)data;
+  whiteboard_log_debug_fb();
+
+  /* closes the socket */
+  sib_access_remove_subscription_socket(watch->sa, watch->subscription_id);
+  if(watch->destroy != NULL)
+    watch->destroy(watch->user_data);
+  if(watch->msg != NULL)
+    sib_msgcache_put_parser(&watch->msg);
+  g_free((gchar *)watch->nodeid);
+  g_free(watch->subscription_id);
+  sib_access_unref(watch->sa);
+  g_free(watch);
+  whiteboard_log_debug_fe();
+}
+
+/**
+ * Give the unhandled bytes of the receive buffer to the framer. When the
+ * framer completes a message, the whole message is parsed at once.
+ *
+ * @return Length of the message if it was completed, 0 if more data is
+ *         needed, -1 on parse error
+ */
+static gint sib_access_parse_buffered(SubData *sdata, NodeMsgContent_t *msg)
+{
+  const gchar *frame = NULL;
+  gsize framelen = 0;
+  gsize used = 0;
+  ssStatus_t status;
+
+  if( sdata->remaining_len == 0 )
+    return 0;
+
+  used = sib_framer_feed(sdata->framer,
+			 sdata->recvbuf + sdata->len - sdata->remaining_len,
+			 sdata->remaining_len,
+			 &frame, &framelen);
+  sdata->remaining_len -= used;
+  if(frame == NULL)
+    return 0;
+
+  whiteboard_log_debug("Parsing message; length: %d, remaining_len: %d\n",
+		       (gint)framelen, sdata->remaining_len);
+  status = parseSSAPmsg_section (msg, (gchar *)frame, framelen, 0);
+  if(status == ss_StatusOK)
+    return framelen;
+
+  /* a framed message ends with the end tag, so it must parse completely */
+  whiteboard_log_debug("Parse error %d\n", status);
+  sib_framer_reset(sdata->framer);
+  return -1;
+}
+
 gint sib_access_receive_message( SubData *sdata, NodeMsgContent_t *msg)
 {
   gint rtmp;
   gint bytes_handled = 0;
-  //apr09unused gint tmpbytes = 0;
-  //apr09unused gint bytecountold = 0;
-  gint bytecountnew = 0;
-  ssStatus_t status;
-  gint index = 0;
   gboolean finished = FALSE;
   while(!finished)
     {
-      if( sdata->remaining_len )
+      bytes_handled = sib_access_parse_buffered(sdata, msg);
+      if( bytes_handled != 0 )
 	{
-	  index = sdata->len - sdata->remaining_len;
-	  //bytecountold = parseM3msg_parsedbytecount(msg);
-	  // before first parsed section, parser responds with -1
-	  //if(bytecountold < 0) 
-	  //  bytecountold = 0;
-	  
-	  bytes_handled += sdata->remaining_len;
-	  whiteboard_log_debug("Parsing section; index:%d, remaining_len: %d, bytes_handled: %d\n",
-			       index, sdata->remaining_len, bytes_handled);
-	  
-	  status = parseSSAPmsg_section (msg,
-					 sdata->recvbuf + index,
-					 sdata->remaining_len,
-					 0);
-	  
-	  if(status == ss_StatusOK)
-	    {
-	      gint not_handled;
-	      bytecountnew = parseSSAPmsg_parsedbytecount(msg);
-	      not_handled = bytes_handled - bytecountnew;
-	      whiteboard_log_debug("Parse finished, bytecount (%d), not_handled (%d)\n", bytecountnew, not_handled);
-	      sdata->remaining_len = not_handled;
-	      bytes_handled = bytecountnew;
-	      finished = TRUE;
-	    }
-	  else if(status == ss_ParsingInProgress)
-	    {
-	      sdata->len = 0;
-	      sdata->remaining_len = 0;
-	    }
-	  else
-	    {
-	      whiteboard_log_debug("Parse error %d\n", status);
-	      finished = TRUE;
-	      bytes_handled = -1;
-	    }
+	  finished = TRUE;
 	}
-      
-      if (!finished)
+      else
 	{
-	  // rtmp = recv(sdata->s, sdata->recvbuf, BUF_SIZE, 0);
-	  rtmp = Hrecv(instance, sdata->s, sdata->recvbuf, BUF_SIZE, 0);
+	  rtmp = sub_data_recv(sdata);
 	  if(rtmp < 0)
 	    {
 	      whiteboard_log_warning("receive error\n");
@@ -1291,8 +2054,6 @@ gint sib_access_receive_message( SubData *sdata, NodeMsgContent_t *msg)
 	      gchar *dbg = g_strndup( sdata->recvbuf, rtmp);
 	      whiteboard_log_debug("Received (%d) bytes, len: %d, msg: %s\n", rtmp, sdata->len, dbg);
 	      g_free(dbg);
-	      sdata->len = rtmp;
-	      sdata->remaining_len = rtmp;
 	    }
 	  else
 	    {
@@ -1300,8 +2061,9 @@ gint sib_access_receive_message( SubData *sdata, NodeMsgContent_t *msg)
 	      finished = TRUE;
 	      bytes_handled = -1;
 	    }
+	  if(bytes_handled < 0)
+	    sib_framer_reset(sdata->framer);
 	}
-      
     }
   
   return bytes_handled;
@@ -1317,13 +2079,15 @@ gboolean sib_access_add_subscription_socket(SIBAccess *sa, guchar *subscription_
   g_return_val_if_fail(socket != NULL,FALSE);
 
   whiteboard_log_debug("Trying to add subdata with id (%s)\n", subscription_id);
-  if(sib_access_get_subscription_socket(sa,subscription_id) == NULL)
+  g_mutex_lock(sa->subs_mutex);
+  if(g_hash_table_lookup(sa->subs_sockfd_map, subscription_id) == NULL)
     {
       //      new = g_new0(gint, 1);
       //*new = socket;
       g_hash_table_insert( sa->subs_sockfd_map, g_strdup((gchar *)subscription_id), sdata);
       ret = TRUE;
     }
+  g_mutex_unlock(sa->subs_mutex);
   whiteboard_log_debug_fe();
   return ret;
 }
@@ -1334,10 +2098,12 @@ SubData *sib_access_get_subscription_socket(SIBAccess *sa, guchar *subscription_
   whiteboard_log_debug_fb();
   g_return_val_if_fail(sa != NULL, NULL);
   g_return_val_if_fail(subscription_id!= NULL, NULL);
+  g_mutex_lock(sa->subs_mutex);
   whiteboard_log_debug("Trying to get socket with subscription_id: %s, map size: %d\n",
 		       subscription_id, g_hash_table_size(sa->subs_sockfd_map));
 
   sdata =  g_hash_table_lookup(sa->subs_sockfd_map, subscription_id) ;
+  g_mutex_unlock(sa->subs_mutex);
   if(sdata == NULL)
     {
       whiteboard_log_debug("SData with subscription id: %s not found\n", subscription_id);
@@ -1349,32 +2115,203 @@ SubData *sib_access_get_subscription_socket(SIBAccess *sa, guchar *subscription_
 
 gboolean sib_access_remove_subscription_socket(SIBAccess *sa, guchar *subscription_id)
 {
-  SubData *sdata;
   gboolean retval = FALSE;
    whiteboard_log_debug_fb();
    g_return_val_if_fail(sa != NULL, -1);
    g_return_val_if_fail(subscription_id!= NULL, -1);
-   sdata = sib_access_get_subscription_socket(sa, subscription_id);
-   if (sdata != NULL)
-     {
-       /* Remove the socket from the hash map */
-       retval = g_hash_table_remove(sa->subs_sockfd_map, subscription_id);
-     }
+   g_mutex_lock(sa->subs_mutex);
+   /* Remove the socket from the hash map, closes the socket */
+   retval = g_hash_table_remove(sa->subs_sockfd_map, subscription_id);
+   g_mutex_unlock(sa->subs_mutex);
    whiteboard_log_debug_fe();
    return retval;
 }
 
 
+/**
+ * Size class of a receive buffer in the SubData cache.
+ *
+ * @return The class, -1 if buffers of this size are not cached
+ */
+static gint sub_data_size_class(gint size)
+{
+  gint c;
+  for(c = 0; c < SUB_DATA_CACHE_CLASSES; c++)
+    {
+      if(size == (BUF_SIZE << c))
+	return c;
+    }
+  return -1;
+}
+
+/**
+ * Get the SubData cache of the calling thread. The thread's reference
+ * is dropped when the thread exits.
+ */
+static SubDataCache *sub_data_cache_get(void)
+{
+  SubDataCache *cache = (SubDataCache *)g_static_private_get(&sub_data_cache_key);
+  if(cache == NULL)
+    {
+      cache = g_new0(SubDataCache, 1);
+      cache->refcount = 1;
+      g_static_private_set(&sub_data_cache_key, cache, sub_data_cache_free);
+    }
+  return cache;
+}
+
+/**
+ * Take the SubData other threads have handed back.
+ *
+ * @return The list linked by next, NULL if none
+ */
+static SubData *sub_data_cache_take_remote(SubDataCache *cache)
+{
+  SubData *list = NULL;
+  SubData *sdata = NULL;
+  gint n = 0;
+
+  do
+    list = (SubData *)g_atomic_pointer_get(&cache->remote);
+  while(list != NULL &&
+	!g_atomic_pointer_compare_and_exchange(&cache->remote, list, NULL));
+
+  for(sdata = list; sdata != NULL; sdata = sdata->next)
+    n++;
+  g_atomic_int_add(&cache->remote_count, -n);
+  return list;
+}
+
+/**
+ * Move the SubData other threads have handed back to the free lists.
+ */
+static void sub_data_cache_collect(SubDataCache *cache)
+{
+  SubData *sdata = NULL;
+  SubData *next = NULL;
+  gint c;
+
+  for(sdata = sub_data_cache_take_remote(cache); sdata != NULL; sdata = next)
+    {
+      next = sdata->next;
+      c = sub_data_size_class(sdata->size);
+      if(cache->count[c] < SUB_DATA_CACHE_DEPTH)
+	{
+	  sdata->next = cache->free[c];
+	  cache->free[c] = sdata;
+	  cache->count[c]++;
+	}
+      else
+	{
+	  sub_data_destroy(sdata);
+	}
+    }
+}
+
+/**
+ * Called when a thread exits. The cache itself lives on until the
+ * SubData the thread has taken are freed.
+ */
+static void sub_data_cache_free(gpointer data)
+{
+  SubDataCache *cache = (SubDataCache *)data;
+  SubData *sdata = NULL;
+  gint c;
+
+  for(c = 0; c < SUB_DATA_CACHE_CLASSES; c++)
+    {
+      while( (sdata = cache->free[c]) != NULL )
+	{
+	  cache->free[c] = sdata->next;
+	  sub_data_destroy(sdata);
+	}
+      cache->count[c] = 0;
+    }
+  sub_data_cache_unref(cache);
+}
+
+static void sub_data_cache_unref(SubDataCache *cache)
+{
+  SubData *sdata = NULL;
+  SubData *next = NULL;
+
+  if(!g_atomic_int_dec_and_test(&cache->refcount))
+    return;
+
+  for(sdata = sub_data_cache_take_remote(cache); sdata != NULL; sdata = next)
+    {
+      next = sdata->next;
+      sub_data_destroy(sdata);
+    }
+  g_free(cache);
+}
+
+static void sub_data_destroy(SubData *sdata)
+{
+  if(sdata->recvbuf)
+    g_free(sdata->recvbuf);
+  sib_framer_free(sdata->framer);
+  g_free(sdata);
+}
+
+/*
+ * A SubData is returned to the cache of the thread that took it, also if
+ * another thread frees it; otherwise the caches of threads that only take
+ * SubData would stay empty.
+ */
 void sub_data_free(gpointer data)
 {
   SubData *sdata = (SubData *)data;
+  SubDataCache *owner = NULL;
+  SubData *head = NULL;
+  gint c;
   whiteboard_log_debug_fb();
   g_return_if_fail(sdata != NULL);
 
-  if(sdata->recvbuf)
-    g_free(sdata->recvbuf);
-  
-  g_free(sdata);
+  g_atomic_int_add(&sub_data_in_use, -1);
+  owner = sdata->owner;
+  sdata->owner = NULL;
+  c = sub_data_size_class(sdata->size);
+
+  /* a framer keeps its largest message, do not hold on to that */
+  if(c >= 0 && sib_framer_get_capacity(sdata->framer) > SUB_DATA_FRAMER_MAX)
+    {
+      sib_framer_free(sdata->framer);
+      sdata->framer = sib_framer_new();
+    }
+
+  if(c < 0)
+    {
+      sub_data_destroy(sdata);
+    }
+  else if(owner == (SubDataCache *)g_static_private_get(&sub_data_cache_key))
+    {
+      if(owner->count[c] < SUB_DATA_CACHE_DEPTH)
+	{
+	  sdata->next = owner->free[c];
+	  owner->free[c] = sdata;
+	  owner->count[c]++;
+	}
+      else
+	{
+	  sub_data_destroy(sdata);
+	}
+    }
+  else if(g_atomic_int_exchange_and_add(&owner->remote_count, 1) < SUB_DATA_CACHE_REMOTE)
+    {
+      do
+	{
+	  head = (SubData *)g_atomic_pointer_get(&owner->remote);
+	  sdata->next = head;
+	}
+      while(!g_atomic_pointer_compare_and_exchange(&owner->remote, head, sdata));
+    }
+  else
+    {
+      g_atomic_int_add(&owner->remote_count, -1);
+      sub_data_destroy(sdata);
+    }
+  sub_data_cache_unref(owner);
   
   whiteboard_log_debug_fe();
 }
@@ -1386,21 +2323,151 @@ void sub_data_free_close(gpointer data)
   g_return_if_fail(sdata != NULL);
   
   // close(sdata->s);
-  Hclose(instance, sdata->s);
+  sdata->transport->close(sdata->s);
   sub_data_free(sdata);
   
   whiteboard_log_debug_fe();
 }
 
-static SubData *sub_data_new(int s)
+/**
+ * Get a SubData with a receive buffer of the given size, from the
+ * calling thread's cache if possible. The buffer is not cleared.
+ */
+static SubData *sub_data_new(const SIBTransport *transport, int s, gint size)
 {
   SubData *self = NULL;
+  SubDataCache *cache = NULL;
+  gint c;
+  gint in_use;
+  gint peak;
   whiteboard_log_debug_fb();
-  self = g_new0(SubData, 1);
+
+  g_atomic_int_inc(&sub_data_requests);
+  cache = sub_data_cache_get();
+  c = sub_data_size_class(size);
+  if(c >= 0)
+    {
+      if(cache->free[c] == NULL)
+	sub_data_cache_collect(cache);
+      self = cache->free[c];
+    }
+
+  if(self != NULL)
+    {
+      cache->free[c] = self->next;
+      cache->count[c]--;
+      g_atomic_int_inc(&sub_data_hits);
+      self->full = FALSE;
+      self->recvs = 0;
+      self->grows = 0;
+      sib_framer_reset(self->framer);
+    }
+  else
+    {
+      self = g_new0(SubData, 1);
+      self->size = size;
+      self->recvbuf = g_new(gchar, size);
+      self->framer = sib_framer_new();
+    }
+  self->transport = transport;
   self->s = s;
-  self->recvbuf = g_new0(gchar, BUF_SIZE);
   self->len = 0;
   self->remaining_len = 0;
+  self->total = 0;
+  self->next = NULL;
+  self->owner = cache;
+  g_atomic_int_inc(&cache->refcount);
+
+  in_use = g_atomic_int_exchange_and_add(&sub_data_in_use, 1) + 1;
+  do
+    {
+      peak = g_atomic_int_get(&sub_data_peak);
+    }
+  while(in_use > peak && !g_atomic_int_compare_and_exchange(&sub_data_peak, peak, in_use));
+
   whiteboard_log_debug_fe();
   return self;
 }
+
+/**
+ * Receive into the buffer of a SubData. Must only be called when the
+ * previous data has been parsed. If the previous receive filled the
+ * buffer, the buffer is doubled first.
+ *
+ * @return Bytes received, 0 on end of stream, negative on error
+ */
+static gint sub_data_recv(SubData *sdata)
+{
+  gint rtmp;
+
+  if(sdata->full && sdata->size < RECV_BUF_MAX)
+    {
+      sdata->size = MIN(sdata->size * 2, RECV_BUF_MAX);
+      g_free(sdata->recvbuf);
+      sdata->recvbuf = g_new(gchar, sdata->size);
+      sdata->grows++;
+    }
+
+  // rtmp = recv(sdata->s, sdata->recvbuf, sdata->size, 0);
+  rtmp = sdata->transport->recv(sdata->s, sdata->recvbuf, sdata->size);
+  sdata->recvs++;
+  if(rtmp > 0)
+    {
+      sdata->len = rtmp;
+      sdata->remaining_len = rtmp;
+      sdata->total += rtmp;
+      sdata->full = (rtmp == sdata->size);
+    }
+  return rtmp;
+}
+
+/**
+ * Change the write generation if op modifies the SIB. Called when a write
+ * starts and again when it completes, so that a query overlapping the
+ * write in any way sees a different generation before and after it.
+ */
+static void sib_access_note_write(SIBAccess *sa, SIBAccessOp op)
+{
+  if(op == SIB_ACCESS_OP_INSERT || op == SIB_ACCESS_OP_UPDATE || op == SIB_ACCESS_OP_REMOVE)
+    g_atomic_int_inc(&sa->write_generation);
+}
+
+/**
+ * Initial receive buffer size for a response to the given operation.
+ */
+static gint sib_access_recv_hint(SIBAccess *sa, SIBAccessOp op)
+{
+  gint hint;
+  g_mutex_lock(sa->recv_mutex);
+  hint = sa->recv_history[op].hint;
+  g_mutex_unlock(sa->recv_mutex);
+  return hint;
+}
+
+/**
+ * Record the size of a received response. The next buffer for the
+ * operation is big enough for it, rounded up to a power of two. After
+ * smaller responses the size decays by half per response, so one huge
+ * result does not pin a huge buffer.
+ */
+static void sib_access_record_response(SIBAccess *sa, SIBAccessOp op, SubData *sdata, gint bytes)
+{
+  RecvHistory *h = NULL;
+  gint size = BUF_SIZE;
+
+  while(size < bytes && size < RECV_BUF_MAX)
+    size *= 2;
+
+  g_mutex_lock(sa->recv_mutex);
+  h = &sa->recv_history[op];
+  h->responses++;
+  h->bytes += bytes;
+  h->max_bytes = MAX(h->max_bytes, bytes);
+  h->recvs += sdata->recvs;
+  h->grows += sdata->grows;
+  h->hint = MAX(size, MAX(h->hint / 2, BUF_SIZE));
+  g_mutex_unlock(sa->recv_mutex);
+
+  sdata->recvs = 0;
+  sdata->grows = 0;
+}
@@ -0,0 +1,162 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_arena.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_arena.h"
+
+/** An additional block, its data follows */
+typedef struct _SIBArenaBlock
+{
+  struct _SIBArenaBlock *next;
+} SIBArenaBlock;
+
+/** The first block's data follows */
+struct _SIBArena
+{
+  SIBArenaBlock *blocks;
+  gchar *pos;
+  gchar *end;
+};
+
+#define SIB_ARENA_HEADER SIB_ARENA_SIZE(sizeof(SIBArena))
+#define SIB_ARENA_BLOCK_HEADER SIB_ARENA_SIZE(sizeof(SIBArenaBlock))
+
+static volatile gint sib_arena_arenas = 0;
+static volatile gint sib_arena_blocks = 0;
+static volatile gint sib_arena_allocs = 0;
+
+SIBArena *sib_arena_new(gsize size)
+{
+  SIBArena *self = NULL;
+
+  size = SIB_ARENA_SIZE(size);
+  self = (SIBArena *)g_malloc(SIB_ARENA_HEADER + size);
+  self->blocks = NULL;
+  self->pos = (gchar *)self + SIB_ARENA_HEADER;
+  self->end = self->pos + size;
+
+  g_atomic_int_inc(&sib_arena_arenas);
+  g_atomic_int_inc(&sib_arena_blocks);
+
+  return self;
+}
+
+void sib_arena_free(SIBArena *self)
+{
+  SIBArenaBlock *block = NULL;
+
+  g_return_if_fail(self != NULL);
+
+  while (self->blocks != NULL)
+    {
+      block = self->blocks;
+      self->blocks = block->next;
+      g_free(block);
+    }
+  g_free(self);
+}
+
+gpointer sib_arena_alloc(SIBArena *self, gsize size)
+{
+  SIBArenaBlock *block = NULL;
+  gpointer mem = NULL;
+  gsize blocksize;
+
+  g_return_val_if_fail(self != NULL, NULL);
+
+  size = SIB_ARENA_SIZE(size);
+  if ((gsize)(self->end - self->pos) < size)
+    {
+      blocksize = MAX(size, SIB_ARENA_BLOCK_SIZE);
+      block = (SIBArenaBlock *)g_malloc(SIB_ARENA_BLOCK_HEADER + blocksize);
+      block->next = self->blocks;
+      self->blocks = block;
+      self->pos = (gchar *)block + SIB_ARENA_BLOCK_HEADER;
+      self->end = self->pos + blocksize;
+      g_atomic_int_inc(&sib_arena_blocks);
+    }
+
+  mem = self->pos;
+  self->pos += size;
+  g_atomic_int_inc(&sib_arena_allocs);
+
+  return mem;
+}
+
+gpointer sib_arena_alloc0(SIBArena *self, gsize size)
+{
+  gpointer mem = sib_arena_alloc(self, size);
+
+  if (mem != NULL)
+    memset(mem, 0, size);
+  return mem;
+}
+
+gchar *sib_arena_strdup(SIBArena *self, const gchar *str)
+{
+  gchar *copy = NULL;
+  gsize len;
+
+  if (str == NULL)
+    return NULL;
+
+  len = strlen(str) + 1;
+  copy = (gchar *)sib_arena_alloc(self, len);
+  if (copy != NULL)
+    memcpy(copy, str, len);
+  return copy;
+}
+
+void sib_arena_get_stats(SIBArenaStats *stats)
+{
+  g_return_if_fail(stats != NULL);
+
+  stats->arenas = g_atomic_int_get(&sib_arena_arenas);
+  stats->blocks = g_atomic_int_get(&sib_arena_blocks);
+  stats->allocs = g_atomic_int_get(&sib_arena_allocs);
+}
@@ -0,0 +1,288 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_batch.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+
+#include "sib_batch.h"
+
+/*
+ * A batch is freed by its window timeout, also when it was handed on
+ * earlier, so the timeout never sees a freed batch.
+ */
+typedef struct _SIBBatch
+{
+  SIBBatcher *batcher;
+  gchar *key;
+  GSList *items;    /* newest first */
+  guint count;
+  gsize size;
+  gboolean done;    /* handed on, no longer in the batcher */
+} SIBBatch;
+
+struct _SIBBatcher
+{
+  GMutex *mutex;
+  GHashTable *batches;  /* key -> SIBBatch */
+  guint window;
+  gsize max_size;
+  guint max_items;
+  SIBBatchFunc func;
+  gpointer user_data;
+  guint timeouts;       /* batches whose window has not ended */
+  gboolean destroyed;
+  SIBBatchStats stats;
+};
+
+static gboolean sib_batch_timeout(gpointer data);
+
+static GSList *sib_batch_take(SIBBatcher *self, SIBBatch *batch, gboolean early);
+
+static void sib_batch_collect(gpointer key, gpointer value, gpointer user_data);
+
+SIBBatcher *sib_batcher_new(guint window,
+			    gsize max_size,
+			    guint max_items,
+			    SIBBatchFunc func,
+			    gpointer user_data)
+{
+  SIBBatcher *self = NULL;
+
+  g_return_val_if_fail(func != NULL, NULL);
+
+  self = g_new0(SIBBatcher, 1);
+  self->mutex = g_mutex_new();
+  self->batches = g_hash_table_new(g_str_hash, g_str_equal);
+  self->window = window;
+  self->max_size = max_size;
+  self->max_items = MAX(1, max_items);
+  self->func = func;
+  self->user_data = user_data;
+  return self;
+}
+
+void sib_batcher_destroy(SIBBatcher *self)
+{
+  GSList *batches = NULL;
+  GSList *ready = NULL;
+  GSList *l = NULL;
+  gboolean free_now = FALSE;
+
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  g_hash_table_foreach(self->batches, sib_batch_collect, &batches);
+  for (l = batches; l != NULL; l = l->next)
+    ready = g_slist_prepend(ready, sib_batch_take(self, (SIBBatch *)l->data, FALSE));
+  self->destroyed = TRUE;
+  free_now = (self->timeouts == 0);
+  g_mutex_unlock(self->mutex);
+  g_slist_free(batches);
+
+  for (l = ready; l != NULL; l = l->next)
+    self->func((GSList *)l->data, self->user_data);
+  g_slist_free(ready);
+
+  if (free_now)
+    {
+      g_hash_table_destroy(self->batches);
+      g_mutex_free(self->mutex);
+      g_free(self);
+    }
+}
+
+gboolean sib_batcher_add(SIBBatcher *self,
+			 const gchar *key,
+			 gpointer item,
+			 gsize size)
+{
+  SIBBatch *batch = NULL;
+  GSList *full = NULL;
+  GSList *ready = NULL;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(key != NULL, FALSE);
+
+  if (size > self->max_size)
+    return FALSE;
+
+  g_mutex_lock(self->mutex);
+  if (self->destroyed)
+    {
+      g_mutex_unlock(self->mutex);
+      return FALSE;
+    }
+
+  batch = (SIBBatch *)g_hash_table_lookup(self->batches, key);
+  if (batch != NULL && batch->size + size > self->max_size)
+    {
+      full = sib_batch_take(self, batch, TRUE);
+      batch = NULL;
+    }
+
+  if (batch == NULL)
+    {
+      batch = g_new0(SIBBatch, 1);
+      batch->batcher = self;
+      batch->key = g_strdup(key);
+      g_hash_table_insert(self->batches, batch->key, batch);
+      self->timeouts++;
+      g_timeout_add(self->window, sib_batch_timeout, batch);
+    }
+
+  batch->items = g_slist_prepend(batch->items, item);
+  batch->count++;
+  batch->size += size;
+  self->stats.waiting++;
+
+  if (batch->count >= self->max_items)
+    ready = sib_batch_take(self, batch, TRUE);
+  g_mutex_unlock(self->mutex);
+
+  /* the older batch first, so a key's items are handed on in order */
+  if (full != NULL)
+    self->func(full, self->user_data);
+  if (ready != NULL)
+    self->func(ready, self->user_data);
+
+  return TRUE;
+}
+
+void sib_batcher_flush(SIBBatcher *self, const gchar *key)
+{
+  SIBBatch *batch = NULL;
+  GSList *items = NULL;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(key != NULL);
+
+  g_mutex_lock(self->mutex);
+  batch = (SIBBatch *)g_hash_table_lookup(self->batches, key);
+  if (batch != NULL)
+    items = sib_batch_take(self, batch, TRUE);
+  g_mutex_unlock(self->mutex);
+
+  if (items != NULL)
+    self->func(items, self->user_data);
+}
+
+void sib_batcher_get_stats(SIBBatcher *self, SIBBatchStats *stats)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_mutex_lock(self->mutex);
+  *stats = self->stats;
+  g_mutex_unlock(self->mutex);
+}
+
+/**
+ * End the window of a batch: hand it on if it is still waiting, and free
+ * it.
+ *
+ * @param data The batch
+ * @return FALSE to remove the timeout
+ */
+static gboolean sib_batch_timeout(gpointer data)
+{
+  SIBBatch *batch = (SIBBatch *)data;
+  SIBBatcher *self = batch->batcher;
+  GSList *items = NULL;
+  gboolean free_self = FALSE;
+
+  g_mutex_lock(self->mutex);
+  if (!batch->done)
+    items = sib_batch_take(self, batch, FALSE);
+  self->timeouts--;
+  free_self = (self->destroyed && self->timeouts == 0);
+  g_mutex_unlock(self->mutex);
+
+  if (items != NULL)
+    self->func(items, self->user_data);
+
+  g_free(batch->key);
+  g_free(batch);
+
+  if (free_self)
+    {
+      g_hash_table_destroy(self->batches);
+      g_mutex_free(self->mutex);
+      g_free(self);
+    }
+
+  return FALSE;
+}
+
+/**
+ * Remove a batch from the batcher. Called with the lock held.
+ *
+ * @param self The batcher
+ * @param batch The batch, freed by its timeout
+ * @param early Whether the batch is handed on before its window ended
+ * @return The items in the order they were added
+ */
+static GSList *sib_batch_take(SIBBatcher *self, SIBBatch *batch, gboolean early)
+{
+  GSList *items = NULL;
+
+  g_hash_table_remove(self->batches, batch->key);
+  batch->done = TRUE;
+  items = g_slist_reverse(batch->items);
+  batch->items = NULL;
+
+  self->stats.batches++;
+  self->stats.items += batch->count;
+  self->stats.max_batch = MAX(self->stats.max_batch, batch->count);
+  self->stats.waiting -= batch->count;
+  if (early)
+    self->stats.early++;
+
+  return items;
+}
+
+static void sib_batch_collect(gpointer key, gpointer value, gpointer user_data)
+{
+  GSList **batches = (GSList **)user_data;
+  *batches = g_slist_prepend(*batches, value);
+}
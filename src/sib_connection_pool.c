@@ -0,0 +1,356 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_connection_pool.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_connection_pool.h"
+
+struct _SIBConnectionPool
+{
+  GMutex *mutex;
+
+  /* idle connections, most recently used first */
+  GList *idle;
+  guint idle_count;
+  guint in_use;
+
+  guint max_idle;
+  guint idle_timeout;
+
+  SIBConnectionPoolConnectFunc connect;
+  SIBConnectionPoolCloseFunc close;
+  gpointer user_data;
+
+  /* set when reused connections keep failing, i.e. the SIB closes the
+     connection after each response */
+  gboolean reuse_disabled;
+  guint consecutive_reuse_failures;
+  gboolean reuse_succeeded;
+
+  SIBConnectionPoolStats stats;
+
+  /* for connect rate calculation */
+  GTimeVal sample_time;
+  guint sample_connects;
+};
+
+/*****************************************************************************
+ * Private utilities
+ *****************************************************************************/
+
+static glong sib_connection_pool_elapsed(GTimeVal *since, GTimeVal *now)
+{
+  return (now->tv_sec - since->tv_sec);
+}
+
+static void sib_connection_pool_close(SIBConnectionPool *self, SIBConnection *conn)
+{
+  self->close(conn->s, self->user_data);
+  g_free(conn);
+}
+
+/**
+ * Remove timed out connections from the idle list. Must be called with
+ * the pool locked. Returns the removed connections, which must be closed
+ * after the pool is unlocked.
+ */
+static GList *sib_connection_pool_take_expired(SIBConnectionPool *self, GTimeVal *now)
+{
+  GList *item = NULL;
+  GList *next = NULL;
+  GList *expired = NULL;
+
+  for(item = self->idle; item != NULL; item = next)
+    {
+      SIBConnection *conn = (SIBConnection *)item->data;
+      next = item->next;
+      if( sib_connection_pool_elapsed(&conn->last_used, now) >= (glong)self->idle_timeout )
+	{
+	  self->idle = g_list_remove_link(self->idle, item);
+	  expired = g_list_concat(item, expired);
+	  self->idle_count--;
+	  self->stats.evictions++;
+	}
+    }
+  return expired;
+}
+
+static void sib_connection_pool_close_list(SIBConnectionPool *self, GList *list)
+{
+  GList *item = NULL;
+  for(item = list; item != NULL; item = item->next)
+    {
+      sib_connection_pool_close(self, (SIBConnection *)item->data);
+    }
+  g_list_free(list);
+}
+
+/*****************************************************************************
+ * Construction/destruction
+ *****************************************************************************/
+
+SIBConnectionPool *sib_connection_pool_new(guint max_idle,
+					   guint idle_timeout,
+					   SIBConnectionPoolConnectFunc connect,
+					   SIBConnectionPoolCloseFunc close,
+					   gpointer user_data)
+{
+  SIBConnectionPool *self = NULL;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(connect != NULL, NULL);
+  g_return_val_if_fail(close != NULL, NULL);
+
+  self = g_new0(SIBConnectionPool, 1);
+  self->mutex = g_mutex_new();
+  self->max_idle = max_idle;
+  self->idle_timeout = idle_timeout;
+  self->connect = connect;
+  self->close = close;
+  self->user_data = user_data;
+  g_get_current_time(&self->sample_time);
+
+  whiteboard_log_debug_fe();
+  return self;
+}
+
+void sib_connection_pool_destroy(SIBConnectionPool *self)
+{
+  whiteboard_log_debug_fb();
+  g_return_if_fail(self != NULL);
+
+  if(self->in_use > 0)
+    {
+      whiteboard_log_warning("Destroying connection pool with %d connections in use\n",
+			     self->in_use);
+    }
+
+  sib_connection_pool_close_list(self, self->idle);
+  self->idle = NULL;
+
+  g_mutex_free(self->mutex);
+  g_free(self);
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Checkout/checkin
+ *****************************************************************************/
+
+SIBConnection *sib_connection_pool_checkout(SIBConnectionPool *self)
+{
+  SIBConnection *conn = NULL;
+  GList *expired = NULL;
+  GTimeVal now;
+  int s;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(self != NULL, NULL);
+
+  g_get_current_time(&now);
+
+  g_mutex_lock(self->mutex);
+  expired = sib_connection_pool_take_expired(self, &now);
+  if(self->idle != NULL)
+    {
+      conn = (SIBConnection *)self->idle->data;
+      self->idle = g_list_delete_link(self->idle, self->idle);
+      self->idle_count--;
+      self->in_use++;
+      self->stats.hits++;
+    }
+  else
+    {
+      self->stats.misses++;
+    }
+  g_mutex_unlock(self->mutex);
+
+  sib_connection_pool_close_list(self, expired);
+
+  if(conn != NULL)
+    {
+      conn->reused = TRUE;
+      whiteboard_log_debug("Reusing connection %d (%d uses)\n", conn->s, conn->uses);
+      whiteboard_log_debug_fe();
+      return conn;
+    }
+
+  /* No idle connection, open a new one outside the lock */
+  s = self->connect(self->user_data);
+
+  g_mutex_lock(self->mutex);
+  if(s < 0)
+    {
+      self->stats.connect_failures++;
+    }
+  else
+    {
+      self->stats.connects++;
+      self->in_use++;
+    }
+  g_mutex_unlock(self->mutex);
+
+  if(s < 0)
+    {
+      whiteboard_log_debug_fe();
+      return NULL;
+    }
+
+  conn = g_new0(SIBConnection, 1);
+  conn->s = s;
+  conn->reused = FALSE;
+  conn->last_used = now;
+
+  whiteboard_log_debug_fe();
+  return conn;
+}
+
+void sib_connection_pool_checkin(SIBConnectionPool *self,
+				 SIBConnection *conn,
+				 gboolean healthy)
+{
+  gboolean keep = FALSE;
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(conn != NULL);
+
+  g_get_current_time(&conn->last_used);
+
+  g_mutex_lock(self->mutex);
+  self->in_use--;
+
+  if(conn->reused)
+    {
+      if(healthy)
+	{
+	  self->reuse_succeeded = TRUE;
+	  self->consecutive_reuse_failures = 0;
+	}
+      else
+	{
+	  self->stats.reuse_failures++;
+	  self->consecutive_reuse_failures++;
+	  if( !self->reuse_succeeded &&
+	      !self->reuse_disabled &&
+	      self->consecutive_reuse_failures >= SIB_CONNECTION_POOL_MAX_REUSE_FAILURES )
+	    {
+	      whiteboard_log_warning("SIB does not keep connections open, disabling connection reuse\n");
+	      self->reuse_disabled = TRUE;
+	    }
+	}
+    }
+
+  if(!healthy)
+    {
+      self->stats.discards++;
+    }
+  else if(!self->reuse_disabled && self->idle_count < self->max_idle)
+    {
+      conn->uses++;
+      self->idle = g_list_prepend(self->idle, conn);
+      self->idle_count++;
+      keep = TRUE;
+    }
+  g_mutex_unlock(self->mutex);
+
+  if(!keep)
+    {
+      sib_connection_pool_close(self, conn);
+    }
+  whiteboard_log_debug_fe();
+}
+
+guint sib_connection_pool_evict_idle(SIBConnectionPool *self)
+{
+  GList *expired = NULL;
+  guint count = 0;
+  GTimeVal now;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(self != NULL, 0);
+
+  g_get_current_time(&now);
+
+  g_mutex_lock(self->mutex);
+  expired = sib_connection_pool_take_expired(self, &now);
+  g_mutex_unlock(self->mutex);
+
+  count = g_list_length(expired);
+  sib_connection_pool_close_list(self, expired);
+
+  whiteboard_log_debug_fe();
+  return count;
+}
+
+void sib_connection_pool_get_stats(SIBConnectionPool *self,
+				   SIBConnectionPoolStats *stats)
+{
+  GTimeVal now;
+  gdouble elapsed;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_get_current_time(&now);
+
+  g_mutex_lock(self->mutex);
+  *stats = self->stats;
+  stats->idle = self->idle_count;
+  stats->in_use = self->in_use;
+  stats->reuse_disabled = self->reuse_disabled;
+
+  elapsed = (now.tv_sec - self->sample_time.tv_sec) +
+    (now.tv_usec - self->sample_time.tv_usec) / (gdouble)G_USEC_PER_SEC;
+  if(elapsed > 0)
+    stats->connects_per_sec = (self->stats.connects - self->sample_connects) / elapsed;
+  else
+    stats->connects_per_sec = 0;
+
+  self->sample_time = now;
+  self->sample_connects = self->stats.connects;
+  g_mutex_unlock(self->mutex);
+}
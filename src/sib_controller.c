@@ -279,8 +279,11 @@ static gboolean sib_controller_search_timeout( gpointer user_data)
 /*       udn = g_strdup(LOCAL_UDN); */
 /*       servercount++;  */
 /*     } */
-  //ssdata->ip = g_strdup(SIB_IP); 
-  //   ssdata->port = SIB_PORT; 
+#ifdef SIB_IP
+  /* the SIB is reached over TCP/IP, see sib_transport_for_address() */
+  ssdata->ip = g_strdup(SIB_IP);
+  ssdata->port = SIB_PORT;
+#endif
        ssdata->name = (guchar *)g_strdup(TEST_NAME); 
        ssdata->uri = (guchar *)g_strdup(TEST_UDN); 
   
@@ -0,0 +1,296 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_delta.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <string.h>
+
+#include "sib_delta.h"
+#include "sib_triple.h"
+
+/* Triples in the order they were first changed, with an index */
+typedef struct _SIBDeltaSet
+{
+  GQueue *order;       /* SIBTriple */
+  GHashTable *index;   /* SIBTriple -> GList link in order */
+} SIBDeltaSet;
+
+struct _SIBDelta
+{
+  SIBDeltaSet inserted;
+  SIBDeltaSet removed;
+  guint triples;       /* triple changes added */
+};
+
+static volatile gint sib_delta_deltas = 0;
+static volatile gint sib_delta_triples = 0;
+static volatile gint sib_delta_eliminated = 0;
+
+static void sib_delta_set_init(SIBDeltaSet *set);
+
+static void sib_delta_set_clear(SIBDeltaSet *set);
+
+static gboolean sib_delta_set_add(SIBDeltaSet *set, SIBTriple *triple);
+
+static gboolean sib_delta_set_drop(SIBDeltaSet *set, const SIBTriple *triple);
+
+static void sib_delta_set_drop_matching(SIBDeltaSet *set, const SIBTriple *pattern);
+
+static gchar *sib_delta_set_render(SIBDeltaSet *set);
+
+static GSList *sib_delta_parse(SIBDelta *self, const gchar *triples, GError **error);
+
+static gboolean sib_delta_is_pattern(const SIBTriple *triple);
+
+SIBDelta *sib_delta_new(void)
+{
+  SIBDelta *self = g_new0(SIBDelta, 1);
+  sib_delta_set_init(&self->inserted);
+  sib_delta_set_init(&self->removed);
+  return self;
+}
+
+void sib_delta_free(SIBDelta *self)
+{
+  g_return_if_fail(self != NULL);
+
+  sib_delta_set_clear(&self->inserted);
+  sib_delta_set_clear(&self->removed);
+  g_free(self);
+}
+
+gboolean sib_delta_insert(SIBDelta *self, const gchar *triples, GError **error)
+{
+  GError *parse_error = NULL;
+  GSList *list = NULL;
+  GSList *l = NULL;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(triples != NULL, FALSE);
+
+  list = sib_delta_parse(self, triples, &parse_error);
+  if (parse_error != NULL)
+    {
+      g_propagate_error(error, parse_error);
+      return FALSE;
+    }
+
+  for (l = list; l != NULL; l = l->next)
+    {
+      SIBTriple *triple = (SIBTriple *)l->data;
+      /* removed earlier and inserted again: only the insert is needed */
+      sib_delta_set_drop(&self->removed, triple);
+      if (!sib_delta_set_add(&self->inserted, triple))
+	sib_triple_free(triple);
+    }
+  g_slist_free(list);
+
+  return TRUE;
+}
+
+gboolean sib_delta_remove(SIBDelta *self, const gchar *triples, GError **error)
+{
+  GError *parse_error = NULL;
+  GSList *list = NULL;
+  GSList *l = NULL;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(triples != NULL, FALSE);
+
+  list = sib_delta_parse(self, triples, &parse_error);
+  if (parse_error != NULL)
+    {
+      g_propagate_error(error, parse_error);
+      return FALSE;
+    }
+
+  for (l = list; l != NULL; l = l->next)
+    {
+      SIBTriple *triple = (SIBTriple *)l->data;
+      /* the remove is kept even if the triple was only inserted here: it
+	 may have been in the SIB before */
+      if (sib_delta_is_pattern(triple))
+	sib_delta_set_drop_matching(&self->inserted, triple);
+      else
+	sib_delta_set_drop(&self->inserted, triple);
+      if (!sib_delta_set_add(&self->removed, triple))
+	sib_triple_free(triple);
+    }
+  g_slist_free(list);
+
+  return TRUE;
+}
+
+void sib_delta_finish(SIBDelta *self, gchar **inserted, gchar **removed)
+{
+  guint sent;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(inserted != NULL);
+  g_return_if_fail(removed != NULL);
+
+  sent = g_queue_get_length(self->inserted.order) +
+    g_queue_get_length(self->removed.order);
+  g_atomic_int_inc(&sib_delta_deltas);
+  g_atomic_int_add(&sib_delta_triples, self->triples);
+  g_atomic_int_add(&sib_delta_eliminated, self->triples - sent);
+
+  *inserted = sib_delta_set_render(&self->inserted);
+  *removed = sib_delta_set_render(&self->removed);
+  sib_delta_free(self);
+}
+
+void sib_delta_get_stats(SIBDeltaStats *stats)
+{
+  g_return_if_fail(stats != NULL);
+
+  stats->deltas = g_atomic_int_get(&sib_delta_deltas);
+  stats->triples = g_atomic_int_get(&sib_delta_triples);
+  stats->eliminated = g_atomic_int_get(&sib_delta_eliminated);
+}
+
+static void sib_delta_set_init(SIBDeltaSet *set)
+{
+  set->order = g_queue_new();
+  set->index = g_hash_table_new(sib_triple_hash, sib_triple_equal);
+}
+
+static void sib_delta_set_clear(SIBDeltaSet *set)
+{
+  GList *l = NULL;
+
+  for (l = set->order->head; l != NULL; l = l->next)
+    sib_triple_free((SIBTriple *)l->data);
+  g_queue_free(set->order);
+  g_hash_table_destroy(set->index);
+}
+
+/**
+ * Add a triple to a set.
+ *
+ * @return FALSE if the set has the triple already, triple is not taken
+ */
+static gboolean sib_delta_set_add(SIBDeltaSet *set, SIBTriple *triple)
+{
+  if (g_hash_table_lookup(set->index, triple) != NULL)
+    return FALSE;
+
+  g_queue_push_tail(set->order, triple);
+  g_hash_table_insert(set->index, triple, set->order->tail);
+  return TRUE;
+}
+
+/**
+ * Remove a triple from a set.
+ *
+ * @return FALSE if the set does not have the triple
+ */
+static gboolean sib_delta_set_drop(SIBDeltaSet *set, const SIBTriple *triple)
+{
+  GList *link = (GList *)g_hash_table_lookup(set->index, triple);
+  SIBTriple *member = NULL;
+
+  if (link == NULL)
+    return FALSE;
+
+  member = (SIBTriple *)link->data;
+  g_hash_table_remove(set->index, member);
+  g_queue_delete_link(set->order, link);
+  sib_triple_free(member);
+  return TRUE;
+}
+
+static void sib_delta_set_drop_matching(SIBDeltaSet *set, const SIBTriple *pattern)
+{
+  GList *l = set->order->head;
+  GList *next = NULL;
+
+  while (l != NULL)
+    {
+      next = l->next;
+      if (sib_triple_matches((SIBTriple *)l->data, pattern))
+	sib_delta_set_drop(set, (SIBTriple *)l->data);
+      l = next;
+    }
+}
+
+/**
+ * Render a set as an M3XML triple list.
+ *
+ * @return The list, NULL if the set is empty
+ */
+static gchar *sib_delta_set_render(SIBDeltaSet *set)
+{
+  GString *out = NULL;
+  GSList *triples = NULL;
+  GList *l = NULL;
+
+  if (g_queue_is_empty(set->order))
+    return NULL;
+
+  for (l = set->order->tail; l != NULL; l = l->prev)
+    triples = g_slist_prepend(triples, l->data);
+
+  out = g_string_new(NULL);
+  sib_triple_list_append(out, triples);
+  g_slist_free(triples);
+  return g_string_free(out, FALSE);
+}
+
+/**
+ * Parse the triples of a write and count them as changes.
+ */
+static GSList *sib_delta_parse(SIBDelta *self, const gchar *triples, GError **error)
+{
+  GSList *list = sib_triple_list_parse(triples, -1, error);
+  self->triples += g_slist_length(list);
+  return list;
+}
+
+static gboolean sib_delta_is_pattern(const SIBTriple *triple)
+{
+  return (strcmp(triple->subject, SIB_TRIPLE_ANY) == 0 ||
+	  strcmp(triple->predicate, SIB_TRIPLE_ANY) == 0 ||
+	  strcmp(triple->object, SIB_TRIPLE_ANY) == 0);
+}
@@ -0,0 +1,610 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_executor.c
+ *
+ * Work-stealing executor. The deques follow Chase and Lev, "Dynamic
+ * circular work-stealing deque" (SPAA 2005), with a fixed capacity; the
+ * injection queue is an intrusive multi-producer, single-consumer list
+ * whose consumer is whichever worker holds inject_lock.
+ *
+ * Deque indices only grow and are compared by difference, so they may
+ * wrap around.
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_executor.h"
+
+/** Keeps the fields written by different threads on separate lines */
+#define SIB_EXECUTOR_CACHE_LINE 64
+
+#define SIB_EXECUTOR_DEQUE_MASK (SIB_EXECUTOR_DEQUE_SIZE - 1)
+
+typedef struct _SIBExecutorTask
+{
+  volatile gpointer next;  /* injection queue link */
+  SIBExecutorFunc func;
+  gpointer data;
+} SIBExecutorTask;
+
+typedef struct _SIBExecutorDeque
+{
+  volatile gint top;     /* thieves take from here */
+  gchar pad1[SIB_EXECUTOR_CACHE_LINE - sizeof(gint)];
+  volatile gint bottom;  /* the owner pushes and pops here */
+  gchar pad2[SIB_EXECUTOR_CACHE_LINE - sizeof(gint)];
+  SIBExecutorTask * volatile slot[SIB_EXECUTOR_DEQUE_SIZE];
+} SIBExecutorDeque;
+
+typedef struct _SIBExecutorWorker
+{
+  SIBExecutorDeque deque;
+  SIBExecutor *executor;
+  guint index;
+  gboolean active;       /* a thread runs in this slot, under mutex */
+
+  /* Written by the owner only */
+  guint executed;
+  guint local;
+  guint injected;
+  guint stolen;
+  guint parked;
+} SIBExecutorWorker;
+
+struct _SIBExecutor
+{
+  SIBExecutorWorker **workers;
+  guint max_threads;
+
+  /* Injection queue: producers swing inject_head, the worker holding
+     inject_lock consumes from inject_tail */
+  volatile gpointer inject_head;
+  gchar pad1[SIB_EXECUTOR_CACHE_LINE - sizeof(gpointer)];
+  SIBExecutorTask *inject_tail;
+  SIBExecutorTask inject_stub;
+  volatile gint inject_lock;
+  gchar pad2[SIB_EXECUTOR_CACHE_LINE - sizeof(gint)];
+
+  /* Submitted tasks not yet taken, may briefly be negative */
+  volatile gint pending;
+  volatile gint sleepers;
+  volatile gint threads;
+
+  /* Protects parking, starting and stopping workers */
+  GMutex *mutex;
+  GCond *wakeup;
+  GCond *stopped;
+  gboolean stopping;
+};
+
+/** The worker running in the current thread */
+static GStaticPrivate sib_executor_current = G_STATIC_PRIVATE_INIT;
+
+static gpointer sib_executor_worker(gpointer data);
+
+static SIBExecutorTask *sib_executor_find(SIBExecutor *self,
+					  SIBExecutorWorker *w);
+
+static gboolean sib_executor_park(SIBExecutor *self, SIBExecutorWorker *w);
+
+static void sib_executor_start(SIBExecutor *self);
+
+static gboolean sib_executor_deque_push(SIBExecutorDeque *q,
+					SIBExecutorTask *task);
+
+static SIBExecutorTask *sib_executor_deque_pop(SIBExecutorDeque *q);
+
+static SIBExecutorTask *sib_executor_deque_steal(SIBExecutorDeque *q);
+
+static void sib_executor_inject(SIBExecutor *self, SIBExecutorTask *task);
+
+static SIBExecutorTask *sib_executor_inject_take(SIBExecutor *self,
+						 SIBExecutorWorker *w);
+
+static SIBExecutorTask *sib_executor_inject_pop(SIBExecutor *self);
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+SIBExecutor *sib_executor_new(guint max_threads)
+{
+  SIBExecutor *self = NULL;
+  guint i;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(max_threads > 0, NULL);
+
+  self = g_new0(SIBExecutor, 1);
+  self->max_threads = max_threads;
+  self->workers = g_new0(SIBExecutorWorker *, max_threads);
+  for (i = 0; i < max_threads; i++)
+    {
+      self->workers[i] = g_new0(SIBExecutorWorker, 1);
+      self->workers[i]->executor = self;
+      self->workers[i]->index = i;
+    }
+
+  self->inject_stub.next = NULL;
+  self->inject_head = &self->inject_stub;
+  self->inject_tail = &self->inject_stub;
+
+  self->mutex = g_mutex_new();
+  self->wakeup = g_cond_new();
+  self->stopped = g_cond_new();
+
+  whiteboard_log_debug_fe();
+  return self;
+}
+
+void sib_executor_destroy(SIBExecutor *self)
+{
+  guint i;
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(self != NULL);
+
+  /* Workers exit once nothing is pending */
+  g_mutex_lock(self->mutex);
+  self->stopping = TRUE;
+  g_cond_broadcast(self->wakeup);
+  while (g_atomic_int_get(&self->threads) > 0)
+    g_cond_wait(self->stopped, self->mutex);
+  g_mutex_unlock(self->mutex);
+
+  for (i = 0; i < self->max_threads; i++)
+    g_free(self->workers[i]);
+  g_free(self->workers);
+  g_cond_free(self->stopped);
+  g_cond_free(self->wakeup);
+  g_mutex_free(self->mutex);
+  g_free(self);
+
+  whiteboard_log_debug_fe();
+}
+
+void sib_executor_submit(SIBExecutor *self, SIBExecutorFunc func, gpointer data)
+{
+  SIBExecutorTask *task = NULL;
+  SIBExecutorWorker *w = NULL;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(func != NULL);
+
+  task = g_new(SIBExecutorTask, 1);
+  task->func = func;
+  task->data = data;
+
+  /* Workers keep their own tasks, other threads inject */
+  w = (SIBExecutorWorker *)g_static_private_get(&sib_executor_current);
+  if (w == NULL || w->executor != self ||
+      sib_executor_deque_push(&w->deque, task) == FALSE)
+    sib_executor_inject(self, task);
+
+  /* A parking worker increments sleepers before checking pending, so
+     either it sees this task or we see it */
+  g_atomic_int_inc(&self->pending);
+  if (g_atomic_int_get(&self->sleepers) > 0 ||
+      (guint)g_atomic_int_get(&self->threads) < self->max_threads)
+    sib_executor_start(self);
+}
+
+void sib_executor_get_stats(SIBExecutor *self, SIBExecutorStats *stats)
+{
+  SIBExecutorWorker *w = NULL;
+  guint i;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  memset(stats, 0, sizeof(SIBExecutorStats));
+  stats->threads = g_atomic_int_get(&self->threads);
+  stats->idle = g_atomic_int_get(&self->sleepers);
+
+  /* Counters of running workers may be slightly stale */
+  for (i = 0; i < self->max_threads; i++)
+    {
+      w = self->workers[i];
+      stats->executed += w->executed;
+      stats->local += w->local;
+      stats->injected += w->injected;
+      stats->stolen += w->stolen;
+      stats->parked += w->parked;
+    }
+}
+
+/*****************************************************************************
+ * Workers
+ *****************************************************************************/
+
+/**
+ * Worker thread: run tasks until idle for SIB_EXECUTOR_IDLE_TIMEOUT or
+ * the executor is stopped.
+ *
+ * @param data The SIBExecutorWorker
+ * @return NULL
+ */
+static gpointer sib_executor_worker(gpointer data)
+{
+  SIBExecutorWorker *w = (SIBExecutorWorker *)data;
+  SIBExecutor *self = w->executor;
+  SIBExecutorTask *task = NULL;
+
+  g_static_private_set(&sib_executor_current, w, NULL);
+
+  for (;;)
+    {
+      task = sib_executor_find(self, w);
+      if (task != NULL)
+	{
+	  g_atomic_int_add(&self->pending, -1);
+	  task->func(task->data);
+	  g_free(task);
+	  w->executed++;
+	}
+      else if (sib_executor_park(self, w) == FALSE)
+	{
+	  break;
+	}
+    }
+
+  g_static_private_set(&sib_executor_current, NULL, NULL);
+  return NULL;
+}
+
+/**
+ * Take the next task: the newest of the worker's own, then a batch from
+ * the injection queue, then the oldest of another worker's.
+ *
+ * @param self The executor
+ * @param w The worker
+ * @return A task or NULL
+ */
+static SIBExecutorTask *sib_executor_find(SIBExecutor *self,
+					  SIBExecutorWorker *w)
+{
+  SIBExecutorTask *task = NULL;
+  guint i;
+
+  task = sib_executor_deque_pop(&w->deque);
+  if (task != NULL)
+    {
+      w->local++;
+      return task;
+    }
+
+  task = sib_executor_inject_take(self, w);
+  if (task != NULL)
+    {
+      w->injected++;
+      return task;
+    }
+
+  for (i = 1; i < self->max_threads; i++)
+    {
+      task = sib_executor_deque_steal(&self->workers[(w->index + i) %
+						     self->max_threads]->deque);
+      if (task != NULL)
+	{
+	  w->stolen++;
+	  return task;
+	}
+    }
+
+  return NULL;
+}
+
+/**
+ * Wait until tasks are pending. Gives up the thread after
+ * SIB_EXECUTOR_IDLE_TIMEOUT or when the executor is stopped.
+ *
+ * @param self The executor
+ * @param w The worker
+ * @return FALSE if the worker should exit
+ */
+static gboolean sib_executor_park(SIBExecutor *self, SIBExecutorWorker *w)
+{
+  GTimeVal deadline;
+  gboolean run = TRUE;
+
+  /* Pending but not visible yet, e.g. another worker is draining the
+     injection queue */
+  if (g_atomic_int_get(&self->pending) > 0)
+    {
+      g_thread_yield();
+      return TRUE;
+    }
+
+  g_get_current_time(&deadline);
+  g_time_val_add(&deadline, SIB_EXECUTOR_IDLE_TIMEOUT * G_USEC_PER_SEC);
+
+  g_mutex_lock(self->mutex);
+  g_atomic_int_inc(&self->sleepers);
+  w->parked++;
+  while (g_atomic_int_get(&self->pending) <= 0)
+    {
+      if (self->stopping ||
+	  g_cond_timed_wait(self->wakeup, self->mutex, &deadline) == FALSE)
+	{
+	  /* Exit with the lock held, so a submitter either sees this worker
+	     sleeping or sees a free slot and starts another */
+	  if (g_atomic_int_get(&self->pending) <= 0)
+	    run = FALSE;
+	  break;
+	}
+    }
+  g_atomic_int_add(&self->sleepers, -1);
+
+  if (run == FALSE)
+    {
+      w->active = FALSE;
+      g_atomic_int_add(&self->threads, -1);
+      if (g_atomic_int_get(&self->threads) == 0)
+	g_cond_broadcast(self->stopped);
+    }
+  g_mutex_unlock(self->mutex);
+
+  return run;
+}
+
+/**
+ * Wake a sleeping worker, or start a new one if none is sleeping and the
+ * limit allows.
+ *
+ * @param self The executor
+ */
+static void sib_executor_start(SIBExecutor *self)
+{
+  SIBExecutorWorker *w = NULL;
+  guint i;
+
+  g_mutex_lock(self->mutex);
+  if (g_atomic_int_get(&self->sleepers) > 0)
+    {
+      g_cond_signal(self->wakeup);
+    }
+  else if ((guint)g_atomic_int_get(&self->threads) < self->max_threads &&
+	   self->stopping == FALSE)
+    {
+      for (i = 0; i < self->max_threads; i++)
+	{
+	  w = self->workers[i];
+	  if (w->active == FALSE)
+	    break;
+	}
+
+      w->active = TRUE;
+      g_atomic_int_inc(&self->threads);
+      if (g_thread_create(sib_executor_worker, w, FALSE, NULL) == NULL)
+	{
+	  whiteboard_log_warning("Could not start executor worker\n");
+	  w->active = FALSE;
+	  g_atomic_int_add(&self->threads, -1);
+	}
+    }
+  g_mutex_unlock(self->mutex);
+}
+
+/*****************************************************************************
+ * Deques
+ *****************************************************************************/
+
+/**
+ * Push a task at the bottom. Called by the owner only.
+ *
+ * @return FALSE if the deque is full
+ */
+static gboolean sib_executor_deque_push(SIBExecutorDeque *q,
+					SIBExecutorTask *task)
+{
+  guint b = (guint)q->bottom;
+  guint t = (guint)g_atomic_int_get(&q->top);
+
+  if ((gint)(b - t) >= SIB_EXECUTOR_DEQUE_SIZE)
+    return FALSE;
+
+  q->slot[b & SIB_EXECUTOR_DEQUE_MASK] = task;
+
+  /* Publishes the slot to thieves */
+  g_atomic_int_add(&q->bottom, 1);
+  return TRUE;
+}
+
+/**
+ * Pop the newest task from the bottom. Called by the owner only.
+ *
+ * @return The task or NULL if empty
+ */
+static SIBExecutorTask *sib_executor_deque_pop(SIBExecutorDeque *q)
+{
+  SIBExecutorTask *task = NULL;
+  guint b;
+  guint t;
+  gint size;
+
+  /* Claim the bottom slot before looking at top */
+  b = (guint)q->bottom - 1;
+  g_atomic_int_add(&q->bottom, -1);
+  t = (guint)g_atomic_int_get(&q->top);
+
+  size = (gint)(b - t);
+  if (size < 0)
+    {
+      g_atomic_int_add(&q->bottom, 1);
+      return NULL;
+    }
+
+  task = q->slot[b & SIB_EXECUTOR_DEQUE_MASK];
+  if (size > 0)
+    return task;
+
+  /* The last task, a thief may be taking it */
+  if (g_atomic_int_compare_and_exchange(&q->top, (gint)t, (gint)(t + 1)) == FALSE)
+    task = NULL;
+  g_atomic_int_add(&q->bottom, 1);
+
+  return task;
+}
+
+/**
+ * Steal the oldest task from the top. Called by other workers.
+ *
+ * @return The task or NULL if empty or lost a race
+ */
+static SIBExecutorTask *sib_executor_deque_steal(SIBExecutorDeque *q)
+{
+  SIBExecutorTask *task = NULL;
+  guint t = (guint)g_atomic_int_get(&q->top);
+  guint b = (guint)g_atomic_int_get(&q->bottom);
+
+  if ((gint)(b - t) <= 0)
+    return NULL;
+
+  task = q->slot[t & SIB_EXECUTOR_DEQUE_MASK];
+  if (g_atomic_int_compare_and_exchange(&q->top, (gint)t, (gint)(t + 1)) == FALSE)
+    return NULL;
+
+  return task;
+}
+
+/*****************************************************************************
+ * Injection queue
+ *****************************************************************************/
+
+/**
+ * Append a task to the injection queue. Lock-free, any thread.
+ */
+static void sib_executor_inject(SIBExecutor *self, SIBExecutorTask *task)
+{
+  SIBExecutorTask *prev = NULL;
+
+  task->next = NULL;
+  do
+    prev = (SIBExecutorTask *)g_atomic_pointer_get(&self->inject_head);
+  while (g_atomic_pointer_compare_and_exchange(&self->inject_head,
+					       prev, task) == FALSE);
+
+  /* The consumer sees the task once it is linked */
+  g_atomic_pointer_compare_and_exchange(&prev->next, NULL, task);
+}
+
+/**
+ * Take a task from the injection queue, and move up to
+ * SIB_EXECUTOR_INJECT_BATCH more to the worker's deque. Returns NULL at
+ * once if another worker is taking.
+ *
+ * @param self The executor
+ * @param w The worker
+ * @return A task or NULL
+ */
+static SIBExecutorTask *sib_executor_inject_take(SIBExecutor *self,
+						 SIBExecutorWorker *w)
+{
+  SIBExecutorTask *task = NULL;
+  SIBExecutorTask *more = NULL;
+  guint i;
+
+  if (g_atomic_int_compare_and_exchange(&self->inject_lock, 0, 1) == FALSE)
+    return NULL;
+
+  task = sib_executor_inject_pop(self);
+  for (i = 0; task != NULL && i < SIB_EXECUTOR_INJECT_BATCH; i++)
+    {
+      more = sib_executor_inject_pop(self);
+      if (more == NULL)
+	break;
+      if (sib_executor_deque_push(&w->deque, more) == FALSE)
+	{
+	  sib_executor_inject(self, more);
+	  break;
+	}
+    }
+
+  g_atomic_int_compare_and_exchange(&self->inject_lock, 1, 0);
+  return task;
+}
+
+/**
+ * Remove the oldest task from the injection queue. Called with
+ * inject_lock held.
+ *
+ * @return The task or NULL if empty, or if the next task is still being
+ *         linked
+ */
+static SIBExecutorTask *sib_executor_inject_pop(SIBExecutor *self)
+{
+  SIBExecutorTask *tail = self->inject_tail;
+  SIBExecutorTask *next = (SIBExecutorTask *)g_atomic_pointer_get(&tail->next);
+
+  if (tail == &self->inject_stub)
+    {
+      if (next == NULL)
+	return NULL;
+      self->inject_tail = next;
+      tail = next;
+      next = (SIBExecutorTask *)g_atomic_pointer_get(&next->next);
+    }
+
+  if (next != NULL)
+    {
+      self->inject_tail = next;
+      return tail;
+    }
+
+  if (tail != (SIBExecutorTask *)g_atomic_pointer_get(&self->inject_head))
+    return NULL;
+
+  /* tail is the last task: put the stub behind it so it can be removed */
+  sib_executor_inject(self, &self->inject_stub);
+  next = (SIBExecutorTask *)g_atomic_pointer_get(&tail->next);
+  if (next != NULL)
+    {
+      self->inject_tail = next;
+      return tail;
+    }
+
+  return NULL;
+}
@@ -0,0 +1,152 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_flight.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+
+#include "sib_flight.h"
+
+struct _SIBFlight
+{
+  gchar *key;
+  guint generation;
+  GSList *waiters;  /* newest first */
+  guint count;
+  gboolean replaced;  /* removed from the group by a newer flight */
+};
+
+struct _SIBFlightGroup
+{
+  GMutex *mutex;
+  GHashTable *flights;  /* key -> SIBFlight */
+  SIBFlightStats stats;
+};
+
+SIBFlightGroup *sib_flight_group_new(void)
+{
+  SIBFlightGroup *self = g_new0(SIBFlightGroup, 1);
+  self->mutex = g_mutex_new();
+  self->flights = g_hash_table_new(g_str_hash, g_str_equal);
+  return self;
+}
+
+void sib_flight_group_destroy(SIBFlightGroup *self)
+{
+  g_return_if_fail(self != NULL);
+
+  g_hash_table_destroy(self->flights);
+  g_mutex_free(self->mutex);
+  g_free(self);
+}
+
+SIBFlight *sib_flight_join(SIBFlightGroup *self,
+			   const gchar *key,
+			   guint generation,
+			   gpointer waiter)
+{
+  SIBFlight *flight = NULL;
+
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(key != NULL, NULL);
+
+  g_mutex_lock(self->mutex);
+  flight = (SIBFlight *)g_hash_table_lookup(self->flights, key);
+  if (flight != NULL && flight->generation == generation)
+    {
+      flight->waiters = g_slist_prepend(flight->waiters, waiter);
+      flight->count++;
+      self->stats.followers++;
+      g_mutex_unlock(self->mutex);
+      return NULL;
+    }
+
+  if (flight != NULL)
+    {
+      /* written since the flight started, its leader lands it without
+	 the group's help */
+      g_hash_table_remove(self->flights, flight->key);
+      flight->replaced = TRUE;
+    }
+
+  flight = g_new0(SIBFlight, 1);
+  flight->key = g_strdup(key);
+  flight->generation = generation;
+  flight->count = 1;
+  g_hash_table_insert(self->flights, flight->key, flight);
+  self->stats.leaders++;
+  self->stats.in_flight++;
+  g_mutex_unlock(self->mutex);
+
+  return flight;
+}
+
+GSList *sib_flight_land(SIBFlightGroup *self, SIBFlight *flight)
+{
+  GSList *waiters = NULL;
+
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(flight != NULL, NULL);
+
+  g_mutex_lock(self->mutex);
+  if (!flight->replaced)
+    g_hash_table_remove(self->flights, flight->key);
+  self->stats.in_flight--;
+  self->stats.max_group = MAX(self->stats.max_group, flight->count);
+  waiters = flight->waiters;
+  g_mutex_unlock(self->mutex);
+
+  g_free(flight->key);
+  g_free(flight);
+  return g_slist_reverse(waiters);
+}
+
+void sib_flight_get_stats(SIBFlightGroup *self, SIBFlightStats *stats)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_mutex_lock(self->mutex);
+  *stats = self->stats;
+  g_mutex_unlock(self->mutex);
+}
@@ -0,0 +1,307 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_framer.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_framer.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define SIB_FRAMER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* AVX2 is compiled in with a function attribute and used only if the CPU
+   has it, so the binary still runs on older x86 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SIB_FRAMER_AVX2 1
+#include <immintrin.h>
+#endif
+
+#define ENDTAG SIB_FRAMER_ENDTAG
+#define ENDTAGLEN SIB_FRAMER_ENDTAGLEN
+
+struct _SIBFramer
+{
+  /* beginning of a message that has not been completed */
+  GString *partial;
+  /* partial holds a message returned by the previous call */
+  gboolean delivered;
+};
+
+static SIBFramerFindFunc sib_framer_find = NULL;
+static const gchar *sib_framer_impl = NULL;
+
+/*****************************************************************************
+ * End tag search
+ *****************************************************************************/
+
+gssize sib_framer_find_end_scalar(const gchar *buf, gsize len)
+{
+  const gchar *p = buf;
+  const gchar *end = buf + len;
+
+  while( (gsize)(end - p) >= ENDTAGLEN &&
+	 (p = memchr(p, '<', end - p - ENDTAGLEN + 1)) != NULL )
+    {
+      if(memcmp(p, ENDTAG, ENDTAGLEN) == 0)
+	return (p - buf) + ENDTAGLEN;
+      p++;
+    }
+  return -1;
+}
+
+/*
+ * The vector searches compare a block with the first character of the
+ * tag and the block ENDTAGLEN - 1 bytes later with the last character.
+ * Only positions where both match are compared in full.
+ */
+
+#ifdef SIB_FRAMER_SSE2
+static gssize sib_framer_find_end_sse2(const gchar *buf, gsize len)
+{
+  const __m128i first = _mm_set1_epi8('<');
+  const __m128i last = _mm_set1_epi8('>');
+  gsize i = 0;
+  gssize tail;
+
+  for(i = 0; i + 16 + ENDTAGLEN - 1 <= len; i += 16)
+    {
+      __m128i block_first = _mm_loadu_si128((const __m128i *)(buf + i));
+      __m128i block_last = _mm_loadu_si128((const __m128i *)(buf + i + ENDTAGLEN - 1));
+      guint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+						   _mm_cmpeq_epi8(last, block_last)));
+      while(mask != 0)
+	{
+	  guint bit = __builtin_ctz(mask);
+	  if(memcmp(buf + i + bit + 1, ENDTAG + 1, ENDTAGLEN - 2) == 0)
+	    return i + bit + ENDTAGLEN;
+	  mask &= mask - 1;
+	}
+    }
+
+  tail = sib_framer_find_end_scalar(buf + i, len - i);
+  return (tail < 0 ? -1 : (gssize)i + tail);
+}
+#endif
+
+#ifdef SIB_FRAMER_AVX2
+__attribute__((target("avx2")))
+static gssize sib_framer_find_end_avx2(const gchar *buf, gsize len)
+{
+  const __m256i first = _mm256_set1_epi8('<');
+  const __m256i last = _mm256_set1_epi8('>');
+  gsize i = 0;
+  gssize tail;
+
+  for(i = 0; i + 32 + ENDTAGLEN - 1 <= len; i += 32)
+    {
+      __m256i block_first = _mm256_loadu_si256((const __m256i *)(buf + i));
+      __m256i block_last = _mm256_loadu_si256((const __m256i *)(buf + i + ENDTAGLEN - 1));
+      guint mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+							 _mm256_cmpeq_epi8(last, block_last)));
+      while(mask != 0)
+	{
+	  guint bit = __builtin_ctz(mask);
+	  if(memcmp(buf + i + bit + 1, ENDTAG + 1, ENDTAGLEN - 2) == 0)
+	    return i + bit + ENDTAGLEN;
+	  mask &= mask - 1;
+	}
+    }
+
+  tail = sib_framer_find_end_scalar(buf + i, len - i);
+  return (tail < 0 ? -1 : (gssize)i + tail);
+}
+#endif
+
+SIBFramerFindFunc sib_framer_get_sse2(void)
+{
+#ifdef SIB_FRAMER_SSE2
+  return sib_framer_find_end_sse2;
+#else
+  return NULL;
+#endif
+}
+
+SIBFramerFindFunc sib_framer_get_avx2(void)
+{
+#ifdef SIB_FRAMER_AVX2
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+    return sib_framer_find_end_avx2;
+#endif
+  return NULL;
+}
+
+static void sib_framer_select(void)
+{
+  /* concurrent first calls select the same function, no lock needed */
+  if(sib_framer_find != NULL)
+    return;
+
+  if(sib_framer_get_avx2() != NULL)
+    {
+      sib_framer_impl = "avx2";
+      sib_framer_find = sib_framer_get_avx2();
+    }
+  else if(sib_framer_get_sse2() != NULL)
+    {
+      sib_framer_impl = "sse2";
+      sib_framer_find = sib_framer_get_sse2();
+    }
+  else
+    {
+      sib_framer_impl = "scalar";
+      sib_framer_find = sib_framer_find_end_scalar;
+    }
+}
+
+gssize sib_framer_find_end(const gchar *buf, gsize len)
+{
+  if(G_UNLIKELY(sib_framer_find == NULL))
+    sib_framer_select();
+  return sib_framer_find(buf, len);
+}
+
+const gchar *sib_framer_get_impl_name(void)
+{
+  sib_framer_select();
+  return sib_framer_impl;
+}
+
+/*****************************************************************************
+ * Framer
+ *****************************************************************************/
+
+SIBFramer *sib_framer_new(void)
+{
+  SIBFramer *self = g_new0(SIBFramer, 1);
+  self->partial = g_string_new(NULL);
+  return self;
+}
+
+void sib_framer_free(SIBFramer *self)
+{
+  g_return_if_fail(self != NULL);
+  g_string_free(self->partial, TRUE);
+  g_free(self);
+}
+
+void sib_framer_reset(SIBFramer *self)
+{
+  g_return_if_fail(self != NULL);
+  g_string_truncate(self->partial, 0);
+  self->delivered = FALSE;
+}
+
+gsize sib_framer_get_capacity(SIBFramer *self)
+{
+  g_return_val_if_fail(self != NULL, 0);
+  return self->partial->allocated_len;
+}
+
+gsize sib_framer_feed(SIBFramer *self,
+		      const gchar *data,
+		      gsize len,
+		      const gchar **msg,
+		      gsize *msglen)
+{
+  gssize end = -1;
+  gsize used = 0;
+
+  g_return_val_if_fail(self != NULL, 0);
+  g_return_val_if_fail(msg != NULL, 0);
+  g_return_val_if_fail(msglen != NULL, 0);
+
+  *msg = NULL;
+  *msglen = 0;
+
+  if(self->delivered)
+    sib_framer_reset(self);
+
+  if(self->partial->len == 0)
+    {
+      /* common case: the whole message is in one buffer, no copying */
+      end = sib_framer_find_end(data, len);
+      if(end >= 0)
+	{
+	  *msg = data;
+	  *msglen = end;
+	  return end;
+	}
+      g_string_append_len(self->partial, data, len);
+      return len;
+    }
+
+  /* the end tag may be split between the kept bytes and the new ones */
+  {
+    gchar seam[2 * ENDTAGLEN];
+    gsize before = MIN(self->partial->len, ENDTAGLEN - 1);
+    gsize after = MIN(len, ENDTAGLEN - 1);
+
+    memcpy(seam, self->partial->str + self->partial->len - before, before);
+    memcpy(seam + before, data, after);
+    end = sib_framer_find_end(seam, before + after);
+    if(end >= 0)
+      used = end - before;
+  }
+
+  if(end < 0)
+    {
+      end = sib_framer_find_end(data, len);
+      used = (end < 0 ? len : (gsize)end);
+    }
+
+  g_string_append_len(self->partial, data, used);
+  if(end >= 0)
+    {
+      *msg = self->partial->str;
+      *msglen = self->partial->len;
+      self->delivered = TRUE;
+    }
+  return used;
+}
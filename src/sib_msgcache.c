@@ -0,0 +1,199 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_msgcache.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+
+#include <sibmsg.h>
+
+#include "sib_msgcache.h"
+
+/* an object is only cached if libssap can reset it for reuse */
+#if defined(HAVE_PARSESSAPMSG_RESET) && HAVE_DECL_PARSESSAPMSG_RESET
+#define SIB_MSGCACHE_PARSERS 1
+#endif
+#if defined(HAVE_SSBUFDESC_RESET) && HAVE_DECL_SSBUFDESC_RESET
+#define SIB_MSGCACHE_BUILDERS 1
+#endif
+
+#if defined(SIB_MSGCACHE_PARSERS) || defined(SIB_MSGCACHE_BUILDERS)
+/** Free objects of one thread */
+typedef struct _SIBMsgCache
+{
+  NodeMsgContent_t *parsers[SIB_MSGCACHE_DEPTH];
+  guint n_parsers;
+  ssBufDesc_t *builders[SIB_MSGCACHE_DEPTH];
+  guint n_builders;
+} SIBMsgCache;
+
+static GStaticPrivate sib_msgcache_key = G_STATIC_PRIVATE_INIT;
+#endif
+
+/* process wide counters, updated atomically */
+static volatile gint sib_msgcache_parser_hits = 0;
+static volatile gint sib_msgcache_parser_misses = 0;
+static volatile gint sib_msgcache_builder_hits = 0;
+static volatile gint sib_msgcache_builder_misses = 0;
+
+#if defined(SIB_MSGCACHE_PARSERS) || defined(SIB_MSGCACHE_BUILDERS)
+static void sib_msgcache_free(gpointer data)
+{
+  SIBMsgCache *cache = (SIBMsgCache *)data;
+
+  while (cache->n_parsers > 0)
+    parseSSAPmsg_free(&cache->parsers[--cache->n_parsers]);
+  while (cache->n_builders > 0)
+    ssBufDesc_free(&cache->builders[--cache->n_builders]);
+  g_free(cache);
+}
+
+/**
+ * Get the cache of the calling thread. The cache is freed when the thread
+ * exits.
+ */
+static SIBMsgCache *sib_msgcache_get(void)
+{
+  SIBMsgCache *cache = (SIBMsgCache *)g_static_private_get(&sib_msgcache_key);
+  if (cache == NULL)
+    {
+      cache = g_new0(SIBMsgCache, 1);
+      g_static_private_set(&sib_msgcache_key, cache, sib_msgcache_free);
+    }
+  return cache;
+}
+#endif
+
+NodeMsgContent_t *sib_msgcache_get_parser(void)
+{
+#ifdef SIB_MSGCACHE_PARSERS
+  SIBMsgCache *cache = sib_msgcache_get();
+
+  if (cache->n_parsers > 0)
+    {
+      g_atomic_int_inc(&sib_msgcache_parser_hits);
+      return cache->parsers[--cache->n_parsers];
+    }
+#endif
+
+  g_atomic_int_inc(&sib_msgcache_parser_misses);
+  return parseSSAPmsg_new();
+}
+
+void sib_msgcache_put_parser(NodeMsgContent_t **msg)
+{
+#ifdef SIB_MSGCACHE_PARSERS
+  SIBMsgCache *cache = NULL;
+#endif
+
+  g_return_if_fail(msg != NULL);
+
+  if (*msg == NULL)
+    return;
+
+#ifdef SIB_MSGCACHE_PARSERS
+  cache = sib_msgcache_get();
+  if (cache->n_parsers < SIB_MSGCACHE_DEPTH)
+    {
+      /* reset now, so the parsed strings are not kept while idle */
+      parseSSAPmsg_reset(*msg);
+      cache->parsers[cache->n_parsers++] = *msg;
+      *msg = NULL;
+      return;
+    }
+#endif
+
+  parseSSAPmsg_free(msg);
+}
+
+ssBufDesc_t *sib_msgcache_get_builder(void)
+{
+#ifdef SIB_MSGCACHE_BUILDERS
+  SIBMsgCache *cache = sib_msgcache_get();
+
+  if (cache->n_builders > 0)
+    {
+      g_atomic_int_inc(&sib_msgcache_builder_hits);
+      return cache->builders[--cache->n_builders];
+    }
+#endif
+
+  g_atomic_int_inc(&sib_msgcache_builder_misses);
+  return ssBufDesc_new();
+}
+
+void sib_msgcache_put_builder(ssBufDesc_t **buf)
+{
+#ifdef SIB_MSGCACHE_BUILDERS
+  SIBMsgCache *cache = NULL;
+#endif
+
+  g_return_if_fail(buf != NULL);
+
+  if (*buf == NULL)
+    return;
+
+#ifdef SIB_MSGCACHE_BUILDERS
+  cache = sib_msgcache_get();
+  if (cache->n_builders < SIB_MSGCACHE_DEPTH)
+    {
+      /* the message buffer is kept, it is reused by the next message */
+      ssBufDesc_reset(*buf);
+      cache->builders[cache->n_builders++] = *buf;
+      *buf = NULL;
+      return;
+    }
+#endif
+
+  ssBufDesc_free(buf);
+}
+
+void sib_msgcache_get_stats(SIBMsgCacheStats *stats)
+{
+  g_return_if_fail(stats != NULL);
+
+  stats->parser_hits = g_atomic_int_get(&sib_msgcache_parser_hits);
+  stats->parser_misses = g_atomic_int_get(&sib_msgcache_parser_misses);
+  stats->builder_hits = g_atomic_int_get(&sib_msgcache_builder_hits);
+  stats->builder_misses = g_atomic_int_get(&sib_msgcache_builder_misses);
+}
@@ -0,0 +1,165 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_payload.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_payload.h"
+
+/** A copied payload's data follows the structure */
+struct _SIBPayload
+{
+  volatile gint refcount;
+  const gchar *data;
+  gsize len;
+  GDestroyNotify destroy;
+  gpointer destroy_data;
+};
+
+static volatile gint sib_payload_payloads = 0;
+static volatile gint sib_payload_copied = 0;
+/* may pass 4 GB, so it is not atomic */
+static gsize sib_payload_bytes = 0;
+static GStaticMutex sib_payload_bytes_mutex = G_STATIC_MUTEX_INIT;
+
+SIBPayload *sib_payload_new_wrap(const gchar *data, gssize len,
+				 GDestroyNotify destroy, gpointer destroy_data)
+{
+  SIBPayload *self = NULL;
+
+  g_return_val_if_fail(data != NULL, NULL);
+
+  self = g_new(SIBPayload, 1);
+  self->refcount = 1;
+  self->data = data;
+  self->len = (len < 0) ? strlen(data) : (gsize)len;
+  self->destroy = destroy;
+  self->destroy_data = destroy_data;
+
+  g_atomic_int_inc(&sib_payload_payloads);
+  return self;
+}
+
+SIBPayload *sib_payload_new_take(gchar *data, gssize len)
+{
+  g_return_val_if_fail(data != NULL, NULL);
+
+  return sib_payload_new_wrap(data, len, g_free, data);
+}
+
+SIBPayload *sib_payload_new_copy(const gchar *data, gssize len)
+{
+  SIBPayload *self = NULL;
+  gchar *copy = NULL;
+
+  g_return_val_if_fail(data != NULL, NULL);
+
+  if (len < 0)
+    len = strlen(data);
+
+  self = (SIBPayload *)g_malloc(sizeof(SIBPayload) + len + 1);
+  copy = (gchar *)(self + 1);
+  memcpy(copy, data, len);
+  copy[len] = '\0';
+
+  self->refcount = 1;
+  self->data = copy;
+  self->len = len;
+  self->destroy = NULL;
+  self->destroy_data = NULL;
+
+  g_atomic_int_inc(&sib_payload_payloads);
+  g_atomic_int_inc(&sib_payload_copied);
+  g_static_mutex_lock(&sib_payload_bytes_mutex);
+  sib_payload_bytes += len;
+  g_static_mutex_unlock(&sib_payload_bytes_mutex);
+  return self;
+}
+
+SIBPayload *sib_payload_ref(SIBPayload *self)
+{
+  g_return_val_if_fail(self != NULL, NULL);
+
+  g_atomic_int_inc(&self->refcount);
+  return self;
+}
+
+void sib_payload_unref(SIBPayload *self)
+{
+  g_return_if_fail(self != NULL);
+
+  if (!g_atomic_int_dec_and_test(&self->refcount))
+    return;
+
+  if (self->destroy)
+    self->destroy(self->destroy_data);
+  g_free(self);
+}
+
+const gchar *sib_payload_get_data(SIBPayload *self)
+{
+  g_return_val_if_fail(self != NULL, NULL);
+
+  return self->data;
+}
+
+gsize sib_payload_get_len(SIBPayload *self)
+{
+  g_return_val_if_fail(self != NULL, 0);
+
+  return self->len;
+}
+
+void sib_payload_get_stats(SIBPayloadStats *stats)
+{
+  g_return_if_fail(stats != NULL);
+
+  stats->payloads = g_atomic_int_get(&sib_payload_payloads);
+  stats->copied = g_atomic_int_get(&sib_payload_copied);
+  g_static_mutex_lock(&sib_payload_bytes_mutex);
+  stats->bytes = sib_payload_bytes;
+  g_static_mutex_unlock(&sib_payload_bytes_mutex);
+}
@@ -0,0 +1,492 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_pipeline.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_framer.h"
+#include "sib_pipeline.h"
+
+#define SIB_PIPELINE_BUF_SIZE 8192
+
+/**
+ * An outstanding request. The waiter owns the struct, the reader thread
+ * only fills it in.
+ */
+typedef struct _SIBPipelineRequest
+{
+  gchar *key;                  // node id and message number
+  NodeMsgContent_t *response;
+  GCond *cond;
+  guint connection;            // generation of the connection used
+  gboolean claimed;            // reader is parsing the response
+  gboolean done;
+  gint result;
+} SIBPipelineRequest;
+
+struct _SIBPipeline
+{
+  /* protects everything below except the I/O itself */
+  GMutex *mutex;
+  /* serializes connecting and writing on the shared socket */
+  GMutex *send_mutex;
+
+  SIBPipelineIO io;
+  gpointer user_data;
+
+  int s;
+  guint connection;  // generation, incremented on every connect
+  GThread *reader;
+  gboolean destroyed;
+
+  /* key -> SIBPipelineRequest */
+  GHashTable *pending;
+
+  SIBPipelineStats stats;
+};
+
+typedef struct _SIBPipelineReaderArgs
+{
+  SIBPipeline *pipeline;
+  int s;
+  guint connection;
+} SIBPipelineReaderArgs;
+
+/*****************************************************************************
+ * Private utilities
+ *****************************************************************************/
+
+static gchar *sib_pipeline_make_key(const gchar *nodeid, const gchar *msgnumber)
+{
+  return g_strdup_printf("%s#%s", nodeid, msgnumber);
+}
+
+/**
+ * Get the trimmed content of the first <tag> element of a message.
+ * Returns NULL if the element is not found.
+ */
+static gchar *sib_pipeline_get_element(const gchar *msg, gint len, const gchar *tag)
+{
+  gchar *open = g_strdup_printf("<%s>", tag);
+  gchar *close = g_strdup_printf("</%s>", tag);
+  gchar *value = NULL;
+  gchar *begin = NULL;
+  gchar *end = NULL;
+
+  begin = g_strstr_len(msg, len, open);
+  if(begin != NULL)
+    {
+      begin += strlen(open);
+      end = g_strstr_len(begin, len - (begin - msg), close);
+      if(end != NULL)
+	{
+	  value = g_strstrip(g_strndup(begin, end - begin));
+	}
+    }
+  g_free(open);
+  g_free(close);
+  return value;
+}
+
+static gboolean sib_pipeline_fail_request(gpointer key, gpointer value, gpointer user_data)
+{
+  SIBPipelineReaderArgs *args = (SIBPipelineReaderArgs *)user_data;
+  SIBPipelineRequest *req = (SIBPipelineRequest *)value;
+
+  if(req->connection != args->connection)
+    return FALSE;
+
+  req->result = -1;
+  req->done = TRUE;
+  args->pipeline->stats.failures++;
+  g_cond_signal(req->cond);
+  return TRUE;
+}
+
+/**
+ * Fail all requests sent on the connection of a reader. Must be called
+ * with the pipeline locked.
+ */
+static void sib_pipeline_fail_pending(SIBPipeline *self, SIBPipelineReaderArgs *args)
+{
+  g_hash_table_foreach_remove(self->pending, sib_pipeline_fail_request, args);
+}
+
+/**
+ * Hand a complete message to the request waiting for it.
+ */
+static void sib_pipeline_dispatch(SIBPipeline *self, gchar *msg, gint len)
+{
+  gchar *nodeid = NULL;
+  gchar *msgnumber = NULL;
+  gchar *key = NULL;
+  SIBPipelineRequest *req = NULL;
+  ssStatus_t status;
+
+  nodeid = sib_pipeline_get_element(msg, len, "node_id");
+  msgnumber = sib_pipeline_get_element(msg, len, "transaction_id");
+  if(nodeid == NULL || msgnumber == NULL)
+    {
+      whiteboard_log_warning("Pipelined response without node id or transaction id\n");
+      g_free(nodeid);
+      g_free(msgnumber);
+      return;
+    }
+  key = sib_pipeline_make_key(nodeid, msgnumber);
+  g_free(nodeid);
+  g_free(msgnumber);
+
+  g_mutex_lock(self->mutex);
+  req = (SIBPipelineRequest *)g_hash_table_lookup(self->pending, key);
+  if(req == NULL)
+    {
+      self->stats.orphans++;
+      g_mutex_unlock(self->mutex);
+      whiteboard_log_debug("No request waiting for response %s, dropped\n", key);
+      g_free(key);
+      return;
+    }
+  g_hash_table_remove(self->pending, key);
+  req->claimed = TRUE;
+  g_mutex_unlock(self->mutex);
+  g_free(key);
+
+  /* the waiter does not touch the response while the request is claimed */
+  status = parseSSAPmsg_section(req->response, msg, len, 0);
+  if(status == ss_StatusOK)
+    {
+      req->result = parseSSAPmsg_parsedbytecount(req->response);
+    }
+  else
+    {
+      whiteboard_log_debug("Parse error %d\n", status);
+      req->result = -1;
+    }
+
+  g_mutex_lock(self->mutex);
+  req->done = TRUE;
+  g_cond_signal(req->cond);
+  g_mutex_unlock(self->mutex);
+}
+
+/**
+ * Reader thread of one connection. Splits the stream into SSAP messages
+ * and dispatches them until the connection breaks.
+ */
+static gpointer sib_pipeline_reader(gpointer data)
+{
+  SIBPipelineReaderArgs *args = (SIBPipelineReaderArgs *)data;
+  SIBPipeline *self = args->pipeline;
+  SIBFramer *framer = sib_framer_new();
+  gchar *recvbuf = g_new(gchar, SIB_PIPELINE_BUF_SIZE);
+  gint rtmp = 0;
+  gint used = 0;
+  const gchar *msg = NULL;
+  gsize msglen = 0;
+  whiteboard_log_debug_fb();
+
+  while(TRUE)
+    {
+      rtmp = self->io.recv(args->s, recvbuf, SIB_PIPELINE_BUF_SIZE, self->user_data);
+      if(rtmp <= 0)
+	{
+	  whiteboard_log_debug("Pipelined connection %d closed (%d)\n", args->s, rtmp);
+	  break;
+	}
+
+      for(used = 0; used < rtmp; )
+	{
+	  used += sib_framer_feed(framer, recvbuf + used, rtmp - used, &msg, &msglen);
+	  if(msg != NULL)
+	    sib_pipeline_dispatch(self, (gchar *)msg, msglen);
+	}
+    }
+
+  g_mutex_lock(self->mutex);
+  if(self->s == args->s)
+    {
+      self->s = -1;
+      self->io.close(args->s, self->user_data);
+    }
+  sib_pipeline_fail_pending(self, args);
+  g_mutex_unlock(self->mutex);
+
+  sib_framer_free(framer);
+  g_free(recvbuf);
+  g_free(args);
+  whiteboard_log_debug_fe();
+  return NULL;
+}
+
+/**
+ * Make sure the pipeline has a connection and a reader thread. Must be
+ * called with send_mutex locked.
+ */
+static gboolean sib_pipeline_ensure_connection(SIBPipeline *self)
+{
+  SIBPipelineReaderArgs *args = NULL;
+  GThread *old_reader = NULL;
+  int s;
+
+  g_mutex_lock(self->mutex);
+  if(self->s >= 0)
+    {
+      g_mutex_unlock(self->mutex);
+      return TRUE;
+    }
+  old_reader = self->reader;
+  self->reader = NULL;
+  g_mutex_unlock(self->mutex);
+
+  /* the previous reader has already given up the connection */
+  if(old_reader != NULL)
+    g_thread_join(old_reader);
+
+  s = self->io.connect(self->user_data);
+  if(s < 0)
+    return FALSE;
+
+  args = g_new0(SIBPipelineReaderArgs, 1);
+  args->pipeline = self;
+  args->s = s;
+
+  g_mutex_lock(self->mutex);
+  self->s = s;
+  self->connection++;
+  self->stats.connects++;
+  args->connection = self->connection;
+  self->reader = g_thread_create(sib_pipeline_reader, args, TRUE, NULL);
+  if(self->reader == NULL)
+    {
+      whiteboard_log_warning("Could not create pipeline reader thread\n");
+      self->s = -1;
+      g_mutex_unlock(self->mutex);
+      self->io.close(s, self->user_data);
+      g_free(args);
+      return FALSE;
+    }
+  g_mutex_unlock(self->mutex);
+  return TRUE;
+}
+
+/*****************************************************************************
+ * Construction/destruction
+ *****************************************************************************/
+
+SIBPipeline *sib_pipeline_new(const SIBPipelineIO *io, gpointer user_data)
+{
+  SIBPipeline *self = NULL;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(io != NULL, NULL);
+
+  self = g_new0(SIBPipeline, 1);
+  g_return_val_if_fail(self != NULL, NULL);
+
+  self->mutex = g_mutex_new();
+  self->send_mutex = g_mutex_new();
+  self->io = *io;
+  self->user_data = user_data;
+  self->s = -1;
+  self->pending = g_hash_table_new(g_str_hash, g_str_equal);
+
+  whiteboard_log_debug_fe();
+  return self;
+}
+
+void sib_pipeline_destroy(SIBPipeline *self)
+{
+  GThread *reader = NULL;
+  whiteboard_log_debug_fb();
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->send_mutex);
+  g_mutex_lock(self->mutex);
+  self->destroyed = TRUE;
+  reader = self->reader;
+  self->reader = NULL;
+  /* wake up the reader, it closes the socket and fails the requests */
+  if(self->s >= 0)
+    self->io.shutdown(self->s, self->user_data);
+  g_mutex_unlock(self->mutex);
+  g_mutex_unlock(self->send_mutex);
+
+  if(reader != NULL)
+    g_thread_join(reader);
+
+  g_hash_table_destroy(self->pending);
+  g_mutex_free(self->send_mutex);
+  g_mutex_free(self->mutex);
+  g_free(self);
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Requests
+ *****************************************************************************/
+
+gint sib_pipeline_transact(SIBPipeline *self,
+			   ssElement_ct nodeid,
+			   gint msgnumber,
+			   gchar *msg,
+			   gint len,
+			   NodeMsgContent_t *response)
+{
+  SIBPipelineRequest req;
+  GTimeVal deadline;
+  gchar *number = NULL;
+  gboolean sent = FALSE;
+  gint result = -1;
+  int s = -1;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(self != NULL, -1);
+  g_return_val_if_fail(nodeid != NULL, -1);
+  g_return_val_if_fail(response != NULL, -1);
+
+  memset(&req, 0, sizeof(req));
+  number = g_strdup_printf("%d", msgnumber);
+  req.key = sib_pipeline_make_key((const gchar *)nodeid, number);
+  g_free(number);
+  req.response = response;
+  req.result = -1;
+
+  g_mutex_lock(self->mutex);
+  if(self->destroyed || g_hash_table_lookup(self->pending, req.key) != NULL)
+    {
+      /* responses could not be told apart */
+      self->stats.busy++;
+      g_mutex_unlock(self->mutex);
+      g_free(req.key);
+      whiteboard_log_debug_fe();
+      return SIB_PIPELINE_BUSY;
+    }
+  g_mutex_unlock(self->mutex);
+
+  req.cond = g_cond_new();
+
+  g_mutex_lock(self->send_mutex);
+  if(sib_pipeline_ensure_connection(self))
+    {
+      /* register before sending, the response may arrive before the
+	 send returns */
+      g_mutex_lock(self->mutex);
+      s = self->s;
+      if(s >= 0)
+	{
+	  req.connection = self->connection;
+	  g_hash_table_insert(self->pending, req.key, &req);
+	  self->stats.requests++;
+	  self->stats.in_flight++;
+	  self->stats.max_in_flight = MAX(self->stats.max_in_flight, self->stats.in_flight);
+	}
+      g_mutex_unlock(self->mutex);
+
+      /* s < 0 if the connection broke right after it was made */
+      if(s >= 0)
+	{
+	  if(self->io.send(s, msg, len, self->user_data) < 0)
+	    {
+	      whiteboard_log_debug("Could not send pipelined message on connection %d\n", s);
+	      /* the reader notices the broken connection and fails the
+		 requests sent on it */
+	      self->io.shutdown(s, self->user_data);
+	    }
+	  sent = TRUE;
+	}
+    }
+  g_mutex_unlock(self->send_mutex);
+
+  if(!sent)
+    {
+      whiteboard_log_warning("socket err\n");
+      g_cond_free(req.cond);
+      g_free(req.key);
+      whiteboard_log_debug_fe();
+      return -1;
+    }
+
+  g_get_current_time(&deadline);
+  g_time_val_add(&deadline, SIB_PIPELINE_TIMEOUT * G_USEC_PER_SEC);
+
+  g_mutex_lock(self->mutex);
+  while(!req.done)
+    {
+      if(!g_cond_timed_wait(req.cond, self->mutex, &deadline) && !req.done)
+	{
+	  if(!req.claimed)
+	    {
+	      /* a late response is dropped as an orphan */
+	      g_hash_table_remove(self->pending, req.key);
+	      self->stats.timeouts++;
+	      whiteboard_log_debug("Pipelined request %s timed out\n", req.key);
+	      break;
+	    }
+	  /* the response is being parsed, wait for it */
+	  g_get_current_time(&deadline);
+	  g_time_val_add(&deadline, SIB_PIPELINE_TIMEOUT * G_USEC_PER_SEC);
+	}
+    }
+  self->stats.in_flight--;
+  result = req.done ? req.result : -1;
+  g_mutex_unlock(self->mutex);
+
+  g_cond_free(req.cond);
+  g_free(req.key);
+  whiteboard_log_debug_fe();
+  return result;
+}
+
+void sib_pipeline_get_stats(SIBPipeline *self, SIBPipelineStats *stats)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_mutex_lock(self->mutex);
+  *stats = self->stats;
+  g_mutex_unlock(self->mutex);
+}
@@ -0,0 +1,278 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_query_cache.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_query_cache.h"
+
+/** A cached result, in the hash table and in the LRU list */
+typedef struct _SIBQueryCacheEntry
+{
+  gchar *key;
+  gsize uri_len;
+  gchar *result;
+  gsize size;
+  guint generation;
+  glong stored;
+  struct _SIBQueryCacheEntry *prev; /* more recently used */
+  struct _SIBQueryCacheEntry *next; /* less recently used */
+} SIBQueryCacheEntry;
+
+struct _SIBQueryCache
+{
+  GMutex *mutex;
+  GHashTable *entries; /* key -> SIBQueryCacheEntry */
+  SIBQueryCacheEntry *head;
+  SIBQueryCacheEntry *tail;
+  guint ttl;
+  SIBQueryCacheStats stats;
+};
+
+static gchar *sib_query_cache_key(const gchar *uri, gint type, const gchar *query)
+{
+  return g_strdup_printf("%s\n%d\n%s", uri, type, query);
+}
+
+static glong sib_query_cache_now(void)
+{
+  GTimeVal now;
+  g_get_current_time(&now);
+  return now.tv_sec;
+}
+
+static void sib_query_cache_unlink(SIBQueryCache *self, SIBQueryCacheEntry *entry)
+{
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  else
+    self->head = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  else
+    self->tail = entry->prev;
+  entry->prev = entry->next = NULL;
+}
+
+static void sib_query_cache_link(SIBQueryCache *self, SIBQueryCacheEntry *entry)
+{
+  entry->prev = NULL;
+  entry->next = self->head;
+  if (self->head)
+    self->head->prev = entry;
+  self->head = entry;
+  if (self->tail == NULL)
+    self->tail = entry;
+}
+
+/**
+ * Remove an entry from the cache and free it. Called with the mutex held.
+ */
+static void sib_query_cache_remove(SIBQueryCache *self, SIBQueryCacheEntry *entry)
+{
+  sib_query_cache_unlink(self, entry);
+  g_hash_table_remove(self->entries, entry->key);
+  self->stats.entries--;
+  self->stats.bytes -= entry->size;
+  g_free(entry->key);
+  g_free(entry->result);
+  g_free(entry);
+}
+
+SIBQueryCache *sib_query_cache_new(gsize max_bytes, guint ttl)
+{
+  SIBQueryCache *self = NULL;
+
+  g_return_val_if_fail(max_bytes > 0, NULL);
+
+  self = g_new0(SIBQueryCache, 1);
+  self->mutex = g_mutex_new();
+  self->entries = g_hash_table_new(g_str_hash, g_str_equal);
+  self->ttl = ttl;
+  self->stats.max_bytes = max_bytes;
+  return self;
+}
+
+void sib_query_cache_destroy(SIBQueryCache *self)
+{
+  g_return_if_fail(self != NULL);
+
+  while (self->head)
+    sib_query_cache_remove(self, self->head);
+  g_hash_table_destroy(self->entries);
+  g_mutex_free(self->mutex);
+  g_free(self);
+}
+
+gchar *sib_query_cache_lookup(SIBQueryCache *self,
+			      const gchar *uri,
+			      gint type,
+			      const gchar *query,
+			      guint generation)
+{
+  SIBQueryCacheEntry *entry = NULL;
+  gchar *result = NULL;
+  gchar *key = NULL;
+
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(uri != NULL, NULL);
+  g_return_val_if_fail(query != NULL, NULL);
+
+  key = sib_query_cache_key(uri, type, query);
+
+  g_mutex_lock(self->mutex);
+  entry = (SIBQueryCacheEntry *)g_hash_table_lookup(self->entries, key);
+  if (entry != NULL && entry->generation != generation)
+    {
+      self->stats.invalidated++;
+      sib_query_cache_remove(self, entry);
+      entry = NULL;
+    }
+  else if (entry != NULL && self->ttl > 0 &&
+	   sib_query_cache_now() - entry->stored >= (glong)self->ttl)
+    {
+      self->stats.expired++;
+      sib_query_cache_remove(self, entry);
+      entry = NULL;
+    }
+
+  if (entry != NULL)
+    {
+      self->stats.hits++;
+      sib_query_cache_unlink(self, entry);
+      sib_query_cache_link(self, entry);
+      result = g_strdup(entry->result);
+    }
+  else
+    {
+      self->stats.misses++;
+    }
+  g_mutex_unlock(self->mutex);
+
+  g_free(key);
+  return result;
+}
+
+void sib_query_cache_store(SIBQueryCache *self,
+			   const gchar *uri,
+			   gint type,
+			   const gchar *query,
+			   guint generation,
+			   const gchar *result)
+{
+  SIBQueryCacheEntry *entry = NULL;
+  SIBQueryCacheEntry *old = NULL;
+  gsize size;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(uri != NULL);
+  g_return_if_fail(query != NULL);
+  g_return_if_fail(result != NULL);
+
+  entry = g_new0(SIBQueryCacheEntry, 1);
+  entry->key = sib_query_cache_key(uri, type, query);
+  entry->uri_len = strlen(uri);
+  size = sizeof(SIBQueryCacheEntry) + strlen(entry->key) + strlen(result) + 2;
+  if (size > self->stats.max_bytes / SIB_QUERY_CACHE_MAX_ENTRY_FRACTION)
+    {
+      /* would push out too many other results */
+      g_free(entry->key);
+      g_free(entry);
+      return;
+    }
+  entry->result = g_strdup(result);
+  entry->size = size;
+  entry->generation = generation;
+  entry->stored = sib_query_cache_now();
+
+  g_mutex_lock(self->mutex);
+  old = (SIBQueryCacheEntry *)g_hash_table_lookup(self->entries, entry->key);
+  if (old != NULL)
+    sib_query_cache_remove(self, old);
+
+  while (self->tail != NULL && self->stats.bytes + size > self->stats.max_bytes)
+    {
+      self->stats.evicted++;
+      sib_query_cache_remove(self, self->tail);
+    }
+
+  g_hash_table_insert(self->entries, entry->key, entry);
+  sib_query_cache_link(self, entry);
+  self->stats.entries++;
+  self->stats.bytes += size;
+  g_mutex_unlock(self->mutex);
+}
+
+void sib_query_cache_purge(SIBQueryCache *self, const gchar *uri)
+{
+  SIBQueryCacheEntry *entry = NULL;
+  SIBQueryCacheEntry *next = NULL;
+  gsize len;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(uri != NULL);
+
+  len = strlen(uri);
+
+  g_mutex_lock(self->mutex);
+  for (entry = self->head; entry != NULL; entry = next)
+    {
+      next = entry->next;
+      if (entry->uri_len == len && strncmp(entry->key, uri, len) == 0)
+	sib_query_cache_remove(self, entry);
+    }
+  g_mutex_unlock(self->mutex);
+}
+
+void sib_query_cache_get_stats(SIBQueryCache *self, SIBQueryCacheStats *stats)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_mutex_lock(self->mutex);
+  *stats = self->stats;
+  g_mutex_unlock(self->mutex);
+}
@@ -0,0 +1,481 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_reactor.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <poll.h>
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_reactor.h"
+
+typedef struct _SIBReactorThread SIBReactorThread;
+
+typedef struct _SIBReactorSource
+{
+  int s;
+  SIBReactorFunc func;
+  gpointer user_data;
+  GDestroyNotify destroy;
+
+  SIBReactorThread *thread;
+  gboolean removed;
+  guint busy;    // reactor thread is waiting on or handling the socket
+} SIBReactorSource;
+
+struct _SIBReactorThread
+{
+  SIBReactor *reactor;
+  GThread *thread;
+
+  GList *sources;
+  guint count;
+
+  /* sources taken into the current poll round and their poll set, grown
+     with count. The wake pipe comes first in the set, if there is one. */
+  SIBReactorSource **active;
+  struct pollfd *fds;
+  guint size;
+
+  /* written to when the thread's sockets change, -1 if the transport's
+     sockets cannot be polled with a pipe */
+  int wake[2];
+};
+
+struct _SIBReactor
+{
+  GMutex *mutex;
+
+  const SIBTransport *transport;
+
+  SIBReactorThread *threads;
+  guint n_threads;
+
+  /* socket -> SIBReactorSource */
+  GHashTable *sources;
+
+  gboolean quit;
+};
+
+/*****************************************************************************
+ * Private utilities
+ *****************************************************************************/
+
+static void sib_reactor_source_free(SIBReactorSource *source)
+{
+  if(source->destroy != NULL)
+    source->destroy(source->user_data);
+  g_free(source);
+}
+
+/**
+ * Unlink a removed source from its thread. Must be called with the
+ * reactor locked and the source not busy. The caller frees the source
+ * after unlocking.
+ */
+static void sib_reactor_unlink(SIBReactor *self, SIBReactorSource *source)
+{
+  SIBReactorThread *thread = source->thread;
+
+  thread->sources = g_list_remove(thread->sources, source);
+  thread->count--;
+  if(g_hash_table_lookup(self->sources, GINT_TO_POINTER(source->s)) == source)
+    g_hash_table_remove(self->sources, GINT_TO_POINTER(source->s));
+}
+
+/**
+ * Make a reactor thread start a new poll round, so that a change to its
+ * sockets is seen at once.
+ */
+static void sib_reactor_wake(SIBReactorThread *thread)
+{
+  gchar c = 0;
+
+  /* a full pipe already wakes the thread */
+  if(thread->wake[1] >= 0)
+    (void)write(thread->wake[1], &c, 1);
+}
+
+static void sib_reactor_drain(SIBReactorThread *thread)
+{
+  gchar buf[64];
+
+  while(read(thread->wake[0], buf, sizeof(buf)) > 0)
+    ;
+}
+
+/**
+ * Create the wake pipe of a reactor thread, if its transport's sockets
+ * are operating system descriptors.
+ */
+static void sib_reactor_pipe(SIBReactor *self, SIBReactorThread *thread)
+{
+  thread->wake[0] = -1;
+  thread->wake[1] = -1;
+  if(self->transport->max_socket > 0)
+    return;
+
+  if(pipe(thread->wake) < 0)
+    {
+      whiteboard_log_warning("Could not create reactor wake pipe: %s\n", strerror(errno));
+      thread->wake[0] = -1;
+      thread->wake[1] = -1;
+      return;
+    }
+  fcntl(thread->wake[0], F_SETFL, O_NONBLOCK);
+  fcntl(thread->wake[1], F_SETFL, O_NONBLOCK);
+  fcntl(thread->wake[0], F_SETFD, FD_CLOEXEC);
+  fcntl(thread->wake[1], F_SETFD, FD_CLOEXEC);
+}
+
+static gpointer sib_reactor_thread(gpointer data)
+{
+  SIBReactorThread *thread = (SIBReactorThread *)data;
+  SIBReactor *self = thread->reactor;
+  SIBReactorSource *source = NULL;
+  GList *item = NULL;
+  GList *dead = NULL;
+  guint base = (thread->wake[0] >= 0 ? 1 : 0);
+  guint n = 0;
+  guint i = 0;
+  gint ready = 0;
+  whiteboard_log_debug_fb();
+
+  while(TRUE)
+    {
+      g_mutex_lock(self->mutex);
+      if(self->quit)
+	{
+	  g_mutex_unlock(self->mutex);
+	  break;
+	}
+      if(thread->size < base + thread->count)
+	{
+	  thread->size = MAX(base + thread->count, thread->size * 2);
+	  thread->active = g_renew(SIBReactorSource *, thread->active, thread->size);
+	  thread->fds = g_renew(struct pollfd, thread->fds, thread->size);
+	}
+      n = 0;
+      if(base > 0)
+	{
+	  thread->fds[n].fd = thread->wake[0];
+	  thread->fds[n].events = POLLIN;
+	  thread->fds[n].revents = 0;
+	  thread->active[n++] = NULL;
+	}
+      for(item = thread->sources; item != NULL; item = item->next)
+	{
+	  source = (SIBReactorSource *)item->data;
+	  if(source->removed)
+	    continue;
+	  thread->fds[n].fd = source->s;
+	  thread->fds[n].events = POLLIN;
+	  thread->fds[n].revents = 0;
+	  source->busy++;
+	  thread->active[n++] = source;
+	}
+      g_mutex_unlock(self->mutex);
+
+      if(n == 0)
+	{
+	  g_usleep(SIB_REACTOR_POLL_INTERVAL * 1000);
+	  continue;
+	}
+
+      /* without a wake pipe, time out now and then to pick up added
+	 sockets */
+      ready = self->transport->poll(thread->fds, n,
+				    (base > 0 ? -1 : SIB_REACTOR_POLL_INTERVAL));
+      if(ready < 0 && errno != EINTR)
+	{
+	  whiteboard_log_warning("%s poll failed\n", self->transport->name);
+	  g_usleep(SIB_REACTOR_POLL_INTERVAL * 1000);
+	}
+      if(ready > 0 && base > 0 && (thread->fds[0].revents & POLLIN) != 0)
+	sib_reactor_drain(thread);
+
+      for(i = base; ready > 0 && i < n; i++)
+	{
+	  source = thread->active[i];
+	  /* a hung up or failed socket is handled too, its read fails */
+	  if(!source->removed &&
+	     (thread->fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+	    {
+	      if(!source->func(source->s, source->user_data))
+		{
+		  g_mutex_lock(self->mutex);
+		  source->removed = TRUE;
+		  g_mutex_unlock(self->mutex);
+		}
+	    }
+	}
+
+      g_mutex_lock(self->mutex);
+      for(i = base; i < n; i++)
+	{
+	  source = thread->active[i];
+	  source->busy--;
+	  if(source->removed && source->busy == 0)
+	    {
+	      sib_reactor_unlink(self, source);
+	      dead = g_list_prepend(dead, source);
+	    }
+	}
+      g_mutex_unlock(self->mutex);
+
+      for(item = dead; item != NULL; item = item->next)
+	sib_reactor_source_free((SIBReactorSource *)item->data);
+      g_list_free(dead);
+      dead = NULL;
+    }
+
+  whiteboard_log_debug_fe();
+  return NULL;
+}
+
+/*****************************************************************************
+ * Construction/destruction
+ *****************************************************************************/
+
+SIBReactor *sib_reactor_new(const SIBTransport *transport, guint threads)
+{
+  SIBReactor *self = NULL;
+  guint i = 0;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(transport != NULL, NULL);
+  g_return_val_if_fail(threads > 0, NULL);
+
+  self = g_new0(SIBReactor, 1);
+  g_return_val_if_fail(self != NULL, NULL);
+
+  self->mutex = g_mutex_new();
+  self->transport = transport;
+  self->sources = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->threads = g_new0(SIBReactorThread, threads);
+
+  for(i = 0; i < threads; i++)
+    {
+      self->threads[i].reactor = self;
+      sib_reactor_pipe(self, &self->threads[i]);
+      self->threads[i].thread = g_thread_create(sib_reactor_thread, &self->threads[i], TRUE, NULL);
+      if(self->threads[i].thread == NULL)
+	{
+	  whiteboard_log_warning("Could not create reactor thread\n");
+	  if(self->threads[i].wake[0] >= 0)
+	    {
+	      close(self->threads[i].wake[0]);
+	      close(self->threads[i].wake[1]);
+	    }
+	  break;
+	}
+      self->n_threads++;
+    }
+
+  if(self->n_threads == 0)
+    {
+      sib_reactor_destroy(self);
+      self = NULL;
+    }
+
+  whiteboard_log_debug_fe();
+  return self;
+}
+
+void sib_reactor_destroy(SIBReactor *self)
+{
+  GList *item = NULL;
+  guint i = 0;
+  whiteboard_log_debug_fb();
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  self->quit = TRUE;
+  g_mutex_unlock(self->mutex);
+
+  for(i = 0; i < self->n_threads; i++)
+    {
+      sib_reactor_wake(&self->threads[i]);
+      g_thread_join(self->threads[i].thread);
+    }
+
+  for(i = 0; i < self->n_threads; i++)
+    {
+      for(item = self->threads[i].sources; item != NULL; item = item->next)
+	sib_reactor_source_free((SIBReactorSource *)item->data);
+      g_list_free(self->threads[i].sources);
+      g_free(self->threads[i].active);
+      g_free(self->threads[i].fds);
+      if(self->threads[i].wake[0] >= 0)
+	{
+	  close(self->threads[i].wake[0]);
+	  close(self->threads[i].wake[1]);
+	}
+    }
+
+  g_hash_table_destroy(self->sources);
+  g_free(self->threads);
+  g_mutex_free(self->mutex);
+  g_free(self);
+  whiteboard_log_debug_fe();
+}
+
+/*****************************************************************************
+ * Sockets
+ *****************************************************************************/
+
+gboolean sib_reactor_add(SIBReactor *self,
+			 int s,
+			 SIBReactorFunc func,
+			 gpointer user_data,
+			 GDestroyNotify destroy)
+{
+  SIBReactorSource *source = NULL;
+  SIBReactorThread *thread = NULL;
+  guint i = 0;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(func != NULL, FALSE);
+
+  if(s < 0 || (self->transport->max_socket > 0 && s >= self->transport->max_socket))
+    {
+      whiteboard_log_debug("Socket %d cannot be watched\n", s);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  g_mutex_lock(self->mutex);
+  if(self->quit || g_hash_table_lookup(self->sources, GINT_TO_POINTER(s)) != NULL)
+    {
+      g_mutex_unlock(self->mutex);
+      whiteboard_log_debug_fe();
+      return FALSE;
+    }
+
+  /* the least loaded thread */
+  for(i = 0; i < self->n_threads; i++)
+    {
+      if(thread == NULL || self->threads[i].count < thread->count)
+	thread = &self->threads[i];
+    }
+
+  source = g_new0(SIBReactorSource, 1);
+  source->s = s;
+  source->func = func;
+  source->user_data = user_data;
+  source->destroy = destroy;
+  source->thread = thread;
+
+  thread->sources = g_list_prepend(thread->sources, source);
+  thread->count++;
+  g_hash_table_insert(self->sources, GINT_TO_POINTER(s), source);
+  g_mutex_unlock(self->mutex);
+
+  sib_reactor_wake(thread);
+
+  whiteboard_log_debug("Watching socket %d\n", s);
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
+void sib_reactor_remove(SIBReactor *self, int s)
+{
+  SIBReactorSource *source = NULL;
+  SIBReactorThread *thread = NULL;
+  whiteboard_log_debug_fb();
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  source = (SIBReactorSource *)g_hash_table_lookup(self->sources, GINT_TO_POINTER(s));
+  if(source != NULL)
+    {
+      source->removed = TRUE;
+      g_hash_table_remove(self->sources, GINT_TO_POINTER(s));
+      if(source->busy == 0)
+	sib_reactor_unlink(self, source);
+      else
+	{
+	  /* the reactor thread frees it after its poll round */
+	  thread = source->thread;
+	  source = NULL;
+	}
+    }
+  g_mutex_unlock(self->mutex);
+
+  if(thread != NULL)
+    sib_reactor_wake(thread);
+
+  if(source != NULL)
+    sib_reactor_source_free(source);
+  whiteboard_log_debug_fe();
+}
+
+guint sib_reactor_get_count(SIBReactor *self)
+{
+  guint count = 0;
+  g_return_val_if_fail(self != NULL, 0);
+
+  g_mutex_lock(self->mutex);
+  count = g_hash_table_size(self->sources);
+  g_mutex_unlock(self->mutex);
+  return count;
+}
+
+gboolean sib_reactor_is_prompt(SIBReactor *self)
+{
+  g_return_val_if_fail(self != NULL, FALSE);
+  return (self->n_threads > 0 && self->threads[0].wake[0] >= 0);
+}
+
+const SIBTransport *sib_reactor_get_transport(SIBReactor *self)
+{
+  g_return_val_if_fail(self != NULL, NULL);
+  return self->transport;
+}
@@ -0,0 +1,916 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_replica.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_triple.h"
+#include "sib_replica.h"
+
+/** Term id matching any term */
+#define SIB_REPLICA_ANY 0
+
+/** Approximate cost of a hash table entry, for the memory estimate */
+#define SIB_REPLICA_ENTRY_BYTES (4 * sizeof(gpointer))
+
+/** A URI or literal of the dictionary */
+typedef struct _SIBReplicaTerm
+{
+  gchar *key;    // 'u' or 'l' followed by the URI or literal
+  guint refs;    // triples using the term
+} SIBReplicaTerm;
+
+typedef struct _SIBReplicaTriple
+{
+  guint s;
+  guint p;
+  guint o;
+} SIBReplicaTriple;
+
+typedef struct _SIBReplicaScope
+{
+  guint id;
+  gchar *query;       // the subscription's query
+  GSList *templates;  // SIBTriple
+  gint sequence;      // -1 until the first indication
+  gboolean valid;
+  gboolean claimed;   // being re-seeded
+  guint changes;      // indications and writes seen
+} SIBReplicaScope;
+
+struct _SIBReplica
+{
+  GMutex *mutex;
+
+  /* dictionary */
+  GHashTable *term_ids;  // key -> id
+  GPtrArray *terms;      // id -> SIBReplicaTerm, NULL if free
+  GSList *free_ids;
+  guint term_count;
+  gsize term_bytes;
+
+  /* each index maps the first id to a table of the second id, which
+     maps the third id to the triple */
+  GHashTable *spo;
+  GHashTable *pos;
+  GHashTable *osp;
+  guint triple_count;
+
+  GSList *scopes;
+  guint next_scope;
+
+  guint hits;
+  guint misses;
+  guint reseeds;
+};
+
+/*****************************************************************************
+ * Dictionary
+ *****************************************************************************/
+
+static gchar *sib_replica_term_key(const gchar *text, gboolean literal)
+{
+  return g_strconcat(literal ? "l" : "u", text, NULL);
+}
+
+/**
+ * Get the id of a term.
+ *
+ * @return The id, 0 if the term is not in the dictionary
+ */
+static guint sib_replica_term_find(SIBReplica *self, const gchar *text, gboolean literal)
+{
+  gchar *key = sib_replica_term_key(text, literal);
+  guint id = GPOINTER_TO_UINT(g_hash_table_lookup(self->term_ids, key));
+
+  g_free(key);
+  return id;
+}
+
+/** Get the id of a term, adding it if needed, and take a reference */
+static guint sib_replica_term_ref(SIBReplica *self, const gchar *text, gboolean literal)
+{
+  SIBReplicaTerm *term = NULL;
+  gchar *key = sib_replica_term_key(text, literal);
+  guint id = GPOINTER_TO_UINT(g_hash_table_lookup(self->term_ids, key));
+
+  if (id != SIB_REPLICA_ANY)
+    {
+      g_free(key);
+      term = (SIBReplicaTerm *)g_ptr_array_index(self->terms, id);
+      term->refs++;
+      return id;
+    }
+
+  term = g_new(SIBReplicaTerm, 1);
+  term->key = key;
+  term->refs = 1;
+  if (self->free_ids != NULL)
+    {
+      id = GPOINTER_TO_UINT(self->free_ids->data);
+      self->free_ids = g_slist_delete_link(self->free_ids, self->free_ids);
+      g_ptr_array_index(self->terms, id) = term;
+    }
+  else
+    {
+      id = self->terms->len;
+      g_ptr_array_add(self->terms, term);
+    }
+  g_hash_table_insert(self->term_ids, term->key, GUINT_TO_POINTER(id));
+  self->term_count++;
+  self->term_bytes += sizeof(SIBReplicaTerm) + strlen(key) + 1;
+  return id;
+}
+
+static void sib_replica_term_unref(SIBReplica *self, guint id)
+{
+  SIBReplicaTerm *term = (SIBReplicaTerm *)g_ptr_array_index(self->terms, id);
+
+  if (--term->refs > 0)
+    return;
+
+  g_hash_table_remove(self->term_ids, term->key);
+  self->term_count--;
+  self->term_bytes -= sizeof(SIBReplicaTerm) + strlen(term->key) + 1;
+  g_free(term->key);
+  g_free(term);
+  g_ptr_array_index(self->terms, id) = NULL;
+  self->free_ids = g_slist_prepend(self->free_ids, GUINT_TO_POINTER(id));
+}
+
+/** Get the text of a term, valid while the term is used */
+static const gchar *sib_replica_term_text(SIBReplica *self, guint id, gboolean *literal)
+{
+  SIBReplicaTerm *term = (SIBReplicaTerm *)g_ptr_array_index(self->terms, id);
+
+  if (literal != NULL)
+    *literal = (term->key[0] == 'l');
+  return term->key + 1;
+}
+
+/**
+ * Get the ids of a template, SIB_REPLICA_ANY for its wildcards.
+ *
+ * @return FALSE if a term of the template is not in the dictionary, no
+ *         triple matches then
+ */
+static gboolean sib_replica_encode(SIBReplica *self,
+				   const SIBTriple *template,
+				   SIBReplicaTriple *ids)
+{
+  ids->s = ids->p = ids->o = SIB_REPLICA_ANY;
+  if (strcmp(template->subject, SIB_TRIPLE_ANY) != 0 &&
+      (ids->s = sib_replica_term_find(self, template->subject, FALSE)) == SIB_REPLICA_ANY)
+    return FALSE;
+  if (strcmp(template->predicate, SIB_TRIPLE_ANY) != 0 &&
+      (ids->p = sib_replica_term_find(self, template->predicate, FALSE)) == SIB_REPLICA_ANY)
+    return FALSE;
+  if (strcmp(template->object, SIB_TRIPLE_ANY) != 0 &&
+      (ids->o = sib_replica_term_find(self, template->object, template->literal)) == SIB_REPLICA_ANY)
+    return FALSE;
+  return TRUE;
+}
+
+/** Get a stored triple with borrowed strings */
+static void sib_replica_decode(SIBReplica *self,
+			       const SIBReplicaTriple *triple,
+			       SIBTriple *out)
+{
+  out->subject = (gchar *)sib_replica_term_text(self, triple->s, NULL);
+  out->predicate = (gchar *)sib_replica_term_text(self, triple->p, NULL);
+  out->object = (gchar *)sib_replica_term_text(self, triple->o, &out->literal);
+}
+
+/*****************************************************************************
+ * Indexes
+ *****************************************************************************/
+
+static void sib_replica_index_insert(GHashTable *index,
+				     guint a, guint b, guint c,
+				     SIBReplicaTriple *triple)
+{
+  GHashTable *second = (GHashTable *)g_hash_table_lookup(index, GUINT_TO_POINTER(a));
+  GHashTable *third = NULL;
+
+  if (second == NULL)
+    {
+      second = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				     NULL, (GDestroyNotify)g_hash_table_destroy);
+      g_hash_table_insert(index, GUINT_TO_POINTER(a), second);
+    }
+  third = (GHashTable *)g_hash_table_lookup(second, GUINT_TO_POINTER(b));
+  if (third == NULL)
+    {
+      third = g_hash_table_new(g_direct_hash, g_direct_equal);
+      g_hash_table_insert(second, GUINT_TO_POINTER(b), third);
+    }
+  g_hash_table_insert(third, GUINT_TO_POINTER(c), triple);
+}
+
+static void sib_replica_index_remove(GHashTable *index, guint a, guint b, guint c)
+{
+  GHashTable *second = (GHashTable *)g_hash_table_lookup(index, GUINT_TO_POINTER(a));
+  GHashTable *third = (GHashTable *)g_hash_table_lookup(second, GUINT_TO_POINTER(b));
+
+  g_hash_table_remove(third, GUINT_TO_POINTER(c));
+  if (g_hash_table_size(third) == 0)
+    g_hash_table_remove(second, GUINT_TO_POINTER(b));
+  if (g_hash_table_size(second) == 0)
+    g_hash_table_remove(index, GUINT_TO_POINTER(a));
+}
+
+static SIBReplicaTriple *sib_replica_lookup(SIBReplica *self, guint s, guint p, guint o)
+{
+  GHashTable *second = (GHashTable *)g_hash_table_lookup(self->spo, GUINT_TO_POINTER(s));
+  GHashTable *third = NULL;
+
+  if (second == NULL)
+    return NULL;
+  third = (GHashTable *)g_hash_table_lookup(second, GUINT_TO_POINTER(p));
+  if (third == NULL)
+    return NULL;
+  return (SIBReplicaTriple *)g_hash_table_lookup(third, GUINT_TO_POINTER(o));
+}
+
+typedef struct _SIBReplicaCollect
+{
+  guint b;
+  guint c;
+  GPtrArray *out;
+} SIBReplicaCollect;
+
+static void sib_replica_collect_triple(gpointer key, gpointer value, gpointer user_data)
+{
+  g_ptr_array_add((GPtrArray *)user_data, value);
+}
+
+static void sib_replica_collect_third(GHashTable *third, guint c, GPtrArray *out)
+{
+  gpointer triple = NULL;
+
+  if (c == SIB_REPLICA_ANY)
+    {
+      g_hash_table_foreach(third, sib_replica_collect_triple, out);
+      return;
+    }
+  triple = g_hash_table_lookup(third, GUINT_TO_POINTER(c));
+  if (triple != NULL)
+    g_ptr_array_add(out, triple);
+}
+
+static void sib_replica_collect_each_third(gpointer key, gpointer value, gpointer user_data)
+{
+  SIBReplicaCollect *collect = (SIBReplicaCollect *)user_data;
+  sib_replica_collect_third((GHashTable *)value, collect->c, collect->out);
+}
+
+static void sib_replica_collect_second(GHashTable *second, guint b, guint c, GPtrArray *out)
+{
+  SIBReplicaCollect collect;
+  GHashTable *third = NULL;
+
+  if (b == SIB_REPLICA_ANY)
+    {
+      collect.c = c;
+      collect.out = out;
+      g_hash_table_foreach(second, sib_replica_collect_each_third, &collect);
+      return;
+    }
+  third = (GHashTable *)g_hash_table_lookup(second, GUINT_TO_POINTER(b));
+  if (third != NULL)
+    sib_replica_collect_third(third, c, out);
+}
+
+static void sib_replica_collect_each_second(gpointer key, gpointer value, gpointer user_data)
+{
+  SIBReplicaCollect *collect = (SIBReplicaCollect *)user_data;
+  sib_replica_collect_second((GHashTable *)value, collect->b, collect->c, collect->out);
+}
+
+static void sib_replica_collect(GHashTable *index, guint a, guint b, guint c, GPtrArray *out)
+{
+  SIBReplicaCollect collect;
+  GHashTable *second = NULL;
+
+  if (a == SIB_REPLICA_ANY)
+    {
+      collect.b = b;
+      collect.c = c;
+      collect.out = out;
+      g_hash_table_foreach(index, sib_replica_collect_each_second, &collect);
+      return;
+    }
+  second = (GHashTable *)g_hash_table_lookup(index, GUINT_TO_POINTER(a));
+  if (second != NULL)
+    sib_replica_collect_second(second, b, c, out);
+}
+
+/**
+ * Find the triples matching a template, from the index of its first
+ * bound field.
+ *
+ * @param out Filled with the SIBReplicaTriple
+ */
+static void sib_replica_match(SIBReplica *self, const SIBTriple *template, GPtrArray *out)
+{
+  SIBReplicaTriple ids;
+
+  if (!sib_replica_encode(self, template, &ids))
+    return;
+
+  if (ids.s != SIB_REPLICA_ANY)
+    sib_replica_collect(self->spo, ids.s, ids.p, ids.o, out);
+  else if (ids.p != SIB_REPLICA_ANY)
+    sib_replica_collect(self->pos, ids.p, ids.o, SIB_REPLICA_ANY, out);
+  else if (ids.o != SIB_REPLICA_ANY)
+    sib_replica_collect(self->osp, ids.o, SIB_REPLICA_ANY, SIB_REPLICA_ANY, out);
+  else
+    sib_replica_collect(self->spo, SIB_REPLICA_ANY, SIB_REPLICA_ANY, SIB_REPLICA_ANY, out);
+}
+
+/*****************************************************************************
+ * Triples
+ *****************************************************************************/
+
+static void sib_replica_add(SIBReplica *self, const SIBTriple *triple)
+{
+  SIBReplicaTriple *stored = NULL;
+  guint s = sib_replica_term_find(self, triple->subject, FALSE);
+  guint p = sib_replica_term_find(self, triple->predicate, FALSE);
+  guint o = sib_replica_term_find(self, triple->object, triple->literal);
+
+  if (s != SIB_REPLICA_ANY && p != SIB_REPLICA_ANY && o != SIB_REPLICA_ANY &&
+      sib_replica_lookup(self, s, p, o) != NULL)
+    return;
+
+  stored = g_new(SIBReplicaTriple, 1);
+  stored->s = sib_replica_term_ref(self, triple->subject, FALSE);
+  stored->p = sib_replica_term_ref(self, triple->predicate, FALSE);
+  stored->o = sib_replica_term_ref(self, triple->object, triple->literal);
+  sib_replica_index_insert(self->spo, stored->s, stored->p, stored->o, stored);
+  sib_replica_index_insert(self->pos, stored->p, stored->o, stored->s, stored);
+  sib_replica_index_insert(self->osp, stored->o, stored->s, stored->p, stored);
+  self->triple_count++;
+}
+
+static void sib_replica_drop(SIBReplica *self, SIBReplicaTriple *stored)
+{
+  sib_replica_index_remove(self->spo, stored->s, stored->p, stored->o);
+  sib_replica_index_remove(self->pos, stored->p, stored->o, stored->s);
+  sib_replica_index_remove(self->osp, stored->o, stored->s, stored->p);
+  sib_replica_term_unref(self, stored->s);
+  sib_replica_term_unref(self, stored->p);
+  sib_replica_term_unref(self, stored->o);
+  g_free(stored);
+  self->triple_count--;
+}
+
+/** Remove the triples matching a template, which may be a plain triple */
+static void sib_replica_remove(SIBReplica *self, const SIBTriple *template)
+{
+  GPtrArray *matches = g_ptr_array_new();
+  guint i;
+
+  sib_replica_match(self, template, matches);
+  for (i = 0; i < matches->len; i++)
+    sib_replica_drop(self, (SIBReplicaTriple *)g_ptr_array_index(matches, i));
+  g_ptr_array_free(matches, TRUE);
+}
+
+/*****************************************************************************
+ * Scopes
+ *****************************************************************************/
+
+static SIBReplicaScope *sib_replica_scope_find(SIBReplica *self, guint id)
+{
+  GSList *item = NULL;
+
+  for (item = self->scopes; item != NULL; item = item->next)
+    {
+      if (((SIBReplicaScope *)item->data)->id == id)
+	return (SIBReplicaScope *)item->data;
+    }
+  return NULL;
+}
+
+/**
+ * Check whether a triple matches a template of a scope.
+ *
+ * @param valid_only Only look at valid scopes
+ */
+static gboolean sib_replica_in_scope(SIBReplica *self,
+				     const SIBTriple *triple,
+				     gboolean valid_only)
+{
+  GSList *item = NULL;
+  GSList *t = NULL;
+
+  for (item = self->scopes; item != NULL; item = item->next)
+    {
+      SIBReplicaScope *scope = (SIBReplicaScope *)item->data;
+      if (valid_only && !scope->valid)
+	continue;
+      for (t = scope->templates; t != NULL; t = t->next)
+	{
+	  /* a wildcard of a query template only matches a wildcard of
+	     the scope, so this also tells whether a query template is
+	     covered */
+	  if (sib_triple_matches(triple, (SIBTriple *)t->data))
+	    return TRUE;
+	}
+    }
+  return FALSE;
+}
+
+/**
+ * Parse a triple list.
+ *
+ * @param text The triple list, NULL or empty for none
+ * @param ok Set to FALSE if text could not be parsed
+ * @return List of SIBTriple
+ */
+static GSList *sib_replica_parse(const gchar *text, gboolean *ok)
+{
+  GError *error = NULL;
+  GSList *triples = NULL;
+
+  *ok = TRUE;
+  if (text == NULL || *text == '\0')
+    return NULL;
+
+  triples = sib_triple_list_parse(text, -1, &error);
+  if (error != NULL)
+    {
+      g_error_free(error);
+      *ok = FALSE;
+    }
+  return triples;
+}
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+SIBReplica *sib_replica_new(void)
+{
+  SIBReplica *self = g_new0(SIBReplica, 1);
+
+  self->mutex = g_mutex_new();
+  self->term_ids = g_hash_table_new(g_str_hash, g_str_equal);
+  self->terms = g_ptr_array_new();
+  /* id 0 is SIB_REPLICA_ANY */
+  g_ptr_array_add(self->terms, NULL);
+  self->spo = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				    NULL, (GDestroyNotify)g_hash_table_destroy);
+  self->pos = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				    NULL, (GDestroyNotify)g_hash_table_destroy);
+  self->osp = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				    NULL, (GDestroyNotify)g_hash_table_destroy);
+  self->next_scope = 1;
+  return self;
+}
+
+static void sib_replica_free_triple(gpointer key, gpointer value, gpointer user_data)
+{
+  g_free(value);
+}
+
+static void sib_replica_free_third(gpointer key, gpointer value, gpointer user_data)
+{
+  g_hash_table_foreach((GHashTable *)value, sib_replica_free_triple, NULL);
+}
+
+static void sib_replica_free_second(gpointer key, gpointer value, gpointer user_data)
+{
+  g_hash_table_foreach((GHashTable *)value, sib_replica_free_third, NULL);
+}
+
+void sib_replica_destroy(SIBReplica *self)
+{
+  GSList *item = NULL;
+  guint i;
+
+  g_return_if_fail(self != NULL);
+
+  /* the triples are owned by the spo index */
+  g_hash_table_foreach(self->spo, sib_replica_free_second, NULL);
+  g_hash_table_destroy(self->spo);
+  g_hash_table_destroy(self->pos);
+  g_hash_table_destroy(self->osp);
+
+  for (i = 0; i < self->terms->len; i++)
+    {
+      SIBReplicaTerm *term = (SIBReplicaTerm *)g_ptr_array_index(self->terms, i);
+      if (term != NULL)
+	{
+	  g_free(term->key);
+	  g_free(term);
+	}
+    }
+  g_ptr_array_free(self->terms, TRUE);
+  g_hash_table_destroy(self->term_ids);
+  g_slist_free(self->free_ids);
+
+  for (item = self->scopes; item != NULL; item = item->next)
+    {
+      SIBReplicaScope *scope = (SIBReplicaScope *)item->data;
+      sib_triple_list_free(scope->templates);
+      g_free(scope->query);
+      g_free(scope);
+    }
+  g_slist_free(self->scopes);
+
+  g_mutex_free(self->mutex);
+  g_free(self);
+}
+
+guint sib_replica_add_scope(SIBReplica *self,
+			    const gchar *templates,
+			    const gchar *results)
+{
+  SIBReplicaScope *scope = NULL;
+  GSList *parsed = NULL;
+  GSList *triples = NULL;
+  GSList *item = NULL;
+  gboolean ok = FALSE;
+  guint id;
+
+  g_return_val_if_fail(self != NULL, 0);
+  g_return_val_if_fail(templates != NULL, 0);
+  g_return_val_if_fail(results != NULL, 0);
+
+  parsed = sib_replica_parse(templates, &ok);
+  if (!ok || parsed == NULL)
+    {
+      sib_triple_list_free(parsed);
+      return 0;
+    }
+  triples = sib_replica_parse(results, &ok);
+  if (!ok)
+    {
+      sib_triple_list_free(parsed);
+      sib_triple_list_free(triples);
+      return 0;
+    }
+
+  g_mutex_lock(self->mutex);
+  /* the results are current, older triples of the scope are not */
+  for (item = parsed; item != NULL; item = item->next)
+    sib_replica_remove(self, (SIBTriple *)item->data);
+  for (item = triples; item != NULL; item = item->next)
+    sib_replica_add(self, (SIBTriple *)item->data);
+
+  scope = g_new0(SIBReplicaScope, 1);
+  scope->id = id = self->next_scope++;
+  scope->query = g_strdup(templates);
+  scope->templates = parsed;
+  scope->sequence = -1;
+  scope->valid = TRUE;
+  self->scopes = g_slist_prepend(self->scopes, scope);
+  g_mutex_unlock(self->mutex);
+
+  sib_triple_list_free(triples);
+  return id;
+}
+
+void sib_replica_remove_scope(SIBReplica *self, guint id)
+{
+  SIBReplicaScope *scope = NULL;
+  GPtrArray *matches = NULL;
+  GSList *item = NULL;
+  SIBTriple triple;
+  guint i;
+
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  scope = sib_replica_scope_find(self, id);
+  if (scope == NULL)
+    {
+      g_mutex_unlock(self->mutex);
+      return;
+    }
+  self->scopes = g_slist_remove(self->scopes, scope);
+
+  matches = g_ptr_array_new();
+  for (item = scope->templates; item != NULL; item = item->next)
+    {
+      g_ptr_array_set_size(matches, 0);
+      sib_replica_match(self, (SIBTriple *)item->data, matches);
+      for (i = 0; i < matches->len; i++)
+	{
+	  SIBReplicaTriple *stored = (SIBReplicaTriple *)g_ptr_array_index(matches, i);
+	  sib_replica_decode(self, stored, &triple);
+	  if (!sib_replica_in_scope(self, &triple, FALSE))
+	    sib_replica_drop(self, stored);
+	}
+    }
+  g_ptr_array_free(matches, TRUE);
+  g_mutex_unlock(self->mutex);
+
+  sib_triple_list_free(scope->templates);
+  g_free(scope->query);
+  g_free(scope);
+}
+
+void sib_replica_apply(SIBReplica *self,
+		       guint id,
+		       gint sequence,
+		       const gchar *added,
+		       const gchar *removed)
+{
+  SIBReplicaScope *scope = NULL;
+  GSList *add = NULL;
+  GSList *remove = NULL;
+  GSList *item = NULL;
+  gboolean ok = FALSE;
+
+  g_return_if_fail(self != NULL);
+
+  remove = sib_replica_parse(removed, &ok);
+  if (ok)
+    add = sib_replica_parse(added, &ok);
+
+  g_mutex_lock(self->mutex);
+  scope = sib_replica_scope_find(self, id);
+  if (scope != NULL)
+    scope->changes++;
+  if (scope != NULL && scope->valid)
+    {
+      if (!ok || (scope->sequence >= 0 && sequence != scope->sequence + 1))
+	{
+	  /* the scope may be missing changes */
+	  scope->valid = FALSE;
+	}
+      else
+	{
+	  for (item = remove; item != NULL; item = item->next)
+	    sib_replica_remove(self, (SIBTriple *)item->data);
+	  for (item = add; item != NULL; item = item->next)
+	    sib_replica_add(self, (SIBTriple *)item->data);
+	  scope->sequence = sequence;
+	}
+    }
+  g_mutex_unlock(self->mutex);
+
+  sib_triple_list_free(remove);
+  sib_triple_list_free(add);
+}
+
+gboolean sib_replica_write(SIBReplica *self,
+			   const gchar *inserted,
+			   const gchar *removed)
+{
+  GSList *add = NULL;
+  GSList *remove = NULL;
+  GSList *item = NULL;
+  gboolean ok = FALSE;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+
+  remove = sib_replica_parse(removed, &ok);
+  if (ok)
+    add = sib_replica_parse(inserted, &ok);
+  if (!ok)
+    {
+      sib_triple_list_free(remove);
+      sib_triple_list_free(add);
+      sib_replica_invalidate(self);
+      return FALSE;
+    }
+
+  g_mutex_lock(self->mutex);
+  for (item = self->scopes; item != NULL; item = item->next)
+    ((SIBReplicaScope *)item->data)->changes++;
+  for (item = remove; item != NULL; item = item->next)
+    sib_replica_remove(self, (SIBTriple *)item->data);
+  for (item = add; item != NULL; item = item->next)
+    {
+      if (sib_replica_in_scope(self, (SIBTriple *)item->data, FALSE))
+	sib_replica_add(self, (SIBTriple *)item->data);
+    }
+  g_mutex_unlock(self->mutex);
+
+  sib_triple_list_free(remove);
+  sib_triple_list_free(add);
+  return TRUE;
+}
+
+void sib_replica_invalidate(SIBReplica *self)
+{
+  GSList *item = NULL;
+
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  for (item = self->scopes; item != NULL; item = item->next)
+    {
+      ((SIBReplicaScope *)item->data)->valid = FALSE;
+      ((SIBReplicaScope *)item->data)->changes++;
+    }
+  g_mutex_unlock(self->mutex);
+}
+
+gchar *sib_replica_claim_invalid(SIBReplica *self, guint id, guint *mark)
+{
+  SIBReplicaScope *scope = NULL;
+  gchar *query = NULL;
+
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(mark != NULL, NULL);
+
+  g_mutex_lock(self->mutex);
+  scope = sib_replica_scope_find(self, id);
+  if (scope != NULL && !scope->valid && !scope->claimed)
+    {
+      scope->claimed = TRUE;
+      *mark = scope->changes;
+      query = g_strdup(scope->query);
+    }
+  g_mutex_unlock(self->mutex);
+
+  return query;
+}
+
+gboolean sib_replica_reseed_scope(SIBReplica *self,
+				  guint id,
+				  guint mark,
+				  const gchar *results)
+{
+  SIBReplicaScope *scope = NULL;
+  GSList *triples = NULL;
+  GSList *item = NULL;
+  gboolean ok = FALSE;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+
+  if (results != NULL)
+    triples = sib_replica_parse(results, &ok);
+
+  g_mutex_lock(self->mutex);
+  scope = sib_replica_scope_find(self, id);
+  if (scope != NULL)
+    {
+      scope->claimed = FALSE;
+      /* a change while the query was out may be missing from the results */
+      ok = (ok && !scope->valid && mark == scope->changes);
+      if (ok)
+	{
+	  for (item = scope->templates; item != NULL; item = item->next)
+	    sib_replica_remove(self, (SIBTriple *)item->data);
+	  for (item = triples; item != NULL; item = item->next)
+	    sib_replica_add(self, (SIBTriple *)item->data);
+	  scope->sequence = -1;
+	  scope->valid = TRUE;
+	  self->reseeds++;
+	}
+    }
+  else
+    {
+      ok = FALSE;
+    }
+  g_mutex_unlock(self->mutex);
+
+  sib_triple_list_free(triples);
+  return ok;
+}
+
+gchar *sib_replica_query(SIBReplica *self, const gchar *templates)
+{
+  GSList *parsed = NULL;
+  GSList *item = NULL;
+  GSList *triples = NULL;
+  GPtrArray *matches = NULL;
+  GPtrArray *results = NULL;
+  GHashTable *seen = NULL;
+  SIBTriple *decoded = NULL;
+  GString *out = NULL;
+  gboolean ok = FALSE;
+  guint i;
+
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(templates != NULL, NULL);
+
+  parsed = sib_replica_parse(templates, &ok);
+
+  g_mutex_lock(self->mutex);
+  for (item = parsed; ok && item != NULL; item = item->next)
+    ok = sib_replica_in_scope(self, (SIBTriple *)item->data, TRUE);
+  if (!ok || parsed == NULL)
+    {
+      self->misses++;
+      g_mutex_unlock(self->mutex);
+      sib_triple_list_free(parsed);
+      return NULL;
+    }
+
+  /* a triple matching several templates is returned once */
+  matches = g_ptr_array_new();
+  results = g_ptr_array_new();
+  seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for (item = parsed; item != NULL; item = item->next)
+    {
+      g_ptr_array_set_size(matches, 0);
+      sib_replica_match(self, (SIBTriple *)item->data, matches);
+      for (i = 0; i < matches->len; i++)
+	{
+	  gpointer stored = g_ptr_array_index(matches, i);
+	  if (g_hash_table_lookup(seen, stored) == NULL)
+	    {
+	      g_hash_table_insert(seen, stored, stored);
+	      g_ptr_array_add(results, stored);
+	    }
+	}
+    }
+
+  /* the strings are borrowed from the dictionary */
+  decoded = g_new(SIBTriple, results->len + 1);
+  for (i = results->len; i > 0; i--)
+    {
+      sib_replica_decode(self, (SIBReplicaTriple *)g_ptr_array_index(results, i - 1),
+			 &decoded[i - 1]);
+      triples = g_slist_prepend(triples, &decoded[i - 1]);
+    }
+  out = g_string_new(NULL);
+  sib_triple_list_append(out, triples);
+  self->hits++;
+  g_mutex_unlock(self->mutex);
+
+  g_free(decoded);
+  g_slist_free(triples);
+  g_hash_table_destroy(seen);
+  g_ptr_array_free(results, TRUE);
+  g_ptr_array_free(matches, TRUE);
+  sib_triple_list_free(parsed);
+  return g_string_free(out, FALSE);
+}
+
+void sib_replica_get_stats(SIBReplica *self, SIBReplicaStats *stats)
+{
+  GSList *item = NULL;
+
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(stats != NULL);
+
+  g_mutex_lock(self->mutex);
+  stats->scopes = g_slist_length(self->scopes);
+  stats->invalid = 0;
+  for (item = self->scopes; item != NULL; item = item->next)
+    {
+      if (!((SIBReplicaScope *)item->data)->valid)
+	stats->invalid++;
+    }
+  stats->triples = self->triple_count;
+  stats->terms = self->term_count;
+  /* each triple is an entry in the three indexes */
+  stats->bytes = (self->term_bytes +
+		  self->term_count * SIB_REPLICA_ENTRY_BYTES +
+		  self->triple_count * (sizeof(SIBReplicaTriple) + 3 * SIB_REPLICA_ENTRY_BYTES));
+  stats->hits = self->hits;
+  stats->misses = self->misses;
+  stats->reseeds = self->reseeds;
+  g_mutex_unlock(self->mutex);
+}
@@ -0,0 +1,713 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_scheduler.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_executor.h"
+#include "sib_scheduler.h"
+
+/** A queued item */
+typedef struct _SIBSchedulerItem
+{
+  volatile gpointer next;  /* queue link */
+  gpointer data;
+  GTimeVal queued;
+} SIBSchedulerItem;
+
+/** The item a thread is running, see sib_scheduler_defer() */
+typedef struct _SIBSchedulerRun
+{
+  SIBScheduler *scheduler;
+  GTimeVal start;
+  gboolean deferred;
+} SIBSchedulerRun;
+
+/**
+ * Queue of one priority class. Producers swing head without a lock; the
+ * runner holding the scheduler's take flag removes items from tail.
+ */
+typedef struct _SIBSchedulerQueue
+{
+  volatile gpointer head;
+  SIBSchedulerItem *tail;
+  SIBSchedulerItem stub;
+  volatile gint depth;
+} SIBSchedulerQueue;
+
+/*
+ * Pushing an item and dispatching runners take no lock: the counters are
+ * atomic and each class is a lock-free queue. Runners of one scheduler
+ * take items one at a time through the take flag, which is held only
+ * while an item is picked. The mutex serializes sib_scheduler_estimate() and
+ * the readers of its results.
+ */
+struct _SIBScheduler
+{
+  SIBExecutor *executor;
+  GFunc func;
+  gpointer user_data;
+
+  /* The owner and each dispatched runner hold a reference */
+  volatile gint refcount;
+  volatile gint destroyed;
+
+  SIBSchedulerQueue queue[SIBSchedulerClassCount];
+  volatile gint taking;
+  volatile gint queued;     /* pushed and not yet taken */
+  guint max_queued;
+  volatile gint running;    /* runners running an item */
+  volatile gint dispatched; /* runners submitted to the executor, at most threads */
+  volatile gint threads;
+
+  volatile gint peak[SIBSchedulerClassCount];
+  volatile gint pushed[SIBSchedulerClassCount];
+  volatile gint rejected[SIBSchedulerClassCount];
+
+  /* Written by the runner holding the take flag */
+  guint aged[SIBSchedulerClassCount];
+  guint max_wait[SIBSchedulerClassCount];
+  gdouble total_wait[SIBSchedulerClassCount];
+  guint run[SIBSchedulerClassCount];
+
+  /* Load since the previous sib_scheduler_estimate(), in ms */
+  volatile gint arrived;
+  volatile gint served;
+  volatile gint service_total;
+  volatile gint wait_total;
+  volatile gint waited;
+
+  /* Previous decision, under mutex */
+  GMutex *mutex;
+  GTimer *window;
+  gdouble arrival_rate;
+  gdouble service_time;
+  gdouble queue_wait;
+  guint target;
+};
+
+static GStaticPrivate sib_scheduler_current = G_STATIC_PRIVATE_INIT;
+
+static const guint sib_scheduler_aging[SIBSchedulerClassCount] =
+  {
+    SIB_SCHEDULER_AGING_CONTROL,
+    SIB_SCHEDULER_AGING_WRITE,
+    SIB_SCHEDULER_AGING_READ,
+    SIB_SCHEDULER_AGING_BULK
+  };
+
+static const gchar *sib_scheduler_names[SIBSchedulerClassCount] =
+  {
+    "control",
+    "write",
+    "read",
+    "bulk"
+  };
+
+static void sib_scheduler_run(gpointer data);
+
+static void sib_scheduler_dispatch(SIBScheduler *self);
+
+static SIBSchedulerItem *sib_scheduler_pop(SIBScheduler *self);
+
+static SIBSchedulerItem *sib_scheduler_take(SIBScheduler *self);
+
+static void sib_scheduler_lock_take(SIBScheduler *self);
+
+static void sib_scheduler_unlock_take(SIBScheduler *self);
+
+static void sib_scheduler_unref(SIBScheduler *self);
+
+static void sib_scheduler_count_service(SIBScheduler *self, GTimeVal *start);
+
+static void sib_scheduler_queue_init(SIBSchedulerQueue *q);
+
+static void sib_scheduler_queue_push(SIBSchedulerQueue *q,
+				     SIBSchedulerItem *item);
+
+static SIBSchedulerItem *sib_scheduler_queue_peek(SIBSchedulerQueue *q);
+
+static SIBSchedulerItem *sib_scheduler_queue_pop(SIBSchedulerQueue *q);
+
+static gint sib_scheduler_take_count(volatile gint *counter);
+
+static guint sib_scheduler_elapsed(GTimeVal *from, GTimeVal *to);
+
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+SIBScheduler *sib_scheduler_new(SIBExecutor *executor,
+				GFunc func,
+				gpointer user_data,
+				gint max_threads,
+				guint max_queued)
+{
+  SIBScheduler *self = NULL;
+  gint i;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(executor != NULL, NULL);
+  g_return_val_if_fail(func != NULL, NULL);
+
+  self = g_new0(SIBScheduler, 1);
+  self->executor = executor;
+  self->func = func;
+  self->user_data = user_data;
+  self->refcount = 1;
+  self->max_queued = max_queued;
+  self->threads = max_threads;
+  self->window = g_timer_new();
+  self->mutex = g_mutex_new();
+  for (i = 0; i < SIBSchedulerClassCount; i++)
+    sib_scheduler_queue_init(&self->queue[i]);
+
+  whiteboard_log_debug_fe();
+  return self;
+}
+
+void sib_scheduler_destroy(SIBScheduler *self)
+{
+  whiteboard_log_debug_fb();
+
+  g_return_if_fail(self != NULL);
+
+  g_atomic_int_compare_and_exchange(&self->destroyed, 0, 1);
+
+  /* Dispatched runners keep their reference until they return */
+  sib_scheduler_unref(self);
+
+  whiteboard_log_debug_fe();
+}
+
+gboolean sib_scheduler_push(SIBScheduler *self,
+			    SIBSchedulerClass klass,
+			    gpointer data)
+{
+  SIBSchedulerItem *item = NULL;
+  gint queued;
+  gint depth;
+  gint peak;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(klass < SIBSchedulerClassCount, FALSE);
+
+  /* The place in the queue is reserved before the item is linked */
+  queued = g_atomic_int_exchange_and_add(&self->queued, 1);
+  if (g_atomic_int_get(&self->destroyed) ||
+      (self->max_queued > 0 && (guint)queued >= self->max_queued))
+    {
+      g_atomic_int_add(&self->queued, -1);
+      g_atomic_int_inc(&self->rejected[klass]);
+      return FALSE;
+    }
+
+  item = g_new(SIBSchedulerItem, 1);
+  item->data = data;
+  g_get_current_time(&item->queued);
+
+  depth = g_atomic_int_exchange_and_add(&self->queue[klass].depth, 1) + 1;
+  do
+    peak = g_atomic_int_get(&self->peak[klass]);
+  while (depth > peak &&
+	 !g_atomic_int_compare_and_exchange(&self->peak[klass], peak, depth));
+  g_atomic_int_inc(&self->pushed[klass]);
+  g_atomic_int_inc(&self->arrived);
+
+  sib_scheduler_queue_push(&self->queue[klass], item);
+  sib_scheduler_dispatch(self);
+
+  return TRUE;
+}
+
+void sib_scheduler_set_max_threads(SIBScheduler *self, gint max_threads)
+{
+  g_return_if_fail(self != NULL);
+
+  g_mutex_lock(self->mutex);
+  self->threads = max_threads;
+  g_mutex_unlock(self->mutex);
+  sib_scheduler_dispatch(self);
+}
+
+gboolean sib_scheduler_defer(SIBScheduler *self, GTimeVal *started)
+{
+  SIBSchedulerRun *run = NULL;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(started != NULL, FALSE);
+
+  run = (SIBSchedulerRun *)g_static_private_get(&sib_scheduler_current);
+  if (run == NULL || run->scheduler != self || run->deferred)
+    return FALSE;
+
+  /* The completion keeps the scheduler until it is counted */
+  run->deferred = TRUE;
+  *started = run->start;
+  g_atomic_int_inc(&self->refcount);
+  return TRUE;
+}
+
+void sib_scheduler_complete(SIBScheduler *self, GTimeVal *started)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(started != NULL);
+
+  sib_scheduler_count_service(self, started);
+  sib_scheduler_unref(self);
+}
+
+guint sib_scheduler_estimate(SIBScheduler *self)
+{
+  gdouble period;
+  gdouble busy;
+  gdouble backlog;
+  gdouble waiting;
+  guint served;
+  guint service;
+  guint waited;
+  guint wait;
+  guint queued;
+  guint target;
+  guint threads;
+
+  g_return_val_if_fail(self != NULL, 0);
+
+  g_mutex_lock(self->mutex);
+  period = g_timer_elapsed(self->window, NULL);
+  g_timer_start(self->window);
+  threads = g_atomic_int_get(&self->threads);
+  if (period <= 0.0 || g_atomic_int_get(&self->destroyed))
+    {
+      g_mutex_unlock(self->mutex);
+      return threads;
+    }
+
+  /* Keep the previous service time estimate over idle periods */
+  self->arrival_rate = sib_scheduler_take_count(&self->arrived) / period;
+  served = sib_scheduler_take_count(&self->served);
+  service = sib_scheduler_take_count(&self->service_total);
+  if (served > 0)
+    self->service_time = (gdouble)service / served;
+  waited = sib_scheduler_take_count(&self->waited);
+  wait = sib_scheduler_take_count(&self->wait_total);
+  self->queue_wait = waited > 0 ? (gdouble)wait / waited : 0.0;
+  queued = g_atomic_int_get(&self->queued);
+
+  busy = self->arrival_rate * self->service_time / 1000.0;
+  busy += busy * SIB_SCHEDULER_HEADROOM / 100.0;
+  backlog = queued * self->service_time / 1000.0 / period;
+  target = (guint)(busy + backlog + 0.999);
+
+  /* Waiting longer than the goal means the estimate runs short, e.g.
+     while the service time is still off: add the items waiting on
+     average, the arrival rate times the wait by Little's law */
+  if (self->queue_wait > SIB_SCHEDULER_WAIT_GOAL)
+    {
+      waiting = self->arrival_rate * self->queue_wait / 1000.0;
+      target = MAX(target, threads + (guint)(waiting + 0.999));
+    }
+  self->target = target;
+
+  if (target >= threads)
+    threads = target;
+  else
+    threads = threads - (threads - target + 1) / 2;
+  g_mutex_unlock(self->mutex);
+
+  return threads;
+}
+
+void sib_scheduler_get_load(SIBScheduler *self, SIBSchedulerLoad *load)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(load != NULL);
+
+  g_mutex_lock(self->mutex);
+  load->threads = g_atomic_int_get(&self->threads);
+  load->running = g_atomic_int_get(&self->running);
+  load->queued = g_atomic_int_get(&self->queued);
+  load->max_queued = self->max_queued;
+  load->arrival_rate = self->arrival_rate;
+  load->service_time = self->service_time;
+  load->queue_wait = self->queue_wait;
+  load->target = self->target;
+  g_mutex_unlock(self->mutex);
+}
+
+void sib_scheduler_get_stats(SIBScheduler *self,
+			     SIBSchedulerClass klass,
+			     SIBSchedulerStats *stats)
+{
+  g_return_if_fail(self != NULL);
+  g_return_if_fail(klass < SIBSchedulerClassCount);
+  g_return_if_fail(stats != NULL);
+
+  stats->depth = g_atomic_int_get(&self->queue[klass].depth);
+  stats->peak = g_atomic_int_get(&self->peak[klass]);
+  stats->pushed = g_atomic_int_get(&self->pushed[klass]);
+  stats->rejected = g_atomic_int_get(&self->rejected[klass]);
+
+  sib_scheduler_lock_take(self);
+  stats->aged = self->aged[klass];
+  stats->max_wait = self->max_wait[klass];
+  stats->avg_wait = self->run[klass] > 0 ?
+    self->total_wait[klass] / self->run[klass] : 0.0;
+  sib_scheduler_unlock_take(self);
+}
+
+const gchar *sib_scheduler_class_name(SIBSchedulerClass klass)
+{
+  g_return_val_if_fail(klass < SIBSchedulerClassCount, "unknown");
+  return sib_scheduler_names[klass];
+}
+
+/*****************************************************************************
+ * Static functions
+ *****************************************************************************/
+
+/**
+ * Submit runners for the queued items, as long as fewer than threads are
+ * dispatched. Called after each change of the counters it reads, so an
+ * item is never left without a runner.
+ *
+ * @param self The scheduler
+ */
+static void sib_scheduler_dispatch(SIBScheduler *self)
+{
+  gint dispatched;
+
+  while (g_atomic_int_get(&self->destroyed) == FALSE)
+    {
+      dispatched = g_atomic_int_get(&self->dispatched);
+      if (dispatched >= g_atomic_int_get(&self->threads) ||
+	  g_atomic_int_get(&self->queued) <= dispatched - g_atomic_int_get(&self->running))
+	break;
+
+      if (g_atomic_int_compare_and_exchange(&self->dispatched,
+					    dispatched, dispatched + 1))
+	{
+	  g_atomic_int_inc(&self->refcount);
+	  sib_executor_submit(self->executor, sib_scheduler_run, self);
+	}
+    }
+}
+
+/**
+ * Executor task: run the best queued item. The item is picked when the
+ * runner gets to run, not when it was submitted.
+ *
+ * @param data The SIBScheduler
+ */
+static void sib_scheduler_run(gpointer data)
+{
+  SIBScheduler *self = (SIBScheduler *)data;
+  SIBSchedulerItem *item = NULL;
+  SIBSchedulerRun *outer = NULL;
+  SIBSchedulerRun run;
+
+  item = sib_scheduler_pop(self);
+  if (item != NULL)
+    {
+      run.scheduler = self;
+      run.deferred = FALSE;
+      g_get_current_time(&run.start);
+      outer = (SIBSchedulerRun *)g_static_private_get(&sib_scheduler_current);
+      g_static_private_set(&sib_scheduler_current, &run, NULL);
+      self->func(item->data, self->user_data);
+      g_static_private_set(&sib_scheduler_current, outer, NULL);
+      g_free(item);
+
+      if (run.deferred == FALSE)
+	sib_scheduler_count_service(self, &run.start);
+      g_atomic_int_add(&self->running, -1);
+    }
+  g_atomic_int_add(&self->dispatched, -1);
+  sib_scheduler_dispatch(self);
+
+  sib_scheduler_unref(self);
+}
+
+/**
+ * Add the service time of an item that completed now.
+ *
+ * @param self The scheduler
+ * @param start When the item started to run
+ */
+static void sib_scheduler_count_service(SIBScheduler *self, GTimeVal *start)
+{
+  GTimeVal end;
+
+  g_get_current_time(&end);
+  g_atomic_int_add(&self->service_total, sib_scheduler_elapsed(start, &end));
+  g_atomic_int_inc(&self->served);
+}
+
+/**
+ * Drop a reference, freeing the scheduler with the last one.
+ *
+ * @param self The scheduler
+ */
+static void sib_scheduler_unref(SIBScheduler *self)
+{
+  if (g_atomic_int_dec_and_test(&self->refcount) == FALSE)
+    return;
+
+  g_mutex_free(self->mutex);
+  g_timer_destroy(self->window);
+  g_free(self);
+}
+
+/**
+ * Take an item for a runner. While items are queued, one of them is
+ * taken, waiting for the take flag or for an item that is still being
+ * linked. There is at most one runner per queued item.
+ *
+ * @param self The scheduler
+ * @return The item or NULL if none is queued
+ */
+static SIBSchedulerItem *sib_scheduler_pop(SIBScheduler *self)
+{
+  SIBSchedulerItem *item = NULL;
+
+  while (item == NULL && g_atomic_int_get(&self->queued) > 0)
+    {
+      if (g_atomic_int_compare_and_exchange(&self->taking, 0, 1))
+	{
+	  item = sib_scheduler_take(self);
+	  sib_scheduler_unlock_take(self);
+	}
+      if (item == NULL)
+	g_thread_yield();
+    }
+
+  return item;
+}
+
+/**
+ * Take the next item to run: the oldest item that has waited longer than
+ * the aging limit of its class, otherwise the head of the highest non-empty
+ * class. Called with the take flag held.
+ *
+ * @param self The scheduler
+ * @return The item or NULL if all queues are empty
+ */
+static SIBSchedulerItem *sib_scheduler_take(SIBScheduler *self)
+{
+  SIBSchedulerItem *item = NULL;
+  GTimeVal now;
+  gint klass = -1;
+  gint first = -1;
+  guint wait = 0;
+  guint oldest = 0;
+  gint i;
+
+  g_get_current_time(&now);
+
+  for (i = 0; i < SIBSchedulerClassCount; i++)
+    {
+      item = sib_scheduler_queue_peek(&self->queue[i]);
+      if (item == NULL)
+	continue;
+
+      if (first < 0)
+	first = i;
+
+      wait = sib_scheduler_elapsed(&item->queued, &now);
+      if (i > first && wait > sib_scheduler_aging[i] &&
+	  (klass < 0 || wait > oldest))
+	{
+	  klass = i;
+	  oldest = wait;
+	}
+    }
+
+  if (klass < 0)
+    klass = first;
+  else
+    self->aged[klass]++;
+
+  if (klass < 0)
+    return NULL;
+
+  item = sib_scheduler_queue_pop(&self->queue[klass]);
+  if (item == NULL)
+    return NULL;
+
+  /* running first, so the runners never look short of items */
+  g_atomic_int_inc(&self->running);
+  g_atomic_int_add(&self->queued, -1);
+  g_atomic_int_add(&self->queue[klass].depth, -1);
+
+  wait = sib_scheduler_elapsed(&item->queued, &now);
+  if (wait > self->max_wait[klass])
+    self->max_wait[klass] = wait;
+  self->total_wait[klass] += wait;
+  self->run[klass]++;
+  g_atomic_int_add(&self->wait_total, wait);
+  g_atomic_int_inc(&self->waited);
+
+  return item;
+}
+
+/**
+ * Wait for the take flag, e.g. to read the counters of the runners.
+ */
+static void sib_scheduler_lock_take(SIBScheduler *self)
+{
+  while (g_atomic_int_compare_and_exchange(&self->taking, 0, 1) == FALSE)
+    g_thread_yield();
+}
+
+static void sib_scheduler_unlock_take(SIBScheduler *self)
+{
+  g_atomic_int_compare_and_exchange(&self->taking, 1, 0);
+}
+
+static void sib_scheduler_queue_init(SIBSchedulerQueue *q)
+{
+  q->stub.next = NULL;
+  q->head = &q->stub;
+  q->tail = &q->stub;
+  q->depth = 0;
+}
+
+/**
+ * Append an item. Lock-free, any thread.
+ */
+static void sib_scheduler_queue_push(SIBSchedulerQueue *q,
+				     SIBSchedulerItem *item)
+{
+  SIBSchedulerItem *prev = NULL;
+
+  item->next = NULL;
+  do
+    prev = (SIBSchedulerItem *)g_atomic_pointer_get(&q->head);
+  while (g_atomic_pointer_compare_and_exchange(&q->head, prev, item) == FALSE);
+
+  /* The taker sees the item once it is linked */
+  g_atomic_pointer_compare_and_exchange(&prev->next, NULL, item);
+}
+
+/**
+ * Get the oldest item without removing it. Called with the take flag
+ * held.
+ *
+ * @return The item or NULL if empty or not linked yet
+ */
+static SIBSchedulerItem *sib_scheduler_queue_peek(SIBSchedulerQueue *q)
+{
+  SIBSchedulerItem *tail = q->tail;
+
+  if (tail == &q->stub)
+    tail = (SIBSchedulerItem *)g_atomic_pointer_get(&tail->next);
+  return tail;
+}
+
+/**
+ * Remove the oldest item. Called with the take flag held.
+ *
+ * @return The item or NULL if empty, or if the next item is still being
+ *         linked
+ */
+static SIBSchedulerItem *sib_scheduler_queue_pop(SIBSchedulerQueue *q)
+{
+  SIBSchedulerItem *tail = q->tail;
+  SIBSchedulerItem *next = (SIBSchedulerItem *)g_atomic_pointer_get(&tail->next);
+
+  if (tail == &q->stub)
+    {
+      if (next == NULL)
+	return NULL;
+      q->tail = next;
+      tail = next;
+      next = (SIBSchedulerItem *)g_atomic_pointer_get(&next->next);
+    }
+
+  if (next != NULL)
+    {
+      q->tail = next;
+      return tail;
+    }
+
+  if (tail != (SIBSchedulerItem *)g_atomic_pointer_get(&q->head))
+    return NULL;
+
+  /* tail is the last item: put the stub behind it so it can be removed */
+  sib_scheduler_queue_push(q, &q->stub);
+  next = (SIBSchedulerItem *)g_atomic_pointer_get(&tail->next);
+  if (next != NULL)
+    {
+      q->tail = next;
+      return tail;
+    }
+
+  return NULL;
+}
+
+/**
+ * Read a counter and reset it to zero.
+ */
+static gint sib_scheduler_take_count(volatile gint *counter)
+{
+  gint value;
+
+  do
+    value = g_atomic_int_get(counter);
+  while (g_atomic_int_compare_and_exchange(counter, value, 0) == FALSE);
+  return value;
+}
+
+/**
+ * Milliseconds between two times, 0 if to is before from.
+ */
+static guint sib_scheduler_elapsed(GTimeVal *from, GTimeVal *to)
+{
+  glong ms = (to->tv_sec - from->tv_sec) * 1000 +
+    (to->tv_usec - from->tv_usec) / 1000;
+
+  return ms > 0 ? (guint)ms : 0;
+}
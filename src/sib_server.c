@@ -64,6 +64,12 @@ struct _SIBServer
 
   // subscription id -> WhiteboardNodeHandle
   GHashTable *subscription_map;
+
+  // triples of template subscriptions, NULL if not kept
+  SIBReplica *replica;
+
+  // request scheduler, see serverthread_push()
+  volatile gpointer bulkhead;
   
   //  GMutex* mutex;
   gint refcount;
@@ -81,6 +87,15 @@ struct _SIBServer
 static WhiteBoardSIBAccess* sib_server_create_whiteboard_sib_access(SIBServer* server,
 								    SIBService* service);
 
+/**
+ * Wrap a request argument of a D-Bus call in a payload without copying
+ *
+ * @param handle The handle of the call
+ * @param request The request argument
+ */
+static SIBPayload *sib_server_request_payload(WhiteBoardSIBAccessHandle* handle,
+					      guchar *request);
+
 /*****************************************************************************
  * Construction/destruction
  *****************************************************************************/
@@ -110,6 +125,9 @@ SIBServer* sib_server_new(SIBService* service,
   server->name =  (guchar *)g_strdup( (gchar *)name);
   server->whiteboard_sib_access = sib_server_create_whiteboard_sib_access(server,
 									  service);
+#ifdef WITH_REPLICA
+  server->replica = sib_replica_new();
+#endif
 
   server->refcount = 1;
   //	server->mutex = g_mutex_new();
@@ -183,6 +201,20 @@ static WhiteBoardSIBAccess* sib_server_create_whiteboard_sib_access(SIBServer* s
   return whiteboard_sib_access;
 }
 
+/*
+ * The arguments of a D-Bus call point into its message, which the
+ * handle holds until the handle's last reference is dropped. The
+ * payload keeps a handle reference instead of a copy of the request.
+ */
+static SIBPayload *sib_server_request_payload(WhiteBoardSIBAccessHandle* handle,
+					      guchar *request)
+{
+  whiteboard_sib_access_handle_ref(handle);
+  return sib_payload_new_wrap((const gchar *)request, -1,
+			      (GDestroyNotify)whiteboard_sib_access_handle_unref,
+			      handle);
+}
+
 /**
  * Destroy a UPnP server struct
  *
@@ -197,6 +229,8 @@ static gboolean sib_server_destroy(SIBServer* server)
   //	g_return_val_if_fail(server->mutex != NULL, FALSE);
 
 
+  serverthread_release(server);
+
   /* Free the UDN string */
   if (server->udn)
     g_free(server->udn);
@@ -210,6 +244,9 @@ static gboolean sib_server_destroy(SIBServer* server)
 
   if(server->name)
     g_free(server->name);
+
+  if(server->replica)
+    sib_replica_destroy(server->replica);
 	
   /* Destroy the Whiteboard_Sib_Access instance */
   if (server->whiteboard_sib_access)
@@ -331,6 +368,40 @@ SIBAccess *sib_server_get_sib_access(SIBServer* self)
   return self->access;
 }
 
+SIBReplica *sib_server_get_replica(SIBServer* self)
+{
+  g_return_val_if_fail(self != NULL, NULL);
+  return self->replica;
+}
+
+volatile gpointer *sib_server_get_bulkhead(SIBServer* self)
+{
+  g_return_val_if_fail(self != NULL, NULL);
+  return &self->bulkhead;
+}
+
+/**
+ * Periodic maintenance of the server's SIB access
+ *
+ * @param self An SIBServer instance
+ */
+void sib_server_maintenance(SIBServer* self)
+{
+  SIBReplicaStats stats;
+
+  g_return_if_fail(self != NULL);
+  if(self->access)
+    sib_access_maintenance(self->access);
+  if(self->replica)
+    {
+      sib_replica_get_stats(self->replica, &stats);
+      whiteboard_log_debug("Replica of %s: %u triples, %u terms, ~%lu bytes, "
+			   "%u scopes (%u invalid, %u re-seeds), hits %u, misses %u\n",
+			   self->udn, stats.triples, stats.terms, (gulong)stats.bytes,
+			   stats.scopes, stats.invalid, stats.reseeds, stats.hits, stats.misses);
+    }
+}
+
 
 void sib_server_join_cb(WhiteBoardSIBAccess* source,
 			WhiteBoardSIBAccessHandle* handle,
@@ -428,6 +499,7 @@ void sib_server_insert_cb(WhiteBoardSIBAccess* source,
   
   SIBServer* server = NULL;
   SIBService* service = NULL;
+  SIBPayload *payload = NULL;
 
   whiteboard_log_debug_fb();
   
@@ -443,7 +515,9 @@ void sib_server_insert_cb(WhiteBoardSIBAccess* source,
   sib_server_ref(server);
   sib_service_unlock(service);
   
-  serverthread_insert(server, handle, nodeid, siburi, msgnumber, encoding, request);
+  payload = sib_server_request_payload(handle, request);
+  serverthread_insert(server, handle, nodeid, siburi, msgnumber, encoding, payload);
+  sib_payload_unref(payload);
   sib_server_unref(server);
   
   
@@ -470,6 +544,8 @@ void sib_server_update_cb(WhiteBoardSIBAccess* source,
   
   SIBServer* server = NULL;
   SIBService* service = NULL;
+  SIBPayload *insert_payload = NULL;
+  SIBPayload *remove_payload = NULL;
 
   whiteboard_log_debug_fb();
   
@@ -485,7 +561,11 @@ void sib_server_update_cb(WhiteBoardSIBAccess* source,
   sib_server_ref(server);
   sib_service_unlock(service);
   
-  serverthread_update(server, handle, nodeid, siburi, msgnumber, encoding, insert_request, remove_request);
+  insert_payload = sib_server_request_payload(handle, insert_request);
+  remove_payload = sib_server_request_payload(handle, remove_request);
+  serverthread_update(server, handle, nodeid, siburi, msgnumber, encoding, insert_payload, remove_payload);
+  sib_payload_unref(insert_payload);
+  sib_payload_unref(remove_payload);
   sib_server_unref(server);
   whiteboard_log_debug_fe();
 }
@@ -507,6 +587,7 @@ void sib_server_remove_cb(WhiteBoardSIBAccess* source,
 
   SIBServer* server = NULL;
   SIBService* service = NULL;
+  SIBPayload *payload = NULL;
 
   whiteboard_log_debug_fb();
   
@@ -522,7 +603,9 @@ void sib_server_remove_cb(WhiteBoardSIBAccess* source,
   sib_server_ref(server);
   sib_service_unlock(service);
   
-  serverthread_remove(server, handle, nodeid, siburi, msgnumber, encoding, request);
+  payload = sib_server_request_payload(handle, request);
+  serverthread_remove(server, handle, nodeid, siburi, msgnumber, encoding, payload);
+  sib_payload_unref(payload);
   sib_server_unref(server);
   
   whiteboard_log_debug_fe();
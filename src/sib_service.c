@@ -52,6 +52,9 @@
 
 #include "serverthread.h"
 
+/** Interval of the periodic maintenance (idle connection eviction and
+    statistics dump), in seconds */
+#define SIB_SERVICE_MAINTENANCE_INTERVAL 30
 
 /*****************************************************************************
  * Structure definitions
@@ -69,6 +72,8 @@ struct _SIBService
   GMutex* mutex;
   
   WhiteBoardSIBAccess  *control_channel;
+
+  guint maintenance_id;
 };
 
 static SIBService* service_singleton = NULL;
@@ -87,6 +92,8 @@ static void sib_service_shutdown_cb(WhiteBoardNode* context,
 
 static void sib_service_device_listener( SIBDeviceStatus status, SIBServerData *ssdata, gpointer user_data);
 
+static gboolean sib_service_maintenance_cb(gpointer user_data);
+
 /*****************************************************************************
  * Creation/destruction
  *****************************************************************************/
@@ -257,6 +264,10 @@ gint sib_service_start(SIBService* service)
 		       (GCallback) sib_service_shutdown_cb,
 		       NULL);
 
+      service->maintenance_id = g_timeout_add(SIB_SERVICE_MAINTENANCE_INTERVAL * 1000,
+					      sib_service_maintenance_cb,
+					      service);
+
       //serverthread_create_listener();
       g_main_loop_run(service->main_loop);
     }
@@ -315,6 +326,11 @@ gint sib_service_stop(SIBService* service)
 
   if (g_main_loop_is_running(service->main_loop) == TRUE)
     {
+      if (service->maintenance_id != 0)
+	{
+	  g_source_remove(service->maintenance_id);
+	  service->maintenance_id = 0;
+	}
       sib_controller_stop(service->controller);
       service->ctrl_running = FALSE;
       
@@ -495,6 +511,33 @@ static void sib_service_shutdown_cb(WhiteBoardNode* context,
   whiteboard_log_debug_fe();
 }
 
+/**
+ * Periodic maintenance of all known servers.
+ *
+ * @param user_data The SIBService instance
+ * @return TRUE to keep the timeout
+ */
+static gboolean sib_service_maintenance_cb(gpointer user_data)
+{
+  SIBService *service = (SIBService *)user_data;
+  GList *item = NULL;
+  whiteboard_log_debug_fb();
+
+  g_return_val_if_fail(service != NULL, FALSE);
+
+  sib_service_lock(service);
+  for (item = service->siblist; item != NULL; item = item->next)
+    {
+      sib_server_maintenance((SIBServer *)item->data);
+    }
+  sib_service_unlock(service);
+
+  serverthread_maintenance();
+
+  whiteboard_log_debug_fe();
+  return TRUE;
+}
+
 static void sib_service_device_listener(SIBDeviceStatus status, SIBServerData *ssdata, gpointer user_data)
 {
   SIBService *service = NULL;
@@ -0,0 +1,396 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_transport.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <h_in/h_bsdapi.h>
+
+#include <glib.h>
+#include <whiteboard_log.h>
+
+#include "sib_transport.h"
+
+/* NoTA service id of the SIB */
+#define SID_M3SIB 10
+
+/* Urgh, global to access nota */
+extern h_in_t* instance;
+
+/*****************************************************************************
+ * NoTA H_IN
+ *****************************************************************************/
+
+static int sib_transport_hin_connect(const gchar *ip, gint port)
+{
+  int s;
+  nota_addr_t sib_addr = {SID_M3SIB,0};     // at SID 10
+
+  s = Hsocket(instance, AF_NOTA, SOCK_STREAM, 0);
+  if(s < 0)
+    {
+      whiteboard_log_warning("Could not open socket\n");
+      return -1;
+    }
+
+  if( Hconnect( instance, s, (struct sockaddr *)&sib_addr, sizeof(sib_addr)) < 0)
+    {
+      whiteboard_log_warning("Could not connect socket\n");
+      Hclose(instance, s);
+      return -1;
+    }
+  return s;
+}
+
+static gint sib_transport_hin_send(int s, const gchar *buf, gint len)
+{
+  return Hsend(instance, s, buf, len, 0);
+}
+
+static gint sib_transport_hin_recv(int s, gchar *buf, gint len)
+{
+  return Hrecv(instance, s, buf, len, 0);
+}
+
+static gint sib_transport_hin_shutdown(int s, int how)
+{
+  /* H_IN has no shutdown of its own, its sockets accept the libc call */
+  return shutdown(s, how);
+}
+
+static void sib_transport_hin_close(int s)
+{
+  Hclose(instance, s);
+}
+
+/* H_IN has no poll of its own, so a poll set is waited on with Hselect */
+static gint sib_transport_hin_poll(struct pollfd *fds, guint nfds, gint timeout)
+{
+  fd_set readfds;
+  struct timeval tv;
+  int maxfd = -1;
+  gint ready = 0;
+  guint i = 0;
+
+  FD_ZERO(&readfds);
+  for(i = 0; i < nfds; i++)
+    {
+      fds[i].revents = 0;
+      if(fds[i].fd < 0 || fds[i].fd >= FD_SETSIZE)
+	{
+	  errno = EINVAL;
+	  return -1;
+	}
+      FD_SET(fds[i].fd, &readfds);
+      maxfd = MAX(maxfd, fds[i].fd);
+    }
+
+  tv.tv_sec = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000;
+  ready = Hselect(instance, maxfd + 1, &readfds, NULL, NULL,
+		  (timeout < 0 ? NULL : &tv));
+  if(ready <= 0)
+    return ready;
+
+  for(i = 0; i < nfds; i++)
+    {
+      if(FD_ISSET(fds[i].fd, &readfds))
+	fds[i].revents = POLLIN;
+    }
+  return ready;
+}
+
+static const SIBTransport sib_transport_hin_ops =
+  {
+    "h_in",
+    sib_transport_hin_connect,
+    sib_transport_hin_send,
+    sib_transport_hin_recv,
+    sib_transport_hin_shutdown,
+    sib_transport_hin_close,
+    sib_transport_hin_poll,
+    FD_SETSIZE
+  };
+
+/*****************************************************************************
+ * TCP/IP
+ *****************************************************************************/
+
+static void sib_transport_tcp_tune(int s)
+{
+  int on = 1;
+  int value;
+
+  /* requests are small and written at once, do not wait to coalesce */
+  if(setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0)
+    whiteboard_log_warning("Could not set TCP_NODELAY: %s\n", strerror(errno));
+
+  /* notice dead SIBs on idle pooled and subscription connections */
+  if(setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) < 0)
+    whiteboard_log_warning("Could not set SO_KEEPALIVE: %s\n", strerror(errno));
+#ifdef TCP_KEEPIDLE
+  value = SIB_TRANSPORT_TCP_KEEPIDLE;
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value));
+#endif
+#ifdef TCP_KEEPINTVL
+  value = SIB_TRANSPORT_TCP_KEEPINTVL;
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value));
+#endif
+#ifdef TCP_KEEPCNT
+  value = SIB_TRANSPORT_TCP_KEEPCNT;
+  setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value));
+#endif
+  (void)value;
+}
+
+static int sib_transport_tcp_connect(const gchar *ip, gint port)
+{
+  struct addrinfo hints;
+  struct addrinfo *res = NULL;
+  struct addrinfo *ai = NULL;
+  gchar service[16];
+  int s = -1;
+  int err;
+
+  g_return_val_if_fail(ip != NULL, -1);
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  g_snprintf(service, sizeof(service), "%d", port);
+
+  err = getaddrinfo(ip, service, &hints, &res);
+  if(err != 0)
+    {
+      whiteboard_log_warning("Could not resolve %s: %s\n", ip, gai_strerror(err));
+      return -1;
+    }
+
+  for(ai = res; ai != NULL; ai = ai->ai_next)
+    {
+      s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if(s < 0)
+	continue;
+      if(connect(s, ai->ai_addr, ai->ai_addrlen) == 0)
+	break;
+      close(s);
+      s = -1;
+    }
+  freeaddrinfo(res);
+
+  if(s < 0)
+    {
+      whiteboard_log_warning("Could not connect to %s:%d\n", ip, port);
+      return -1;
+    }
+  sib_transport_tcp_tune(s);
+  return s;
+}
+
+static gint sib_transport_tcp_send(int s, const gchar *buf, gint len)
+{
+  gint n;
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL; // a closed connection is an error, not SIGPIPE
+#else
+  const int flags = 0;
+#endif
+  do
+    {
+      n = send(s, buf, len, flags);
+    }
+  while(n < 0 && errno == EINTR);
+  return n;
+}
+
+static gint sib_transport_tcp_recv(int s, gchar *buf, gint len)
+{
+  gint n;
+  do
+    {
+      n = recv(s, buf, len, 0);
+    }
+  while(n < 0 && errno == EINTR);
+  return n;
+}
+
+static gint sib_transport_tcp_shutdown(int s, int how)
+{
+  return shutdown(s, how);
+}
+
+static void sib_transport_tcp_close(int s)
+{
+  close(s);
+}
+
+static gint sib_transport_tcp_poll(struct pollfd *fds, guint nfds, gint timeout)
+{
+  return poll(fds, nfds, timeout);
+}
+
+static const SIBTransport sib_transport_tcp_ops =
+  {
+    "tcp",
+    sib_transport_tcp_connect,
+    sib_transport_tcp_send,
+    sib_transport_tcp_recv,
+    sib_transport_tcp_shutdown,
+    sib_transport_tcp_close,
+    sib_transport_tcp_poll,
+    0
+  };
+
+/*****************************************************************************
+ * Unix domain sockets
+ *****************************************************************************/
+
+static int sib_transport_unix_connect(const gchar *ip, gint port)
+{
+  struct sockaddr_un addr;
+  const gchar *path = NULL;
+  int size = SIB_TRANSPORT_UNIX_BUFSIZE;
+  int s;
+
+  g_return_val_if_fail(ip != NULL, -1);
+  g_return_val_if_fail(g_str_has_prefix(ip, SIB_TRANSPORT_UNIX_PREFIX), -1);
+
+  path = ip + strlen(SIB_TRANSPORT_UNIX_PREFIX);
+  if(strlen(path) >= sizeof(addr.sun_path))
+    {
+      whiteboard_log_warning("Socket path too long: %s\n", path);
+      return -1;
+    }
+
+  s = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(s < 0)
+    {
+      whiteboard_log_warning("Could not open socket\n");
+      return -1;
+    }
+
+  /* a query result usually fits in one read and write */
+  setsockopt(s, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if(connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      whiteboard_log_warning("Could not connect to %s: %s\n", path, strerror(errno));
+      close(s);
+      return -1;
+    }
+  return s;
+}
+
+/* apart from connecting, Unix domain sockets behave like TCP sockets */
+static const SIBTransport sib_transport_unix_ops =
+  {
+    "unix",
+    sib_transport_unix_connect,
+    sib_transport_tcp_send,
+    sib_transport_tcp_recv,
+    sib_transport_tcp_shutdown,
+    sib_transport_tcp_close,
+    sib_transport_tcp_poll,
+    0
+  };
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+const SIBTransport *sib_transport_hin(void)
+{
+  return &sib_transport_hin_ops;
+}
+
+const SIBTransport *sib_transport_tcp(void)
+{
+  return &sib_transport_tcp_ops;
+}
+
+const SIBTransport *sib_transport_unix(void)
+{
+  return &sib_transport_unix_ops;
+}
+
+const SIBTransport *sib_transport_for_address(const gchar *ip, gint port)
+{
+  if(ip != NULL && g_str_has_prefix(ip, SIB_TRANSPORT_UNIX_PREFIX))
+    return &sib_transport_unix_ops;
+  if(ip != NULL && *ip != '\0' && port > 0)
+    return &sib_transport_tcp_ops;
+  return &sib_transport_hin_ops;
+}
+
+gint sib_transport_send_all(const SIBTransport *transport, int s, const gchar *buf, gint len)
+{
+  gint total = 0;
+  gint n;
+
+  g_return_val_if_fail(transport != NULL, -1);
+
+  while(total < len)
+    {
+      n = transport->send(s, buf + total, len - total);
+      if(n < 0)
+	return -1;
+      total += n;
+    }
+  return 0;
+}
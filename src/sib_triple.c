@@ -0,0 +1,361 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_triple.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_triple.h"
+
+typedef enum _SIBTripleField
+  {
+    SIB_TRIPLE_FIELD_NONE,
+    SIB_TRIPLE_FIELD_SUBJECT,
+    SIB_TRIPLE_FIELD_PREDICATE,
+    SIB_TRIPLE_FIELD_OBJECT
+  } SIBTripleField;
+
+struct _SIBTripleParser
+{
+  GSList *triples;     // in reverse order
+  guint count;
+  SIBTriple *current;  // triple being parsed
+  SIBTripleField field;
+  GString *text;
+};
+
+/*****************************************************************************
+ * Triples
+ *****************************************************************************/
+
+SIBTriple *sib_triple_new(const gchar *subject,
+			  const gchar *predicate,
+			  const gchar *object,
+			  gboolean literal)
+{
+  SIBTriple *self = g_new0(SIBTriple, 1);
+  self->subject = g_strdup(subject);
+  self->predicate = g_strdup(predicate);
+  self->object = g_strdup(object);
+  self->literal = literal;
+  return self;
+}
+
+SIBTriple *sib_triple_copy(const SIBTriple *triple)
+{
+  g_return_val_if_fail(triple != NULL, NULL);
+  return sib_triple_new(triple->subject, triple->predicate, triple->object, triple->literal);
+}
+
+void sib_triple_free(SIBTriple *triple)
+{
+  if(triple == NULL)
+    return;
+  g_free(triple->subject);
+  g_free(triple->predicate);
+  g_free(triple->object);
+  g_free(triple);
+}
+
+/* NULL safe strcmp, g_strcmp0 is not available in older glib */
+static gint sib_triple_strcmp0(const gchar *a, const gchar *b)
+{
+  if(a == NULL || b == NULL)
+    return (a == b ? 0 : (a == NULL ? -1 : 1));
+  return strcmp(a, b);
+}
+
+static guint sib_triple_str_hash(const gchar *s)
+{
+  return (s != NULL ? g_str_hash(s) : 0);
+}
+
+guint sib_triple_hash(gconstpointer triple)
+{
+  const SIBTriple *t = (const SIBTriple *)triple;
+  return (sib_triple_str_hash(t->subject) * 31 +
+	  sib_triple_str_hash(t->predicate)) * 31 +
+    sib_triple_str_hash(t->object) + (t->literal ? 1 : 0);
+}
+
+gboolean sib_triple_equal(gconstpointer a, gconstpointer b)
+{
+  const SIBTriple *x = (const SIBTriple *)a;
+  const SIBTriple *y = (const SIBTriple *)b;
+  return (x->literal == y->literal &&
+	  sib_triple_strcmp0(x->subject, y->subject) == 0 &&
+	  sib_triple_strcmp0(x->predicate, y->predicate) == 0 &&
+	  sib_triple_strcmp0(x->object, y->object) == 0);
+}
+
+static gboolean sib_triple_field_matches(const gchar *value, const gchar *pattern)
+{
+  return (pattern == NULL || strcmp(pattern, SIB_TRIPLE_ANY) == 0 ||
+	  sib_triple_strcmp0(value, pattern) == 0);
+}
+
+gboolean sib_triple_matches(const SIBTriple *triple, const SIBTriple *pattern)
+{
+  g_return_val_if_fail(triple != NULL, FALSE);
+  g_return_val_if_fail(pattern != NULL, FALSE);
+
+  if(!sib_triple_field_matches(triple->subject, pattern->subject) ||
+     !sib_triple_field_matches(triple->predicate, pattern->predicate))
+    return FALSE;
+  if(pattern->object == NULL || strcmp(pattern->object, SIB_TRIPLE_ANY) == 0)
+    return TRUE;
+  return (triple->literal == pattern->literal &&
+	  sib_triple_strcmp0(triple->object, pattern->object) == 0);
+}
+
+/*****************************************************************************
+ * Triple list parsing
+ *****************************************************************************/
+
+SIBTripleParser *sib_triple_parser_new(void)
+{
+  SIBTripleParser *self = g_new0(SIBTripleParser, 1);
+  self->text = g_string_new(NULL);
+  return self;
+}
+
+void sib_triple_parser_start(SIBTripleParser *self,
+			     const gchar *element,
+			     const gchar **attribute_names,
+			     const gchar **attribute_values)
+{
+  gint i;
+
+  if(strcmp(element, "triple") == 0)
+    {
+      sib_triple_free(self->current);
+      self->current = g_new0(SIBTriple, 1);
+      self->field = SIB_TRIPLE_FIELD_NONE;
+      return;
+    }
+  if(self->current == NULL)
+    return;
+
+  if(strcmp(element, "subject") == 0)
+    self->field = SIB_TRIPLE_FIELD_SUBJECT;
+  else if(strcmp(element, "predicate") == 0)
+    self->field = SIB_TRIPLE_FIELD_PREDICATE;
+  else if(strcmp(element, "object") == 0)
+    {
+      self->field = SIB_TRIPLE_FIELD_OBJECT;
+      for(i = 0; attribute_names[i] != NULL; i++)
+	{
+	  if(strcmp(attribute_names[i], "type") == 0)
+	    self->current->literal = (g_ascii_strcasecmp(attribute_values[i], "literal") == 0);
+	}
+    }
+  else
+    return;
+  g_string_truncate(self->text, 0);
+}
+
+void sib_triple_parser_end(SIBTripleParser *self, const gchar *element)
+{
+  if(self->current == NULL)
+    return;
+
+  if(strcmp(element, "triple") == 0)
+    {
+      if(self->current->subject != NULL && self->current->predicate != NULL &&
+	 self->current->object != NULL)
+	{
+	  self->triples = g_slist_prepend(self->triples, self->current);
+	  self->count++;
+	}
+      else
+	{
+	  sib_triple_free(self->current);
+	}
+      self->current = NULL;
+      return;
+    }
+
+  switch(self->field)
+    {
+    case SIB_TRIPLE_FIELD_SUBJECT:
+      g_free(self->current->subject);
+      self->current->subject = g_strstrip(g_strdup(self->text->str));
+      break;
+    case SIB_TRIPLE_FIELD_PREDICATE:
+      g_free(self->current->predicate);
+      self->current->predicate = g_strstrip(g_strdup(self->text->str));
+      break;
+    case SIB_TRIPLE_FIELD_OBJECT:
+      g_free(self->current->object);
+      /* whitespace is significant in literals */
+      self->current->object = (self->current->literal ?
+			       g_strdup(self->text->str) :
+			       g_strstrip(g_strdup(self->text->str)));
+      break;
+    default:
+      break;
+    }
+  self->field = SIB_TRIPLE_FIELD_NONE;
+}
+
+void sib_triple_parser_text(SIBTripleParser *self, const gchar *text, gsize len)
+{
+  if(self->field != SIB_TRIPLE_FIELD_NONE)
+    g_string_append_len(self->text, text, len);
+}
+
+guint sib_triple_parser_get_count(SIBTripleParser *self)
+{
+  g_return_val_if_fail(self != NULL, 0);
+  return self->count;
+}
+
+GSList *sib_triple_parser_finish(SIBTripleParser *self)
+{
+  GSList *triples = NULL;
+  g_return_val_if_fail(self != NULL, NULL);
+
+  triples = g_slist_reverse(self->triples);
+  sib_triple_free(self->current);
+  g_string_free(self->text, TRUE);
+  g_free(self);
+  return triples;
+}
+
+static void sib_triple_list_start(GMarkupParseContext *context,
+				  const gchar *element,
+				  const gchar **attribute_names,
+				  const gchar **attribute_values,
+				  gpointer user_data,
+				  GError **error)
+{
+  sib_triple_parser_start((SIBTripleParser *)user_data, element,
+			  attribute_names, attribute_values);
+}
+
+static void sib_triple_list_end(GMarkupParseContext *context,
+				const gchar *element,
+				gpointer user_data,
+				GError **error)
+{
+  sib_triple_parser_end((SIBTripleParser *)user_data, element);
+}
+
+static void sib_triple_list_text(GMarkupParseContext *context,
+				 const gchar *text,
+				 gsize len,
+				 gpointer user_data,
+				 GError **error)
+{
+  sib_triple_parser_text((SIBTripleParser *)user_data, text, len);
+}
+
+GSList *sib_triple_list_parse(const gchar *text, gssize len, GError **error)
+{
+  static const GMarkupParser parser =
+    {
+      sib_triple_list_start,
+      sib_triple_list_end,
+      sib_triple_list_text,
+      NULL,
+      NULL
+    };
+  SIBTripleParser *collector = NULL;
+  GMarkupParseContext *context = NULL;
+  gboolean ok;
+
+  g_return_val_if_fail(text != NULL, NULL);
+
+  collector = sib_triple_parser_new();
+  context = g_markup_parse_context_new(&parser, 0, collector, NULL);
+  ok = (g_markup_parse_context_parse(context, text, len, error) &&
+	g_markup_parse_context_end_parse(context, error));
+  g_markup_parse_context_free(context);
+
+  if(!ok)
+    {
+      sib_triple_list_free(sib_triple_parser_finish(collector));
+      return NULL;
+    }
+  return sib_triple_parser_finish(collector);
+}
+
+/*****************************************************************************
+ * Triple list output
+ *****************************************************************************/
+
+void sib_triple_list_append(GString *out, GSList *triples)
+{
+  GSList *item = NULL;
+  gchar *s, *p, *o;
+
+  g_return_if_fail(out != NULL);
+
+  g_string_append(out, "<triple_list>");
+  for(item = triples; item != NULL; item = item->next)
+    {
+      SIBTriple *t = (SIBTriple *)item->data;
+      s = g_markup_escape_text(t->subject, -1);
+      p = g_markup_escape_text(t->predicate, -1);
+      o = g_markup_escape_text(t->object, -1);
+      g_string_append_printf(out,
+			     "<triple><subject type=\"uri\">%s</subject>"
+			     "<predicate>%s</predicate>"
+			     "<object type=\"%s\">%s</object></triple>",
+			     s, p, (t->literal ? "literal" : "uri"), o);
+      g_free(s);
+      g_free(p);
+      g_free(o);
+    }
+  g_string_append(out, "</triple_list>");
+}
+
+void sib_triple_list_free(GSList *triples)
+{
+  GSList *item = NULL;
+  for(item = triples; item != NULL; item = item->next)
+    sib_triple_free((SIBTriple *)item->data);
+  g_slist_free(triples);
+}
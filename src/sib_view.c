@@ -0,0 +1,349 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ * WhiteBoard SIB access component
+ *
+ * sib_view.c
+ *
+ * Copyright 2007 Nokia Corporation
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "sib_triple.h"
+#include "sib_view.h"
+
+/** Triples are kept in result order, the table maps each triple to its
+    link in the queue */
+struct _SIBView
+{
+  GHashTable *triples;
+  GQueue *order;
+  gint sequence;   // -1 until the first indication
+  gboolean stale;
+  gchar *results;  // rendered results, NULL after a change
+};
+
+static volatile gint sib_view_views = 0;
+static volatile gint sib_view_answers = 0;
+static volatile gint sib_view_indications = 0;
+static volatile gint sib_view_gaps = 0;
+static volatile gint sib_view_resets = 0;
+
+/*****************************************************************************
+ * Triple list parsing
+ *****************************************************************************/
+
+typedef struct _SIBViewParse
+{
+  SIBTripleParser *triples;
+  gboolean root_seen;
+  gboolean triple_list;  // the root element is a triple list
+} SIBViewParse;
+
+static void sib_view_parse_start(GMarkupParseContext *context,
+				 const gchar *element,
+				 const gchar **attribute_names,
+				 const gchar **attribute_values,
+				 gpointer user_data,
+				 GError **error)
+{
+  SIBViewParse *parse = (SIBViewParse *)user_data;
+
+  if (!parse->root_seen)
+    {
+      parse->root_seen = TRUE;
+      parse->triple_list = (strcmp(element, "triple_list") == 0);
+    }
+  sib_triple_parser_start(parse->triples, element, attribute_names, attribute_values);
+}
+
+static void sib_view_parse_end(GMarkupParseContext *context,
+			       const gchar *element,
+			       gpointer user_data,
+			       GError **error)
+{
+  sib_triple_parser_end(((SIBViewParse *)user_data)->triples, element);
+}
+
+static void sib_view_parse_text(GMarkupParseContext *context,
+				const gchar *text,
+				gsize len,
+				gpointer user_data,
+				GError **error)
+{
+  sib_triple_parser_text(((SIBViewParse *)user_data)->triples, text, len);
+}
+
+/**
+ * Parse a triple list, unlike sib_triple_list_parse() other documents are
+ * refused.
+ *
+ * @param text The triple list
+ * @param ok Set to FALSE if text is not a triple list
+ * @return List of SIBTriple
+ */
+static GSList *sib_view_parse(const gchar *text, gboolean *ok)
+{
+  static const GMarkupParser parser =
+    {
+      sib_view_parse_start,
+      sib_view_parse_end,
+      sib_view_parse_text,
+      NULL,
+      NULL
+    };
+  SIBViewParse parse;
+  GMarkupParseContext *context = NULL;
+  GSList *triples = NULL;
+
+  parse.triples = sib_triple_parser_new();
+  parse.root_seen = FALSE;
+  parse.triple_list = FALSE;
+
+  context = g_markup_parse_context_new(&parser, 0, &parse, NULL);
+  *ok = (g_markup_parse_context_parse(context, text, -1, NULL) &&
+	 g_markup_parse_context_end_parse(context, NULL) &&
+	 parse.triple_list);
+  g_markup_parse_context_free(context);
+
+  triples = sib_triple_parser_finish(parse.triples);
+  if (!*ok)
+    {
+      sib_triple_list_free(triples);
+      return NULL;
+    }
+  return triples;
+}
+
+/*****************************************************************************
+ * Contents
+ *****************************************************************************/
+
+/** Drop the contents of a view */
+static void sib_view_clear(SIBView *self)
+{
+  if (self->triples != NULL)
+    g_hash_table_destroy(self->triples);
+  if (self->order != NULL)
+    g_queue_free(self->order);
+  self->triples = g_hash_table_new_full(sib_triple_hash, sib_triple_equal,
+					(GDestroyNotify)sib_triple_free, NULL);
+  self->order = g_queue_new();
+  g_free(self->results);
+  self->results = NULL;
+}
+
+/** Add triples to a view, taking them over. Triples already in the view
+    are freed. */
+static void sib_view_add(SIBView *self, GSList *triples)
+{
+  GSList *item = NULL;
+
+  for (item = triples; item != NULL; item = item->next)
+    {
+      SIBTriple *triple = (SIBTriple *)item->data;
+      if (g_hash_table_lookup(self->triples, triple) != NULL)
+	{
+	  sib_triple_free(triple);
+	  continue;
+	}
+      g_queue_push_tail(self->order, triple);
+      g_hash_table_insert(self->triples, triple, g_queue_peek_tail_link(self->order));
+    }
+  g_slist_free(triples);
+}
+
+static void sib_view_remove(SIBView *self, GSList *triples)
+{
+  GSList *item = NULL;
+  GList *link = NULL;
+
+  for (item = triples; item != NULL; item = item->next)
+    {
+      link = (GList *)g_hash_table_lookup(self->triples, item->data);
+      if (link == NULL)
+	continue;
+      g_queue_delete_link(self->order, link);
+      g_hash_table_remove(self->triples, item->data);
+    }
+  sib_triple_list_free(triples);
+}
+
+/** Replace the contents of a view */
+static gboolean sib_view_load(SIBView *self, const gchar *results)
+{
+  GSList *triples = NULL;
+  gboolean ok = FALSE;
+
+  sib_view_clear(self);
+  self->sequence = -1;
+  triples = sib_view_parse(results, &ok);
+  self->stale = !ok;
+  sib_view_add(self, triples);
+  return ok;
+}
+
+/*****************************************************************************
+ * Public functions
+ *****************************************************************************/
+
+SIBView *sib_view_new(const gchar *results)
+{
+  SIBView *self = NULL;
+
+  g_return_val_if_fail(results != NULL, NULL);
+
+  self = g_new0(SIBView, 1);
+  g_atomic_int_inc(&sib_view_views);
+  if (!sib_view_load(self, results))
+    {
+      sib_view_free(self);
+      return NULL;
+    }
+  return self;
+}
+
+void sib_view_free(SIBView *self)
+{
+  g_return_if_fail(self != NULL);
+
+  if (self->triples != NULL)
+    g_hash_table_destroy(self->triples);
+  if (self->order != NULL)
+    g_queue_free(self->order);
+  g_free(self->results);
+  g_free(self);
+  g_atomic_int_add(&sib_view_views, -1);
+}
+
+gboolean sib_view_reset(SIBView *self, const gchar *results)
+{
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(results != NULL, FALSE);
+
+  g_atomic_int_inc(&sib_view_resets);
+  return sib_view_load(self, results);
+}
+
+gboolean sib_view_apply(SIBView *self,
+			gint sequence,
+			const gchar *added,
+			const gchar *removed)
+{
+  GSList *add = NULL;
+  GSList *remove = NULL;
+  gboolean ok = TRUE;
+
+  g_return_val_if_fail(self != NULL, FALSE);
+
+  if (self->stale)
+    return FALSE;
+
+  /* an indication was lost, the view may be missing changes */
+  if (self->sequence >= 0 && sequence != self->sequence + 1)
+    {
+      g_atomic_int_inc(&sib_view_gaps);
+      self->stale = TRUE;
+      return FALSE;
+    }
+
+  if (removed != NULL && *removed != '\0')
+    remove = sib_view_parse(removed, &ok);
+  if (ok && added != NULL && *added != '\0')
+    add = sib_view_parse(added, &ok);
+  if (!ok)
+    {
+      sib_triple_list_free(remove);
+      self->stale = TRUE;
+      return FALSE;
+    }
+
+  sib_view_remove(self, remove);
+  sib_view_add(self, add);
+  self->sequence = sequence;
+  g_free(self->results);
+  self->results = NULL;
+  g_atomic_int_inc(&sib_view_indications);
+  return TRUE;
+}
+
+gchar *sib_view_get_results(SIBView *self)
+{
+  GString *out = NULL;
+  GSList *triples = NULL;
+  GList *link = NULL;
+
+  g_return_val_if_fail(self != NULL, NULL);
+
+  if (self->stale)
+    return NULL;
+
+  /* rendered once per change, hot queries only copy it */
+  if (self->results == NULL)
+    {
+      for (link = g_queue_peek_tail_link(self->order); link != NULL; link = link->prev)
+	triples = g_slist_prepend(triples, link->data);
+      out = g_string_new(NULL);
+      sib_triple_list_append(out, triples);
+      g_slist_free(triples);
+      self->results = g_string_free(out, FALSE);
+    }
+  g_atomic_int_inc(&sib_view_answers);
+  return g_strdup(self->results);
+}
+
+gint sib_view_get_sequence(SIBView *self)
+{
+  g_return_val_if_fail(self != NULL, -1);
+
+  return self->sequence;
+}
+
+void sib_view_get_stats(SIBViewStats *stats)
+{
+  g_return_if_fail(stats != NULL);
+
+  stats->views = g_atomic_int_get(&sib_view_views);
+  stats->answers = g_atomic_int_get(&sib_view_answers);
+  stats->indications = g_atomic_int_get(&sib_view_indications);
+  stats->gaps = g_atomic_int_get(&sib_view_gaps);
+  stats->resets = g_atomic_int_get(&sib_view_resets);
+}